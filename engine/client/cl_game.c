@@ -1208,7 +1208,7 @@ static qboolean CL_LoadHudSprite( const char *szSpriteName, model_t *m_pSprite,
 		}
 	}
 
-	buf = FS_LoadFile( szSpriteName, &size, false );
+	buf = FS_MapFile( szSpriteName, &size, false );
 	if( buf == NULL )
 		return false;
 
@@ -1220,7 +1220,7 @@ static qboolean CL_LoadHudSprite( const char *szSpriteName, model_t *m_pSprite,
 		ref.dllFuncs.Mod_ProcessRenderData( m_pSprite, true, buf );
 	}
 
-	Mem_Free( buf );
+	FS_UnmapFile( buf );
 
 	if( !loaded )
 	{
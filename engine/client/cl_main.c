@@ -39,6 +39,7 @@ CVAR_DEFINE_AUTO( cl_download_ingame, "1", FCVAR_ARCHIVE, "allow to downloading
 CVAR_DEFINE_AUTO( cl_logofile, "lambda", FCVAR_ARCHIVE, "player logo name" );
 CVAR_DEFINE_AUTO( cl_logocolor, "orange", FCVAR_ARCHIVE, "player logo color" );
 CVAR_DEFINE_AUTO( cl_test_bandwidth, "1", FCVAR_ARCHIVE, "test network bandwith before connection" );
+CVAR_DEFINE_AUTO( cl_prefetch, "2", FCVAR_ARCHIVE, "threads reading resources in background while connecting, 0 to disable" );
 convar_t	*rcon_client_password;
 convar_t	*rcon_address;
 convar_t	*cl_timeout;
@@ -194,7 +195,7 @@ void CL_CheckClientState( void )
 		Cvar_SetValue( "scr_loading", 0.0f );	// reset progress bar
 		Netchan_ReportFlow( &cls.netchan );
 
-		Con_DPrintf( "client connected at %.2f sec\n", Sys_DoubleTime() - cls.timestart );
+		Con_DPrintf( "client connected at %.2f sec, prefetch %s\n", Sys_DoubleTime() - cls.timestart, cl_prefetch.value > 0.0f ? "on" : "off" );
 		if(( cls.demoplayback || cls.disable_servercount != cl.servercount ) && cl.video_prepped )
 			SCR_EndLoadingPlaque(); // get rid of loading plaque
 	}
@@ -1066,6 +1067,9 @@ void CL_SendConnectPacket( void )
 		if( cl_dlmax->value > FRAGMENT_MAX_SIZE  || cl_dlmax->value < FRAGMENT_MIN_SIZE )
 			Cvar_SetValue( "cl_dlmax", FRAGMENT_DEFAULT_SIZE );
 
+		if( net_deflate->value > 0.0f )
+			extensions |= NET_EXT_DEFLATE;
+
 		Info_RemoveKey( cls.userinfo, "cl_maxpacket" );
 		Info_RemoveKey( cls.userinfo, "cl_maxpayload" );
 
@@ -1335,6 +1339,7 @@ void CL_ClearState( void )
 	int	i;
 
 	CL_ClearResourceLists();
+	FS_PrefetchClear();
 
 	for( i = 0; i < MAX_CLIENTS; i++ )
 		COM_ClearCustomizationList( &cl.players[i].customdata, false );
@@ -1448,6 +1453,12 @@ void CL_Reconnect( qboolean setup_netchan )
 			{
 				Con_Reportf( "^2NET_EXT_SPLITSIZE enabled^7 (packet size is %d)\n", (int)cl_dlmax->value );
 			}
+
+			if( cls.extensions & NET_EXT_DEFLATE )
+			{
+				cls.netchan.deflate = true;
+				Con_Reportf( "^2NET_EXT_DEFLATE enabled^7\n" );
+			}
 		}
 
 	}
@@ -2808,6 +2819,7 @@ void CL_InitLocal( void )
 	Cvar_RegisterVariable( &cl_logofile );
 	Cvar_RegisterVariable( &cl_logocolor );
 	Cvar_RegisterVariable( &cl_test_bandwidth );
+	Cvar_RegisterVariable( &cl_prefetch );
 
 	// register our variables
 	cl_crosshair = Cvar_Get( "crosshair", "1", FCVAR_ARCHIVE, "show weapon chrosshair" );
@@ -1592,6 +1592,9 @@ void CL_RegisterResources( sizebuf_t *msg )
 
 			Mod_FreeUnused ();
 
+			// drop prefetched files nobody asked for
+			FS_PrefetchClear();
+
 			if( host_developer.value <= DEV_NONE )
 				Con_ClearNotify(); // clear any lines of console text
 
@@ -1667,6 +1670,45 @@ void CL_ParseConsistencyInfo( sizebuf_t *msg )
 	}
 }
 
+/*
+==============
+CL_PrefetchResources
+
+start reading resources which are already on disk,
+CL_PrecacheResources gets them from memory
+==============
+*/
+static void CL_PrefetchResources( void )
+{
+	resource_t	*pResource;
+
+	if( cl_prefetch.value <= 0.0f )
+		return;
+
+	for( pResource = cl.resourcesneeded.pNext; pResource != &cl.resourcesneeded; pResource = pResource->pNext )
+	{
+		switch( pResource->type )
+		{
+		case t_sound:
+			// sentences and streams
+			if( pResource->szFileName[0] == '!' || pResource->szFileName[0] == '*' )
+				break;
+			FS_PrefetchFile( va( DEFAULT_SOUNDPATH "%s", pResource->szFileName ));
+			break;
+		case t_model:
+			// world submodels
+			if( pResource->szFileName[0] == '*' )
+				break;
+			FS_PrefetchFile( pResource->szFileName );
+			break;
+		default:
+			break;
+		}
+	}
+
+	FS_PrefetchStart( (int)cl_prefetch.value );
+}
+
 /*
 ==============
 CL_ParseResourceList
@@ -1701,6 +1743,8 @@ void CL_ParseResourceList( sizebuf_t *msg )
 
 	CL_ParseConsistencyInfo( msg );
 
+	CL_PrefetchResources();
+
 	CL_StartResourceDownloading( "Verifying and downloading resources...\n", false );
 }
 
@@ -654,6 +654,7 @@ extern convar_t	cl_logocolor;
 extern convar_t	cl_allow_download;
 extern convar_t	cl_allow_upload;
 extern convar_t	cl_download_ingame;
+extern convar_t	cl_prefetch;
 extern convar_t	*cl_nopred;
 extern convar_t	*cl_showfps;
 extern convar_t	*cl_envshot_size;
@@ -405,6 +405,7 @@ typedef struct host_parm_s
 	double		realtime;		// host.curtime
 	double		frametime;	// time between engine frames
 	double		realframetime;	// for some system events, e.g. console animations
+	double		framestart;	// Sys_DoubleTime when current frame was started at realtime
 
 	uint		framecount;	// global framecount
 
@@ -514,6 +515,7 @@ void _Mem_Check( const char *filename, int fileline );
 qboolean Mem_IsAllocatedExt( byte *poolptr, void *data );
 void Mem_PrintList( size_t minallocationsize );
 void Mem_PrintStats( void );
+void Mem_GetAllocStats( size_t *numallocs, size_t *numbytes );
 
 #define Mem_Malloc( pool, size ) _Mem_Alloc( pool, size, false, __FILE__, __LINE__ )
 #define Mem_Calloc( pool, size ) _Mem_Alloc( pool, size, true, __FILE__, __LINE__ )
@@ -541,6 +543,11 @@ const char *FS_GetDiskPath( const char *name, qboolean gamedironly );
 byte *W_LoadLump( wfile_t *wad, const char *lumpname, size_t *lumpsizeptr, const char type );
 void W_Close( wfile_t *wad );
 byte *FS_LoadFile( const char *path, fs_offset_t *filesizeptr, qboolean gamedironly );
+byte *FS_MapFile( const char *path, fs_offset_t *filesizeptr, qboolean gamedironly );
+void FS_UnmapFile( byte *data );
+void FS_PrefetchFile( const char *path );
+void FS_PrefetchStart( int numthreads );
+void FS_PrefetchClear( void );
 qboolean CRC32_File( dword *crcvalue, const char *filename );
 qboolean MD5_HashFile( byte digest[16], const char *pszFileName, uint seed[4] );
 byte *FS_LoadDirectFile( const char *path, fs_offset_t *filesizeptr );
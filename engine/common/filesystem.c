@@ -27,6 +27,12 @@ GNU General Public License for more details.
 #include <dirent.h>
 #include <errno.h>
 #endif
+#if XASH_WIN32
+#include <windows.h>
+#elif XASH_POSIX
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
 #include "miniz.h" // header-only zlib replacement
 #include "common.h"
 #include "wadfile.h"
@@ -34,9 +40,14 @@ GNU General Public License for more details.
 #include "library.h"
 #include "xash3d_mathlib.h"
 #include "protocol.h"
+#include "threadpool.h"
 
 #define FILE_COPY_SIZE		(1024 * 1024)
 #define FILE_BUFF_SIZE		(2048)
+#define FS_MAP_MINSIZE		(64 * 1024)	// smaller files are cheaper to read than to map
+#define ZIP_MAX_SEEKPOINTS		8		// per deflated stream
+#define FS_PREFETCH_MAXSIZE		(256 * 1024 * 1024)	// memory for not yet loaded files
+#define ZIP_SEEKPOINT_SPACING		(512 * 1024)	// initial, grows with file
 
 // PAK errors
 #define PAK_LOAD_OK			0
@@ -72,12 +83,49 @@ typedef struct stringlist_s
 	char		**strings;
 } stringlist_t;
 
+typedef struct stringset_s
+{
+	// hash of stringlist_t strings, index + 1 or zero for free slot
+	int		size;
+	int		*table;
+} stringset_t;
+
 typedef struct wadtype_s
 {
 	char		*ext;
 	signed char		type;
 } wadtype_t;
 
+typedef struct zipseekpoint_s
+{
+	tinfl_decompressor	decomp;
+	byte		dict[TINFL_LZ_DICT_SIZE];
+	size_t		dict_ofs;
+	fs_offset_t	in_position;
+	fs_offset_t	out_position;
+	int		status;
+} zipseekpoint_t;
+
+typedef struct zipstream_s
+{
+	string		name;
+	tinfl_decompressor	decomp;
+	byte		dict[TINFL_LZ_DICT_SIZE];	// wrapping output window
+	size_t		dict_ofs;			// start of not handed out data
+	size_t		dict_avail;
+	int		status;			// last tinfl_status
+	fs_offset_t	in_position;		// compressed bytes read from archive
+	fs_offset_t	in_length;		// compressed file size
+	fs_offset_t	in_ind, in_len;		// input buffer index and length
+	byte		in[FILE_BUFF_SIZE * 4];
+	fs_offset_t	out_position;		// uncompressed bytes handed out
+	qboolean		seekable;			// file was seeked back, keep seek points
+	fs_offset_t	spacing;
+	fs_offset_t	nextpoint;
+	int		numpoints;
+	zipseekpoint_t	*points[ZIP_MAX_SEEKPOINTS];
+} zipstream_t;
+
 struct file_s
 {
 	int		handle;			// file descriptor
@@ -89,6 +137,7 @@ struct file_s
 						// contents buffer
 	fs_offset_t		buff_ind, buff_len;		// buffer current index and length
 	byte		buff[FILE_BUFF_SIZE];	// intermediate buffer
+	zipstream_t	*zstream;			// inflate state for deflated zip entries
 #ifdef XASH_REDUCE_FD
 	const char *backup_path;
 	fs_offset_t backup_position;
@@ -233,6 +282,20 @@ static int FS_SysFileTime( const char *filename );
 static signed char W_TypeFromExt( const char *lumpname );
 static const char *W_ExtFromType( signed char lumptype );
 static void FS_Purge( file_t* file );
+static void FS_IndexInit( void );
+#if !XASH_WIN32 && !XASH_IOS
+static const char *FS_IndexFixFileCase( const char *path, const char *dirpath, const char *filename );
+#endif
+static void FS_IndexInvalidate( void );
+static void FS_IndexRecheck( void );
+static void FS_IndexStats_f( void );
+static void FS_Bench_f( void );
+static file_t *FS_OpenHandle( const char *syspath, int handle, fs_offset_t offset, fs_offset_t len );
+static void Zip_Bench_f( void );
+static byte *FS_PrefetchTake( const char *path, fs_offset_t *filesizeptr, qboolean gamedironly );
+static void FS_PrefetchShutdown( void );
+static void FS_PrefetchBench_f( void );
+static void FS_MapBench_f( void );
 
 /*
 =============================================================================
@@ -284,6 +347,58 @@ static void stringlistappend( stringlist_t *list, char *text )
 	list->numstrings++;
 }
 
+static uint stringhash( const char *text )
+{
+	uint	hash = 2166136261u;
+
+	while( *text )
+	{
+		hash ^= (byte)*text++;
+		hash *= 16777619u;
+	}
+
+	return hash;
+}
+
+static void stringsetfree( stringset_t *set )
+{
+	if( set->table )
+		Mem_Free( set->table );
+	memset( set, 0, sizeof( *set ));
+}
+
+// appends string to list if it wasn't in it yet, set is lazily rebuilt from list
+static void stringlistappendunique( stringlist_t *list, stringset_t *set, char *text )
+{
+	int	i, slot;
+
+	if(( list->numstrings + 1 ) * 2 > set->size )
+	{
+		stringsetfree( set );
+		for( set->size = 256; set->size < ( list->numstrings + 1 ) * 2; set->size <<= 1 );
+		set->table = Mem_Calloc( fs_mempool, set->size * sizeof( *set->table ));
+
+		for( i = 0; i < list->numstrings; i++ )
+		{
+			for( slot = stringhash( list->strings[i] ) & ( set->size - 1 ); set->table[slot]; slot = ( slot + 1 ) & ( set->size - 1 ));
+			set->table[slot] = i + 1;
+		}
+	}
+
+	for( slot = stringhash( text ) & ( set->size - 1 ); set->table[slot]; slot = ( slot + 1 ) & ( set->size - 1 ))
+	{
+		if( !Q_strcmp( list->strings[set->table[slot] - 1], text ))
+			return;
+	}
+
+	i = list->numstrings;
+	stringlistappend( list, text );
+
+	// virtual directories are not added
+	if( list->numstrings != i )
+		set->table[slot] = i + 1;
+}
+
 static void stringlistsort( stringlist_t *list )
 {
 	char	*temp;
@@ -408,6 +523,7 @@ static const char *FS_FixFileCase( const char *path )
 #elif !XASH_WIN32 && !XASH_IOS // assume case insensitive
 	DIR *dir; struct dirent *entry;
 	char path2[PATH_MAX], *fname;
+	const char *fixed;
 
 	if( !fs_caseinsensitive )
 		return path;
@@ -446,6 +562,9 @@ static const char *FS_FixFileCase( const char *path )
 
 	//Con_Reportf( "FS_FixFileCase: %s\n", path );
 
+	if(( fixed = FS_IndexFixFileCase( path, path2, fname )) != NULL )
+		return fixed;
+
 	if( !( dir = opendir( path2 ) ) )
 		return path;
 
@@ -1009,6 +1128,412 @@ static byte *Zip_LoadFile( const char *path, fs_offset_t *sizeptr, qboolean game
 	return NULL;
 }
 
+/*
+=============================================================================
+
+ZIP STREAMS
+
+=============================================================================
+*/
+static struct
+{
+	qboolean	noseekpoints;	// for benchmark
+	uint	opened;
+	uint	restarts;
+	uint	restores;
+	uint	seekpoints;
+	size_t	inflated;
+	size_t	skipped;
+} fs_zstats;
+
+/*
+====================
+Zip_SaveSeekPoint
+
+snapshot decoder state at current stream position,
+keeps up to ZIP_MAX_SEEKPOINTS evenly spaced points
+====================
+*/
+static void Zip_SaveSeekPoint( zipstream_t *zs )
+{
+	zipseekpoint_t	*point;
+	int		i;
+
+	if( zs->numpoints == ZIP_MAX_SEEKPOINTS )
+	{
+		// thin out every other point and double spacing
+		for( i = 1; i < ZIP_MAX_SEEKPOINTS / 2; i++ )
+		{
+			point = zs->points[i];
+			zs->points[i] = zs->points[i * 2];
+			zs->points[i * 2] = point;
+		}
+
+		zs->numpoints = ZIP_MAX_SEEKPOINTS / 2;
+		zs->spacing *= 2;
+
+		if( zs->out_position < zs->points[zs->numpoints - 1]->out_position + zs->spacing )
+			return;
+	}
+
+	if( !zs->points[zs->numpoints] )
+		zs->points[zs->numpoints] = Mem_Malloc( fs_mempool, sizeof( zipseekpoint_t ));
+	point = zs->points[zs->numpoints];
+
+	point->decomp = zs->decomp;
+	memcpy( point->dict, zs->dict, TINFL_LZ_DICT_SIZE );
+	point->dict_ofs = zs->dict_ofs;
+	point->in_position = zs->in_position - ( zs->in_len - zs->in_ind );
+	point->out_position = zs->out_position;
+	point->status = zs->status;
+	zs->numpoints++;
+	fs_zstats.seekpoints++;
+}
+
+/*
+====================
+Zip_RestartStream
+
+move decoder to nearest known position at or before offset
+====================
+*/
+static void Zip_RestartStream( zipstream_t *zs, fs_offset_t offset )
+{
+	zipseekpoint_t	*point = NULL;
+	int		i;
+
+	for( i = 0; i < zs->numpoints && zs->points[i]->out_position <= offset; i++ )
+		point = zs->points[i];
+
+	if( point )
+	{
+		zs->decomp = point->decomp;
+		memcpy( zs->dict, point->dict, TINFL_LZ_DICT_SIZE );
+		zs->dict_ofs = point->dict_ofs;
+		zs->in_position = point->in_position;
+		zs->out_position = point->out_position;
+		zs->status = point->status;
+		fs_zstats.restores++;
+	}
+	else
+	{
+		tinfl_init( &zs->decomp );
+		zs->dict_ofs = 0;
+		zs->in_position = 0;
+		zs->out_position = 0;
+		zs->status = TINFL_STATUS_NEEDS_MORE_INPUT;
+		fs_zstats.restarts++;
+	}
+
+	zs->dict_avail = 0;
+	zs->in_ind = zs->in_len = 0;
+
+	if( zs->numpoints )
+		zs->nextpoint = zs->points[zs->numpoints - 1]->out_position + zs->spacing;
+	else zs->nextpoint = zs->spacing;
+}
+
+/*
+====================
+Zip_Inflate
+
+decode next count bytes of stream into dest, or drop them if dest is NULL
+====================
+*/
+static fs_offset_t Zip_Inflate( file_t *file, byte *dest, fs_offset_t count )
+{
+	zipstream_t	*zs = file->zstream;
+	fs_offset_t	done = 0;
+
+	while( done < count )
+	{
+		size_t	in_bytes, out_bytes;
+		uint	flags = 0;
+
+		// hand out already decoded data
+		if( zs->dict_avail )
+		{
+			fs_offset_t	n = Q_min( (fs_offset_t)zs->dict_avail, count - done );
+
+			if( dest ) memcpy( dest + done, zs->dict + zs->dict_ofs, n );
+			zs->dict_ofs = ( zs->dict_ofs + n ) & ( TINFL_LZ_DICT_SIZE - 1 );
+			zs->dict_avail -= n;
+			zs->out_position += n;
+			done += n;
+			continue;
+		}
+
+		if( zs->status == TINFL_STATUS_DONE || zs->status < 0 )
+			break;
+
+		if( zs->seekable && zs->out_position >= zs->nextpoint )
+		{
+			Zip_SaveSeekPoint( zs );
+			zs->nextpoint = zs->out_position + zs->spacing;
+		}
+
+		if( zs->in_ind == zs->in_len && zs->in_position < zs->in_length )
+		{
+			fs_offset_t	nb = Q_min( (fs_offset_t)sizeof( zs->in ), zs->in_length - zs->in_position );
+
+			FS_EnsureOpenFile( file );
+			lseek( file->handle, file->offset + zs->in_position, SEEK_SET );
+			nb = read( file->handle, zs->in, nb );
+
+			if( nb <= 0 )
+			{
+				zs->status = TINFL_STATUS_FAILED;
+				break;
+			}
+
+			zs->in_ind = 0;
+			zs->in_len = nb;
+			zs->in_position += nb;
+		}
+
+		if( zs->in_position < zs->in_length )
+			flags |= TINFL_FLAG_HAS_MORE_INPUT;
+
+		in_bytes = zs->in_len - zs->in_ind;
+		out_bytes = TINFL_LZ_DICT_SIZE - zs->dict_ofs;
+
+		zs->status = tinfl_decompress( &zs->decomp, zs->in + zs->in_ind, &in_bytes, zs->dict, zs->dict + zs->dict_ofs, &out_bytes, flags );
+
+		zs->in_ind += in_bytes;
+		zs->dict_avail = out_bytes;
+
+		if( zs->status == TINFL_STATUS_NEEDS_MORE_INPUT && !out_bytes && zs->in_ind == zs->in_len && zs->in_position >= zs->in_length )
+			zs->status = TINFL_STATUS_FAILED_CANNOT_MAKE_PROGRESS;
+	}
+
+	if( zs->status < 0 && done < count )
+		Con_Reportf( S_ERROR "Zip_Inflate: %s is corrupted (%d)\n", zs->name, zs->status );
+
+	return done;
+}
+
+/*
+====================
+Zip_ReadStream
+
+read from current file position, seeks are done lazily here
+====================
+*/
+static fs_offset_t Zip_ReadStream( file_t *file, byte *dest, fs_offset_t count )
+{
+	zipstream_t	*zs = file->zstream;
+
+	if( file->position != zs->out_position )
+	{
+		if( file->position < zs->out_position )
+		{
+			// file seeks back, start to remember seek points
+			zs->seekable = !fs_zstats.noseekpoints;
+
+			Zip_RestartStream( zs, file->position );
+		}
+
+		fs_zstats.skipped += file->position - zs->out_position;
+		Zip_Inflate( file, NULL, file->position - zs->out_position );
+
+		if( file->position != zs->out_position )
+			return 0;
+	}
+
+	count = Zip_Inflate( file, dest, count );
+	fs_zstats.inflated += count;
+
+	return count;
+}
+
+/*
+====================
+Zip_OpenStream
+
+Open deflated file for reading, it's decoded in small window when read
+====================
+*/
+static file_t *Zip_OpenStream( zip_t *zip, zipfile_t *pfile )
+{
+	file_t		*file;
+	zipstream_t	*zs;
+
+	file = FS_OpenHandle( zip->filename, zip->handle, pfile->offset, pfile->size );
+	if( !file ) return NULL;
+
+	zs = Mem_Calloc( fs_mempool, sizeof( *zs ));
+	Q_strncpy( zs->name, pfile->name, sizeof( zs->name ));
+	zs->in_length = pfile->compressed_size;
+	zs->spacing = ZIP_SEEKPOINT_SPACING;
+	tinfl_init( &zs->decomp );
+	zs->status = TINFL_STATUS_NEEDS_MORE_INPUT;
+
+	file->zstream = zs;
+	fs_zstats.opened++;
+
+	return file;
+}
+
+/*
+====================
+Zip_CloseStream
+
+====================
+*/
+static void Zip_CloseStream( file_t *file )
+{
+	zipstream_t	*zs = file->zstream;
+	int		i;
+
+	for( i = 0; i < ZIP_MAX_SEEKPOINTS; i++ )
+	{
+		if( zs->points[i] )
+			Mem_Free( zs->points[i] );
+	}
+
+	Mem_Free( zs );
+	file->zstream = NULL;
+}
+
+/*
+====================
+Zip_Bench_f
+
+compare whole file inflate with streaming reads and seeks
+====================
+*/
+static void Zip_Bench_f( void )
+{
+	searchpath_t	*search;
+	stringlist_t	names;
+	double		start, elapsed[4];
+	size_t		total[4] = { 0 };
+	int		i, j, pass, mismatches = 0;
+	uint		seed = 1;
+
+	stringlistinit( &names );
+
+	for( search = fs_searchpaths; search; search = search->next )
+	{
+		if( !search->zip ) continue;
+
+		for( i = 0; i < search->zip->numfiles; i++ )
+		{
+			if( search->zip->files[i].flags == ZIP_COMPRESSION_DEFLATED )
+				stringlistappend( &names, search->zip->files[i].name );
+		}
+	}
+
+	if( !names.numstrings )
+	{
+		Con_Printf( "fs_zip_bench: no deflated zip entries in search paths\n" );
+		return;
+	}
+
+	// make sure streams give same data as whole inflate
+	for( i = 0; i < names.numstrings; i++ )
+	{
+		byte		buffer[4096], *data;
+		fs_offset_t	size, pos, nb;
+		file_t		*file;
+
+		data = Zip_LoadFile( names.strings[i], &size, false );
+		file = FS_Open( names.strings[i], "rb", false );
+
+		if( !data || !file || FS_FileLength( file ) != size )
+			mismatches++;
+		else
+		{
+			for( pos = 0; ( nb = FS_Read( file, buffer, sizeof( buffer ))) > 0; pos += nb )
+			{
+				if( memcmp( buffer, data + pos, nb ))
+					break;
+			}
+
+			if( pos != size )
+				mismatches++;
+
+			for( j = 0; j < 16; j++ )
+			{
+				seed = seed * 1103515245 + 12345;
+				pos = (fs_offset_t)( seed >> 8 ) % Q_max( 1, size );
+				FS_Seek( file, pos, SEEK_SET );
+				nb = FS_Read( file, buffer, sizeof( buffer ));
+
+				if( nb != Q_min( size - pos, (fs_offset_t)sizeof( buffer )) || memcmp( buffer, data + pos, nb ))
+				{
+					mismatches++;
+					break;
+				}
+			}
+		}
+
+		if( data ) Mem_Free( data );
+		FS_Close( file );
+	}
+
+	for( pass = 0; pass < 4; pass++ )
+	{
+		start = Sys_DoubleTime();
+
+		for( i = 0; i < names.numstrings; i++ )
+		{
+			byte		buffer[4096];
+			fs_offset_t	size;
+			file_t		*file;
+
+			if( pass == 0 )
+			{
+				byte	*data = Zip_LoadFile( names.strings[i], &size, false );
+
+				if( data )
+				{
+					total[pass] += size;
+					Mem_Free( data );
+				}
+				continue;
+			}
+
+			if(( file = FS_Open( names.strings[i], "rb", false )) == NULL )
+				continue;
+
+			fs_zstats.noseekpoints = ( pass == 2 );
+
+			if( pass == 1 )
+			{
+				// sequential reads like sound streaming
+				while(( size = FS_Read( file, buffer, sizeof( buffer ))) > 0 )
+					total[pass] += size;
+			}
+			else
+			{
+				// random reads, like seeking in file
+				for( j = 0; j < 32; j++ )
+				{
+					seed = seed * 1103515245 + 12345;
+					FS_Seek( file, (fs_offset_t)( seed >> 8 ) % Q_max( 1, file->real_length ), SEEK_SET );
+					total[pass] += FS_Read( file, buffer, sizeof( buffer ));
+				}
+			}
+
+			FS_Close( file );
+		}
+
+		elapsed[pass] = Sys_DoubleTime() - start;
+	}
+
+	fs_zstats.noseekpoints = false;
+
+	Con_Printf( "%i deflated files, %i mismatches\n", names.numstrings, mismatches );
+	Con_Printf( "whole inflate:      %.1f MB in %.3f sec, %.1f MB/s\n", total[0] / ( 1024.0 * 1024.0 ), elapsed[0], total[0] / ( 1024.0 * 1024.0 ) / elapsed[0] );
+	Con_Printf( "streamed reads:     %.1f MB in %.3f sec, %.1f MB/s, %d KB per stream\n", total[1] / ( 1024.0 * 1024.0 ), elapsed[1], total[1] / ( 1024.0 * 1024.0 ) / elapsed[1], (int)( sizeof( zipstream_t ) / 1024 ));
+	Con_Printf( "random reads:       %.3f ms per read without seek points, %.3f ms with\n", elapsed[2] * 1000.0 / ( names.numstrings * 32 ), elapsed[3] * 1000.0 / ( names.numstrings * 32 ));
+	Con_Printf( "streams %u, restarts %u, restores %u, seek points %u, inflated %.1f MB, skipped %.1f MB\n", fs_zstats.opened, fs_zstats.restarts,
+		fs_zstats.restores, fs_zstats.seekpoints, fs_zstats.inflated / ( 1024.0 * 1024.0 ), fs_zstats.skipped / ( 1024.0 * 1024.0 ));
+
+	stringlistfreecontents( &names );
+}
+
 /*
 ====================
 FS_AddWad_Fullpath
@@ -1043,6 +1568,7 @@ static qboolean FS_AddWad_Fullpath( const char *wadfile, qboolean *already_loade
 		search->next = fs_searchpaths;
 		search->flags |= flags;
 		fs_searchpaths = search;
+		FS_IndexInvalidate();
 
 		Con_Reportf( "Adding wadfile: %s (%i files)\n", wadfile, wad->numlumps );
 		return true;
@@ -1100,6 +1626,7 @@ static qboolean FS_AddPak_Fullpath( const char *pakfile, qboolean *already_loade
 		search->next = fs_searchpaths;
 		search->flags |= flags;
 		fs_searchpaths = search;
+		FS_IndexInvalidate();
 
 		Con_Reportf( "Adding pakfile: %s (%i files)\n", pakfile, pak->numfiles );
 
@@ -1154,6 +1681,7 @@ qboolean FS_AddZip_Fullpath( const char *zipfile, qboolean *already_loaded, int
 		search->next = fs_searchpaths;
 		search->flags |= flags;
 		fs_searchpaths = search;
+		FS_IndexInvalidate();
 
 		Con_Reportf( "Adding zipfile: %s (%i files)\n", zipfile, zip->numfiles );
 
@@ -1239,6 +1767,7 @@ void FS_AddGameDirectory( const char *dir, uint flags )
 	search->next = fs_searchpaths;
 	search->flags = flags;
 	fs_searchpaths = search;
+	FS_IndexInvalidate();
 }
 
 /*
@@ -1300,6 +1829,9 @@ FS_ClearSearchPath
 */
 void FS_ClearSearchPath( void )
 {
+	FS_IndexInvalidate();
+	FS_PrefetchClear();
+
 	while( fs_searchpaths )
 	{
 		searchpath_t	*search = fs_searchpaths;
@@ -2039,10 +2571,16 @@ void FS_Init( void )
 	int		i;
 
 	FS_InitMemory();
+	FS_IndexInit();
 
 	Cmd_AddCommand( "fs_rescan", FS_Rescan_f, "rescan filesystem search pathes" );
 	Cmd_AddCommand( "fs_path", FS_Path_f, "show filesystem search pathes" );
 	Cmd_AddCommand( "fs_clearpaths", FS_ClearPaths_f, "clear filesystem search pathes" );
+	Cmd_AddCommand( "fs_index_stats", FS_IndexStats_f, "show file index statistics, 'reset' to clear counters" );
+	Cmd_AddCommand( "fs_bench", FS_Bench_f, "measure file lookups per second with and without file index" );
+	Cmd_AddCommand( "fs_map_bench", FS_MapBench_f, "compare loading archived files into memory and mapping them" );
+	Cmd_AddCommand( "fs_zip_bench", Zip_Bench_f, "compare inflating deflated zip files whole and streaming them" );
+	Cmd_AddCommand( "fs_prefetch_bench", FS_PrefetchBench_f, "compare loading files one by one and after background prefetch, optional number of threads" );
 
 #if !XASH_WIN32
 	if( Sys_CheckParm( "-casesensitive" ) )
@@ -2160,6 +2698,7 @@ void FS_Shutdown( void )
 
 	memset( &SI, 0, sizeof( sysinfo_t ));
 
+	FS_PrefetchShutdown();
 	FS_ClearSearchPath(); // release all wad files too
 	Mem_FreePool( &fs_mempool );
 }
@@ -2342,7 +2881,10 @@ file_t *FS_OpenZipFile( zip_t *zip, int pack_ind )
 	zipfile_t	*pfile;
 	pfile = &zip->files[pack_ind];
 
-	// compressed files handled in Zip_LoadFile
+	// deflated files are inflated while read
+	if( pfile->flags == ZIP_COMPRESSION_DEFLATED )
+		return Zip_OpenStream( zip, pfile );
+
 	if( pfile->flags != ZIP_COMPRESSION_NO_COMPRESSION )
 		return NULL;
 
@@ -2422,661 +2964,2528 @@ qboolean FS_SysFolderExists( const char *path )
 
 /*
 ====================
-FS_FindFile
-
-Look for a file in the packages and in the filesystem
+FS_FindInWad
 
-Return the searchpath where the file was found (or NULL)
-and the file index in the package if relevant
+Look for a lump matching file name and type
 ====================
 */
-static searchpath_t *FS_FindFile( const char *name, int *index, qboolean gamedironly )
+static qboolean FS_FindInWad( searchpath_t *search, const char *name, int *index )
 {
-	searchpath_t	*search;
-	char		*pEnvPath;
-
-	// search through the path, one element at a time
-	for( search = fs_searchpaths; search; search = search->next )
+	dlumpinfo_t	*lump;
+	signed char		type = W_TypeFromExt( name );
+	qboolean		anywadname = true;
+	string		wadname, wadfolder;
+	string		shortname;
+
+	// quick reject by filetype
+	if( type == TYP_NONE ) return false;
+	COM_ExtractFilePath( name, wadname );
+	wadfolder[0] = '\0';
+
+	if( COM_CheckStringEmpty( wadname ) )
 	{
-		if( gamedironly & !FBitSet( search->flags, FS_GAMEDIRONLY_SEARCH_FLAGS ))
-			continue;
+		COM_FileBase( wadname, wadname );
+		Q_strncpy( wadfolder, wadname, sizeof( wadfolder ));
+		COM_DefaultExtension( wadname, ".wad" );
+		anywadname = false;
+	}
 
-		// is the element a pak file?
-		if( search->pack )
-		{
-			int	left, right, middle;
-			pack_t	*pak;
+	// make wadname from wad fullpath
+	COM_FileBase( search->wad->filename, shortname );
+	COM_DefaultExtension( shortname, ".wad" );
 
-			pak = search->pack;
+	// quick reject by wadname
+	if( !anywadname && Q_stricmp( wadname, shortname ))
+		return false;
 
-			// look for the file (binary search)
-			left = 0;
-			right = pak->numfiles - 1;
-			while( left <= right )
-			{
-				int	diff;
+	// NOTE: we can't using long names for wad,
+	// because we using original wad names[16];
+	COM_FileBase( name, shortname );
 
-				middle = (left + right) / 2;
-				diff = Q_stricmp( pak->files[middle].name, name );
+	lump = W_FindLump( search->wad, shortname, type );
 
-				// Found it
-				if( !diff )
-				{
-					if( index ) *index = middle;
-					return search;
-				}
+	if( lump )
+	{
+		if( index )
+			*index = lump - search->wad->lumps;
+		return true;
+	}
 
-				// if we're too far in the list
-				if( diff > 0 )
-					right = middle - 1;
-				else left = middle + 1;
-			}
+	return false;
+}
+
+/*
+=============================================================================
+
+FILE INDEX
+
+=============================================================================
+*/
+#define FS_INDEX_RECHECK	1.0	// seconds between directory changes checks
+#define FS_INDEX_HASHSIZE	1024	// must be power of two
+#define FS_INDEX_MAXDIRS	8192
+#define FS_INDEX_MAXMISSES	8192
+
+typedef struct fsarchive_s
+{
+	const char	*name;		// owned by pack or zip
+	uint		hash;
+	searchpath_t	*search;		// first match
+	int		index;
+	searchpath_t	*gamesearch;	// first match in gamedir paths
+	int		gameindex;
+} fsarchive_t;
+
+typedef struct fsdir_s
+{
+	searchpath_t	*search;		// NULL for FS_FixFileCase directories
+	char		*path;		// relative to searchpath, exact case
+	uint		hash;
+	int		mtime;		// -1 if directory doesn't exist
+	int		scantime;
+	int		numfiles;
+	int		numsubdirs;
+	int		tablesize;	// power of two
+	int		*table;		// name offset + 1, zero is free slot
+	uint		*hashes;
+	char		*names;		// files then subdirs, real case, zero separated
+	struct fsdir_s	*next;
+} fsdir_t;
+
+typedef struct fsmiss_s
+{
+	uint		hash;
+	qboolean		gamedironly;
+	struct fsmiss_s	*next;
+	char		name[1];
+} fsmiss_t;
+
+static struct
+{
+	qboolean		disabled;		// walk the search paths as before
+	qboolean		dirty;		// search paths are changed
+	fsarchive_t	*archives;
+	int		archivesize;	// power of two
+	int		numarchives;
+	fsdir_t		*dirs[FS_INDEX_HASHSIZE];
+	int		numdirs;
+	fsmiss_t		*misses[FS_INDEX_HASHSIZE];
+	int		nummisses;
+	double		nextcheck;
+
+	struct
+	{
+		uint	lookups;
+		uint	misses;		// answered from negative cache
+		uint	builds;
+		uint	dirscans;
+		uint	dirchecks;
+		uint	casefixes;
+		uint	casescans;	// directory scans caused by FS_FixFileCase
+	} stats;
+} fs_index;
+
+/*
+====================
+FS_IndexHash
+
+case insensitive FNV-1a
+====================
+*/
+static uint FS_IndexHash( const char *s )
+{
+	uint	hash = 2166136261u;
+
+	while( *s )
+	{
+		hash ^= (byte)Q_tolower( *s++ );
+		hash *= 16777619u;
+	}
+
+	return hash;
+}
+
+/*
+====================
+FS_IndexCaseSensitive
+
+loose files in custom paths are searched with exact case
+====================
+*/
+static qboolean FS_IndexCaseSensitive( const searchpath_t *search )
+{
+#if XASH_WIN32
+	return false;
+#else
+	return !fs_caseinsensitive || FBitSet( search->flags, FS_CUSTOM_PATH );
+#endif
+}
+
+/*
+====================
+FS_IndexFreeDir
+
+====================
+*/
+static void FS_IndexFreeDirFiles( fsdir_t *dir )
+{
+	if( dir->table ) Mem_Free( dir->table );
+	if( dir->hashes ) Mem_Free( dir->hashes );
+	if( dir->names ) Mem_Free( dir->names );
+
+	dir->table = NULL;
+	dir->hashes = NULL;
+	dir->names = NULL;
+	dir->numfiles = dir->numsubdirs = dir->tablesize = 0;
+}
+
+/*
+====================
+FS_IndexFlushMisses
+
+====================
+*/
+static void FS_IndexFlushMisses( void )
+{
+	int	i;
+
+	for( i = 0; i < FS_INDEX_HASHSIZE; i++ )
+	{
+		while( fs_index.misses[i] )
+		{
+			fsmiss_t	*miss = fs_index.misses[i];
+
+			fs_index.misses[i] = miss->next;
+			Mem_Free( miss );
 		}
-		else if( search->wad )
+	}
+
+	fs_index.nummisses = 0;
+}
+
+/*
+====================
+FS_IndexFlushDirs
+
+====================
+*/
+static void FS_IndexFlushDirs( void )
+{
+	int	i;
+
+	for( i = 0; i < FS_INDEX_HASHSIZE; i++ )
+	{
+		while( fs_index.dirs[i] )
 		{
-			dlumpinfo_t	*lump;
-			signed char		type = W_TypeFromExt( name );
-			qboolean		anywadname = true;
-			string		wadname, wadfolder;
-			string		shortname;
+			fsdir_t	*dir = fs_index.dirs[i];
 
-			// quick reject by filetype
-			if( type == TYP_NONE ) continue;
-			COM_ExtractFilePath( name, wadname );
-			wadfolder[0] = '\0';
+			fs_index.dirs[i] = dir->next;
+			FS_IndexFreeDirFiles( dir );
+			Mem_Free( dir->path );
+			Mem_Free( dir );
+		}
+	}
 
-			if( COM_CheckStringEmpty( wadname ) )
-			{
-				COM_FileBase( wadname, wadname );
-				Q_strncpy( wadfolder, wadname, sizeof( wadfolder ));
-				COM_DefaultExtension( wadname, ".wad" );
-				anywadname = false;
-			}
+	fs_index.numdirs = 0;
+}
 
-			// make wadname from wad fullpath
-			COM_FileBase( search->wad->filename, shortname );
-			COM_DefaultExtension( shortname, ".wad" );
+/*
+====================
+FS_IndexInvalidate
 
-			// quick reject by wadname
-			if( !anywadname && Q_stricmp( wadname, shortname ))
-				continue;
+must be called when search paths are added or removed
+====================
+*/
+static void FS_IndexInvalidate( void )
+{
+	FS_IndexFlushMisses();
+	FS_IndexFlushDirs();
 
-			// NOTE: we can't using long names for wad,
-			// because we using original wad names[16];
-			COM_FileBase( name, shortname );
+	if( fs_index.archives )
+		Mem_Free( fs_index.archives );
 
-			lump = W_FindLump( search->wad, shortname, type );
+	fs_index.archives = NULL;
+	fs_index.archivesize = fs_index.numarchives = 0;
+	fs_index.dirty = true;
+}
 
-			if( lump )
-			{
-				if( index )
-					*index = lump - search->wad->lumps;
-				return search;
-			}
+/*
+====================
+FS_IndexInit
+
+====================
+*/
+static void FS_IndexInit( void )
+{
+#if XASH_DOS4GW
+	// loose files are found by 8.3 names
+	fs_index.disabled = true;
+#else
+	fs_index.disabled = Sys_CheckParm( "-nofsindex" );
+#endif
+	fs_index.dirty = true;
+}
+
+/*
+====================
+FS_IndexTouch
+
+files were written by engine, look at directories on next lookup
+====================
+*/
+static void FS_IndexTouch( void )
+{
+	fs_index.nextcheck = 0.0;
+}
+
+/*
+====================
+FS_IndexAddArchive
+
+====================
+*/
+static void FS_IndexAddArchive( searchpath_t *search, const char *name, int index )
+{
+	uint		hash = FS_IndexHash( name );
+	int		i = hash & ( fs_index.archivesize - 1 );
+	fsarchive_t	*entry;
+
+	for( ; fs_index.archives[i].name; i = ( i + 1 ) & ( fs_index.archivesize - 1 ))
+	{
+		if( fs_index.archives[i].hash == hash && !Q_stricmp( fs_index.archives[i].name, name ))
+			break;
+	}
+
+	entry = &fs_index.archives[i];
+
+	if( !entry->name )
+	{
+		entry->name = name;
+		entry->hash = hash;
+		entry->search = search;
+		entry->index = index;
+		fs_index.numarchives++;
+	}
+
+	if( !entry->gamesearch && FBitSet( search->flags, FS_GAMEDIRONLY_SEARCH_FLAGS ))
+	{
+		entry->gamesearch = search;
+		entry->gameindex = index;
+	}
+}
+
+/*
+====================
+FS_IndexBuild
+
+put all pak and zip entries in one table,
+first added is the one with highest priority
+====================
+*/
+static void FS_IndexBuild( void )
+{
+	searchpath_t	*search;
+	int		i, count = 0;
+
+	for( search = fs_searchpaths; search; search = search->next )
+	{
+		if( search->pack ) count += search->pack->numfiles;
+		else if( search->zip ) count += search->zip->numfiles;
+	}
+
+	for( fs_index.archivesize = 64; fs_index.archivesize < count * 2; fs_index.archivesize <<= 1 );
+	fs_index.archives = Mem_Calloc( fs_mempool, fs_index.archivesize * sizeof( *fs_index.archives ));
+	fs_index.numarchives = 0;
+
+	for( search = fs_searchpaths; search; search = search->next )
+	{
+		if( search->pack )
+		{
+			for( i = 0; i < search->pack->numfiles; i++ )
+				FS_IndexAddArchive( search, search->pack->files[i].name, i );
 		}
 		else if( search->zip )
 		{
-			int     left, right, middle;
-			zip_t  *zip;
+			for( i = 0; i < search->zip->numfiles; i++ )
+				FS_IndexAddArchive( search, search->zip->files[i].name, i );
+		}
+	}
 
-			zip = search->zip;
+	fs_index.dirty = false;
+	fs_index.stats.builds++;
+}
 
-			// look for the file (binary search)
-			left = 0;
-			right = zip->numfiles - 1;
+/*
+====================
+FS_IndexStatDir
 
-			while( left <= right )
-			{
-				int     diff;
+returns directory mtime or -1
+====================
+*/
+static int FS_IndexStatDir( const fsdir_t *dir )
+{
+	char	path[MAX_SYSPATH];
+	int	len;
 
-				middle = (left + right) / 2;
-				diff = Q_stricmp( zip->files[middle].name, name );
+	len = Q_snprintf( path, sizeof( path ), "%s%s", dir->search ? dir->search->filename : "", dir->path );
 
-				// Found it
-				if( !diff )
-				{
-					if( index ) *index = middle;
-					return search;
-				}
+	// windows stat doesn't like trailing slashes
+	while( len > 1 && ( path[len - 1] == '/' || path[len - 1] == '\\' ))
+		path[--len] = '\0';
 
-				// if we're too far in the list
-				if( diff > 0 )
-					right = middle - 1;
-				else left = middle + 1;
+	if( len <= 0 ) return -1;
+
+	return FS_SysFileTime( path );
+}
+
+/*
+====================
+FS_IndexScanDir
+
+remember names of regular files and subdirectories,
+only files can be found by name
+====================
+*/
+static void FS_IndexScanDir( fsdir_t *dir )
+{
+	char		path[MAX_SYSPATH];
+	stringlist_t	list, subdirs;
+	size_t		size = 0;
+	int		i, ofs;
+#if XASH_WIN32
+	struct _finddata_t	n_file;
+	intptr_t		hFile;
+#else
+	DIR		*handle;
+	struct dirent	*entry;
+#endif
+
+	FS_IndexFreeDirFiles( dir );
+	dir->mtime = FS_IndexStatDir( dir );
+	dir->scantime = (int)time( NULL );
+	fs_index.stats.dirscans++;
+
+	if( dir->mtime == -1 )
+		return;
+
+	stringlistinit( &list );
+	stringlistinit( &subdirs );
+
+#if XASH_WIN32
+	Q_snprintf( path, sizeof( path ), "%s%s*", dir->search ? dir->search->filename : "", dir->path );
+
+	if(( hFile = _findfirst( path, &n_file )) != -1 )
+	{
+		do
+		{
+			if( FBitSet( n_file.attrib, _A_SUBDIR ))
+				stringlistappend( &subdirs, n_file.name );
+			else stringlistappend( &list, n_file.name );
+		} while( _findnext( hFile, &n_file ) == 0 );
+		_findclose( hFile );
+	}
+#else
+	Q_snprintf( path, sizeof( path ), "%s%s", dir->search ? dir->search->filename : "", dir->path );
+
+	if(( handle = opendir( path )) != NULL )
+	{
+		while(( entry = readdir( handle )))
+		{
+			qboolean	isdir = false;
+#ifdef DT_REG
+			if( entry->d_type == DT_DIR )
+				isdir = true;
+			else if( entry->d_type == DT_LNK || entry->d_type == DT_UNKNOWN )
+#endif
+			{
+				char		filepath[MAX_SYSPATH];
+				struct stat	buf;
+
+				Q_snprintf( filepath, sizeof( filepath ), "%s%s", path, entry->d_name );
+				if( stat( filepath, &buf ) < 0 )
+					continue;
+
+				if( S_ISDIR( buf.st_mode ))
+					isdir = true;
+				else if( !S_ISREG( buf.st_mode ))
+					continue;
 			}
+#ifdef DT_REG
+			else if( entry->d_type != DT_REG )
+				continue;
+#endif
+			stringlistappend( isdir ? &subdirs : &list, entry->d_name );
 		}
-		else
-		{
-			char	netpath[MAX_SYSPATH];
+		closedir( handle );
+	}
+#endif
 
-			Q_sprintf( netpath, "%s%s", search->filename, name );
+	for( i = 0; i < list.numstrings; i++ )
+		size += Q_strlen( list.strings[i] ) + 1;
+	for( i = 0; i < subdirs.numstrings; i++ )
+		size += Q_strlen( subdirs.strings[i] ) + 1;
+
+	for( dir->tablesize = 16; dir->tablesize < list.numstrings * 2; dir->tablesize <<= 1 );
+	dir->table = Mem_Calloc( fs_mempool, dir->tablesize * sizeof( *dir->table ));
+	dir->hashes = Mem_Calloc( fs_mempool, dir->tablesize * sizeof( *dir->hashes ));
+	dir->names = Mem_Malloc( fs_mempool, size + 1 );
+	dir->numfiles = list.numstrings;
+	dir->numsubdirs = subdirs.numstrings;
+
+	for( i = 0, ofs = 0; i < list.numstrings; i++ )
+	{
+		uint	hash = FS_IndexHash( list.strings[i] );
+		int	slot = hash & ( dir->tablesize - 1 );
+
+		while( dir->table[slot] )
+			slot = ( slot + 1 ) & ( dir->tablesize - 1 );
+
+		dir->table[slot] = ofs + 1;
+		dir->hashes[slot] = hash;
+		Q_strcpy( dir->names + ofs, list.strings[i] );
+		ofs += Q_strlen( list.strings[i] ) + 1;
+	}
+
+	for( i = 0; i < subdirs.numstrings; i++ )
+	{
+		Q_strcpy( dir->names + ofs, subdirs.strings[i] );
+		ofs += Q_strlen( subdirs.strings[i] ) + 1;
+	}
+
+	stringlistfreecontents( &list );
+	stringlistfreecontents( &subdirs );
+}
+
+/*
+====================
+FS_IndexGetDir
+
+returns cached directory listing, scan it on first use
+====================
+*/
+static fsdir_t *FS_IndexGetDir( searchpath_t *search, const char *path, int pathlen )
+{
+	fsdir_t	*dir;
+	uint	hash = 2166136261u;
+	int	i;
+
+	for( i = 0; i < pathlen; i++ )
+	{
+		hash ^= (byte)path[i];
+		hash *= 16777619u;
+	}
+
+	for( dir = fs_index.dirs[hash & ( FS_INDEX_HASHSIZE - 1 )]; dir; dir = dir->next )
+	{
+		if( dir->search == search && dir->hash == hash && !Q_strncmp( dir->path, path, pathlen ) && !dir->path[pathlen] )
+			return dir;
+	}
+
+	// something is looking for garbage names,
+	// cached misses may be answered by flushed dirs
+	if( fs_index.numdirs >= FS_INDEX_MAXDIRS )
+	{
+		FS_IndexFlushMisses();
+		FS_IndexFlushDirs();
+	}
+
+	dir = Mem_Calloc( fs_mempool, sizeof( *dir ));
+	dir->search = search;
+	dir->hash = hash;
+	dir->path = Mem_Malloc( fs_mempool, pathlen + 1 );
+	memcpy( dir->path, path, pathlen );
+	dir->path[pathlen] = '\0';
+	dir->next = fs_index.dirs[hash & ( FS_INDEX_HASHSIZE - 1 )];
+	fs_index.dirs[hash & ( FS_INDEX_HASHSIZE - 1 )] = dir;
+	fs_index.numdirs++;
+
+	FS_IndexScanDir( dir );
+
+	return dir;
+}
+
+/*
+====================
+FS_IndexCheckDirs
+
+rescan directories which were changed since last look
+returns true if something was changed
+====================
+*/
+static qboolean FS_IndexCheckDirs( void )
+{
+	qboolean	changed = false;
+	fsdir_t	*dir;
+	int	i;
+
+	for( i = 0; i < FS_INDEX_HASHSIZE; i++ )
+	{
+		for( dir = fs_index.dirs[i]; dir; dir = dir->next )
+		{
+			int	mtime = FS_IndexStatDir( dir );
+
+			fs_index.stats.dirchecks++;
+
+			// mtime has one second precision, so directory
+			// changed in the same second as scanned is rescanned again
+			if( mtime != dir->mtime || ( mtime != -1 && mtime >= dir->scantime ))
+			{
+				FS_IndexScanDir( dir );
+				changed = true;
+			}
+		}
+	}
+
+	return changed;
+}
+
+/*
+====================
+FS_IndexDirFind
+
+returns real name of a file in cached directory listing
+====================
+*/
+static const char *FS_IndexDirFind( const fsdir_t *dir, const char *filename, qboolean casesensitive )
+{
+	uint	hash;
+	int	slot;
+
+	if( !dir->numfiles )
+		return NULL;
+
+	hash = FS_IndexHash( filename );
+
+	for( slot = hash & ( dir->tablesize - 1 ); dir->table[slot]; slot = ( slot + 1 ) & ( dir->tablesize - 1 ))
+	{
+		const char	*s = dir->names + dir->table[slot] - 1;
+
+		if( dir->hashes[slot] != hash )
+			continue;
+
+		if( casesensitive ? !Q_strcmp( s, filename ) : !Q_stricmp( s, filename ))
+			return s;
+	}
+
+	return NULL;
+}
+
+/*
+====================
+FS_IndexFindLoose
+
+look for a file in cached directory listing
+====================
+*/
+static qboolean FS_IndexFindLoose( searchpath_t *search, const char *name )
+{
+	const char	*filename, *p;
+	fsdir_t		*dir;
+
+	for( filename = p = name; *p; p++ )
+	{
+		if( *p == '/' || *p == '\\' )
+			filename = p + 1;
+	}
+
+	if( !*filename )
+		return false;
+
+	dir = FS_IndexGetDir( search, name, filename - name );
+
+	return FS_IndexDirFind( dir, filename, FS_IndexCaseSensitive( search )) != NULL;
+}
+
+#if !XASH_WIN32 && !XASH_IOS
+/*
+====================
+FS_IndexFixFileCase
+
+FS_FixFileCase through cached directory listings,
+returns NULL if file index is disabled
+====================
+*/
+static const char *FS_IndexFixFileCase( const char *path, const char *dirpath, const char *filename )
+{
+	char		temp[MAX_SYSPATH];
+	const char	*realname;
+	uint		scans;
+	fsdir_t		*dir;
+	int		len;
+
+	if( fs_index.disabled )
+		return NULL;
+
+	len = Q_snprintf( temp, sizeof( temp ), "%s/", dirpath );
+	if( len < 0 || len >= sizeof( temp ))
+		return path;
+
+	FS_IndexRecheck();
+
+	scans = fs_index.stats.dirscans;
+	dir = FS_IndexGetDir( NULL, temp, len );
+	fs_index.stats.casefixes++;
+
+	if( fs_index.stats.dirscans != scans )
+		fs_index.stats.casescans++;
+
+	if(( realname = FS_IndexDirFind( dir, filename, false )) != NULL )
+		return va( "%s/%s", dirpath, realname );
+
+	return path;
+}
+#endif
+
+/*
+====================
+FS_IndexFindMiss
+
+====================
+*/
+static qboolean FS_IndexFindMiss( const char *name, uint hash, qboolean gamedironly )
+{
+	fsmiss_t	*miss;
+
+	for( miss = fs_index.misses[hash & ( FS_INDEX_HASHSIZE - 1 )]; miss; miss = miss->next )
+	{
+		if( miss->hash == hash && miss->gamedironly == gamedironly && !Q_strcmp( miss->name, name ))
+			return true;
+	}
+
+	return false;
+}
+
+/*
+====================
+FS_IndexAddMiss
+
+====================
+*/
+static void FS_IndexAddMiss( const char *name, uint hash, qboolean gamedironly )
+{
+	size_t	len = Q_strlen( name );
+	fsmiss_t	*miss;
+
+	if( fs_index.nummisses >= FS_INDEX_MAXMISSES )
+		FS_IndexFlushMisses();
+
+	miss = Mem_Malloc( fs_mempool, sizeof( *miss ) + len );
+	miss->hash = hash;
+	miss->gamedironly = gamedironly;
+	memcpy( miss->name, name, len + 1 );
+	miss->next = fs_index.misses[hash & ( FS_INDEX_HASHSIZE - 1 )];
+	fs_index.misses[hash & ( FS_INDEX_HASHSIZE - 1 )] = miss;
+	fs_index.nummisses++;
+}
+
+/*
+====================
+FS_IndexRecheck
+
+look at cached directories once in a while
+====================
+*/
+static void FS_IndexRecheck( void )
+{
+	double	now = Sys_DoubleTime();
+
+	if( now >= fs_index.nextcheck )
+	{
+		if( FS_IndexCheckDirs( ))
+			FS_IndexFlushMisses();
+		fs_index.nextcheck = now + FS_INDEX_RECHECK;
+	}
+}
+
+/*
+====================
+FS_IndexUpdate
+
+====================
+*/
+static void FS_IndexUpdate( void )
+{
+	if( fs_index.dirty )
+		FS_IndexBuild();
+
+	FS_IndexRecheck();
+}
+
+/*
+====================
+FS_IndexFindFile
+
+same as search path walk, but paks and zips are looked up
+in one table and directories listings are cached
+====================
+*/
+static searchpath_t *FS_IndexFindFile( const char *name, int *index, qboolean gamedironly )
+{
+	fsarchive_t	*entry = NULL;
+	searchpath_t	*search, *found = NULL;
+	uint		hash;
+	int		i;
+
+	FS_IndexUpdate();
+
+	fs_index.stats.lookups++;
+	hash = FS_IndexHash( name );
+
+	// case sensitive because loose files are
+	if( FS_IndexFindMiss( name, hash, gamedironly ))
+	{
+		fs_index.stats.misses++;
+		return NULL;
+	}
+
+	for( i = hash & ( fs_index.archivesize - 1 ); fs_index.archives[i].name; i = ( i + 1 ) & ( fs_index.archivesize - 1 ))
+	{
+		if( fs_index.archives[i].hash == hash && !Q_stricmp( fs_index.archives[i].name, name ))
+		{
+			entry = &fs_index.archives[i];
+			found = gamedironly ? entry->gamesearch : entry->search;
+			break;
+		}
+	}
+
+	// wads and directories still can override it
+	for( search = fs_searchpaths; search && search != found; search = search->next )
+	{
+		if( gamedironly && !FBitSet( search->flags, FS_GAMEDIRONLY_SEARCH_FLAGS ))
+			continue;
+
+		if( search->pack || search->zip )
+			continue;
+
+		if( search->wad )
+		{
+			if( FS_FindInWad( search, name, index ))
+				return search;
+		}
+		else if( FS_IndexFindLoose( search, name ))
+		{
+			if( index ) *index = -1;
+			return search;
+		}
+	}
+
+	if( found )
+	{
+		if( index ) *index = gamedironly ? entry->gameindex : entry->index;
+		return found;
+	}
+
+	FS_IndexAddMiss( name, hash, gamedironly );
+
+	return NULL;
+}
+
+/*
+====================
+FS_IndexStats_f
+
+====================
+*/
+static void FS_IndexStats_f( void )
+{
+	int	i, files = 0;
+	fsdir_t	*dir;
+
+	if( Cmd_Argc() > 1 && !Q_stricmp( Cmd_Argv( 1 ), "reset" ))
+	{
+		memset( &fs_index.stats, 0, sizeof( fs_index.stats ));
+		return;
+	}
+
+	for( i = 0; i < FS_INDEX_HASHSIZE; i++ )
+	{
+		for( dir = fs_index.dirs[i]; dir; dir = dir->next )
+			files += dir->numfiles;
+	}
+
+	if( fs_index.disabled )
+		Con_Printf( "file index is disabled by -nofsindex\n" );
+
+	Con_Printf( "%i archived files in table of %i slots, built %u times\n", fs_index.numarchives, fs_index.archivesize, fs_index.stats.builds );
+	Con_Printf( "%i directories cached with %i files, %u scans, %u checks\n", fs_index.numdirs, files, fs_index.stats.dirscans, fs_index.stats.dirchecks );
+	Con_Printf( "%u lookups, %u answered by %i cached misses\n", fs_index.stats.lookups, fs_index.stats.misses, fs_index.nummisses );
+	Con_Printf( "%u case fixes, %u directory scans, %u avoided\n", fs_index.stats.casefixes, fs_index.stats.casescans, fs_index.stats.casefixes - fs_index.stats.casescans );
+}
+
+/*
+====================
+FS_BenchPhase
+
+====================
+*/
+static void FS_BenchPhase( const char *name, int mode, double seconds, stringlist_t *names, stringlist_t *patterns )
+{
+	double	start, end;
+	int	i, count = 0;
+
+	start = Sys_DoubleTime();
+	end = start + seconds;
+
+	while( Sys_DoubleTime() < end )
+	{
+		for( i = 0; i < 64; i++, count++ )
+		{
+			if( mode == 0 )
+			{
+				FS_FileExists( names->strings[count % names->numstrings], false );
+			}
+			else if( mode == 1 )
+			{
+				file_t	*f = FS_Open( names->strings[count % names->numstrings], "rb", false );
+				if( f ) FS_Close( f );
+			}
+			else if( mode == 2 )
+			{
+				search_t	*t = FS_Search( patterns->strings[count % patterns->numstrings], true, false );
+				if( t ) Mem_Free( t );
+				i += 7; // much slower
+			}
+			else
+			{
+				FS_SysFileExists( names->strings[count % names->numstrings], true );
+			}
+		}
+	}
+
+	Con_Printf( "%-14s %-6s %12.0f per second\n", name, fs_index.disabled ? "walk" : "index", count / ( Sys_DoubleTime() - start ));
+}
+
+/*
+====================
+FS_Bench_f
+
+lookup archived files, missing optional files and wildcards
+with and without file index
+====================
+*/
+static void FS_Bench_f( void )
+{
+	stringlist_t	names, patterns;
+	searchpath_t	*search;
+	qboolean		disabled = fs_index.disabled;
+	double		seconds = 3.0;
+	int		i, mode, mismatches = 0;
+
+	if( Cmd_Argc() > 1 )
+		seconds = bound( 0.5, Q_atof( Cmd_Argv( 1 )), 60.0 );
+
+	stringlistinit( &names );
+	stringlistinit( &patterns );
+
+	// every other name is missing to emulate optional assets
+	for( search = fs_searchpaths; search && names.numstrings < 8192; search = search->next )
+	{
+		int	count = search->pack ? search->pack->numfiles : search->zip ? search->zip->numfiles : 0;
+
+		for( i = 0; i < count && names.numstrings < 8192; i += 7 )
+		{
+			const char	*name = search->pack ? search->pack->files[i].name : search->zip->files[i].name;
+			string		temp;
+			char		*slash;
+
+			stringlistappend( &names, (char *)name );
+			Q_snprintf( temp, sizeof( temp ), "%s_missing.tga", name );
+			stringlistappend( &names, temp );
+
+			Q_strncpy( temp, name, sizeof( temp ));
+			if(( slash = Q_strrchr( temp, '/' )) != NULL && patterns.numstrings < 16 )
+			{
+				Q_strcpy( slash + 1, "*" );
+				stringlistappend( &patterns, temp );
+			}
+		}
+	}
+
+	if( !names.numstrings )
+	{
+		Con_Printf( "fs_bench: no pak or zip files in search paths\n" );
+		stringlistfreecontents( &names );
+		stringlistfreecontents( &patterns );
+		return;
+	}
+
+	if( !patterns.numstrings )
+		stringlistappend( &patterns, "*" );
+
+	// both ways must give the same answer
+	for( i = 0; i < names.numstrings; i++ )
+	{
+		searchpath_t	*walk, *index;
+		int		walkind = -1, indexind = -1;
+
+		fs_index.disabled = true;
+		walk = FS_FindFile( names.strings[i], &walkind, i & 1 );
+		fs_index.disabled = false;
+		index = FS_FindFile( names.strings[i], &indexind, i & 1 );
+
+		if( walk != index || walkind != indexind )
+		{
+			if( mismatches++ < 8 )
+				Con_Printf( S_WARN "fs_bench: %s found in %s by walk and in %s by index\n", names.strings[i],
+					walk ? walk->filename : "nothing", index ? index->filename : "nothing" );
+		}
+	}
+
+	Con_Printf( "%i names, %i patterns, %i mismatches, %.1f seconds per test\n", names.numstrings, patterns.numstrings, mismatches, seconds / 6.0 );
+
+	for( mode = 0; mode < 3; mode++ )
+	{
+		const char *title = mode == 0 ? "FS_FileExists" : mode == 1 ? "FS_Open" : "FS_Search";
+
+		fs_index.disabled = true;
+		FS_BenchPhase( title, mode, seconds / 6.0, &names, &patterns );
+		fs_index.disabled = false;
+		FS_BenchPhase( title, mode, seconds / 6.0, &names, &patterns );
+	}
+
+	// loose files from directories cached above, with wrong case
+	stringlistfreecontents( &names );
+
+	for( i = 0; i < FS_INDEX_HASHSIZE; i++ )
+	{
+		fsdir_t	*dir;
+
+		for( dir = fs_index.dirs[i]; dir && names.numstrings < 4096; dir = dir->next )
+		{
+			const char	*s;
+			int		j;
+
+			if( !dir->search || FS_IndexCaseSensitive( dir->search ))
+				continue;
+
+			for( j = 0, s = dir->names; j < dir->numfiles; j++, s += Q_strlen( s ) + 1 )
+			{
+				char	temp[MAX_SYSPATH];
+				int	len = Q_snprintf( temp, sizeof( temp ), "%s%s", dir->search->filename, dir->path );
+
+				Q_strncpy( temp + len, s, sizeof( temp ) - len );
+				Q_strupr( temp + len, temp + len );
+
+				if( Q_strcmp( temp + len, s ))
+					stringlistappend( &names, temp );
+			}
+		}
+	}
+
+	if( names.numstrings && fs_caseinsensitive )
+	{
+		for( i = 0, mismatches = 0; i < names.numstrings; i++ )
+		{
+			qboolean	exists;
+
+			fs_index.disabled = true;
+			exists = FS_SysFileExists( names.strings[i], true );
+			fs_index.disabled = false;
+
+			if( exists != FS_SysFileExists( names.strings[i], true ))
+				mismatches++;
+		}
+
+		Con_Printf( "%i loose files with wrong case, %i mismatches\n", names.numstrings, mismatches );
+
+		fs_index.disabled = true;
+		FS_BenchPhase( "FS_FixFileCase", 3, seconds / 6.0, &names, &patterns );
+		fs_index.disabled = false;
+		FS_BenchPhase( "FS_FixFileCase", 3, seconds / 6.0, &names, &patterns );
+	}
+
+	fs_index.disabled = disabled;
+	stringlistfreecontents( &names );
+	stringlistfreecontents( &patterns );
+}
+
+/*
+====================
+FS_WalkSearchPaths
+
+Look at every element of search path in turn
+====================
+*/
+static searchpath_t *FS_WalkSearchPaths( const char *name, int *index, qboolean gamedironly )
+{
+	searchpath_t	*search;
+
+	// search through the path, one element at a time
+	for( search = fs_searchpaths; search; search = search->next )
+	{
+		if( gamedironly & !FBitSet( search->flags, FS_GAMEDIRONLY_SEARCH_FLAGS ))
+			continue;
+
+		// is the element a pak file?
+		if( search->pack )
+		{
+			int	left, right, middle;
+			pack_t	*pak;
+
+			pak = search->pack;
+
+			// look for the file (binary search)
+			left = 0;
+			right = pak->numfiles - 1;
+			while( left <= right )
+			{
+				int	diff;
+
+				middle = (left + right) / 2;
+				diff = Q_stricmp( pak->files[middle].name, name );
+
+				// Found it
+				if( !diff )
+				{
+					if( index ) *index = middle;
+					return search;
+				}
+
+				// if we're too far in the list
+				if( diff > 0 )
+					right = middle - 1;
+				else left = middle + 1;
+			}
+		}
+		else if( search->wad )
+		{
+			if( FS_FindInWad( search, name, index ))
+				return search;
+		}
+		else if( search->zip )
+		{
+			int     left, right, middle;
+			zip_t  *zip;
+
+			zip = search->zip;
+
+			// look for the file (binary search)
+			left = 0;
+			right = zip->numfiles - 1;
+
+			while( left <= right )
+			{
+				int     diff;
+
+				middle = (left + right) / 2;
+				diff = Q_stricmp( zip->files[middle].name, name );
+
+				// Found it
+				if( !diff )
+				{
+					if( index ) *index = middle;
+					return search;
+				}
+
+				// if we're too far in the list
+				if( diff > 0 )
+					right = middle - 1;
+				else left = middle + 1;
+			}
+		}
+		else
+		{
+			char	netpath[MAX_SYSPATH];
+
+			Q_sprintf( netpath, "%s%s", search->filename, name );
+
+			if( FS_SysFileExists( netpath, !( search->flags & FS_CUSTOM_PATH ) ))
+			{
+				if( index != NULL ) *index = -1;
+				return search;
+			}
+		}
+	}
+
+	return NULL;
+}
+
+/*
+====================
+FS_FindFile
+
+Look for a file in the packages and in the filesystem
+
+Return the searchpath where the file was found (or NULL)
+and the file index in the package if relevant
+====================
+*/
+static searchpath_t *FS_FindFile( const char *name, int *index, qboolean gamedironly )
+{
+	searchpath_t	*search;
+	char		*pEnvPath;
+
+	if( !fs_index.disabled )
+		search = FS_IndexFindFile( name, index, gamedironly );
+	else search = FS_WalkSearchPaths( name, index, gamedironly );
+
+	if( search )
+		return search;
+
+	if( fs_ext_path )
+	{
+		char	netpath[MAX_SYSPATH];
+
+		// clear searchpath
+		search = &fs_directpath;
+		memset( search, 0, sizeof( searchpath_t ));
+
+		// root folder has a more priority than netpath
+		Q_strncpy( search->filename, host.rootdir, sizeof( search->filename ));
+		Q_strcat( search->filename, PATH_SPLITTER );
+		Q_snprintf( netpath, MAX_SYSPATH, "%s%s", search->filename, name );
+
+		if( FS_SysFileExists( netpath, !( search->flags & FS_CUSTOM_PATH ) ))
+		{
+			if( index != NULL )
+				*index = -1;
+			return search;
+		}
+
+#if 0
+		// search for environment path
+		while( ( pEnvPath = getenv( "Path" ) ) )
+		{
+			char *end = Q_strchr( pEnvPath, ';' );
+			if( !end ) break;
+			Q_strncpy( search->filename, pEnvPath, (end - pEnvPath) + 1 );
+			Q_strcat( search->filename, PATH_SPLITTER );
+			Q_snprintf( netpath, MAX_SYSPATH, "%s%s", search->filename, name );
+
+			if( FS_SysFileExists( netpath, !( search->flags & FS_CUSTOM_PATH ) ))
+			{
+				if( index != NULL )
+					*index = -1;
+				return search;
+			}
+			pEnvPath += (end - pEnvPath) + 1; // move pointer
+		}
+#endif // 0
+	}
+
+	if( index != NULL )
+		*index = -1;
+
+	return NULL;
+}
+
+
+/*
+===========
+FS_OpenReadFile
+
+Look for a file in the search paths and open it in read-only mode
+===========
+*/
+file_t *FS_OpenReadFile( const char *filename, const char *mode, qboolean gamedironly )
+{
+	searchpath_t	*search;
+	int		pack_ind;
+
+	search = FS_FindFile( filename, &pack_ind, gamedironly );
+
+	// not found?
+	if( search == NULL )
+		return NULL;
+
+	if( search->pack )
+		return FS_OpenPackedFile( search->pack, pack_ind );
+	else if( search->wad )
+		return NULL; // let W_LoadFile get lump correctly
+	else if( search->zip )
+		return FS_OpenZipFile( search->zip, pack_ind );
+	else if( pack_ind < 0 )
+	{
+		char	path [MAX_SYSPATH];
+
+		// found in the filesystem?
+		Q_sprintf( path, "%s%s", search->filename, filename );
+		return FS_SysOpen( path, mode );
+	}
+
+	return NULL;
+}
+
+/*
+=============================================================================
+
+MAIN PUBLIC FUNCTIONS
+
+=============================================================================
+*/
+/*
+====================
+FS_Open
+
+Open a file. The syntax is the same as fopen
+====================
+*/
+file_t *FS_Open( const char *filepath, const char *mode, qboolean gamedironly )
+{
+	// some stupid mappers used leading '/' or '\' in path to models or sounds
+	if( filepath[0] == '/' || filepath[0] == '\\' )
+		filepath++;
+
+	if( filepath[0] == '/' || filepath[0] == '\\' )
+		filepath++;
+
+	if( FS_CheckNastyPath( filepath, false ))
+		return NULL;
+
+	// if the file is opened in "write", "append", or "read/write" mode
+	if( mode[0] == 'w' || mode[0] == 'a'|| mode[0] == 'e' || Q_strchr( mode, '+' ))
+	{
+		char	real_path[MAX_SYSPATH];
+
+		// open the file on disk directly
+		Q_sprintf( real_path, "%s/%s", fs_writedir, filepath );
+		FS_CreatePath( real_path );// Create directories up to the file
+		FS_IndexTouch();
+		return FS_SysOpen( real_path, mode );
+	}
+
+	// else, we look at the various search paths and open the file in read-only mode
+	return FS_OpenReadFile( filepath, mode, gamedironly );
+}
+
+/*
+====================
+FS_Close
+
+Close a file
+====================
+*/
+int FS_Close( file_t *file )
+{
+	if( !file ) return 0;
+
+	FS_BackupFileName( file, NULL, 0 );
+
+	if( file->zstream )
+		Zip_CloseStream( file );
+
+	if( file->handle >= 0 )
+		if( close( file->handle ))
+			return EOF;
+
+	Mem_Free( file );
+	return 0;
+}
+
+/*
+====================
+FS_Write
+
+Write "datasize" bytes into a file
+====================
+*/
+fs_offset_t FS_Write( file_t *file, const void *data, size_t datasize )
+{
+	fs_offset_t	result;
+
+	if( !file ) return 0;
+
+	// if necessary, seek to the exact file position we're supposed to be
+	if( file->buff_ind != file->buff_len )
+		lseek( file->handle, file->buff_ind - file->buff_len, SEEK_CUR );
+
+	// purge cached data
+	FS_Purge( file );
+
+	// write the buffer and update the position
+	result = write( file->handle, data, (fs_offset_t)datasize );
+	file->position = lseek( file->handle, 0, SEEK_CUR );
+
+	if( file->real_length < file->position )
+		file->real_length = file->position;
+
+	if( result < 0 )
+		return 0;
+	return result;
+}
+
+/*
+====================
+FS_Read
+
+Read up to "buffersize" bytes from a file
+====================
+*/
+fs_offset_t FS_Read( file_t *file, void *buffer, size_t buffersize )
+{
+	fs_offset_t	count, done;
+	fs_offset_t	nb;
+
+	// nothing to copy
+	if( buffersize == 0 ) return 1;
+
+	// Get rid of the ungetc character
+	if( file->ungetc != EOF )
+	{
+		((char*)buffer)[0] = file->ungetc;
+		buffersize--;
+		file->ungetc = EOF;
+		done = 1;
+	}
+	else done = 0;
+
+	// first, we copy as many bytes as we can from "buff"
+	if( file->buff_ind < file->buff_len )
+	{
+		count = file->buff_len - file->buff_ind;
+
+		done += ((fs_offset_t)buffersize > count ) ? count : (fs_offset_t)buffersize;
+		memcpy( buffer, &file->buff[file->buff_ind], done );
+		file->buff_ind += done;
+
+		buffersize -= done;
+		if( buffersize == 0 )
+			return done;
+	}
+
+	// NOTE: at this point, the read buffer is always empty
+
+	FS_EnsureOpenFile( file );
+	// we must take care to not read after the end of the file
+	count = file->real_length - file->position;
+
+	// if we have a lot of data to get, put them directly into "buffer"
+	if( buffersize > sizeof( file->buff ) / 2 )
+	{
+		if( count > (fs_offset_t)buffersize )
+			count = (fs_offset_t)buffersize;
+
+		if( file->zstream )
+			nb = Zip_ReadStream( file, &((byte *)buffer)[done], count );
+		else
+		{
+			lseek( file->handle, file->offset + file->position, SEEK_SET );
+			nb = read (file->handle, &((byte *)buffer)[done], count );
+		}
+
+		if( nb > 0 )
+		{
+			done += nb;
+			file->position += nb;
+			// purge cached data
+			FS_Purge( file );
+		}
+	}
+	else
+	{
+		if( count > (fs_offset_t)sizeof( file->buff ))
+			count = (fs_offset_t)sizeof( file->buff );
+
+		if( file->zstream )
+			nb = Zip_ReadStream( file, file->buff, count );
+		else
+		{
+			lseek( file->handle, file->offset + file->position, SEEK_SET );
+			nb = read( file->handle, file->buff, count );
+		}
+
+		if( nb > 0 )
+		{
+			file->buff_len = nb;
+			file->position += nb;
+
+			// copy the requested data in "buffer" (as much as we can)
+			count = (fs_offset_t)buffersize > file->buff_len ? file->buff_len : (fs_offset_t)buffersize;
+			memcpy( &((byte *)buffer)[done], file->buff, count );
+			file->buff_ind = count;
+			done += count;
+		}
+	}
+
+	return done;
+}
+
+/*
+====================
+FS_Print
+
+Print a string into a file
+====================
+*/
+int FS_Print( file_t *file, const char *msg )
+{
+	return FS_Write( file, msg, Q_strlen( msg ));
+}
+
+/*
+====================
+FS_Printf
+
+Print a string into a file
+====================
+*/
+int FS_Printf( file_t *file, const char *format, ... )
+{
+	int	result;
+	va_list	args;
+
+	va_start( args, format );
+	result = FS_VPrintf( file, format, args );
+	va_end( args );
+
+	return result;
+}
+
+/*
+====================
+FS_VPrintf
+
+Print a string into a file
+====================
+*/
+int FS_VPrintf( file_t *file, const char *format, va_list ap )
+{
+	int	len;
+	fs_offset_t	buff_size = MAX_SYSPATH;
+	char	*tempbuff;
+
+	if( !file ) return 0;
+
+	while( 1 )
+	{
+		tempbuff = (char *)Mem_Malloc( fs_mempool, buff_size );
+		len = Q_vsprintf( tempbuff, format, ap );
+
+		if( len >= 0 && len < buff_size )
+			break;
+
+		Mem_Free( tempbuff );
+		buff_size *= 2;
+	}
+
+	len = write( file->handle, tempbuff, len );
+	Mem_Free( tempbuff );
+
+	return len;
+}
+
+/*
+====================
+FS_Getc
+
+Get the next character of a file
+====================
+*/
+int FS_Getc( file_t *file )
+{
+	char	c;
+
+	if( FS_Read( file, &c, 1 ) != 1 )
+		return EOF;
+
+	return c;
+}
+
+/*
+====================
+FS_UnGetc
+
+Put a character back into the read buffer (only supports one character!)
+====================
+*/
+int FS_UnGetc( file_t *file, byte c )
+{
+	// If there's already a character waiting to be read
+	if( file->ungetc != EOF )
+		return EOF;
+
+	file->ungetc = c;
+	return c;
+}
+
+/*
+====================
+FS_Gets
+
+Same as fgets
+====================
+*/
+int FS_Gets( file_t *file, byte *string, size_t bufsize )
+{
+	int	c, end = 0;
+
+	while( 1 )
+	{
+		c = FS_Getc( file );
+
+		if( c == '\r' || c == '\n' || c < 0 )
+			break;
+
+		if( end < bufsize - 1 )
+			string[end++] = c;
+	}
+	string[end] = 0;
+
+	// remove \n following \r
+	if( c == '\r' )
+	{
+		c = FS_Getc( file );
+
+		if( c != '\n' )
+			FS_UnGetc( file, (byte)c );
+	}
+
+	return c;
+}
+
+/*
+====================
+FS_Seek
+
+Move the position index in a file
+====================
+*/
+int FS_Seek( file_t *file, fs_offset_t offset, int whence )
+{
+	// compute the file offset
+	switch( whence )
+	{
+	case SEEK_CUR:
+		offset += file->position - file->buff_len + file->buff_ind;
+		break;
+	case SEEK_SET:
+		break;
+	case SEEK_END:
+		offset += file->real_length;
+		break;
+	default:
+		return -1;
+	}
+
+	if( offset < 0 || offset > file->real_length )
+		return -1;
+
+	// if we have the data in our read buffer, we don't need to actually seek
+	if( file->position - file->buff_len <= offset && offset <= file->position )
+	{
+		file->buff_ind = offset + file->buff_len - file->position;
+		return 0;
+	}
+
+	FS_EnsureOpenFile( file );
+	// Purge cached data
+	FS_Purge( file );
+
+	// deflated stream is moved on next read
+	if( !file->zstream && lseek( file->handle, file->offset + offset, SEEK_SET ) == -1 )
+		return -1;
+	file->position = offset;
+
+	return 0;
+}
+
+/*
+====================
+FS_Tell
+
+Give the current position in a file
+====================
+*/
+fs_offset_t FS_Tell( file_t *file )
+{
+	if( !file ) return 0;
+	return file->position - file->buff_len + file->buff_ind;
+}
+
+/*
+====================
+FS_Eof
+
+indicates at reached end of file
+====================
+*/
+qboolean FS_Eof( file_t *file )
+{
+	if( !file ) return true;
+	return (( file->position - file->buff_len + file->buff_ind ) == file->real_length ) ? true : false;
+}
+
+/*
+====================
+FS_Purge
+
+Erases any buffered input or output data
+====================
+*/
+void FS_Purge( file_t *file )
+{
+	file->buff_len = 0;
+	file->buff_ind = 0;
+	file->ungetc = EOF;
+}
+
+/*
+============
+FS_LoadFile
+
+Filename are relative to the xash directory.
+Always appends a 0 byte.
+============
+*/
+byte *FS_LoadFile( const char *path, fs_offset_t *filesizeptr, qboolean gamedironly )
+{
+	file_t	*file;
+	byte	*buf = NULL;
+	fs_offset_t	filesize = 0;
+
+	// already read in background
+	if(( buf = FS_PrefetchTake( path, &filesize, gamedironly )) != NULL )
+	{
+		if( filesizeptr )
+			*filesizeptr = filesize;
+		return buf;
+	}
+
+	file = FS_Open( path, "rb", gamedironly );
+
+	if( file )
+	{
+		filesize = file->real_length;
+
+		buf = (byte *)Mem_Malloc( fs_mempool, filesize + 1 );
+		buf[filesize] = '\0';
+		FS_Read( file, buf, filesize );
+		FS_Close( file );
+	}
+	else
+	{
+		buf = W_LoadFile( path, &filesize, gamedironly );
+
+		if( !buf )
+			buf = Zip_LoadFile( path, &filesize, gamedironly );
+
+	}
+
+	if( filesizeptr )
+		*filesizeptr = filesize;
+
+	return buf;
+}
+
+/*
+=============================================================================
+
+MEMORY MAPPED FILES
+
+=============================================================================
+*/
+// views are never shared, loaders may patch their copy
+typedef struct fsview_s
+{
+	byte		*data;
+	fs_offset_t	size;
+	void		*base;		// mapping start, NULL if data is loaded
+	size_t		maplen;
+	struct fsview_s	*next;
+} fsview_t;
+
+static struct
+{
+	fsview_t		*views;
+	uint		mapped;
+	uint		loaded;
+	size_t		mappedbytes;
+	size_t		loadedbytes;
+} fs_map;
+
+/*
+====================
+FS_MapRegion
+
+map part of opened file with copy on write,
+so loaders which patch their buffers still work.
+Offsets come from archive directories and can't be trusted,
+touching a page past the end of file raises SIGBUS
+====================
+*/
+static qboolean FS_MapRegion( fsview_t *view, int handle, fs_offset_t offset, fs_offset_t size )
+{
+#if XASH_WIN32
+	SYSTEM_INFO	si;
+	HANDLE		hMapping;
+	fs_offset_t	start, filesize;
+
+	filesize = _filelengthi64( handle );
+
+	if( offset < 0 || size <= 0 || filesize < 0 || offset > filesize - size )
+		return false;
+
+	GetSystemInfo( &si );
+	start = offset - offset % si.dwAllocationGranularity;
+	view->maplen = (size_t)( offset - start + size );
+
+	hMapping = CreateFileMappingA( (HANDLE)_get_osfhandle( handle ), NULL, PAGE_WRITECOPY, 0, 0, NULL );
+	if( !hMapping ) return false;
+
+	view->base = MapViewOfFile( hMapping, FILE_MAP_COPY, (DWORD)((uint64_t)start >> 32 ), (DWORD)start, view->maplen );
+	CloseHandle( hMapping ); // view holds the mapping
+
+	if( !view->base ) return false;
+#elif XASH_POSIX
+	long		pagesize = sysconf( _SC_PAGESIZE );
+	fs_offset_t	start = offset - offset % pagesize;
+	struct stat	st;
+	void		*base;
+
+	if( fstat( handle, &st ) < 0 )
+		return false;
+
+	if( offset < 0 || size <= 0 || offset > (fs_offset_t)st.st_size - size )
+		return false;
+
+	view->maplen = (size_t)( offset - start + size );
+	base = mmap( NULL, view->maplen, PROT_READ|PROT_WRITE, MAP_PRIVATE, handle, start );
+
+	if( base == MAP_FAILED ) return false;
+	view->base = base;
+#else
+	return false;
+#endif
+	view->data = (byte *)view->base + ( offset - start );
+	view->size = size;
+
+	return true;
+}
+
+/*
+====================
+FS_WillMapRegion
+
+FS_MapFile would try to map this archive region
+instead of loading it, prefetch only reads it ahead
+====================
+*/
+static qboolean FS_WillMapRegion( fs_offset_t offset, fs_offset_t size )
+{
+#if defined( XASH_REDUCE_FD ) || ( !XASH_WIN32 && !XASH_POSIX )
+	return false;
+#else
+#if !XASH_X86 && !XASH_AMD64
+	// keep natural alignment for loaders that cast buffer to structs
+	if( offset & 3 ) return false;
+#endif
+	return size >= FS_MAP_MINSIZE;
+#endif
+}
+
+/*
+====================
+FS_MapFile
+
+Returns file contents directly from mapping of pak, stored zip entry
+or wad lump, or loaded copy if it can't be mapped. Loose files are
+always loaded, they can be rewritten or truncated by downloads while
+mapped. Archives are opened for the whole session and not expected
+to change, but truncating one under a running game still faults.
+Every call gets its own copy on write view, so buffer can be patched.
+Data is not zero terminated. Must be released with FS_UnmapFile
+====================
+*/
+byte *FS_MapFile( const char *path, fs_offset_t *filesizeptr, qboolean gamedironly )
+{
+	const char	*name = path;
+	fs_offset_t	offset = 0, size = 0;
+	searchpath_t	*search = NULL;
+	int		index, handle = -1;
+	fsview_t		*view;
+
+	if( filesizeptr ) *filesizeptr = 0;
 
-			if( FS_SysFileExists( netpath, !( search->flags & FS_CUSTOM_PATH ) ))
-			{
-				if( index != NULL ) *index = -1;
-				return search;
-			}
-		}
-	}
+	// same as FS_Open
+	if( name[0] == '/' || name[0] == '\\' )
+		name++;
 
-	if( fs_ext_path )
-	{
-		char	netpath[MAX_SYSPATH];
+	if( name[0] == '/' || name[0] == '\\' )
+		name++;
 
-		// clear searchpath
-		search = &fs_directpath;
-		memset( search, 0, sizeof( searchpath_t ));
+	if( !FS_CheckNastyPath( name, false ))
+		search = FS_FindFile( name, &index, gamedironly );
 
-		// root folder has a more priority than netpath
-		Q_strncpy( search->filename, host.rootdir, sizeof( search->filename ));
-		Q_strcat( search->filename, PATH_SPLITTER );
-		Q_snprintf( netpath, MAX_SYSPATH, "%s%s", search->filename, name );
+	if( search && search->pack )
+	{
+		handle = search->pack->handle;
+		offset = search->pack->files[index].filepos;
+		size = search->pack->files[index].filelen;
+	}
+	else if( search && search->zip && search->zip->files[index].flags == ZIP_COMPRESSION_NO_COMPRESSION )
+	{
+		handle = search->zip->handle;
+		offset = search->zip->files[index].offset;
+		size = search->zip->files[index].size;
+	}
+	else if( search && search->wad && search->wad->handle && !search->wad->handle->zstream )
+	{
+		handle = search->wad->handle->handle;
+		offset = search->wad->handle->offset + search->wad->lumps[index].filepos;
+		size = search->wad->lumps[index].disksize;
+	}
 
-		if( FS_SysFileExists( netpath, !( search->flags & FS_CUSTOM_PATH ) ))
-		{
-			if( index != NULL )
-				*index = -1;
-			return search;
-		}
+	view = Mem_Calloc( fs_mempool, sizeof( *view ));
 
-#if 0
-		// search for environment path
-		while( ( pEnvPath = getenv( "Path" ) ) )
-		{
-			char *end = Q_strchr( pEnvPath, ';' );
-			if( !end ) break;
-			Q_strncpy( search->filename, pEnvPath, (end - pEnvPath) + 1 );
-			Q_strcat( search->filename, PATH_SPLITTER );
-			Q_snprintf( netpath, MAX_SYSPATH, "%s%s", search->filename, name );
+	// descriptors are closed and reopened behind our back with XASH_REDUCE_FD
+	if( !FS_WillMapRegion( offset, size ))
+		handle = -1;
 
-			if( FS_SysFileExists( netpath, !( search->flags & FS_CUSTOM_PATH ) ))
-			{
-				if( index != NULL )
-					*index = -1;
-				return search;
-			}
-			pEnvPath += (end - pEnvPath) + 1; // move pointer
-		}
-#endif // 0
+	if(( view->data = FS_PrefetchTake( path, &view->size, gamedironly )) != NULL )
+	{
+		fs_map.loaded++;
+		fs_map.loadedbytes += view->size;
+	}
+	else if( handle >= 0 && FS_MapRegion( view, handle, offset, size ))
+	{
+		fs_map.mapped++;
+		fs_map.mappedbytes += size;
+	}
+	else if(( view->data = FS_LoadFile( path, &view->size, gamedironly )) != NULL )
+	{
+		fs_map.loaded++;
+		fs_map.loadedbytes += view->size;
+	}
+	else
+	{
+		Mem_Free( view );
+		return NULL;
 	}
 
-	if( index != NULL )
-		*index = -1;
+	view->next = fs_map.views;
+	fs_map.views = view;
 
-	return NULL;
-}
+	if( filesizeptr ) *filesizeptr = view->size;
 
+	return view->data;
+}
 
 /*
-===========
-FS_OpenReadFile
+====================
+FS_UnmapFile
 
-Look for a file in the search paths and open it in read-only mode
-===========
+====================
 */
-file_t *FS_OpenReadFile( const char *filename, const char *mode, qboolean gamedironly )
+void FS_UnmapFile( byte *data )
 {
-	searchpath_t	*search;
-	int		pack_ind;
+	fsview_t	**prev, *view;
 
-	search = FS_FindFile( filename, &pack_ind, gamedironly );
+	if( !data ) return;
 
-	// not found?
-	if( search == NULL )
-		return NULL;
+	for( prev = &fs_map.views; *prev; prev = &(*prev)->next )
+	{
+		if( (*prev)->data == data )
+			break;
+	}
 
-	if( search->pack )
-		return FS_OpenPackedFile( search->pack, pack_ind );
-	else if( search->wad )
-		return NULL; // let W_LoadFile get lump correctly
-	else if( search->zip )
-		return FS_OpenZipFile( search->zip, pack_ind );
-	else if( pack_ind < 0 )
+	if( !*prev )
 	{
-		char	path [MAX_SYSPATH];
+		Con_Reportf( S_ERROR "FS_UnmapFile: %p is not mapped\n", data );
+		return;
+	}
 
-		// found in the filesystem?
-		Q_sprintf( path, "%s%s", search->filename, filename );
-		return FS_SysOpen( path, mode );
+	view = *prev;
+	*prev = view->next;
+
+	if( view->base )
+	{
+#if XASH_WIN32
+		UnmapViewOfFile( view->base );
+#elif XASH_POSIX
+		munmap( view->base, view->maplen );
+#endif
 	}
+	else Mem_Free( view->data );
 
-	return NULL;
+	Mem_Free( view );
 }
 
 /*
 =============================================================================
 
-MAIN PUBLIC FUNCTIONS
+PREFETCH
 
 =============================================================================
 */
+typedef struct fsprefetch_s
+{
+	char		*name;
+	uint		hash;
+	searchpath_t	*search;		// where file was found when queued
+	int		index;
+	char		*filename;	// archive or loose file
+	fs_offset_t	offset;
+	fs_offset_t	size;
+	fs_offset_t	compressed;	// deflated size, zero if stored
+	byte		*data;		// filled by worker
+	qboolean		ready;
+	qboolean		readahead;	// FS_MapFile maps it, only warm up the page cache
+} fsprefetch_t;
+
+static struct
+{
+	threadpool_t	*pool;
+	int		numthreads;
+	fsprefetch_t	*files;
+	int		numfiles;
+	int		maxfiles;
+	int		*table;		// file index + 1, zero is free slot
+	int		tablesize;
+	qboolean		started;
+	size_t		totalsize;
+
+	// last opened archive of each thread
+	const searchpath_t	*archives[MAX_POOL_THREADS];
+	int		handles[MAX_POOL_THREADS];
+
+	struct
+	{
+		uint	queued;
+		uint	taken;
+		uint	stale;		// file was moved since queued
+		uint	failed;
+		size_t	bytes;
+	} stats;
+} fs_prefetch;
+
 /*
 ====================
-FS_Open
+FS_PrefetchJob
 
-Open a file. The syntax is the same as fopen
+runs in worker thread, touches nothing but its own entry
 ====================
 */
-file_t *FS_Open( const char *filepath, const char *mode, qboolean gamedironly )
+static void FS_PrefetchJob( void *data, int index, int thread )
 {
-	// some stupid mappers used leading '/' or '\' in path to models or sounds
-	if( filepath[0] == '/' || filepath[0] == '\\' )
-		filepath++;
+	fsprefetch_t	*pf = &((fsprefetch_t *)data)[index];
+	fs_offset_t	len = pf->compressed ? pf->compressed : pf->size;
+	byte		*dest = pf->data;
+	fs_offset_t	done = 0;
+	int		handle;
 
-	if( filepath[0] == '/' || filepath[0] == '\\' )
-		filepath++;
+	if( pf->index >= 0 && fs_prefetch.archives[thread] == pf->search )
+	{
+		handle = fs_prefetch.handles[thread];
+	}
+	else
+	{
+		if( fs_prefetch.archives[thread] )
+			close( fs_prefetch.handles[thread] );
+		fs_prefetch.archives[thread] = NULL;
 
-	if( FS_CheckNastyPath( filepath, false ))
-		return NULL;
+		if(( handle = open( pf->filename, O_RDONLY|O_BINARY )) < 0 )
+			return;
 
-	// if the file is opened in "write", "append", or "read/write" mode
-	if( mode[0] == 'w' || mode[0] == 'a'|| mode[0] == 'e' || Q_strchr( mode, '+' ))
+		// keep archive open for next files
+		if( pf->index >= 0 )
+		{
+			fs_prefetch.archives[thread] = pf->search;
+			fs_prefetch.handles[thread] = handle;
+		}
+	}
+
+	// read through small buffer and throw it away
+	if( pf->readahead && ( dest = malloc( FS_MAP_MINSIZE )) == NULL )
 	{
-		char	real_path[MAX_SYSPATH];
+		if( !fs_prefetch.archives[thread] )
+			close( handle );
+		return;
+	}
 
-		// open the file on disk directly
-		Q_sprintf( real_path, "%s/%s", fs_writedir, filepath );
-		FS_CreatePath( real_path );// Create directories up to the file
-		return FS_SysOpen( real_path, mode );
+	if( pf->compressed && ( dest = malloc( len )) == NULL )
+	{
+		if( !fs_prefetch.archives[thread] )
+			close( handle );
+		return;
 	}
 
-	// else, we look at the various search paths and open the file in read-only mode
-	return FS_OpenReadFile( filepath, mode, gamedironly );
-}
+	if( lseek( handle, pf->offset, SEEK_SET ) != -1 )
+	{
+		while( done < len )
+		{
+			fs_offset_t	nb;
 
-/*
-====================
-FS_Close
+			if( pf->readahead )
+				nb = read( handle, dest, Q_min( len - done, FS_MAP_MINSIZE ));
+			else nb = read( handle, dest + done, len - done );
 
-Close a file
-====================
-*/
-int FS_Close( file_t *file )
-{
-	if( !file ) return 0;
+			if( nb <= 0 ) break;
+			done += nb;
+		}
+	}
 
-	FS_BackupFileName( file, NULL, 0 );
+	if( !fs_prefetch.archives[thread] )
+		close( handle );
 
-	if( file->handle >= 0 )
-		if( close( file->handle ))
-			return EOF;
+	if( pf->readahead )
+	{
+		free( dest );
+		return;
+	}
 
-	Mem_Free( file );
-	return 0;
+	if( done == len && pf->compressed )
+		done = tinfl_decompress_mem_to_mem( pf->data, pf->size, dest, len, 0 ) == pf->size ? pf->size : 0;
+	else if( done == len )
+		done = pf->size;
+
+	if( pf->compressed )
+		free( dest );
+
+	pf->ready = ( done == pf->size );
 }
 
 /*
 ====================
-FS_Write
+FS_PrefetchFind
 
-Write "datasize" bytes into a file
 ====================
 */
-fs_offset_t FS_Write( file_t *file, const void *data, size_t datasize )
+static fsprefetch_t *FS_PrefetchFind( const char *name )
 {
-	fs_offset_t	result;
-
-	if( !file ) return 0;
+	uint	hash = FS_IndexHash( name );
+	int	slot;
 
-	// if necessary, seek to the exact file position we're supposed to be
-	if( file->buff_ind != file->buff_len )
-		lseek( file->handle, file->buff_ind - file->buff_len, SEEK_CUR );
-
-	// purge cached data
-	FS_Purge( file );
+	if( !fs_prefetch.tablesize )
+		return NULL;
 
-	// write the buffer and update the position
-	result = write( file->handle, data, (fs_offset_t)datasize );
-	file->position = lseek( file->handle, 0, SEEK_CUR );
+	for( slot = hash & ( fs_prefetch.tablesize - 1 ); fs_prefetch.table[slot]; slot = ( slot + 1 ) & ( fs_prefetch.tablesize - 1 ))
+	{
+		fsprefetch_t	*pf = &fs_prefetch.files[fs_prefetch.table[slot] - 1];
 
-	if( file->real_length < file->position )
-		file->real_length = file->position;
+		if( pf->hash == hash && !Q_stricmp( pf->name, name ))
+			return pf;
+	}
 
-	if( result < 0 )
-		return 0;
-	return result;
+	return NULL;
 }
 
 /*
 ====================
-FS_Read
+FS_PrefetchFile
 
-Read up to "buffersize" bytes from a file
+queue file to be read in background by FS_PrefetchStart
 ====================
 */
-fs_offset_t FS_Read( file_t *file, void *buffer, size_t buffersize )
+void FS_PrefetchFile( const char *path )
 {
-	fs_offset_t	count, done;
-	fs_offset_t	nb;
+	fsprefetch_t	*pf;
+	searchpath_t	*search;
+	char		filename[MAX_SYSPATH];
+	fs_offset_t	offset = 0, size = 0, compressed = 0;
+	qboolean		readahead = false;
+	int		index, slot;
 
-	// nothing to copy
-	if( buffersize == 0 ) return 1;
+#ifdef XASH_REDUCE_FD
+	return; // workers need own descriptors
+#endif
+	// new resource list
+	if( fs_prefetch.started )
+		FS_PrefetchClear();
 
-	// Get rid of the ungetc character
-	if( file->ungetc != EOF )
+	if( path[0] == '/' || path[0] == '\\' )
+		path++;
+
+	if( path[0] == '/' || path[0] == '\\' )
+		path++;
+
+	if( FS_CheckNastyPath( path, false ) || FS_PrefetchFind( path ))
+		return;
+
+	search = FS_FindFile( path, &index, false );
+
+	if( !search )
+		return;
+
+	if( search->pack )
 	{
-		((char*)buffer)[0] = file->ungetc;
-		buffersize--;
-		file->ungetc = EOF;
-		done = 1;
-	}
-	else done = 0;
+		Q_strncpy( filename, search->pack->filename, sizeof( filename ));
+		offset = search->pack->files[index].filepos;
+		size = search->pack->files[index].filelen;
 
-	// first, we copy as many bytes as we can from "buff"
-	if( file->buff_ind < file->buff_len )
+		// mapped on demand, a heap copy would only waste memory
+		readahead = FS_WillMapRegion( offset, size );
+	}
+	else if( search->zip )
 	{
-		count = file->buff_len - file->buff_ind;
+		zipfile_t	*file = &search->zip->files[index];
 
-		done += ((fs_offset_t)buffersize > count ) ? count : (fs_offset_t)buffersize;
-		memcpy( buffer, &file->buff[file->buff_ind], done );
-		file->buff_ind += done;
+		if( file->flags != ZIP_COMPRESSION_NO_COMPRESSION && file->flags != ZIP_COMPRESSION_DEFLATED )
+			return;
 
-		buffersize -= done;
-		if( buffersize == 0 )
-			return done;
+		Q_strncpy( filename, search->zip->filename, sizeof( filename ));
+		offset = file->offset;
+		size = file->size;
+		if( file->flags == ZIP_COMPRESSION_DEFLATED )
+			compressed = file->compressed_size;
+		else readahead = FS_WillMapRegion( offset, size );
 	}
+	else if( !search->wad && index < 0 )
+	{
+		struct stat	buf;
 
-	// NOTE: at this point, the read buffer is always empty
+		// only exact case, so worker doesn't need FS_FixFileCase
+		Q_snprintf( filename, sizeof( filename ), "%s%s", search->filename, path );
+		if( stat( filename, &buf ) < 0 || !S_ISREG( buf.st_mode ))
+			return;
+		size = buf.st_size;
+	}
+	else return; // wad lumps are loaded with their wad
 
-	FS_EnsureOpenFile( file );
-	// we must take care to not read after the end of the file
-	count = file->real_length - file->position;
+	if( size <= 0 || ( !readahead && fs_prefetch.totalsize + size > FS_PREFETCH_MAXSIZE ))
+		return;
 
-	// if we have a lot of data to get, put them directly into "buffer"
-	if( buffersize > sizeof( file->buff ) / 2 )
+	if( fs_prefetch.numfiles == fs_prefetch.maxfiles )
 	{
-		if( count > (fs_offset_t)buffersize )
-			count = (fs_offset_t)buffersize;
-		lseek( file->handle, file->offset + file->position, SEEK_SET );
-		nb = read (file->handle, &((byte *)buffer)[done], count );
-
-		if( nb > 0 )
-		{
-			done += nb;
-			file->position += nb;
-			// purge cached data
-			FS_Purge( file );
-		}
+		fs_prefetch.maxfiles = Q_max( 256, fs_prefetch.maxfiles * 2 );
+		fs_prefetch.files = Mem_Realloc( fs_mempool, fs_prefetch.files, fs_prefetch.maxfiles * sizeof( *fs_prefetch.files ));
 	}
-	else
-	{
-		if( count > (fs_offset_t)sizeof( file->buff ))
-			count = (fs_offset_t)sizeof( file->buff );
-		lseek( file->handle, file->offset + file->position, SEEK_SET );
-		nb = read( file->handle, file->buff, count );
 
-		if( nb > 0 )
-		{
-			file->buff_len = nb;
-			file->position += nb;
+	// keep table at most half full
+	if( fs_prefetch.numfiles * 2 >= fs_prefetch.tablesize )
+	{
+		int	i;
 
-			// copy the requested data in "buffer" (as much as we can)
-			count = (fs_offset_t)buffersize > file->buff_len ? file->buff_len : (fs_offset_t)buffersize;
-			memcpy( &((byte *)buffer)[done], file->buff, count );
-			file->buff_ind = count;
-			done += count;
+		if( fs_prefetch.table )
+			Mem_Free( fs_prefetch.table );
+
+		fs_prefetch.tablesize = Q_max( 512, fs_prefetch.tablesize * 2 );
+		fs_prefetch.table = Mem_Calloc( fs_mempool, fs_prefetch.tablesize * sizeof( *fs_prefetch.table ));
+
+		for( i = 0; i < fs_prefetch.numfiles; i++ )
+		{
+			slot = fs_prefetch.files[i].hash & ( fs_prefetch.tablesize - 1 );
+
+			while( fs_prefetch.table[slot] )
+				slot = ( slot + 1 ) & ( fs_prefetch.tablesize - 1 );
+			fs_prefetch.table[slot] = i + 1;
 		}
 	}
 
-	return done;
-}
+	pf = &fs_prefetch.files[fs_prefetch.numfiles++];
+	memset( pf, 0, sizeof( *pf ));
+	pf->name = copystring( path );
+	pf->hash = FS_IndexHash( path );
+	pf->search = search;
+	pf->index = index;
+	pf->filename = copystring( filename );
+	pf->offset = offset;
+	pf->size = size;
+	pf->compressed = compressed;
+	pf->readahead = readahead;
+
+	// buffers are allocated here, zone allocator is not thread safe
+	if( !readahead )
+	{
+		pf->data = Mem_Malloc( fs_mempool, size + 1 );
+		pf->data[size] = '\0';
+		fs_prefetch.totalsize += size;
+	}
 
-/*
-====================
-FS_Print
+	slot = pf->hash & ( fs_prefetch.tablesize - 1 );
+	while( fs_prefetch.table[slot] )
+		slot = ( slot + 1 ) & ( fs_prefetch.tablesize - 1 );
+	fs_prefetch.table[slot] = fs_prefetch.numfiles;
 
-Print a string into a file
-====================
-*/
-int FS_Print( file_t *file, const char *msg )
-{
-	return FS_Write( file, msg, Q_strlen( msg ));
+	fs_prefetch.stats.queued++;
 }
 
 /*
 ====================
-FS_Printf
+FS_PrefetchStart
 
-Print a string into a file
+read queued files in given number of background threads
 ====================
 */
-int FS_Printf( file_t *file, const char *format, ... )
+void FS_PrefetchStart( int numthreads )
 {
-	int	result;
-	va_list	args;
+	numthreads = bound( 1, numthreads, MAX_POOL_THREADS - 1 );
 
-	va_start( args, format );
-	result = FS_VPrintf( file, format, args );
-	va_end( args );
+	if( !fs_prefetch.numfiles || fs_prefetch.started )
+		return;
 
-	return result;
+	if( fs_prefetch.numthreads != numthreads )
+	{
+		ThreadPool_Destroy( fs_prefetch.pool );
+		// pool counts calling thread too, it only reads in ThreadPool_Wait
+		fs_prefetch.pool = ThreadPool_Create( "FS_Prefetch", numthreads + 1 );
+		fs_prefetch.numthreads = numthreads;
+	}
+
+	fs_prefetch.started = true;
+	ThreadPool_Start( fs_prefetch.pool, FS_PrefetchJob, fs_prefetch.files, fs_prefetch.numfiles );
 }
 
 /*
 ====================
-FS_VPrintf
+FS_PrefetchTake
 
-Print a string into a file
+give away prefetched file if it's still the one FS_FindFile gives
 ====================
 */
-int FS_VPrintf( file_t *file, const char *format, va_list ap )
+static byte *FS_PrefetchTake( const char *path, fs_offset_t *filesizeptr, qboolean gamedironly )
 {
-	int	len;
-	fs_offset_t	buff_size = MAX_SYSPATH;
-	char	*tempbuff;
+	fsprefetch_t	*pf;
+	searchpath_t	*search;
+	byte		*data;
+	int		index;
 
-	if( !file ) return 0;
+	if( !fs_prefetch.numfiles || gamedironly )
+		return NULL;
 
-	while( 1 )
-	{
-		tempbuff = (char *)Mem_Malloc( fs_mempool, buff_size );
-		len = Q_vsprintf( tempbuff, format, ap );
+	if( path[0] == '/' || path[0] == '\\' )
+		path++;
 
-		if( len >= 0 && len < buff_size )
-			break;
+	if( path[0] == '/' || path[0] == '\\' )
+		path++;
 
-		Mem_Free( tempbuff );
-		buff_size *= 2;
+	if(( pf = FS_PrefetchFind( path )) == NULL || !pf->data )
+		return NULL;
+
+	// load order stays the same, just wait for all reads
+	ThreadPool_Wait( fs_prefetch.pool );
+
+	search = FS_FindFile( path, &index, false );
+	data = pf->data;
+	pf->data = NULL;
+
+	if( !pf->ready )
+	{
+		fs_prefetch.stats.failed++;
+		Mem_Free( data );
+		return NULL;
 	}
 
-	len = write( file->handle, tempbuff, len );
-	Mem_Free( tempbuff );
+	if( search != pf->search || index != pf->index )
+	{
+		fs_prefetch.stats.stale++;
+		Mem_Free( data );
+		return NULL;
+	}
 
-	return len;
+	fs_prefetch.stats.taken++;
+	fs_prefetch.stats.bytes += pf->size;
+	if( filesizeptr ) *filesizeptr = pf->size;
+
+	return data;
 }
 
 /*
 ====================
-FS_Getc
+FS_PrefetchClear
 
-Get the next character of a file
+drop files nobody asked for
 ====================
 */
-int FS_Getc( file_t *file )
+void FS_PrefetchClear( void )
 {
-	char	c;
+	int	i, unused = 0;
 
-	if( FS_Read( file, &c, 1 ) != 1 )
-		return EOF;
+	ThreadPool_Wait( fs_prefetch.pool );
 
-	return c;
+	for( i = 0; i < MAX_POOL_THREADS; i++ )
+	{
+		if( fs_prefetch.archives[i] )
+			close( fs_prefetch.handles[i] );
+		fs_prefetch.archives[i] = NULL;
+	}
+
+	for( i = 0; i < fs_prefetch.numfiles; i++ )
+	{
+		fsprefetch_t	*pf = &fs_prefetch.files[i];
+
+		if( pf->data )
+		{
+			Mem_Free( pf->data );
+			unused++;
+		}
+
+		Mem_Free( pf->name );
+		Mem_Free( pf->filename );
+	}
+
+	if( fs_prefetch.numfiles )
+	{
+		Con_Reportf( "FS_PrefetchClear: %i files prefetched, %i used, %i unused\n",
+			fs_prefetch.numfiles, fs_prefetch.numfiles - unused, unused );
+	}
+
+	if( fs_prefetch.table )
+		memset( fs_prefetch.table, 0, fs_prefetch.tablesize * sizeof( *fs_prefetch.table ));
+
+	fs_prefetch.numfiles = 0;
+	fs_prefetch.totalsize = 0;
+	fs_prefetch.started = false;
 }
 
 /*
 ====================
-FS_UnGetc
+FS_PrefetchShutdown
 
-Put a character back into the read buffer (only supports one character!)
 ====================
 */
-int FS_UnGetc( file_t *file, byte c )
+static void FS_PrefetchShutdown( void )
 {
-	// If there's already a character waiting to be read
-	if( file->ungetc != EOF )
-		return EOF;
+	FS_PrefetchClear();
+	ThreadPool_Destroy( fs_prefetch.pool );
 
-	file->ungetc = c;
-	return c;
+	if( fs_prefetch.files )
+		Mem_Free( fs_prefetch.files );
+	if( fs_prefetch.table )
+		Mem_Free( fs_prefetch.table );
+
+	memset( &fs_prefetch, 0, sizeof( fs_prefetch ));
 }
 
 /*
 ====================
-FS_Gets
+FS_PrefetchBench_f
 
-Same as fgets
+load archived files one by one and after prefetch
 ====================
 */
-int FS_Gets( file_t *file, byte *string, size_t bufsize )
+static void FS_PrefetchBench_f( void )
 {
-	int	c, end = 0;
+	searchpath_t	*search;
+	stringlist_t	names;
+	int		i, pass, numthreads = 4;
 
-	while( 1 )
-	{
-		c = FS_Getc( file );
+	if( Cmd_Argc() > 1 )
+		numthreads = bound( 1, Q_atoi( Cmd_Argv( 1 )), MAX_POOL_THREADS - 1 );
 
-		if( c == '\r' || c == '\n' || c < 0 )
-			break;
+	stringlistinit( &names );
 
-		if( end < bufsize - 1 )
-			string[end++] = c;
+	for( search = fs_searchpaths; search; search = search->next )
+	{
+		if( search->pack )
+		{
+			for( i = 0; i < search->pack->numfiles; i++ )
+				stringlistappend( &names, search->pack->files[i].name );
+		}
+		else if( search->zip )
+		{
+			for( i = 0; i < search->zip->numfiles; i++ )
+				stringlistappend( &names, search->zip->files[i].name );
+		}
 	}
-	string[end] = 0;
 
-	// remove \n following \r
-	if( c == '\r' )
+	if( !names.numstrings )
 	{
-		c = FS_Getc( file );
-
-		if( c != '\n' )
-			FS_UnGetc( file, (byte)c );
+		Con_Printf( "fs_prefetch_bench: no pak or zip files in search paths\n" );
+		return;
 	}
 
-	return c;
-}
-
-/*
-====================
-FS_Seek
+	FS_PrefetchClear();
+	memset( &fs_prefetch.stats, 0, sizeof( fs_prefetch.stats ));
 
-Move the position index in a file
-====================
-*/
-int FS_Seek( file_t *file, fs_offset_t offset, int whence )
-{
-	// compute the file offset
-	switch( whence )
+	for( pass = 0; pass < 2; pass++ )
 	{
-	case SEEK_CUR:
-		offset += file->position - file->buff_len + file->buff_ind;
-		break;
-	case SEEK_SET:
-		break;
-	case SEEK_END:
-		offset += file->real_length;
-		break;
-	default:
-		return -1;
-	}
+		double	start = Sys_DoubleTime();
+		size_t	total = 0;
 
-	if( offset < 0 || offset > file->real_length )
-		return -1;
+		if( pass )
+		{
+			for( i = 0; i < names.numstrings; i++ )
+				FS_PrefetchFile( names.strings[i] );
+			FS_PrefetchStart( numthreads );
+		}
 
-	// if we have the data in our read buffer, we don't need to actually seek
-	if( file->position - file->buff_len <= offset && offset <= file->position )
-	{
-		file->buff_ind = offset + file->buff_len - file->position;
-		return 0;
-	}
+		for( i = 0; i < names.numstrings; i++ )
+		{
+			fs_offset_t	size;
+			byte		*data = FS_LoadFile( names.strings[i], &size, false );
 
-	FS_EnsureOpenFile( file );
-	// Purge cached data
-	FS_Purge( file );
+			if( data )
+			{
+				total += size;
+				Mem_Free( data );
+			}
+		}
 
-	if( lseek( file->handle, file->offset + offset, SEEK_SET ) == -1 )
-		return -1;
-	file->position = offset;
+		Con_Printf( "%-16s %i files, %.1f MB in %.3f sec\n", pass ? "with prefetch" : "without prefetch", names.numstrings,
+			total / ( 1024.0 * 1024.0 ), Sys_DoubleTime() - start );
+	}
 
-	return 0;
+	Con_Printf( "%u queued, %u taken (%.1f MB), %u stale, %u failed, %i threads\n", fs_prefetch.stats.queued, fs_prefetch.stats.taken,
+		fs_prefetch.stats.bytes / ( 1024.0 * 1024.0 ), fs_prefetch.stats.stale, fs_prefetch.stats.failed, numthreads );
+
+	FS_PrefetchClear();
+	stringlistfreecontents( &names );
 }
 
 /*
 ====================
-FS_Tell
+FS_MapBench_f
 
-Give the current position in a file
+read every archived file with FS_LoadFile and FS_MapFile
 ====================
 */
-fs_offset_t FS_Tell( file_t *file )
+static void FS_MapBench_f( void )
 {
-	if( !file ) return 0;
-	return file->position - file->buff_len + file->buff_ind;
-}
+	searchpath_t	*search;
+	stringlist_t	names;
+	int		i, pass;
 
-/*
-====================
-FS_Eof
+	stringlistinit( &names );
 
-indicates at reached end of file
-====================
-*/
-qboolean FS_Eof( file_t *file )
-{
-	if( !file ) return true;
-	return (( file->position - file->buff_len + file->buff_ind ) == file->real_length ) ? true : false;
-}
+	for( search = fs_searchpaths; search; search = search->next )
+	{
+		if( search->pack )
+		{
+			for( i = 0; i < search->pack->numfiles; i++ )
+				stringlistappend( &names, search->pack->files[i].name );
+		}
+		else if( search->zip )
+		{
+			for( i = 0; i < search->zip->numfiles; i++ )
+				stringlistappend( &names, search->zip->files[i].name );
+		}
+	}
 
-/*
-====================
-FS_Purge
+	if( !names.numstrings )
+	{
+		Con_Printf( "fs_map_bench: no pak or zip files in search paths\n" );
+		return;
+	}
 
-Erases any buffered input or output data
-====================
-*/
-void FS_Purge( file_t *file )
-{
-	file->buff_len = 0;
-	file->buff_ind = 0;
-	file->ungetc = EOF;
-}
+	for( pass = 0; pass < 2; pass++ )
+	{
+		double	start = Sys_DoubleTime();
+		size_t	total = 0, peak = 0, heap = 0;
+		uint	sum = 0;
 
-/*
-============
-FS_LoadFile
+		for( i = 0; i < names.numstrings; i++ )
+		{
+			fs_offset_t	size, j;
+			byte		*data;
+			size_t		loaded = fs_map.loadedbytes;
 
-Filename are relative to the xash directory.
-Always appends a 0 byte.
-============
-*/
-byte *FS_LoadFile( const char *path, fs_offset_t *filesizeptr, qboolean gamedironly )
-{
-	file_t	*file;
-	byte	*buf = NULL;
-	fs_offset_t	filesize = 0;
+			if( pass == 0 ) data = FS_LoadFile( names.strings[i], &size, false );
+			else data = FS_MapFile( names.strings[i], &size, false );
 
-	file = FS_Open( path, "rb", gamedironly );
+			if( !data ) continue;
 
-	if( file )
-	{
-		filesize = file->real_length;
+			// touch every page like a loader does
+			for( j = 0; j < size; j += 64 )
+				sum += data[j];
 
-		buf = (byte *)Mem_Malloc( fs_mempool, filesize + 1 );
-		buf[filesize] = '\0';
-		FS_Read( file, buf, filesize );
-		FS_Close( file );
-	}
-	else
-	{
-		buf = W_LoadFile( path, &filesize, gamedironly );
+			total += size;
 
-		if( !buf )
-			buf = Zip_LoadFile( path, &filesize, gamedironly );
+			if( pass == 0 ) heap = size;
+			else heap = fs_map.loadedbytes - loaded;
+			peak = Q_max( peak, heap );
+
+			if( pass == 0 ) Mem_Free( data );
+			else FS_UnmapFile( data );
+		}
 
+		Con_Printf( "%-11s %i files, %.1f MB, %.1f MB/s, largest heap buffer %.1f KB (%u)\n", pass ? "FS_MapFile" : "FS_LoadFile",
+			names.numstrings, total / ( 1024.0 * 1024.0 ), total / ( 1024.0 * 1024.0 ) / ( Sys_DoubleTime() - start ), peak / 1024.0, sum & 1 );
 	}
 
-	if( filesizeptr )
-		*filesizeptr = filesize;
+	Con_Printf( "%u files mapped (%.1f MB), %u loaded (%.1f MB)\n", fs_map.mapped, fs_map.mappedbytes / ( 1024.0 * 1024.0 ),
+		fs_map.loaded, fs_map.loadedbytes / ( 1024.0 * 1024.0 ));
 
-	return buf;
+	stringlistfreecontents( &names );
 }
 
 qboolean CRC32_File( dword *crcvalue, const char *filename )
@@ -3440,6 +5849,7 @@ qboolean FS_Rename( const char *oldname, const char *newname )
 	COM_FixSlashes( newpath );
 
 	iRet = rename( oldpath, newpath );
+	FS_IndexTouch();
 
 	return (iRet == 0);
 }
@@ -3462,6 +5872,7 @@ qboolean GAME_EXPORT FS_Delete( const char *path )
 	Q_snprintf( real_path, sizeof( real_path ), "%s%s", fs_writedir, path );
 	COM_FixSlashes( real_path );
 	iRet = remove( real_path );
+	FS_IndexTouch();
 
 	return (iRet == 0);
 }
@@ -3518,6 +5929,7 @@ search_t *FS_Search( const char *pattern, int caseinsensitive, int gamedironly )
 	const char	*slash, *backslash, *colon, *separator;
 	string		netpath, temp;
 	stringlist_t	resultlist;
+	stringset_t	resultset;
 	stringlist_t	dirlist;
 	char		*basepath;
 
@@ -3526,6 +5938,7 @@ search_t *FS_Search( const char *pattern, int caseinsensitive, int gamedironly )
 
 	stringlistinit( &resultlist );
 	stringlistinit( &dirlist );
+	memset( &resultset, 0, sizeof( resultset ));
 	slash = Q_strrchr( pattern, '/' );
 	backslash = Q_strrchr( pattern, '\\' );
 	colon = Q_strrchr( pattern, ':' );
@@ -3536,6 +5949,9 @@ search_t *FS_Search( const char *pattern, int caseinsensitive, int gamedironly )
 	if( basepathlength ) memcpy( basepath, pattern, basepathlength );
 	basepath[basepathlength] = 0;
 
+	if( !fs_index.disabled )
+		FS_IndexUpdate();
+
 	// search through the path, one element at a time
 	for( searchpath = fs_searchpaths; searchpath; searchpath = searchpath->next )
 	{
@@ -3553,16 +5969,7 @@ search_t *FS_Search( const char *pattern, int caseinsensitive, int gamedironly )
 				while( temp[0] )
 				{
 					if( matchpattern( temp, (char *)pattern, true ))
-					{
-						for( resultlistindex = 0; resultlistindex < resultlist.numstrings; resultlistindex++ )
-						{
-							if( !Q_strcmp( resultlist.strings[resultlistindex], temp ))
-								break;
-						}
-
-						if( resultlistindex == resultlist.numstrings )
-							stringlistappend( &resultlist, temp );
-					}
+						stringlistappendunique( &resultlist, &resultset, temp );
 
 					// strip off one path element at a time until empty
 					// this way directories are added to the listing if they match the pattern
@@ -3625,19 +6032,10 @@ search_t *FS_Search( const char *pattern, int caseinsensitive, int gamedironly )
 				{
 					if( matchpattern( temp, wadpattern, true ))
 					{
-						for( resultlistindex = 0; resultlistindex < resultlist.numstrings; resultlistindex++ )
-						{
-							if( !Q_strcmp( resultlist.strings[resultlistindex], temp ))
-								break;
-						}
-
-						if( resultlistindex == resultlist.numstrings )
-						{
-							// build path: wadname/lumpname.ext
-							Q_snprintf( temp2, sizeof(temp2), "%s/%s", wadfolder, temp );
-							COM_DefaultExtension( temp2, va(".%s", W_ExtFromType( wad->lumps[i].type )));
-							stringlistappend( &resultlist, temp2 );
-						}
+						// build path: wadname/lumpname.ext
+						Q_snprintf( temp2, sizeof(temp2), "%s/%s", wadfolder, temp );
+						COM_DefaultExtension( temp2, va(".%s", W_ExtFromType( wad->lumps[i].type )));
+						stringlistappendunique( &resultlist, &resultset, temp2 );
 					}
 
 					// strip off one path element at a time until empty
@@ -3656,6 +6054,21 @@ search_t *FS_Search( const char *pattern, int caseinsensitive, int gamedironly )
 				}
 			}
 		}
+		else if( !fs_index.disabled )
+		{
+			// use cached directory listing
+			fsdir_t	*dir = FS_IndexGetDir( searchpath, basepath, basepathlength );
+			const char	*name = dir->names;
+
+			for( dirlistindex = 0; dirlistindex < dir->numfiles + dir->numsubdirs; dirlistindex++ )
+			{
+				Q_snprintf( temp, sizeof( temp ), "%s%s", basepath, name );
+				name += Q_strlen( name ) + 1;
+
+				if( matchpattern( temp, (char *)pattern, true ))
+					stringlistappendunique( &resultlist, &resultset, temp );
+			}
+		}
 		else
 		{
 			// get a directory listing and look at each name
@@ -3668,22 +6081,15 @@ search_t *FS_Search( const char *pattern, int caseinsensitive, int gamedironly )
 				Q_sprintf( temp, "%s%s", basepath, dirlist.strings[dirlistindex] );
 
 				if( matchpattern( temp, (char *)pattern, true ))
-				{
-					for( resultlistindex = 0; resultlistindex < resultlist.numstrings; resultlistindex++ )
-					{
-						if( !Q_strcmp( resultlist.strings[resultlistindex], temp ))
-							break;
-					}
-
-					if( resultlistindex == resultlist.numstrings )
-						stringlistappend( &resultlist, temp );
-				}
+					stringlistappendunique( &resultlist, &resultset, temp );
 			}
 
 			stringlistfreecontents( &dirlist );
 		}
 	}
 
+	stringsetfree( &resultset );
+
 	if( resultlist.numstrings )
 	{
 		stringlistsort( &resultlist );
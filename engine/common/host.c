@@ -635,6 +635,8 @@ void Host_Frame( float time )
 	if( !Host_FilterTime( time ))
 		return;
 
+	host.framestart = Sys_DoubleTime();
+
 	Host_InputFrame ();  // input frame
 	Host_ClientBegin (); // begin client
 	Host_GetCommands (); // dedicated in
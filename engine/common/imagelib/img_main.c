@@ -249,16 +249,16 @@ rgbdata_t *FS_LoadImage( const char *filename, const byte *buffer, size_t size )
 		{
 			Q_sprintf( path, format->formatstring, loadname, "", format->ext );
 			image.hint = format->hint;
-			f = FS_LoadFile( path, &filesize, false );
+			f = FS_MapFile( path, &filesize, false );
 
 			if( f && filesize > 0 )
 			{
 				if( format->loadfunc( path, f, filesize ))
 				{
-					Mem_Free( f ); // release buffer
+					FS_UnmapFile( f ); // release buffer
 					return ImagePack(); // loaded
 				}
-				else Mem_Free( f ); // release buffer
+				else FS_UnmapFile( f ); // release buffer
 			}
 		}
 	}
@@ -277,7 +277,7 @@ rgbdata_t *FS_LoadImage( const char *filename, const byte *buffer, size_t size )
 					Q_sprintf( path, format->formatstring, loadname, cmap->type[i].suf, format->ext );
 					image.hint = (image_hint_t)cmap->type[i].hint; // side hint
 
-					f = FS_LoadFile( path, &filesize, false );
+					f = FS_MapFile( path, &filesize, false );
 					if( f && filesize > 0 )
 					{
 						// this name will be used only for tell user about problems
@@ -286,11 +286,11 @@ rgbdata_t *FS_LoadImage( const char *filename, const byte *buffer, size_t size )
 							Q_snprintf( sidename, sizeof( sidename ), "%s%s.%s", loadname, cmap->type[i].suf, format->ext );
 							if( FS_AddSideToPack( sidename, cmap->type[i].flags )) // process flags to flip some sides
 							{
-								Mem_Free( f );
+								FS_UnmapFile( f );
 								break; // loaded
 							}
 						}
-						Mem_Free( f );
+						FS_UnmapFile( f );
 					}
 				}
 			}
@@ -24,6 +24,7 @@ GNU General Public License for more details.
 #include "client.h"
 #include "server.h"			// LUMP_ error codes
 #include "ref_common.h"
+#include "pm_local.h"
 typedef struct wadlist_s
 {
 	char			wadnames[MAX_MAP_WADS][32];
@@ -1298,6 +1299,9 @@ static void Mod_MakeHull0( void )
 			else out->children[j] = child - loadmodel->nodes;
 		}
 	}
+
+	if( mod_flathulls->value )
+		PM_PackHull( hull, loadmodel->numnodes, loadmodel->mempool );
 }
 
 /*
@@ -1352,6 +1356,9 @@ static void Mod_SetupHull( dbspmodel_t *bmod, model_t *mod, byte *mempool, int h
 
 	// remap clipnodes to 16-bit indexes
 	RemapClipNodes_r( bmod->clipnodes_out, hull, headnode );
+
+	if( mod_flathulls->value )
+		PM_PackHull( hull, count, mempool );
 }
 
 /*
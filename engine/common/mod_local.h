@@ -121,6 +121,7 @@ extern byte		*com_studiocache;
 extern model_t		*loadmodel;
 extern convar_t		*mod_studiocache;
 extern convar_t		*r_wadtextures;
+extern convar_t		*mod_flathulls;
 extern convar_t		*r_showhull;
 
 //
@@ -23,6 +23,7 @@ GNU General Public License for more details.
 #include "enginefeatures.h"
 #include "client.h"
 #include "server.h"
+#include "pm_local.h"
 
 static model_info_t	mod_crcinfo[MAX_MODELS];
 static model_t	mod_known[MAX_MODELS];
@@ -31,6 +32,7 @@ byte		*com_studiocache;		// cache for submodels
 convar_t		*mod_studiocache;
 convar_t		*r_wadtextures;
 convar_t		*r_showhull;
+convar_t		*mod_flathulls;
 model_t		*loadmodel;
 
 /*
@@ -106,6 +108,8 @@ void Mod_FreeModel( model_t *mod )
 
 	if( mod->type != mod_brush || mod->name[0] != '*' )
 	{
+		if( mod->type == mod_brush )
+			PM_FreePackedHulls( mod->mempool );
 		Mod_FreeUserData( mod );
 		Mem_FreePool( &mod->mempool );
 	}
@@ -137,9 +141,11 @@ void Mod_Init( void )
 	mod_studiocache = Cvar_Get( "r_studiocache", "1", FCVAR_ARCHIVE, "enables studio cache for speedup tracing hitboxes" );
 	r_wadtextures = Cvar_Get( "r_wadtextures", "0", 0, "completely ignore textures in the bsp-file if enabled" );
 	r_showhull = Cvar_Get( "r_showhull", "0", 0, "draw collision hulls 1-3" );
+	mod_flathulls = Cvar_Get( "mod_flathulls", "1", 0, "pack collision hulls into flat arrays on map load for faster traces" );
 
 	Cmd_AddCommand( "mapstats", Mod_PrintWorldStats_f, "show stats for currently loaded map" );
 	Cmd_AddCommand( "modellist", Mod_Modellist_f, "display loaded models list" );
+	Cmd_AddCommand( "pm_trace_bench", PM_TraceBench_f, "record hull traces and replay them with recursive and flat kernels" );
 
 	Mod_ResetStudioAPI ();
 	Mod_InitStudioHull ();
@@ -272,7 +278,7 @@ model_t *Mod_LoadModel( model_t *mod, qboolean crash )
 	Q_strncpy( tempname, mod->name, sizeof( tempname ));
 	COM_FixSlashes( tempname );
 
-	buf = FS_LoadFile( tempname, &length, false );
+	buf = FS_MapFile( tempname, &length, false );
 
 	if( !buf )
 	{
@@ -309,7 +315,7 @@ model_t *Mod_LoadModel( model_t *mod, qboolean crash )
 		// ref.dllFuncs.Mod_LoadModel( mod_brush, mod, buf, &loaded, 0 );
 		break;
 	default:
-		Mem_Free( buf );
+		FS_UnmapFile( buf );
 		if( crash ) Host_Error( "%s has unknown format\n", tempname );
 		else Con_Printf( S_ERROR "%s has unknown format\n", tempname );
 		return NULL;
@@ -338,7 +344,7 @@ model_t *Mod_LoadModel( model_t *mod, qboolean crash )
 	if( !loaded )
 	{
 		Mod_FreeModel( mod );
-		Mem_Free( buf );
+		FS_UnmapFile( buf );
 
 		if( crash ) Host_Error( "Could not load model %s\n", tempname );
 		else Con_Printf( S_ERROR "Could not load model %s\n", tempname );
@@ -368,7 +374,7 @@ model_t *Mod_LoadModel( model_t *mod, qboolean crash )
 			p->initialCRC = currentCRC;
 		}
 	}
-	Mem_Free( buf );
+	FS_UnmapFile( buf );
 
 	return mod;
 }
@@ -529,11 +535,11 @@ void Mod_LoadCacheFile( const char *filename, cache_user_t *cu )
 	Q_strncpy( modname, filename, sizeof( modname ));
 	COM_FixSlashes( modname );
 
-	buf = FS_LoadFile( modname, &size, false );
+	buf = FS_MapFile( modname, &size, false );
 	if( !buf || !size ) Host_Error( "LoadCacheFile: ^1can't load %s^7\n", filename );
 	cu->data = Mem_Malloc( com_studiocache, size );
 	memcpy( cu->data, buf, size );
-	Mem_Free( buf );
+	FS_UnmapFile( buf );
 }
 
 /*
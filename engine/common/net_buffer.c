@@ -27,6 +27,38 @@ GNU General Public License for more details.
 static dword	BitWriteMasks[32][33];
 static dword	ExtraMasks[32];
 
+// write calls capture for msg_bench, see below
+typedef struct msgop_s
+{
+	byte		type;
+	byte		bits;
+	word		pad;
+	uint		value;	// data for bit ops, bit count for blobs
+} msgop_t;
+
+enum
+{
+	MSGOP_ONEBIT = 0,
+	MSGOP_UBITLONG,
+	MSGOP_BITS,
+};
+
+typedef struct msgtrace_s
+{
+	qboolean		active;
+	msgop_t		*ops;
+	int		numops;
+	int		maxops;
+	byte		*blob;	// MSG_WriteBits payloads
+	int		blobsize;
+	int		maxblob;
+	string		filename;
+} msgtrace_t;
+
+static msgtrace_t	msg_trace;
+
+static void MSG_TraceOp( int type, uint value, int bits, const void *data );
+
 short MSG_BigShort( short swap )
 {
 	return (swap >> 8)|(swap << 8);
@@ -138,6 +170,9 @@ void MSG_SeekToByte( sizebuf_t *sb, int bytePos )
 
 void MSG_WriteOneBit( sizebuf_t *sb, int nValue )
 {
+	if( msg_trace.active )
+		MSG_TraceOp( MSGOP_ONEBIT, nValue, 1, NULL );
+
 	if( !MSG_Overflow( sb, 1 ))
 	{
 		if( nValue ) sb->pData[sb->iCurBit>>3] |= BIT( sb->iCurBit & 7 );
@@ -147,7 +182,7 @@ void MSG_WriteOneBit( sizebuf_t *sb, int nValue )
 	}
 }
 
-void MSG_WriteUBitLong( sizebuf_t *sb, uint curData, int numbits )
+static void MSG_StoreUBitLong( sizebuf_t *sb, uint curData, int numbits )
 {
 	Assert( numbits >= 0 && numbits <= 32 );
 
@@ -188,6 +223,14 @@ void MSG_WriteUBitLong( sizebuf_t *sb, uint curData, int numbits )
 	}
 }
 
+void MSG_WriteUBitLong( sizebuf_t *sb, uint curData, int numbits )
+{
+	if( msg_trace.active )
+		MSG_TraceOp( MSGOP_UBITLONG, curData, numbits, NULL );
+
+	MSG_StoreUBitLong( sb, curData, numbits );
+}
+
 /*
 =======================
 MSG_WriteSBitLong
@@ -221,7 +264,153 @@ void MSG_WriteBitLong( sizebuf_t *sb, int data, int numbits, qboolean bSigned )
 	else MSG_WriteUBitLong( sb, (uint)data, numbits );
 }
 
-qboolean MSG_WriteBits( sizebuf_t *sb, const void *pData, int nBits )
+/*
+=======================
+MSG_BeginBitWriter
+
+pick up partial dword at the current position
+=======================
+*/
+void MSG_BeginBitWriter( bitwriter_t *bw, sizebuf_t *sb )
+{
+	bw->sb = sb;
+	bw->iWordBit = sb->iCurBit & ~31;
+	bw->nAccumBits = sb->iCurBit & 31;
+	bw->accum = 0;
+	bw->bTrace = msg_trace.active;
+
+#ifdef XASH_LITTLE_ENDIAN
+	if( bw->nAccumBits )
+	{
+		uint	word = 0;
+
+		memcpy( &word, sb->pData + ( bw->iWordBit >> 3 ), BitByte( bw->nAccumBits ));
+		bw->accum = word & ExtraMasks[bw->nAccumBits];
+	}
+
+	// recording goes through the slow path
+	bw->iMaxBit = ( bw->bTrace || sb->bOverflow ) ? -1 : sb->nDataBits;
+#else
+	bw->iMaxBit = -1;
+#endif
+}
+
+/*
+=======================
+MSG_EndBitWriter
+
+store the tail, bits past the end
+of the last byte are left untouched
+=======================
+*/
+void MSG_EndBitWriter( bitwriter_t *bw )
+{
+#ifdef XASH_LITTLE_ENDIAN
+	sizebuf_t	*sb = bw->sb;
+
+	if( sb->bOverflow )
+		return;
+
+	if( bw->nAccumBits )
+	{
+		int	bytes = BitByte( bw->nAccumBits );
+		byte	*out = sb->pData + ( bw->iWordBit >> 3 );
+		uint	word = (uint)bw->accum;
+		byte	keep = 0;
+
+		if( bw->nAccumBits & 7 )
+			keep = out[bytes - 1] & ~( BIT( bw->nAccumBits & 7 ) - 1 );
+
+		memcpy( out, &word, bytes );
+		out[bytes - 1] |= keep;
+	}
+
+	sb->iCurBit = bw->iWordBit + bw->nAccumBits;
+#endif
+}
+
+/*
+=======================
+MSG_PutUBitLongSlow
+
+MSG_PutUBitLong gets here when it's near the end
+of buffer, overflowed, recording or big-endian
+=======================
+*/
+void MSG_PutUBitLongSlow( bitwriter_t *bw, uint curData, int numbits )
+{
+	sizebuf_t	*sb = bw->sb;
+
+	Assert( numbits >= 0 && numbits <= 32 );
+
+	if( bw->bTrace && msg_trace.active )
+		MSG_TraceOp( MSGOP_UBITLONG, curData, numbits, NULL );
+
+#ifdef XASH_LITTLE_ENDIAN
+	if( sb->bOverflow || bw->iWordBit + bw->nAccumBits + numbits > sb->nDataBits )
+	{
+		sb->bOverflow = true;
+		sb->iCurBit = sb->nDataBits;
+		bw->iMaxBit = -1;
+		return;
+	}
+
+	MSG_AccumBits( bw, curData, numbits );
+#else
+	MSG_StoreUBitLong( sb, curData, numbits );
+#endif
+}
+
+/*
+=======================
+MSG_PutBitAngle
+
+=======================
+*/
+void MSG_PutBitAngle( bitwriter_t *bw, float fAngle, int numbits )
+{
+	uint	mask, shift;
+	int	d;
+
+	// clamp the angle before receiving
+	fAngle = fmod( fAngle, 360.0f );
+	if( fAngle < 0 ) fAngle += 360.0f;
+
+	shift = ( 1 << numbits );
+	mask = shift - 1;
+
+	d = (int)(( fAngle * shift ) / 360.0f );
+	d &= mask;
+
+	MSG_PutUBitLong( bw, (uint)d, numbits );
+}
+
+/*
+=======================
+MSG_PutString
+
+=======================
+*/
+void MSG_PutString( bitwriter_t *bw, const char *pStr )
+{
+	if( pStr )
+	{
+		do
+		{
+			MSG_PutSBitLong( bw, *pStr, 8 );
+			pStr++;
+		} while( *( pStr - 1 ));
+	}
+	else MSG_PutSBitLong( bw, 0, 8 );
+}
+
+/*
+=======================
+MSG_WriteBitsLegacy
+
+=======================
+*/
+static qboolean MSG_WriteBitsLegacy( sizebuf_t *sb, const void *pData, int nBits )
 {
 	byte	*pOut = (byte *)pData;
 	int	nBitsLeft = nBits;
@@ -229,7 +418,7 @@ qboolean MSG_WriteBits( sizebuf_t *sb, const void *pData, int nBits )
 	// get output dword-aligned.
 	while((( dword )pOut & 3 ) != 0 && nBitsLeft >= 8 )
 	{
-		MSG_WriteUBitLong( sb, *pOut, 8 );
+		MSG_StoreUBitLong( sb, *pOut, 8 );
 
 		nBitsLeft -= 8;
 		++pOut;
@@ -238,7 +427,7 @@ qboolean MSG_WriteBits( sizebuf_t *sb, const void *pData, int nBits )
 	// read dwords.
 	while( nBitsLeft >= 32 )
 	{
-		MSG_WriteUBitLong( sb, *(( dword *)pOut ), 32 );
+		MSG_StoreUBitLong( sb, *(( dword *)pOut ), 32 );
 
 		pOut += sizeof( dword );
 		nBitsLeft -= 32;
@@ -247,7 +436,7 @@ qboolean MSG_WriteBits( sizebuf_t *sb, const void *pData, int nBits )
 	// read the remaining bytes.
 	while( nBitsLeft >= 8 )
 	{
-		MSG_WriteUBitLong( sb, *pOut, 8 );
+		MSG_StoreUBitLong( sb, *pOut, 8 );
 
 		nBitsLeft -= 8;
 		++pOut;
@@ -256,12 +445,70 @@ qboolean MSG_WriteBits( sizebuf_t *sb, const void *pData, int nBits )
 	// Read the remaining bits.
 	if( nBitsLeft )
 	{
-		MSG_WriteUBitLong( sb, *pOut, nBitsLeft );
+		MSG_StoreUBitLong( sb, *pOut, nBitsLeft );
 	}
 
 	return !sb->bOverflow;
 }
 
+qboolean MSG_WriteBits( sizebuf_t *sb, const void *pData, int nBits )
+{
+	const byte	*pIn = (const byte *)pData;
+	int		nBitsLeft = nBits;
+	bitwriter_t	bw;
+	uint		value;
+
+	if( msg_trace.active )
+		MSG_TraceOp( MSGOP_BITS, nBits, 0, pData );
+
+	// keep partial write of overflowed buffers as it was
+	if( sb->iCurBit + nBits > sb->nDataBits )
+		return MSG_WriteBitsLegacy( sb, pData, nBits );
+
+	// aligned run is just a copy
+	if(( sb->iCurBit & 7 ) == 0 )
+	{
+		int	bytes = nBitsLeft >> 3;
+
+		memcpy( sb->pData + ( sb->iCurBit >> 3 ), pIn, bytes );
+		sb->iCurBit += bytes << 3;
+		nBitsLeft -= bytes << 3;
+		pIn += bytes;
+
+		if( !nBitsLeft )
+			return !sb->bOverflow;
+	}
+
+	// it's a single call for the trace
+	MSG_BeginBitWriter( &bw, sb );
+	bw.bTrace = false;
+#ifdef XASH_LITTLE_ENDIAN
+	bw.iMaxBit = sb->nDataBits;
+#endif
+
+	while( nBitsLeft >= 32 )
+	{
+		memcpy( &value, pIn, sizeof( value ));
+		MSG_PutUBitLong( &bw, value, 32 );
+		nBitsLeft -= 32;
+		pIn += sizeof( value );
+	}
+
+	while( nBitsLeft >= 8 )
+	{
+		MSG_PutUBitLong( &bw, *pIn, 8 );
+		nBitsLeft -= 8;
+		pIn++;
+	}
+
+	if( nBitsLeft )
+		MSG_PutUBitLong( &bw, *pIn, nBitsLeft );
+
+	MSG_EndBitWriter( &bw );
+
+	return !sb->bOverflow;
+}
+
 void MSG_WriteBitAngle( sizebuf_t *sb, float fAngle, int numbits )
 {
 	uint	mask, shift;
@@ -406,7 +653,15 @@ int MSG_ReadOneBit( sizebuf_t *sb )
 	return 0;
 }
 
-uint MSG_ReadUBitLong( sizebuf_t *sb, int numbits )
+/*
+=======================
+MSG_ReadUBitLongLegacy
+
+dword reads with mask tables, used near the end
+of buffer and as msg_bench reference
+=======================
+*/
+static uint MSG_ReadUBitLongLegacy( sizebuf_t *sb, int numbits )
 {
 	int	idword1;
 	uint	dword1, ret;
@@ -454,6 +709,56 @@ uint MSG_ReadUBitLong( sizebuf_t *sb, int numbits )
 	return ret;
 }
 
+/*
+=======================
+MSG_GetBits
+
+numbits must be in the buffer. 32 bits at any bit offset
+need at most 39 bits of unaligned 64-bit word, so there
+is no dword span to handle
+=======================
+*/
+static uint MSG_GetBits( sizebuf_t *sb, int numbits )
+{
+#ifdef XASH_LITTLE_ENDIAN
+	int	ofs = sb->iCurBit >> 3;
+
+	if( ofs + (int)sizeof( uint64_t ) <= ( sb->nDataBits >> 3 ))
+	{
+		uint64_t	word;
+
+		memcpy( &word, sb->pData + ofs, sizeof( word ));
+		word >>= sb->iCurBit & 7;
+		sb->iCurBit += numbits;
+
+		return (uint)( word & ((( uint64_t )1 << numbits ) - 1 ));
+	}
+#endif
+	return MSG_ReadUBitLongLegacy( sb, numbits );
+}
+
+uint MSG_ReadUBitLong( sizebuf_t *sb, int numbits )
+{
+	if( numbits == 8 )
+	{
+		int leftBits = MSG_GetNumBitsLeft( sb );
+
+		if( leftBits >= 0 && leftBits < 8 )
+			return 0;	// end of message
+	}
+
+	if(( sb->iCurBit + numbits ) > sb->nDataBits )
+	{
+		sb->bOverflow = true;
+		sb->iCurBit = sb->nDataBits;
+		return 0;
+	}
+
+	Assert( numbits > 0 && numbits <= 32 );
+
+	return MSG_GetBits( sb, numbits );
+}
+
 float MSG_ReadBitFloat( sizebuf_t *sb )
 {
 	int	val;
@@ -480,7 +785,13 @@ float MSG_ReadBitFloat( sizebuf_t *sb )
 	return *((float *)&val);
 }
 
-qboolean MSG_ReadBits( sizebuf_t *sb, void *pOutData, int nBits )
+/*
+=======================
+MSG_ReadBitsLegacy
+
+=======================
+*/
+static qboolean MSG_ReadBitsLegacy( sizebuf_t *sb, void *pOutData, int nBits )
 {
 	byte	*pOut = (byte *)pOutData;
 	int	nBitsLeft = nBits;
@@ -488,7 +799,7 @@ qboolean MSG_ReadBits( sizebuf_t *sb, void *pOutData, int nBits )
 	// get output dword-aligned.
 	while((( dword )pOut & 3) != 0 && nBitsLeft >= 8 )
 	{
-		*pOut = (byte)MSG_ReadUBitLong( sb, 8 );
+		*pOut = (byte)MSG_ReadUBitLongLegacy( sb, 8 );
 		++pOut;
 		nBitsLeft -= 8;
 	}
@@ -496,7 +807,7 @@ qboolean MSG_ReadBits( sizebuf_t *sb, void *pOutData, int nBits )
 	// read dwords.
 	while( nBitsLeft >= 32 )
 	{
-		*((dword *)pOut) = MSG_ReadUBitLong( sb, 32 );
+		*((dword *)pOut) = MSG_ReadUBitLongLegacy( sb, 32 );
 		pOut += sizeof( dword );
 		nBitsLeft -= 32;
 	}
@@ -504,7 +815,7 @@ qboolean MSG_ReadBits( sizebuf_t *sb, void *pOutData, int nBits )
 	// read the remaining bytes.
 	while( nBitsLeft >= 8 )
 	{
-		*pOut = MSG_ReadUBitLong( sb, 8 );
+		*pOut = MSG_ReadUBitLongLegacy( sb, 8 );
 		++pOut;
 		nBitsLeft -= 8;
 	}
@@ -512,12 +823,53 @@ qboolean MSG_ReadBits( sizebuf_t *sb, void *pOutData, int nBits )
 	// read the remaining bits.
 	if( nBitsLeft )
 	{
-		*pOut = MSG_ReadUBitLong( sb, nBitsLeft );
+		*pOut = MSG_ReadUBitLongLegacy( sb, nBitsLeft );
 	}
 
 	return !sb->bOverflow;
 }
 
+qboolean MSG_ReadBits( sizebuf_t *sb, void *pOutData, int nBits )
+{
+	byte	*pOut = (byte *)pOutData;
+	int	nBitsLeft = nBits;
+	uint	value;
+
+	// overflowed reads return partial data, leave it as is
+	if( sb->iCurBit + nBits > sb->nDataBits )
+		return MSG_ReadBitsLegacy( sb, pOutData, nBits );
+
+	// aligned run is just a copy
+	if(( sb->iCurBit & 7 ) == 0 )
+	{
+		int	bytes = nBitsLeft >> 3;
+
+		memcpy( pOut, sb->pData + ( sb->iCurBit >> 3 ), bytes );
+		sb->iCurBit += bytes << 3;
+		nBitsLeft -= bytes << 3;
+		pOut += bytes;
+	}
+
+	while( nBitsLeft >= 32 )
+	{
+		value = MSG_GetBits( sb, 32 );
+		memcpy( pOut, &value, sizeof( value ));
+		nBitsLeft -= 32;
+		pOut += sizeof( value );
+	}
+
+	while( nBitsLeft >= 8 )
+	{
+		*pOut++ = MSG_GetBits( sb, 8 );
+		nBitsLeft -= 8;
+	}
+
+	if( nBitsLeft )
+		*pOut = MSG_GetBits( sb, nBitsLeft );
+
+	return !sb->bOverflow;
+}
+
 float MSG_ReadBitAngle( sizebuf_t *sb, int numbits )
 {
 	float	fReturn, shift;
@@ -685,3 +1037,367 @@ void MSG_ExciseBits( sizebuf_t *sb, int startbit, int bitstoremove )
 	MSG_SeekToBit( sb, startbit, SEEK_SET );
 	sb->nDataBits -= bitstoremove;
 }
+/*
+==============================================================================
+
+			MESSAGE IO BENCHMARK
+
+==============================================================================
+*/
+#define MSGTRACE_ID		(('T'<<24)|('G'<<16)|('S'<<8)|('M'))	// little-endian "MSGT"
+#define MSGTRACE_VERSION	1
+#define MSGTRACE_MAXOPS	(1<<21)
+
+typedef struct msgtrace_header_s
+{
+	uint		id;
+	uint		version;
+	int		numops;
+	int		blobsize;
+} msgtrace_header_t;
+
+/*
+=======================
+MSG_TraceOp
+
+remember write call, finish the trace when it's full
+=======================
+*/
+static void MSG_TraceOp( int type, uint value, int bits, const void *data )
+{
+	msgop_t	*op;
+
+	if( type == MSGOP_BITS )
+	{
+		int	bytes = BitByte( value );
+
+		if( msg_trace.blobsize + bytes > msg_trace.maxblob )
+		{
+			msg_trace.maxblob = Q_max( msg_trace.maxblob * 2, msg_trace.blobsize + bytes );
+			msg_trace.blob = Mem_Realloc( host.mempool, msg_trace.blob, msg_trace.maxblob );
+		}
+
+		memcpy( msg_trace.blob + msg_trace.blobsize, data, bytes );
+		msg_trace.blobsize += bytes;
+	}
+
+	op = &msg_trace.ops[msg_trace.numops++];
+	op->type = type;
+	op->bits = bits;
+	op->value = value;
+
+	if( msg_trace.numops == msg_trace.maxops )
+		Cbuf_AddText( "msg_bench stop\n" );
+
+	// still called from this frame, stop at the limit
+	if( msg_trace.numops >= msg_trace.maxops )
+		msg_trace.active = false;
+}
+
+/*
+=======================
+MSG_FreeTrace
+
+=======================
+*/
+static void MSG_FreeTrace( msgtrace_t *trace )
+{
+	if( trace->ops ) Mem_Free( trace->ops );
+	if( trace->blob ) Mem_Free( trace->blob );
+	memset( trace, 0, sizeof( *trace ));
+}
+
+/*
+=======================
+MSG_SaveTrace
+
+=======================
+*/
+static void MSG_SaveTrace( msgtrace_t *trace )
+{
+	msgtrace_header_t	hdr;
+	file_t		*f;
+
+	if( !( f = FS_Open( trace->filename, "wb", false )))
+	{
+		Con_Printf( S_ERROR "couldn't write %s\n", trace->filename );
+		return;
+	}
+
+	hdr.id = MSGTRACE_ID;
+	hdr.version = MSGTRACE_VERSION;
+	hdr.numops = trace->numops;
+	hdr.blobsize = trace->blobsize;
+
+	FS_Write( f, &hdr, sizeof( hdr ));
+	FS_Write( f, trace->ops, trace->numops * sizeof( msgop_t ));
+	FS_Write( f, trace->blob, trace->blobsize );
+	FS_Close( f );
+
+	Con_Printf( "%s: %i calls, %s of blobs\n", trace->filename, trace->numops, Q_memprint( trace->blobsize ));
+}
+
+/*
+=======================
+MSG_LoadTrace
+
+=======================
+*/
+static qboolean MSG_LoadTrace( msgtrace_t *trace, const char *filename )
+{
+	msgtrace_header_t	*hdr;
+	fs_offset_t	size;
+	byte		*data;
+
+	memset( trace, 0, sizeof( *trace ));
+
+	if( !( data = FS_LoadFile( filename, &size, false )))
+	{
+		Con_Printf( S_ERROR "couldn't load %s\n", filename );
+		return false;
+	}
+
+	hdr = (msgtrace_header_t *)data;
+
+	if( size < sizeof( *hdr ) || hdr->id != MSGTRACE_ID || hdr->version != MSGTRACE_VERSION
+		|| hdr->numops < 0 || hdr->blobsize < 0
+		|| size != sizeof( *hdr ) + (fs_offset_t)hdr->numops * sizeof( msgop_t ) + hdr->blobsize )
+	{
+		Con_Printf( S_ERROR "%s is not a message trace\n", filename );
+		Mem_Free( data );
+		return false;
+	}
+
+	trace->numops = hdr->numops;
+	trace->blobsize = hdr->blobsize;
+	trace->ops = Mem_Malloc( host.mempool, Q_max( trace->numops, 1 ) * sizeof( msgop_t ));
+	trace->blob = Mem_Malloc( host.mempool, Q_max( trace->blobsize, 1 ));
+	memcpy( trace->ops, data + sizeof( *hdr ), trace->numops * sizeof( msgop_t ));
+	memcpy( trace->blob, data + sizeof( *hdr ) + trace->numops * sizeof( msgop_t ), trace->blobsize );
+	Mem_Free( data );
+
+	return true;
+}
+
+/*
+=======================
+MSG_ReplayWrites
+
+through sizebuf or through bitwriter
+=======================
+*/
+static double MSG_ReplayWrites( const msgtrace_t *trace, sizebuf_t *sb, qboolean writer )
+{
+	const byte	*blob = trace->blob;
+	double		start = Sys_DoubleTime();
+	bitwriter_t	bw;
+	int		i;
+
+	if( writer )
+		MSG_BeginBitWriter( &bw, sb );
+
+	for( i = 0; i < trace->numops; i++ )
+	{
+		const msgop_t	*op = &trace->ops[i];
+
+		switch( op->type )
+		{
+		case MSGOP_ONEBIT:
+			if( writer ) MSG_PutOneBit( &bw, op->value );
+			else MSG_WriteOneBit( sb, op->value );
+			break;
+		case MSGOP_UBITLONG:
+			if( writer ) MSG_PutUBitLong( &bw, op->value, op->bits );
+			else MSG_WriteUBitLong( sb, op->value, op->bits );
+			break;
+		case MSGOP_BITS:
+			if( writer ) MSG_EndBitWriter( &bw );
+			MSG_WriteBits( sb, blob, op->value );
+			if( writer ) MSG_BeginBitWriter( &bw, sb );
+			blob += BitByte( op->value );
+			break;
+		}
+	}
+
+	if( writer )
+		MSG_EndBitWriter( &bw );
+
+	return Sys_DoubleTime() - start;
+}
+
+/*
+=======================
+MSG_ReplayReads
+
+returns time, counts values that didn't match
+=======================
+*/
+static double MSG_ReplayReads( const msgtrace_t *trace, sizebuf_t *sb, qboolean legacy, byte *scratch, int *mismatches )
+{
+	const byte	*blob = trace->blob;
+	double		start = Sys_DoubleTime();
+	uint		value, mask;
+	int		i, bytes;
+
+	*mismatches = 0;
+
+	for( i = 0; i < trace->numops; i++ )
+	{
+		const msgop_t	*op = &trace->ops[i];
+
+		switch( op->type )
+		{
+		case MSGOP_ONEBIT:
+			if( MSG_ReadOneBit( sb ) != !!op->value )
+				(*mismatches)++;
+			break;
+		case MSGOP_UBITLONG:
+			if( !op->bits ) break;
+			value = legacy ? MSG_ReadUBitLongLegacy( sb, op->bits ) : MSG_ReadUBitLong( sb, op->bits );
+			mask = op->bits == 32 ? 0xFFFFFFFF : BIT( op->bits ) - 1;
+			if( value != ( op->value & mask ))
+				(*mismatches)++;
+			break;
+		case MSGOP_BITS:
+			bytes = BitByte( op->value );
+			if( legacy ) MSG_ReadBitsLegacy( sb, scratch, op->value );
+			else MSG_ReadBits( sb, scratch, op->value );
+			if( memcmp( scratch, blob, op->value >> 3 ))
+				(*mismatches)++;
+			blob += bytes;
+			break;
+		}
+	}
+
+	return Sys_DoubleTime() - start;
+}
+
+/*
+=======================
+MSG_Bench_f
+
+record write calls of real traffic and replay them,
+writes through sizebuf and through bitwriter, reads
+through dword and 64-bit window routines
+=======================
+*/
+void MSG_Bench_f( void )
+{
+	double	wtime[2] = { 0 }, rtime[2] = { 0 };
+	int	i, pass, iterations, mismatches = 0, bad;
+	int	totalbits, maxblob, bufsize, diffbytes = 0;
+	byte	*buf[2], *scratch;
+	msgtrace_t	trace;
+	sizebuf_t	sb[2];
+
+	if( Cmd_Argc() >= 3 && !Q_stricmp( Cmd_Argv( 1 ), "record" ))
+	{
+		if( msg_trace.active || msg_trace.ops )
+		{
+			Con_Printf( "already recording to %s\n", msg_trace.filename );
+			return;
+		}
+
+		// writes from encoder threads would race
+		if( Cvar_VariableInteger( "sv_encode_threads" ) > 1 )
+		{
+			Con_Printf( S_ERROR "set sv_encode_threads to 1 before recording\n" );
+			return;
+		}
+
+		msg_trace.maxops = Cmd_Argc() > 3 ? bound( 1024, Q_atoi( Cmd_Argv( 3 )), MSGTRACE_MAXOPS ) : MSGTRACE_MAXOPS;
+		msg_trace.ops = Mem_Malloc( host.mempool, msg_trace.maxops * sizeof( msgop_t ));
+		Q_strncpy( msg_trace.filename, Cmd_Argv( 2 ), sizeof( msg_trace.filename ));
+		COM_DefaultExtension( msg_trace.filename, ".msgtrace" );
+		msg_trace.active = true;
+
+		Con_Printf( "recording up to %i write calls to %s\n", msg_trace.maxops, msg_trace.filename );
+		return;
+	}
+
+	if( Cmd_Argc() == 2 && !Q_stricmp( Cmd_Argv( 1 ), "stop" ))
+	{
+		if( !msg_trace.ops )
+		{
+			Con_Printf( "not recording\n" );
+			return;
+		}
+
+		msg_trace.active = false;
+		MSG_SaveTrace( &msg_trace );
+		MSG_FreeTrace( &msg_trace );
+		return;
+	}
+
+	if( Cmd_Argc() < 2 || msg_trace.active )
+	{
+		Con_Printf( S_USAGE "msg_bench record <file> [maxcalls] | stop | <file> [iterations]\n" );
+		return;
+	}
+
+	if( !MSG_LoadTrace( &trace, Cmd_Argv( 1 )))
+		return;
+
+	iterations = Cmd_Argc() > 2 ? Q_max( 1, Q_atoi( Cmd_Argv( 2 ))) : 20;
+
+	// size buffers by the trace, plus slack for the unaligned tails
+	for( i = totalbits = maxblob = 0; i < trace.numops; i++ )
+	{
+		totalbits += trace.ops[i].type == MSGOP_BITS ? trace.ops[i].value : trace.ops[i].bits;
+		if( trace.ops[i].type == MSGOP_BITS )
+			maxblob = Q_max( maxblob, BitByte( trace.ops[i].value ));
+	}
+
+	bufsize = PAD_NUMBER( BitByte( totalbits ) + 16, 16 );
+	buf[0] = Mem_Calloc( host.mempool, bufsize );
+	buf[1] = Mem_Calloc( host.mempool, bufsize );
+	scratch = Mem_Calloc( host.mempool, maxblob + 4 );
+
+	// 0 is the old path, 1 is the fast one
+	for( i = 0; i < iterations; i++ )
+	{
+		for( pass = 0; pass < 2; pass++ )
+		{
+			MSG_Init( &sb[pass], "MsgBench", buf[pass], bufsize );
+			wtime[pass] += MSG_ReplayWrites( &trace, &sb[pass], pass );
+
+			MSG_StartReading( &sb[pass], buf[pass], bufsize, 0, -1 );
+			rtime[pass] += MSG_ReplayReads( &trace, &sb[pass], !pass, scratch, &bad );
+			mismatches += bad;
+		}
+	}
+
+	// everything below written bit must be the same
+	for( i = 0; i < BitByte( totalbits ); i++ )
+	{
+		byte	mask = 0xFF;
+
+		if( i == ( totalbits >> 3 ) && ( totalbits & 7 ))
+			mask = BIT( totalbits & 7 ) - 1;
+
+		if(( buf[0][i] ^ buf[1][i] ) & mask )
+			diffbytes++;
+	}
+
+	Con_Printf( "%s: %i calls, %i bits, %i iterations\n", Cmd_Argv( 1 ), trace.numops, totalbits, iterations );
+	Con_Printf( "%-8s %12s %12s %12s %12s\n", "", "write ns/call", "write MB/s", "read ns/call", "read MB/s" );
+
+	for( pass = 0; pass < 2; pass++ )
+	{
+		double	calls = (double)trace.numops * iterations;
+		double	mbytes = totalbits / 8.0 * iterations / ( 1024.0 * 1024.0 );
+
+		Con_Printf( "%-8s %12.2f %12.2f %12.2f %12.2f\n", pass ? "fast" : "legacy",
+			wtime[pass] * 1e9 / Q_max( calls, 1.0 ), mbytes / Q_max( wtime[pass], 0.000001 ),
+			rtime[pass] * 1e9 / Q_max( calls, 1.0 ), mbytes / Q_max( rtime[pass], 0.000001 ));
+	}
+
+	if( diffbytes || mismatches )
+		Con_Printf( "^1%i bytes differ, %i values read back wrong^7\n", diffbytes, mismatches );
+	else Con_Printf( "output is identical\n" );
+
+	Mem_Free( scratch );
+	Mem_Free( buf[0] );
+	Mem_Free( buf[1] );
+	MSG_FreeTrace( &trace );
+}
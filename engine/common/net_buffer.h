@@ -45,6 +45,19 @@ struct sizebuf_s
 	int		nDataBits;
 };
 
+// sequential writer for hot loops. Bits are collected in a register
+// and stored by whole dwords, so there is no read-modify-write per call.
+// Nothing else may touch the buffer until MSG_EndBitWriter
+typedef struct bitwriter_s
+{
+	sizebuf_t		*sb;
+	uint64_t		accum;		// pending bits, lowest first
+	int		nAccumBits;
+	int		iWordBit;		// where accum goes, always dword aligned
+	int		iMaxBit;		// fast path limit, -1 sends everything to slow path
+	qboolean		bTrace;
+} bitwriter_t;
+
 #define MSG_StartReading			MSG_StartWriting
 #define MSG_GetNumBytesRead			MSG_GetNumBytesWritten
 #define MSG_GetRealBytesRead			MSG_GetRealBytesWritten
@@ -58,6 +71,7 @@ struct sizebuf_s
 // common functions
 void MSG_InitExt( sizebuf_t *sb, const char *pDebugName, void *pData, int nBytes, int nMaxBits );
 void MSG_InitMasks( void );	// called once at startup engine
+void MSG_Bench_f( void );
 int MSG_SeekToBit( sizebuf_t *sb, int bitPos, int whence );
 void MSG_ExciseBits( sizebuf_t *sb, int startbit, int bitstoremove );
 _inline int MSG_TellBit( sizebuf_t *sb ) { return sb->iCurBit; }
@@ -78,6 +92,64 @@ qboolean MSG_WriteBits( sizebuf_t *sb, const void *pData, int nBits );
 void MSG_WriteBitAngle( sizebuf_t *sb, float fAngle, int numbits );
 void MSG_WriteBitFloat( sizebuf_t *sb, float val );
 
+// Bit writer functions, same stream as MSG_Write* ones
+void MSG_BeginBitWriter( bitwriter_t *bw, sizebuf_t *sb );
+void MSG_EndBitWriter( bitwriter_t *bw );
+void MSG_PutUBitLongSlow( bitwriter_t *bw, uint curData, int numbits );
+void MSG_PutBitAngle( bitwriter_t *bw, float fAngle, int numbits );
+void MSG_PutString( bitwriter_t *bw, const char *pStr );
+
+_inline void MSG_AccumBits( bitwriter_t *bw, uint curData, int numbits )
+{
+	bw->accum |= ((uint64_t)curData & ((( uint64_t )1 << numbits ) - 1 )) << bw->nAccumBits;
+	bw->nAccumBits += numbits;
+
+	// whole dword is ready, caller checked that it fits
+	if( bw->nAccumBits >= 32 )
+	{
+		uint	word = (uint)bw->accum;
+
+		memcpy( bw->sb->pData + ( bw->iWordBit >> 3 ), &word, sizeof( word ));
+		bw->iWordBit += 32;
+		bw->nAccumBits -= 32;
+		bw->accum >>= 32;
+	}
+}
+
+_inline void MSG_PutUBitLong( bitwriter_t *bw, uint curData, int numbits )
+{
+	if( bw->iWordBit + bw->nAccumBits + numbits > bw->iMaxBit )
+		MSG_PutUBitLongSlow( bw, curData, numbits );
+	else MSG_AccumBits( bw, curData, numbits );
+}
+
+_inline void MSG_PutOneBit( bitwriter_t *bw, int nValue )
+{
+	MSG_PutUBitLong( bw, nValue ? 1 : 0, 1 );
+}
+
+// sign bit comes last, same as MSG_WriteSBitLong
+_inline void MSG_PutSBitLong( bitwriter_t *bw, int data, int numbits )
+{
+	if( data < 0 )
+	{
+		MSG_PutUBitLong( bw, (uint)( 0x80000000 + data ), numbits - 1 );
+		MSG_PutOneBit( bw, 1 );
+	}
+	else
+	{
+		MSG_PutUBitLong( bw, (uint)data, numbits - 1 );
+		MSG_PutOneBit( bw, 0 );
+	}
+}
+
+_inline void MSG_PutBitLong( bitwriter_t *bw, int data, int numbits, qboolean bSigned )
+{
+	if( bSigned )
+		MSG_PutSBitLong( bw, data, numbits );
+	else MSG_PutUBitLong( bw, (uint)data, numbits );
+}
+
 // Byte-write functions
 #define MSG_BeginServerCmd( sb, cmd ) MSG_WriteCmdExt( sb, cmd, NS_SERVER, NULL )
 #define MSG_BeginClientCmd( sb, cmd ) MSG_WriteCmdExt( sb, cmd, NS_CLIENT, NULL )
@@ -18,6 +18,9 @@ GNU General Public License for more details.
 #include "xash3d_mathlib.h"
 #include "net_encode.h"
 #include "protocol.h"
+#define MINIZ_HEADER_FILE_ONLY
+#define MINIZ_NO_ZLIB_COMPATIBLE_NAMES
+#include "miniz.h"
 
 #define MAKE_FRAGID( id, count )	((( id & 0xffff ) << 16 ) | ( count & 0xffff ))
 #define FRAG_GETID( fragid )		(( fragid >> 16 ) & 0xffff )
@@ -32,6 +35,7 @@ GNU General Public License for more details.
 // forward declarations
 void Netchan_FlushIncoming( netchan_t *chan, int stream );
 void Netchan_AddBufferToList( fragbuf_t **pplist, fragbuf_t *pbuf );
+fragbuf_t *Netchan_AllocFragbuf( void );
 
 /*
 packet header ( size in bits )
@@ -89,6 +93,7 @@ convar_t	*net_chokeloopback;
 convar_t	*net_showdrop;
 convar_t	*net_speeds;
 convar_t	*net_qport;
+convar_t	*net_deflate;
 
 int	net_drop;
 netadr_t	net_from;
@@ -237,6 +242,721 @@ void NetSplit_SendLong( netsrc_t sock, size_t length, void *data, netadr_t to, u
 
 }
 
+/*
+=================================
+
+FRAGMENT COMPRESSION
+
+=================================
+*/
+#define DEFLATE_ID		(('L'<<24)|('F'<<16)|('D'<<8)|('Z'))	// little-endian "ZDFL"
+#define DEFLATE_LEVEL	6
+#define DEFLATE_MAX_RATIO	1032	// deflate can't do better than that
+#define DEFLATE_CACHE_SIZE	16	// recently deflated reliable messages
+#define DEFLATE_FILES	64	// remembered content hashes of downloadable files
+#define DEFLATE_CACHE_PATH	"cache/netdeflate"
+
+typedef struct deflate_header_s
+{
+	uint		id;	// DEFLATE_ID
+	uint		size;	// uncompressed size
+	uint		dict;	// crc of the preset dictionary or 0, raw deflate stream follows
+} deflate_header_t;
+
+// signon and resource data is mostly the same between servers and mods,
+// so prime the window with it. The most frequent strings are at the end,
+// where they are closest to the data and cheapest to reference.
+// NOTE: any change here changes dictionary crc and breaks older peers
+static const char net_deflate_dict[] =
+	"gfx/env/skybox/gfx/vgui/gfx/shell_chrome.bmp"
+	"sprites/laserdot.sprsprites/smoke.sprsprites/zerogxplode.sprsprites/bubble.sprsprites/"
+	"models/w_models/p_models/v_models/shell.mdlmodels/player/models/player.mdl"
+	"sound/player/pl_step1.wavsound/player/pl_step2.wavsound/common/wpn_denyselect.wav"
+	"sound/weapons/sound/items/sound/debris/sound/common/null.wavsound/"
+	"\\cl_lw\\1\\cl_lc\\1\\cl_dlmax\\1400\\cl_updaterate\\60\\rate\\25000\\hltv\\"
+	"\\topcolor\\\\bottomcolor\\\\model\\\\name\\\\*sid\\\\*hltv\\\\*fid\\"
+	"\\sv_gravity\\800\\sv_maxspeed\\320\\mp_teamplay\\\\sv_password\\\\coop\\0\\deathmatch\\1\\"
+	"entity_stateplayer_stateclientdatacustomweapon_dataevent_tframe"
+	"m_flNextPrimaryAttackm_flNextSecondaryAttackm_flTimeWeaponIdlem_iClipm_iIdm_fInReload"
+	"fuser1fuser2fuser3fuser4iuser1iuser2iuser3iuser4vuser1vuser2vuser3vuser4"
+	"punchangle[0]punchangle[1]punchangle[2]velocity[0]velocity[1]velocity[2]"
+	"weaponanimweaponmodelviewmodelmaxspeedfovflTimeStepSoundbInDuckflDuckTimeflSwimTime"
+	"movetypesolidskinbodysequenceframeframeratescaleeffectsgaitsequencetargetent"
+	"rendermoderenderamtrenderfxrendercolor.rrendercolor.grendercolor.b"
+	"animtimestartpos[0]startpos[1]startpos[2]endpos[0]endpos[1]endpos[2]impacttime"
+	"mins[0]mins[1]mins[2]maxs[0]maxs[1]maxs[2]controller[0]controller[1]blending[0]"
+	"origin[0]origin[1]origin[2]angles[0]angles[1]angles[2]modelindexaimentownerhealth"
+	"DT_SIGNEDDT_FLOATDT_INTEGERDT_ANGLEDT_TIMEWINDOW_8DT_TIMEWINDOW_BIGDT_STRINGDT_BYTEDT_SHORT"
+	"events/sprites/models/sound/maps/.wav.spr.mdl.bsp.wad.txt";
+
+static tdefl_compressor	*net_compressor;
+static tinfl_decompressor	net_decompressor;
+static uint		net_deflate_dictcrc;
+
+typedef struct deflate_cache_s
+{
+	uint		crc;
+	uint		adler;
+	uint		size;
+	qboolean		usedict;
+	byte		*data;	// NULL if message can't be compressed
+	uint		compsize;
+} deflate_cache_t;
+
+static deflate_cache_t	net_deflate_cache[DEFLATE_CACHE_SIZE];
+static int		net_deflate_cachenext;
+
+typedef struct deflate_file_s
+{
+	char		name[MAX_QPATH];
+	int		filetime;
+	fs_offset_t	filesize;
+	uint		crc;	// content hash, 0 if not computed
+	qboolean		compressible;
+} deflate_file_t;
+
+static deflate_file_t	net_deflate_files[DEFLATE_FILES];
+static int		net_deflate_filenext;
+
+/*
+======================
+Netchan_IsDeflated
+
+======================
+*/
+static qboolean Netchan_IsDeflated( const byte *source )
+{
+	const deflate_header_t *phdr = (const deflate_header_t *)source;
+
+	return phdr && phdr->id == DEFLATE_ID;
+}
+
+/*
+======================
+Netchan_UseDeflate
+
+both sides must agree and
+local user may turn it off
+======================
+*/
+static qboolean Netchan_UseDeflate( netchan_t *chan )
+{
+	return chan->deflate && net_deflate->value > 0.0f;
+}
+
+/*
+======================
+Netchan_Deflate
+
+miniz have no preset dictionaries, so compressor
+is primed with dictionary and flushed, and everything
+up to the flush point is thrown away. Inflater preloads
+the same dictionary into it's output history instead.
+returns compressed buffer or NULL if data won't be smaller
+======================
+*/
+static byte *Netchan_Deflate( const byte *source, uint srcsize, uint *outsize, qboolean usedict, int level )
+{
+	byte		scratch[sizeof( net_deflate_dict ) * 2 + 64];
+	deflate_header_t	*phdr;
+	size_t		insize, outlen;
+	byte		*out;
+	int		flags;
+
+	if( srcsize <= sizeof( deflate_header_t ))
+		return NULL;
+
+	if( !net_compressor && !( net_compressor = tdefl_compressor_alloc( )))
+		return NULL;
+
+	flags = tdefl_create_comp_flags_from_zip_params( level, -MZ_DEFAULT_WINDOW_BITS, MZ_DEFAULT_STRATEGY );
+	tdefl_init( net_compressor, NULL, NULL, flags );
+
+	if( usedict )
+	{
+		insize = sizeof( net_deflate_dict ) - 1;
+		outlen = sizeof( scratch );
+
+		if( tdefl_compress( net_compressor, net_deflate_dict, &insize, scratch, &outlen, TDEFL_SYNC_FLUSH ) != TDEFL_STATUS_OKAY
+			|| insize != sizeof( net_deflate_dict ) - 1 || net_compressor->m_output_flush_remaining )
+			return NULL;
+	}
+
+	out = Mem_Malloc( net_mempool, srcsize );
+	insize = srcsize;
+	outlen = srcsize - sizeof( deflate_header_t );
+
+	if( tdefl_compress( net_compressor, source, &insize, out + sizeof( deflate_header_t ), &outlen, TDEFL_FINISH ) != TDEFL_STATUS_DONE )
+	{
+		// output buffer is full, not worth it
+		Mem_Free( out );
+		return NULL;
+	}
+
+	phdr = (deflate_header_t *)out;
+	phdr->id = DEFLATE_ID;
+	phdr->size = srcsize;
+	phdr->dict = usedict ? net_deflate_dictcrc : 0;
+	*outsize = outlen + sizeof( deflate_header_t );
+
+	return out;
+}
+
+/*
+======================
+Netchan_Inflate
+
+returns uncompressed size or -1 on error
+======================
+*/
+static int Netchan_Inflate( const byte *source, uint srcsize, byte *out, uint outsize )
+{
+	const deflate_header_t	*phdr = (const deflate_header_t *)source;
+	size_t		insize, outlen;
+	size_t		dictlen = 0;
+	byte		*work = out;
+	tinfl_status	status;
+
+	if( srcsize <= sizeof( deflate_header_t ) || !Netchan_IsDeflated( source ))
+		return -1;
+
+	if( phdr->size > outsize || phdr->size / DEFLATE_MAX_RATIO > srcsize )
+		return -1;
+
+	if( phdr->dict )
+	{
+		// different dictionary, refuse to produce garbage
+		if( phdr->dict != net_deflate_dictcrc )
+			return -1;
+
+		dictlen = sizeof( net_deflate_dict ) - 1;
+		work = Mem_Malloc( net_mempool, dictlen + phdr->size );
+		memcpy( work, net_deflate_dict, dictlen );
+	}
+
+	insize = srcsize - sizeof( deflate_header_t );
+	outlen = phdr->size;
+
+	tinfl_init( &net_decompressor );
+	status = tinfl_decompress( &net_decompressor, source + sizeof( deflate_header_t ), &insize,
+		work, work + dictlen, &outlen, TINFL_FLAG_USING_NON_WRAPPING_OUTPUT_BUF );
+
+	if( work != out )
+	{
+		memcpy( out, work + dictlen, outlen );
+		Mem_Free( work );
+	}
+
+	if( status != TINFL_STATUS_DONE || outlen != phdr->size )
+		return -1;
+
+	return outlen;
+}
+
+/*
+======================
+Netchan_DeflateMessage
+
+signon data is the same for every client
+that connects during map, so keep recent
+results keyed by content hash
+======================
+*/
+static const byte *Netchan_DeflateMessage( const byte *source, uint srcsize, uint *outsize )
+{
+	qboolean		usedict = net_deflate->value >= 2.0f;
+	deflate_cache_t	*entry;
+	uint		crc, adler;
+	int		i;
+
+	CRC32_Init( &crc );
+	CRC32_ProcessBuffer( &crc, source, srcsize );
+	crc = CRC32_Final( crc );
+	adler = mz_adler32( MZ_ADLER32_INIT, source, srcsize );
+
+	for( i = 0; i < DEFLATE_CACHE_SIZE; i++ )
+	{
+		entry = &net_deflate_cache[i];
+
+		if( entry->size != srcsize || entry->crc != crc || entry->adler != adler || entry->usedict != usedict )
+			continue;
+
+		*outsize = entry->compsize;
+		return entry->data;
+	}
+
+	entry = &net_deflate_cache[net_deflate_cachenext];
+	net_deflate_cachenext = ( net_deflate_cachenext + 1 ) % DEFLATE_CACHE_SIZE;
+
+	if( entry->data )
+		Mem_Free( entry->data );
+
+	entry->crc = crc;
+	entry->adler = adler;
+	entry->size = srcsize;
+	entry->usedict = usedict;
+	entry->compsize = 0;
+	entry->data = Netchan_Deflate( source, srcsize, &entry->compsize, usedict, DEFLATE_LEVEL );
+
+	*outsize = entry->compsize;
+	return entry->data;
+}
+
+/*
+======================
+Netchan_DeflateFile
+
+find or create deflated copy of file in cache folder,
+copies are named by content hash so they are shared
+between clients, maps and renamed files
+returns false if file should be sent as is
+======================
+*/
+static qboolean Netchan_DeflateFile( const char *filename, char *cachename, size_t len, fs_offset_t *filesize )
+{
+	deflate_file_t	*entry = NULL;
+	int		filetime = FS_FileTime( filename, false );
+	fs_offset_t	cachesize;
+	uint		compsize;
+	byte		*uncompressed;
+	byte		*compressed;
+	int		i;
+
+	for( i = 0; i < DEFLATE_FILES; i++ )
+	{
+		deflate_file_t *e = &net_deflate_files[i];
+
+		if( e->filetime == filetime && e->filesize == *filesize && !Q_stricmp( e->name, filename ))
+		{
+			entry = e;
+			break;
+		}
+	}
+
+	if( entry )
+	{
+		if( !entry->compressible )
+			return false;
+
+		Q_snprintf( cachename, len, DEFLATE_CACHE_PATH "/%08x_%x.dfl", entry->crc, (uint)entry->filesize );
+
+		// somebody could remove the cache folder meanwhile
+		if(( cachesize = FS_FileSize( cachename, false )) > 0 )
+		{
+			*filesize = cachesize;
+			return true;
+		}
+	}
+	else
+	{
+		entry = &net_deflate_files[net_deflate_filenext];
+		net_deflate_filenext = ( net_deflate_filenext + 1 ) % DEFLATE_FILES;
+
+		Q_strncpy( entry->name, filename, sizeof( entry->name ));
+		entry->filetime = filetime;
+		entry->filesize = *filesize;
+		entry->crc = 0;
+		entry->compressible = true;
+	}
+
+	if( !( uncompressed = FS_LoadFile( filename, NULL, false )))
+	{
+		entry->compressible = false;
+		return false;
+	}
+
+	CRC32_Init( &entry->crc );
+	CRC32_ProcessBuffer( &entry->crc, uncompressed, entry->filesize );
+	entry->crc = CRC32_Final( entry->crc );
+
+	Q_snprintf( cachename, len, DEFLATE_CACHE_PATH "/%08x_%x.dfl", entry->crc, (uint)entry->filesize );
+
+	// same content was already deflated under another name
+	if(( cachesize = FS_FileSize( cachename, false )) > 0 )
+	{
+		Mem_Free( uncompressed );
+		*filesize = cachesize;
+		return true;
+	}
+
+	compressed = Netchan_Deflate( uncompressed, entry->filesize, &compsize, false, DEFLATE_LEVEL );
+	Mem_Free( uncompressed );
+
+	if( !compressed || !FS_WriteFile( cachename, compressed, compsize ))
+	{
+		if( compressed ) Mem_Free( compressed );
+		entry->compressible = false;
+		return false;
+	}
+
+	Con_DPrintf( "deflated file %s (%s -> %s)\n", filename, Q_memprint( entry->filesize ), Q_memprint( compsize ));
+	Mem_Free( compressed );
+	*filesize = compsize;
+
+	return true;
+}
+
+/*
+======================
+Netchan_CompressBench_f
+
+compare LZSS and deflate on a given file
+======================
+*/
+static void Netchan_CompressBench_f( void )
+{
+	const char	*names[] = { "lzss", "deflate -1", "deflate -6", "deflate -9", "deflate -6 +dict" };
+	const int		levels[] = { 0, 1, 6, 9, 6 };
+	int		i, j, iterations;
+	fs_offset_t	size;
+	byte		*data, *out;
+
+	if( Cmd_Argc() < 2 )
+	{
+		Con_Printf( S_USAGE "net_compress_bench <file> [iterations]\n" );
+		return;
+	}
+
+	if( !( data = FS_LoadFile( Cmd_Argv( 1 ), &size, false )) || size <= 0 )
+	{
+		Con_Printf( S_ERROR "couldn't load %s\n", Cmd_Argv( 1 ));
+		return;
+	}
+
+	iterations = Cmd_Argc() > 2 ? Q_max( 1, Q_atoi( Cmd_Argv( 2 ))) : 10;
+	out = Mem_Malloc( net_mempool, size + 1 );
+
+	Con_Printf( "%s: %s, %d iterations\n", Cmd_Argv( 1 ), Q_memprint( size ), iterations );
+	Con_Printf( "%-18s %10s %7s %12s %12s\n", "method", "size", "ratio", "comp MB/s", "decomp MB/s" );
+
+	for( i = 0; i < ARRAYSIZE( names ); i++ )
+	{
+		double	comptime = 0.0, decomptime = 0.0;
+		uint	compsize = 0;
+		byte	*comp = NULL;
+		double	start;
+		qboolean	valid = true;
+
+		for( j = 0; j < iterations; j++ )
+		{
+			if( comp )
+			{
+				if( i == 0 ) free( comp );
+				else Mem_Free( comp );
+			}
+
+			start = Sys_DoubleTime();
+			if( i == 0 ) comp = LZSS_Compress( data, size, &compsize );
+			else comp = Netchan_Deflate( data, size, &compsize, i == 4, levels[i] );
+			comptime += Sys_DoubleTime() - start;
+
+			if( !comp ) break;
+		}
+
+		if( !comp )
+		{
+			Con_Printf( "%-18s %10s\n", names[i], "incompressible" );
+			continue;
+		}
+
+		for( j = 0; j < iterations; j++ )
+		{
+			int	outlen;
+
+			start = Sys_DoubleTime();
+			if( i == 0 ) outlen = LZSS_Decompress( comp, out );
+			else outlen = Netchan_Inflate( comp, compsize, out, size );
+			decomptime += Sys_DoubleTime() - start;
+
+			if( outlen != size || memcmp( out, data, size ))
+				valid = false;
+		}
+
+		Con_Printf( "%-18s %10u %6.2f%% %12.2f %12.2f%s\n", names[i], compsize, compsize * 100.0 / size,
+			size * (double)iterations / ( 1024.0 * 1024.0 ) / Q_max( comptime, 0.000001 ),
+			size * (double)iterations / ( 1024.0 * 1024.0 ) / Q_max( decomptime, 0.000001 ),
+			valid ? "" : " ^1MISMATCH^7" );
+
+		if( i == 0 ) free( comp );
+		else Mem_Free( comp );
+	}
+
+	Mem_Free( out );
+	Mem_Free( data );
+}
+
+/*
+=================================
+
+FILE STREAMING
+
+=================================
+*/
+typedef struct netmap_s
+{
+	struct netmap_s	*next;
+	char		name[MAX_OSPATH];	// file the data comes from
+	int		filetime;
+	byte		*data;		// loaded archived file
+	file_t		*file;		// loose file read by fragments
+	size_t		size;
+	int		refcount;
+} netmap_t;
+
+static netmap_t	*net_maps;
+static byte	net_window[FRAGMENT_MAX_SIZE];	// fragment read from loose file
+
+/*
+======================
+Netchan_OpenDiskFile
+
+loose files are read by fragments, they may be
+replaced or truncated by server operator any time
+======================
+*/
+static qboolean Netchan_OpenDiskFile( netmap_t *map )
+{
+	if( !FS_GetDiskPath( map->name, false ))
+		return false;
+
+	if(( map->file = FS_Open( map->name, "rb", false )) == NULL )
+		return false;
+
+	if( FS_FileLength( map->file ) == map->size )
+		return true;
+
+	FS_Close( map->file );
+	map->file = NULL;
+
+	return false;
+}
+
+/*
+======================
+Netchan_ReadMap
+
+returns pointer to size bytes of file at given offset
+======================
+*/
+static const byte *Netchan_ReadMap( netmap_t *map, size_t offset, int size )
+{
+	fs_offset_t	read = 0;
+
+	if( map->data )
+		return map->data + offset;
+
+	if( !FS_Seek( map->file, offset, SEEK_SET ))
+		read = FS_Read( map->file, net_window, size );
+
+	if( read != size )
+	{
+		// file was changed during download, client gets broken copy
+		Con_Printf( S_WARN "%s was changed on disk while sending\n", map->name );
+		memset( net_window + Q_max( read, 0 ), 0, size - Q_max( read, 0 ));
+	}
+
+	return net_window;
+}
+
+/*
+======================
+Netchan_OpenMap
+
+concurrent downloads of the same file
+share single copy of its contents
+======================
+*/
+static netmap_t *Netchan_OpenMap( const char *name, fs_offset_t size )
+{
+	int		filetime = FS_FileTime( name, false );
+	fs_offset_t	loadsize;
+	netmap_t		*map;
+
+	for( map = net_maps; map; map = map->next )
+	{
+		if( map->filetime == filetime && map->size == size && !Q_stricmp( map->name, name ))
+		{
+			map->refcount++;
+			return map;
+		}
+	}
+
+	map = Mem_Calloc( net_mempool, sizeof( *map ));
+	Q_strncpy( map->name, name, sizeof( map->name ));
+	map->filetime = filetime;
+	map->size = size;
+
+	if( !Netchan_OpenDiskFile( map ))
+	{
+		if( !( map->data = FS_LoadFile( name, &loadsize, false )) || loadsize != size )
+		{
+			if( map->data ) Mem_Free( map->data );
+			Mem_Free( map );
+			return NULL;
+		}
+	}
+
+	map->refcount = 1;
+	map->next = net_maps;
+	net_maps = map;
+
+	return map;
+}
+
+/*
+======================
+Netchan_FreeMap
+
+======================
+*/
+static void Netchan_FreeMap( netmap_t *map )
+{
+	if( map->file )
+		FS_Close( map->file );
+	else Mem_Free( map->data );
+
+	Mem_Free( map );
+}
+
+/*
+======================
+Netchan_CloseMap
+
+======================
+*/
+static void Netchan_CloseMap( netmap_t *map )
+{
+	netmap_t	**prev;
+
+	if( --map->refcount > 0 )
+		return;
+
+	for( prev = &net_maps; *prev; prev = &(*prev)->next )
+	{
+		if( *prev == map )
+		{
+			*prev = map->next;
+			break;
+		}
+	}
+
+	Netchan_FreeMap( map );
+}
+
+/*
+======================
+Netchan_CloseFragStream
+
+======================
+*/
+static void Netchan_CloseFragStream( fragstream_t **pstream )
+{
+	if( !*pstream ) return;
+
+	Netchan_CloseMap( (*pstream)->map );
+	Mem_Free( *pstream );
+	*pstream = NULL;
+}
+
+/*
+======================
+Netchan_FragmentPayload
+
+how much file data goes into fragment,
+first one also carries the filename
+======================
+*/
+static int Netchan_FragmentPayload( fragstream_t *stream, int remaining, qboolean first )
+{
+	int	send = Q_min( remaining, Q_min( stream->chunksize, FRAGMENT_MAX_SIZE ));
+
+	if( first )
+		send -= Q_strlen( stream->filename ) + 1;
+
+	// tiny file with long name, first fragment carries only the name
+	return Q_max( send, 0 );
+}
+
+/*
+======================
+Netchan_CountFragments
+
+======================
+*/
+static int Netchan_CountFragments( fragstream_t *stream )
+{
+	int	remaining = stream->map->size;
+	int	count = 0;
+
+	while( remaining > 0 )
+		remaining -= Netchan_FragmentPayload( stream, remaining, count++ == 0 );
+
+	return count;
+}
+
+/*
+======================
+Netchan_ReadFragStream
+
+make next fragment when previous one is gone,
+so no more than one is allocated per download
+======================
+*/
+static void Netchan_ReadFragStream( netchan_t *chan, int stream )
+{
+	fragstream_t	*fs = chan->fragstream[stream];
+	int		remaining;
+	fragbuf_t		*buf;
+
+	if( !fs || chan->fragbufs[stream] )
+		return;
+
+	remaining = fs->map->size - fs->pos;
+
+	if( remaining > 0 )
+	{
+		buf = Netchan_AllocFragbuf();
+		buf->bufferid = fs->bufferid;
+		MSG_Clear( &buf->frag_message );
+
+		if( fs->bufferid++ == 1 )
+			MSG_WriteString( &buf->frag_message, fs->filename );
+
+		buf->isfile = true;
+		buf->isbuffer = true;
+		buf->size = Netchan_FragmentPayload( fs, remaining, buf->bufferid == 1 );
+		buf->foffset = fs->pos;
+
+		MSG_WriteBits( &buf->frag_message, Netchan_ReadMap( fs->map, fs->pos, buf->size ), buf->size << 3 );
+		fs->pos += buf->size;
+
+		chan->fragbufs[stream] = buf;
+	}
+
+	// last fragment is out, don't hold the file
+	if( fs->pos >= fs->map->size )
+		Netchan_CloseFragStream( &chan->fragstream[stream] );
+}
+
+/*
+======================
+Netchan_ShutdownMaps
+
+======================
+*/
+static void Netchan_ShutdownMaps( void )
+{
+	netmap_t	*map, *next;
+
+	for( map = net_maps; map; map = next )
+	{
+		next = map->next;
+		Netchan_FreeMap( map );
+	}
+
+	net_maps = NULL;
+}
+
 /*
 ===============
 Netchan_Init
@@ -254,6 +974,14 @@ void Netchan_Init( void )
 	net_showdrop = Cvar_Get( "net_showdrop", "0", 0, "show packets that are dropped" );
 	net_speeds = Cvar_Get( "net_speeds", "0", FCVAR_ARCHIVE, "show network packets" );
 	net_qport = Cvar_Get( "net_qport", va( "%i", port ), FCVAR_READ_ONLY, "current quake netport" );
+	net_deflate = Cvar_Get( "net_deflate", "2", FCVAR_ARCHIVE, "compress fragments with deflate if remote side supports it, 2 also enables signon dictionary" );
+
+	Cmd_AddCommand( "net_compress_bench", Netchan_CompressBench_f, "compare LZSS and deflate on a file" );
+	Cmd_AddCommand( "msg_bench", MSG_Bench_f, "record message writes and compare bit io routines on them" );
+
+	CRC32_Init( &net_deflate_dictcrc );
+	CRC32_ProcessBuffer( &net_deflate_dictcrc, net_deflate_dict, sizeof( net_deflate_dict ) - 1 );
+	net_deflate_dictcrc = CRC32_Final( net_deflate_dictcrc );
 
 	net_mempool = Mem_AllocPool( "Network Pool" );
 
@@ -262,6 +990,15 @@ void Netchan_Init( void )
 
 void Netchan_Shutdown( void )
 {
+	if( net_compressor )
+		tdefl_compressor_free( net_compressor );
+	net_compressor = NULL;
+
+	// everything else lives in the pool
+	memset( net_deflate_cache, 0, sizeof( net_deflate_cache ));
+	memset( net_deflate_files, 0, sizeof( net_deflate_files ));
+	Netchan_ShutdownMaps();
+
 	Mem_FreePool( &net_mempool );
 }
 
@@ -442,12 +1179,14 @@ void Netchan_ClearFragments( netchan_t *chan )
 		{
 			next = wait->next;
 			Netchan_ClearFragbufs( &wait->fragbufs );
+			Netchan_CloseFragStream( &wait->stream );
 			Mem_Free( wait );
 			wait = next;
 		}
 		chan->waitlist[i] = NULL;
 
 		Netchan_ClearFragbufs( &chan->fragbufs[i] );
+		Netchan_CloseFragStream( &chan->fragstream[i] );
 		Netchan_FlushIncoming( chan, i );
 	}
 }
@@ -625,8 +1364,11 @@ void Netchan_FragSend( netchan_t *chan )
 
 	for( i = 0; i < MAX_STREAMS; i++ )
 	{
+		// refill from the file being streamed
+		Netchan_ReadFragStream( chan, i );
+
 		// already something queued up, just leave in waitlist
-		if( chan->fragbufs[i] ) continue;
+		if( chan->fragbufs[i] || chan->fragstream[i] ) continue;
 
 		wait = chan->waitlist[i];
 
@@ -640,9 +1382,12 @@ void Netchan_FragSend( netchan_t *chan )
 		// copy in to fragbuf
 		chan->fragbufs[i] = wait->fragbufs;
 		chan->fragbufcount[i] = wait->fragbufcount;
+		chan->fragstream[i] = wait->stream;
 
 		// throw away wait list
 		Mem_Free( wait );
+
+		Netchan_ReadFragStream( chan, i );
 	}
 }
 
@@ -715,7 +1460,20 @@ static void Netchan_CreateFragments_( netchan_t *chan, sizebuf_t *msg )
 
 	wait = (fragbufwaiting_t *)Mem_Calloc( net_mempool, sizeof( fragbufwaiting_t ));
 
-	if( !LZSS_IsCompressed( MSG_GetData( msg )))
+	if( Netchan_UseDeflate( chan ) && !Netchan_IsDeflated( MSG_GetData( msg )))
+	{
+		uint	uCompressedSize = 0;
+		uint	uSourceSize = MSG_GetNumBytesWritten( msg );
+		const byte	*pbOut = Netchan_DeflateMessage( msg->pData, uSourceSize, &uCompressedSize );
+
+		if( pbOut )
+		{
+			Con_Reportf( "Deflating split packet (%d -> %d bytes)\n", uSourceSize, uCompressedSize );
+			memcpy( msg->pData, pbOut, uCompressedSize );
+			MSG_SeekToBit( msg, uCompressedSize << 3, SEEK_SET );
+		}
+	}
+	else if( !LZSS_IsCompressed( MSG_GetData( msg )) && !Netchan_IsDeflated( MSG_GetData( msg )))
 	{
 		uint	uCompressedSize = 0;
 		uint	uSourceSize = MSG_GetNumBytesWritten( msg );
@@ -874,7 +1632,20 @@ void Netchan_CreateFileFragmentsFromBuffer( netchan_t *chan, const char *filenam
 		chunksize = chan->pfnBlockSize( chan->client, FRAGSIZE_FRAG );
 	else chunksize = FRAGMENT_MAX_SIZE; // fallback
 
-	if( !LZSS_IsCompressed( pbuf ))
+	if( Netchan_UseDeflate( chan ) && !Netchan_IsDeflated( pbuf ))
+	{
+		uint	uCompressedSize = 0;
+		byte	*pbOut = Netchan_Deflate( pbuf, size, &uCompressedSize, false, DEFLATE_LEVEL );
+
+		if( pbOut )
+		{
+			Con_DPrintf( "Deflating filebuffer (%s -> %s)\n", Q_memprint( size ), Q_memprint( uCompressedSize ));
+			memcpy( pbuf, pbOut, uCompressedSize );
+			size = uCompressedSize;
+			Mem_Free( pbOut );
+		}
+	}
+	else if( !LZSS_IsCompressed( pbuf ) && !Netchan_IsDeflated( pbuf ))
 	{
 		uint	uCompressedSize = 0;
 		byte	*pbOut = LZSS_Compress( pbuf, size, &uCompressedSize );
@@ -950,17 +1721,14 @@ Netchan_CreateFileFragments
 int Netchan_CreateFileFragments( netchan_t *chan, const char *filename )
 {
 	int		chunksize;
-	int		send, pos;
-	int		remaining;
-	int		bufferid = 1;
 	fs_offset_t	filesize = 0;
 	char		compressedfilename[MAX_OSPATH];
 	int		compressedFileTime;
 	int		fileTime;
-	qboolean		firstfragment = true;
 	qboolean		bCompressed = false;
 	fragbufwaiting_t	*wait, *p;
-	fragbuf_t		*buf;
+	fragstream_t	*stream;
+	netmap_t		*map;
 
 	if(( filesize = FS_FileSize( filename, false )) <= 0 )
 	{
@@ -977,11 +1745,20 @@ int Netchan_CreateFileFragments( netchan_t *chan, const char *filename )
 	compressedFileTime = FS_FileTime( compressedfilename, false );
 	fileTime = FS_FileTime( filename, false );
 
-	if( compressedFileTime >= fileTime )
+	if( Netchan_UseDeflate( chan ))
+	{
+		bCompressed = Netchan_DeflateFile( filename, compressedfilename, sizeof( compressedfilename ), &filesize );
+	}
+	else if( compressedFileTime >= fileTime )
 	{
+		fs_offset_t	compressedsize;
+
 		// if compressed file already created and newer than source
-		if( FS_FileSize( compressedfilename, false ) != -1 )
+		if(( compressedsize = FS_FileSize( compressedfilename, false )) != -1 )
+		{
+			filesize = compressedsize;
 			bCompressed = true;
+		}
 	}
 	else
 	{
@@ -995,6 +1772,9 @@ int Netchan_CreateFileFragments( netchan_t *chan, const char *filename )
 		if( compressed )
 		{
 			Con_DPrintf( "compressed file %s (%s -> %s)\n", filename, Q_memprint( filesize ), Q_memprint( uCompressedSize ));
+
+			// unlink stale copy instead of truncating it, somebody may still stream from it
+			FS_Delete( compressedfilename );
 			FS_WriteFile( compressedfilename, compressed, uCompressedSize );
 			filesize = uCompressedSize;
 			bCompressed = true;
@@ -1003,42 +1783,23 @@ int Netchan_CreateFileFragments( netchan_t *chan, const char *filename )
 		Mem_Free( uncompressed );
 	}
 
-	wait = (fragbufwaiting_t *)Mem_Calloc( net_mempool, sizeof( fragbufwaiting_t ));
-	remaining = filesize;
-	pos = 0;
-
-	while( remaining > 0 )
+	// fragments are made from shared file data as channel sends them,
+	// see Netchan_ReadFragStream
+	if( !( map = Netchan_OpenMap( bCompressed ? compressedfilename : filename, filesize )))
 	{
-		send = Q_min( remaining, chunksize );
-
-		buf = Netchan_AllocFragbuf();
-		buf->bufferid = bufferid++;
-
-		// copy in data
-		MSG_Clear( &buf->frag_message );
-
-		if( firstfragment )
-		{
-			// Write filename
-			MSG_WriteString( &buf->frag_message, filename );
-
-			// Send a bit less on first package
-			send -= MSG_GetNumBytesWritten( &buf->frag_message );
-
-			firstfragment = false;
-		}
-
-		buf->isfile = true;
-		buf->size = send;
-		buf->foffset = pos;
-		buf->iscompressed = bCompressed;
-		Q_strncpy( buf->filename, filename, sizeof( buf->filename ));
+		Con_Printf( S_WARN "Unable to read %s for transfer\n", filename );
+		return 0;
+	}
 
-		pos += send;
-		remaining -= send;
+	stream = (fragstream_t *)Mem_Calloc( net_mempool, sizeof( fragstream_t ));
+	Q_strncpy( stream->filename, filename, sizeof( stream->filename ));
+	stream->map = map;
+	stream->chunksize = chunksize;
+	stream->bufferid = 1;
 
-		Netchan_AddFragbufToTail( wait, buf );
-	}
+	wait = (fragbufwaiting_t *)Mem_Calloc( net_mempool, sizeof( fragbufwaiting_t ));
+	wait->fragbufcount = Netchan_CountFragments( stream );
+	wait->stream = stream;
 
 	// now add waiting list item to end of buffer queue
 	if( !chan->waitlist[FRAG_FILE_STREAM] )
@@ -1116,7 +1877,21 @@ qboolean Netchan_CopyNormalFragments( netchan_t *chan, sizebuf_t *msg, size_t *l
 		p = n;
 	}
 
-	if( LZSS_IsCompressed( MSG_GetData( msg )))
+	if( Netchan_IsDeflated( MSG_GetData( msg )))
+	{
+		byte	buf[NET_MAX_MESSAGE];
+		int	outlen = Netchan_Inflate( MSG_GetData( msg ), size, buf, sizeof( buf ));
+
+		if( outlen < 0 )
+		{
+			Con_Printf( S_ERROR "failed to inflate message\n" );
+			return false;
+		}
+
+		memcpy( msg->pData, buf, outlen );
+		size = outlen;
+	}
+	else if( LZSS_IsCompressed( MSG_GetData( msg )))
 	{
 		uint	uDecompressedLen = LZSS_GetActualSize( MSG_GetData( msg ));
 		byte	buf[NET_MAX_MESSAGE];
@@ -1239,7 +2014,34 @@ qboolean Netchan_CopyFileFragments( netchan_t *chan, sizebuf_t *msg )
 		p = n;
 	}
 
-	if( LZSS_IsCompressed( buffer ))
+	if( Netchan_IsDeflated( buffer ) && nsize > sizeof( deflate_header_t ))
+	{
+		const deflate_header_t	*phdr = (const deflate_header_t *)buffer;
+		byte	*uncompressedBuffer = NULL;
+		int	outlen = -1;
+
+		if( phdr->size / DEFLATE_MAX_RATIO <= nsize )
+		{
+			uncompressedBuffer = Mem_Calloc( net_mempool, phdr->size + 1 );
+			outlen = Netchan_Inflate( buffer, nsize, uncompressedBuffer, phdr->size );
+		}
+
+		Mem_Free( buffer );
+
+		if( outlen < 0 )
+		{
+			Con_Printf( S_ERROR "failed to inflate %s\n", filename );
+			if( uncompressedBuffer ) Mem_Free( uncompressedBuffer );
+			MSG_Clear( msg );
+			chan->incomingbufs[FRAG_FILE_STREAM] = NULL;
+			chan->incomingready[FRAG_FILE_STREAM] = false;
+			return false;
+		}
+
+		nsize = outlen;
+		buffer = uncompressedBuffer;
+	}
+	else if( LZSS_IsCompressed( buffer ))
 	{
 		uint	uncompressedSize = LZSS_GetActualSize( buffer ) + 1;
 		byte	*uncompressedBuffer = Mem_Calloc( net_mempool, uncompressedSize );
@@ -1423,7 +2225,10 @@ void Netchan_TransmitBits( netchan_t *chan, int length, byte *data )
 	send_reliable = false;
 
 	if( chan->incoming_acknowledged > chan->last_reliable_sequence && chan->incoming_reliable_acknowledged != chan->reliable_sequence )
+	{
+		chan->retransmits++;
 		send_reliable = true;
+	}
 
 	// A packet can have "reliable payload + frag payload + unreliable payload
 	// frag payload can be a file chunk, if so, it needs to be parsed on the receiving end and reliable payload + unreliable payload need
@@ -1537,29 +2342,6 @@ void Netchan_TransmitBits( netchan_t *chan, int length, byte *data )
 				// which buffer are we sending ?
 				chan->reliable_fragid[i] = MAKE_FRAGID( pbuf->bufferid, chan->fragbufcount[i] );
 
-				// if it's not in-memory, then we'll need to copy it in frame the file handle.
-				if( pbuf->isfile && !pbuf->isbuffer )
-				{
-					byte	filebuffer[NET_MAX_FRAGMENT];
-					file_t	*file;
-
-					if( pbuf->iscompressed )
-					{
-						char	compressedfilename[MAX_OSPATH];
-
-						Q_strncpy( compressedfilename, pbuf->filename, sizeof( compressedfilename ));
-						COM_ReplaceExtension( compressedfilename, ".ztmp" );
-						file = FS_Open( compressedfilename, "rb", false );
-					}
-					else file = FS_Open( pbuf->filename, "rb", false );
-
-					FS_Seek( file, pbuf->foffset, SEEK_SET );
-					FS_Read( file, filebuffer, pbuf->size );
-
-					MSG_WriteBits( &pbuf->frag_message, filebuffer, pbuf->size << 3 );
-					FS_Close( file );
-				}
-
 				// copy frag stuff on top of current buffer
 				MSG_StartWriting( &temp, chan->reliable_buf, sizeof( chan->reliable_buf ), chan->reliable_length, -1 );
 				MSG_WriteBits( &temp, MSG_GetData( &pbuf->frag_message ), MSG_GetNumBitsWritten( &pbuf->frag_message ));
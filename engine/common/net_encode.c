@@ -30,6 +30,8 @@ GNU General Public License for more details.
 
 static qboolean		delta_init = false;
 
+static void Delta_CompileLayout( delta_info_t *dt );
+
 // list of all the struct names
 static const delta_field_t cmd_fields[] =
 {
@@ -448,7 +450,7 @@ qboolean Delta_AddField( const char *pStructName, const char *pName, int flags,
 		return false;
 	}
 
-	if( dt->numFields + 1 > dt->maxFields )
+	if( dt->numFields + 1 > dt->maxFields || dt->numFields + 1 > MAX_DELTA_FIELDS )
 	{
 		Con_DPrintf( S_WARN "Delta_Add: can't add %s->%s encoder list is full\n", pStructName, pName );
 		return false; // too many fields specified (duplicated ?)
@@ -713,6 +715,16 @@ void Delta_ParseTable( char **delta_script, delta_info_t *dt, const char *encode
 	{
 		Assert( dt->numFields <= dt->maxFields );
 
+		// field masks can't hold more
+		if( dt->numFields >= MAX_DELTA_FIELDS && ( !Q_strcmp( token, "DEFINE_DELTA" ) || !Q_strcmp( token, "DEFINE_DELTA_POST" )))
+		{
+			delta_t	skip;
+
+			Con_Printf( S_ERROR "Delta_ParseTable: %s has more than %d fields, extra field ignored\n", dt->pName, MAX_DELTA_FIELDS );
+			Delta_ParseField( delta_script, pInfo, &skip, !Q_strcmp( token, "DEFINE_DELTA_POST" ));
+			continue;
+		}
+
 		if( !Q_strcmp( token, "DEFINE_DELTA" ))
 		{
 			if( Delta_ParseField( delta_script, pInfo, &pField[dt->numFields], false ))
@@ -746,6 +758,7 @@ void Delta_ParseTable( char **delta_script, delta_info_t *dt, const char *encode
 		dt->pFields = Z_Realloc( dt->pFields, dt->numFields * sizeof( delta_t ));
 	}
 
+	Delta_CompileLayout( dt );
 	dt->bInitialized = true; // table is ok
 }
 
@@ -838,6 +851,7 @@ void Delta_Init( void )
 	Delta_AddField( "movevars_t", "wateralpha", DT_FLOAT|DT_SIGNED, 16, 32.0f, 1.0f );
 	Delta_AddField( "movevars_t", "fog_settings", DT_INTEGER, 32, 1.0f, 1.0f );
 	dt->numFields = NUM_FIELDS( pm_fields ) - 4;
+	Delta_CompileLayout( dt );
 
 	// now done
 	dt->bInitialized = true;
@@ -881,6 +895,12 @@ void Delta_Shutdown( void )
 			dt_info[i].pFields = NULL;
 		}
 
+		if( dt_info[i].layout )
+		{
+			Z_Free( dt_info[i].layout );
+			dt_info[i].layout = NULL;
+		}
+
 		dt_info[i].bInitialized = false;
 	}
 
@@ -913,13 +933,13 @@ int Delta_ClampIntegerField( delta_t *pField, int iValue, qboolean bSigned, int
 
 /*
 =====================
-Delta_CompareField
+Delta_CompareFieldExt
 
 compare fields by offsets
 assume from and to is valid
 =====================
 */
-qboolean Delta_CompareField( delta_t *pField, void *from, void *to, float timebase )
+static qboolean Delta_CompareFieldExt( delta_t *pField, qboolean bInactive, void *from, void *to, float timebase )
 {
 	qboolean	bSigned = ( pField->flags & DT_SIGNED ) ? true : false;
 	float	val_a, val_b;
@@ -929,7 +949,7 @@ qboolean Delta_CompareField( delta_t *pField, void *from, void *to, float timeba
 	Assert( from != NULL );
 	Assert( to != NULL );
 
-	if( pField->bInactive )
+	if( bInactive )
 		return true;
 
 	fromF = toF = 0;
@@ -1044,6 +1064,17 @@ qboolean Delta_CompareField( delta_t *pField, void *from, void *to, float timeba
 	return ( fromF == toF ) ? true : false;
 }
 
+/*
+=====================
+Delta_CompareField
+
+=====================
+*/
+qboolean Delta_CompareField( delta_t *pField, void *from, void *to, float timebase )
+{
+	return Delta_CompareFieldExt( pField, pField->bInactive, from, to, timebase );
+}
+
 /*
 =====================
 Delta_TestBaseline
@@ -1053,6 +1084,7 @@ compare baselines to find optimal
 */
 int Delta_TestBaseline( entity_state_t *from, entity_state_t *to, qboolean player, float timebase )
 {
+	delta_fieldmask_t	changed;
 	delta_info_t	*dt = NULL;
 	delta_t		*pField;
 	int		i, countBits;
@@ -1082,13 +1114,15 @@ int Delta_TestBaseline( entity_state_t *from, entity_state_t *to, qboolean playe
 	// activate fields and call custom encode func
 	Delta_CustomEncode( dt, from, to );
 
+	Delta_ChangedFields( dt, from, to, timebase, NULL, &changed );
+
 	// process fields
 	for( i = 0; i < dt->numFields; i++, pField++ )
 	{
 		// flag about field change (sets always)
 		countBits++;
 
-		if( !Delta_CompareField( pField, from, to, timebase ))
+		if( FBitSet( changed.bits[i >> 5], BIT( i & 31 )))
 		{
 			// strings are handled difference
 			if( FBitSet( pField->flags, DT_STRING ))
@@ -1101,56 +1135,78 @@ int Delta_TestBaseline( entity_state_t *from, entity_state_t *to, qboolean playe
 	return countBits;
 }
 
+/*
+=============================
+Delta_MaxEntityBits
+
+upper bound of single entity delta,
+strings are not counted
+=============================
+*/
+int Delta_MaxEntityBits( void )
+{
+	const char	*tables[] = { "entity_state_t", "entity_state_player_t", "custom_entity_state_t" };
+	int		i, j, countBits, maxBits = 0;
+	delta_info_t	*dt;
+
+	for( i = 0; i < ARRAYSIZE( tables ); i++ )
+	{
+		if(( dt = Delta_FindStruct( tables[i] )) == NULL )
+			continue;
+
+		// entity number, remove type, custom baseline, entityType
+		countBits = MAX_ENTITY_BITS + 2 + 1 + 7 + 1 + 2;
+
+		for( j = 0; j < dt->numFields; j++ )
+			countBits += dt->pFields[j].bits + 1;
+
+		maxBits = Q_max( maxBits, countBits );
+	}
+
+	return maxBits;
+}
+
 /*
 =====================
-Delta_WriteField
+Delta_WriteFieldValue
 
-write fields by offsets
-assume from and to is valid
+write changed field value
 =====================
 */
-qboolean Delta_WriteField( sizebuf_t *msg, delta_t *pField, void *from, void *to, float timebase )
+static void Delta_WriteFieldValue( bitwriter_t *bw, delta_t *pField, void *to, float timebase )
 {
 	qboolean		bSigned = ( pField->flags & DT_SIGNED ) ? true : false;
 	float		flValue, flAngle, flTime;
 	uint		iValue;
 	const char	*pStr;
 
-	if( Delta_CompareField( pField, from, to, timebase ))
-	{
-		MSG_WriteOneBit( msg, 0 );	// unchanged
-		return false;
-	}
-
-	MSG_WriteOneBit( msg, 1 );	// changed
-
 	if( pField->flags & DT_BYTE )
 	{
 		iValue = *(byte *)((byte *)to + pField->offset );
 		iValue = Delta_ClampIntegerField( pField, iValue, bSigned, pField->bits );
 		if( pField->multiplier != 1.0f ) iValue *= pField->multiplier;
-		MSG_WriteBitLong( msg, iValue, pField->bits, bSigned );
+		MSG_PutBitLong( bw, iValue, pField->bits, bSigned );
 	}
 	else if( pField->flags & DT_SHORT )
 	{
 		iValue = *(word *)((byte *)to + pField->offset );
 		iValue = Delta_ClampIntegerField( pField, iValue, bSigned, pField->bits );
 		if( pField->multiplier != 1.0f ) iValue *= pField->multiplier;
-		MSG_WriteBitLong( msg, iValue, pField->bits, bSigned );
+		MSG_PutBitLong( bw, iValue, pField->bits, bSigned );
 	}
 	else if( pField->flags & DT_INTEGER )
 	{
 		iValue = *(uint *)((byte *)to + pField->offset );
 		iValue = Delta_ClampIntegerField( pField, iValue, bSigned, pField->bits );
 		if( pField->multiplier != 1.0f ) iValue *= pField->multiplier;
-		MSG_WriteBitLong( msg, iValue, pField->bits, bSigned );
+		MSG_PutBitLong( bw, iValue, pField->bits, bSigned );
 	}
 	else if( pField->flags & DT_FLOAT )
 	{
 		flValue = *(float *)((byte *)to + pField->offset );
 		iValue = (int)(flValue * pField->multiplier);
 		iValue = Delta_ClampIntegerField( pField, iValue, bSigned, pField->bits );
-		MSG_WriteBitLong( msg, iValue, pField->bits, bSigned );
+		MSG_PutBitLong( bw, iValue, pField->bits, bSigned );
 	}
 	else if( pField->flags & DT_ANGLE )
 	{
@@ -1158,7 +1214,7 @@ qboolean Delta_WriteField( sizebuf_t *msg, delta_t *pField, void *from, void *to
 
 		// NOTE: never applies multipliers to angle because
 		// result may be wrong on client-side
-		MSG_WriteBitAngle( msg, flAngle, pField->bits );
+		MSG_PutBitAngle( bw, flAngle, pField->bits );
 	}
 	else if( pField->flags & DT_TIMEWINDOW_8 )
 	{
@@ -1166,7 +1222,7 @@ qboolean Delta_WriteField( sizebuf_t *msg, delta_t *pField, void *from, void *to
 		flTime = Q_rint( timebase * 100.0f ) - Q_rint( flValue * 100.0f );
 		iValue = (uint)abs( flTime );
 		iValue = Delta_ClampIntegerField( pField, iValue, bSigned, pField->bits );
-		MSG_WriteBitLong( msg, iValue, pField->bits, bSigned );
+		MSG_PutBitLong( bw, iValue, pField->bits, bSigned );
 	}
 	else if( pField->flags & DT_TIMEWINDOW_BIG )
 	{
@@ -1174,16 +1230,386 @@ qboolean Delta_WriteField( sizebuf_t *msg, delta_t *pField, void *from, void *to
 		flTime = Q_rint( timebase * pField->multiplier ) - Q_rint( flValue * pField->multiplier );
 		iValue = (uint)abs( flTime );
 		iValue = Delta_ClampIntegerField( pField, iValue, bSigned, pField->bits );
-		MSG_WriteBitLong( msg, iValue, pField->bits, bSigned );
+		MSG_PutBitLong( bw, iValue, pField->bits, bSigned );
 	}
 	else if( pField->flags & DT_STRING )
 	{
 		pStr = (char *)((byte *)to + pField->offset );
-		MSG_WriteString( msg, pStr );
+		MSG_PutString( bw, pStr );
+	}
+}
+
+/*
+=====================
+Delta_WriteFieldExt
+
+write fields by offsets
+assume from and to is valid
+=====================
+*/
+static qboolean Delta_WriteFieldExt( sizebuf_t *msg, delta_t *pField, qboolean bInactive, void *from, void *to, float timebase )
+{
+	bitwriter_t	bw;
+
+	if( Delta_CompareFieldExt( pField, bInactive, from, to, timebase ))
+	{
+		MSG_WriteOneBit( msg, 0 );	// unchanged
+		return false;
 	}
+
+	MSG_BeginBitWriter( &bw, msg );
+	MSG_PutOneBit( &bw, 1 );	// changed
+	Delta_WriteFieldValue( &bw, pField, to, timebase );
+	MSG_EndBitWriter( &bw );
+
 	return true;
 }
 
+/*
+=====================
+Delta_WriteField
+
+=====================
+*/
+qboolean Delta_WriteField( sizebuf_t *msg, delta_t *pField, void *from, void *to, float timebase )
+{
+	return Delta_WriteFieldExt( msg, pField, pField->bInactive, from, to, timebase );
+}
+
+/*
+=====================
+Delta_SaveFieldMask
+
+remember which fields was disabled by custom encoder
+=====================
+*/
+static void Delta_SaveFieldMask( delta_info_t *dt, delta_fieldmask_t *mask )
+{
+	int	i;
+
+	// tables are truncated on load, so this is a corrupted table
+	if( dt->numFields > MAX_DELTA_FIELDS )
+		Host_Error( "Delta_SaveFieldMask: %s has %i fields, max is %i\n", dt->pName, dt->numFields, MAX_DELTA_FIELDS );
+
+	memset( mask, 0, sizeof( *mask ));
+
+	for( i = 0; i < dt->numFields; i++ )
+	{
+		if( dt->pFields[i].bInactive )
+			SetBits( mask->bits[i >> 5], BIT( i & 31 ));
+	}
+}
+
+/*
+=====================
+Delta_IsFieldInactive
+
+take field state from saved mask if present
+=====================
+*/
+static qboolean Delta_IsFieldInactive( delta_info_t *dt, int field, const delta_fieldmask_t *mask )
+{
+	if( mask != NULL )
+		return FBitSet( mask->bits[field >> 5], BIT( field & 31 )) ? true : false;
+	return dt->pFields[field].bInactive;
+}
+
+/*
+=============================================================================
+
+compiled delta layout
+
+fields are compared as raw bytes first, with one vector pass
+over the whole struct, and only fields with different bytes
+that need clamping or rounding go through Delta_CompareFieldExt
+
+=============================================================================
+*/
+#if XASH_AMD64 || ( XASH_X86 && defined __SSE2__ ) || ( defined _M_IX86_FP && _M_IX86_FP >= 2 )
+#include <emmintrin.h>
+#define DELTA_DIFF_SSE2
+#elif XASH_ARM == 8 && XASH_64BIT && defined __ARM_NEON
+#include <arm_neon.h>
+#define DELTA_DIFF_NEON
+#endif
+
+#define MAX_DELTA_STRUCT_SIZE	1024	// enough for clientdata_t
+#define MAX_DELTA_DIFF_WORDS	( MAX_DELTA_STRUCT_SIZE / 32 + 1 )	// one bit per byte and padding for mask1
+
+typedef struct
+{
+	int		word;		// into byte difference bitmask
+	uint		mask0;		// bytes of field in word
+	uint		mask1;		// bytes of field in word + 1
+	qboolean		exact;		// raw difference always means changed
+	qboolean		scalar;		// too wide, always use scalar compare
+} delta_layout_field_t;
+
+typedef struct delta_layout_s
+{
+	int		numFields;	// must match delta_info_t, or layout is outdated
+	int		size;		// bytes to compare
+	delta_layout_field_t	fields[MAX_DELTA_FIELDS];
+} delta_layout_t;
+
+/*
+=====================
+Delta_FieldAccessSize
+
+how many bytes Delta_CompareFieldExt looks at
+=====================
+*/
+static int Delta_FieldAccessSize( const delta_t *pField )
+{
+	if( FBitSet( pField->flags, DT_BYTE ))
+		return 1;
+	if( FBitSet( pField->flags, DT_SHORT ))
+		return 2;
+	if( FBitSet( pField->flags, DT_STRING ))
+		return pField->size;
+	return 4;
+}
+
+/*
+=====================
+Delta_FieldIsExact
+
+field is compared as is, so any
+changed byte means changed field
+=====================
+*/
+static qboolean Delta_FieldIsExact( const delta_t *pField )
+{
+	int	bits = pField->bits;
+
+	// same order of checks as in Delta_CompareFieldExt
+	if( FBitSet( pField->flags, DT_BYTE|DT_SHORT|DT_INTEGER ))
+	{
+		// clamping or multiplier may hide a difference
+		if( pField->multiplier != 1.0f )
+			return false;
+
+		// signed values lose the lowest one on clamp
+		if( FBitSet( pField->flags, DT_SIGNED ))
+			bits--;
+
+		if( FBitSet( pField->flags, DT_BYTE ))
+			return bits >= 8;
+		if( FBitSet( pField->flags, DT_SHORT ))
+			return bits >= 16;
+		return pField->bits >= 32;
+	}
+
+	return FBitSet( pField->flags, DT_ANGLE|DT_FLOAT ) ? true : false;
+}
+
+/*
+=====================
+Delta_CompileLayout
+
+=====================
+*/
+static void Delta_CompileLayout( delta_info_t *dt )
+{
+	delta_layout_t	*layout;
+	int		i, j;
+
+	if( dt->layout )
+	{
+		Z_Free( dt->layout );
+		dt->layout = NULL;
+	}
+
+	if( !dt->pFields || dt->numFields <= 0 || dt->numFields > MAX_DELTA_FIELDS )
+		return;
+
+	layout = Z_Calloc( sizeof( *layout ));
+	layout->numFields = dt->numFields;
+
+	for( i = 0; i < dt->numFields; i++ )
+	{
+		const delta_t		*pField = &dt->pFields[i];
+		delta_layout_field_t	*f = &layout->fields[i];
+		int			size = Delta_FieldAccessSize( pField );
+		int			end = pField->offset + size;
+
+		if( end > MAX_DELTA_STRUCT_SIZE || size > 32 )
+		{
+			f->scalar = true;
+			continue;
+		}
+
+		f->word = pField->offset >> 5;
+		f->exact = Delta_FieldIsExact( pField );
+		layout->size = Q_max( layout->size, end );
+
+		for( j = pField->offset; j < end; j++ )
+		{
+			if(( j >> 5 ) == f->word )
+				SetBits( f->mask0, BIT( j & 31 ));
+			else SetBits( f->mask1, BIT( j & 31 ));
+		}
+	}
+
+	dt->layout = layout;
+}
+
+/*
+=====================
+Delta_DiffBytes
+
+set one bit for every different byte
+=====================
+*/
+static void Delta_DiffBytes( const byte *from, const byte *to, int size, uint *diff )
+{
+	int	i = 0;
+
+	memset( diff, 0, sizeof( *diff ) * ( size / 32 + 2 ));
+
+#if defined DELTA_DIFF_SSE2
+	for( ; i + 32 <= size; i += 32 )
+	{
+		__m128i	eq0 = _mm_cmpeq_epi8( _mm_loadu_si128((const __m128i *)( from + i )), _mm_loadu_si128((const __m128i *)( to + i )));
+		__m128i	eq1 = _mm_cmpeq_epi8( _mm_loadu_si128((const __m128i *)( from + i + 16 )), _mm_loadu_si128((const __m128i *)( to + i + 16 )));
+
+		diff[i >> 5] = ~((uint)_mm_movemask_epi8( eq0 ) | ((uint)_mm_movemask_epi8( eq1 ) << 16 ));
+	}
+#elif defined DELTA_DIFF_NEON
+	static const byte	bitsel[16] = { 1, 2, 4, 8, 16, 32, 64, 128, 1, 2, 4, 8, 16, 32, 64, 128 };
+	const uint8x16_t	sel = vld1q_u8( bitsel );
+
+	for( ; i + 32 <= size; i += 32 )
+	{
+		uint8x16_t	ne0 = vandq_u8( vmvnq_u8( vceqq_u8( vld1q_u8( from + i ), vld1q_u8( to + i ))), sel );
+		uint8x16_t	ne1 = vandq_u8( vmvnq_u8( vceqq_u8( vld1q_u8( from + i + 16 ), vld1q_u8( to + i + 16 ))), sel );
+
+		diff[i >> 5] = (uint)vaddv_u8( vget_low_u8( ne0 ))
+			| ((uint)vaddv_u8( vget_high_u8( ne0 )) << 8 )
+			| ((uint)vaddv_u8( vget_low_u8( ne1 )) << 16 )
+			| ((uint)vaddv_u8( vget_high_u8( ne1 )) << 24 );
+	}
+#endif
+	// tail or no SIMD, skip equal dwords quickly
+	for( ; i + 4 <= size; i += 4 )
+	{
+		if( *(const uint *)( from + i ) == *(const uint *)( to + i ))
+			continue;
+
+		if( from[i+0] != to[i+0] ) SetBits( diff[i >> 5], BIT(( i + 0 ) & 31 ));
+		if( from[i+1] != to[i+1] ) SetBits( diff[i >> 5], BIT(( i + 1 ) & 31 ));
+		if( from[i+2] != to[i+2] ) SetBits( diff[i >> 5], BIT(( i + 2 ) & 31 ));
+		if( from[i+3] != to[i+3] ) SetBits( diff[i >> 5], BIT(( i + 3 ) & 31 ));
+	}
+
+	for( ; i < size; i++ )
+	{
+		if( from[i] != to[i] )
+			SetBits( diff[i >> 5], BIT( i & 31 ));
+	}
+}
+
+/*
+=====================
+Delta_ChangedFieldsScalar
+
+reference path, one field at time
+=====================
+*/
+static void Delta_ChangedFieldsScalar( delta_info_t *dt, const void *from, const void *to, float timebase, const delta_fieldmask_t *inactive, delta_fieldmask_t *changed )
+{
+	int	i;
+
+	memset( changed, 0, sizeof( *changed ));
+
+	for( i = 0; i < dt->numFields; i++ )
+	{
+		if( !Delta_CompareFieldExt( &dt->pFields[i], Delta_IsFieldInactive( dt, i, inactive ), (void *)from, (void *)to, timebase ))
+			SetBits( changed->bits[i >> 5], BIT( i & 31 ));
+	}
+}
+
+/*
+=====================
+Delta_ChangedFields
+
+result is the same as Delta_CompareField for every field
+=====================
+*/
+void Delta_ChangedFields( delta_info_t *dt, const void *from, const void *to, float timebase, const delta_fieldmask_t *inactive, delta_fieldmask_t *changed )
+{
+	delta_layout_t	*layout = dt->layout;
+	uint		diff[MAX_DELTA_DIFF_WORDS + 1];
+	int		i;
+
+	if( !layout || layout->numFields != dt->numFields )
+	{
+		Delta_ChangedFieldsScalar( dt, from, to, timebase, inactive, changed );
+		return;
+	}
+
+	Delta_DiffBytes( from, to, layout->size, diff );
+	memset( changed, 0, sizeof( *changed ));
+
+	for( i = 0; i < dt->numFields; i++ )
+	{
+		const delta_layout_field_t	*f = &layout->fields[i];
+
+		if( Delta_IsFieldInactive( dt, i, inactive ))
+			continue;
+
+		if( !f->scalar )
+		{
+			// same bytes are always the same value
+			if( !( diff[f->word] & f->mask0 ) && !( diff[f->word + 1] & f->mask1 ))
+				continue;
+
+			if( f->exact )
+			{
+				SetBits( changed->bits[i >> 5], BIT( i & 31 ));
+				continue;
+			}
+		}
+
+		if( !Delta_CompareFieldExt( &dt->pFields[i], false, (void *)from, (void *)to, timebase ))
+			SetBits( changed->bits[i >> 5], BIT( i & 31 ));
+	}
+}
+
+/*
+=====================
+Delta_WriteChangedFields
+
+write all fields of table, returns number of changed
+=====================
+*/
+static int Delta_WriteChangedFields( sizebuf_t *msg, delta_info_t *dt, void *from, void *to, float timebase, const delta_fieldmask_t *inactive )
+{
+	delta_fieldmask_t	changed;
+	int		i, numChanges = 0;
+	bitwriter_t	bw;
+
+	Delta_ChangedFields( dt, from, to, timebase, inactive, &changed );
+
+	// whole table goes through the accumulator
+	MSG_BeginBitWriter( &bw, msg );
+
+	for( i = 0; i < dt->numFields; i++ )
+	{
+		if( FBitSet( changed.bits[i >> 5], BIT( i & 31 )))
+		{
+			MSG_PutOneBit( &bw, 1 );	// changed
+			Delta_WriteFieldValue( &bw, &dt->pFields[i], to, timebase );
+			numChanges++;
+		}
+		else MSG_PutOneBit( &bw, 0 );	// unchanged
+	}
+
+	MSG_EndBitWriter( &bw );
+
+	return numChanges;
+}
+
 /*
 =====================
 Delta_ReadField
@@ -1510,38 +1936,52 @@ clientdata_t communication
 */
 /*
 ==================
-MSG_WriteClientData
+MSG_PrepareClientData
 
-Writes current client data only for local client
-Other clients can grab the client state from entity_state_t
 ==================
 */
-void MSG_WriteClientData( sizebuf_t *msg, clientdata_t *from, clientdata_t *to, float timebase )
+void MSG_PrepareClientData( clientdata_t *from, clientdata_t *to, delta_fieldmask_t *mask )
 {
-	delta_t		*pField;
 	delta_info_t	*dt;
-	int		i, startBit;
-	int		numChanges = 0;
 
 	dt = Delta_FindStruct( "clientdata_t" );
 	Assert( dt && dt->bInitialized );
 
-	pField = dt->pFields;
-	Assert( pField != NULL );
-
+	// activate fields and call custom encode func
+	Delta_CustomEncode( dt, from, to );
+	Delta_SaveFieldMask( dt, mask );
+}
+
+/*
+==================
+MSG_WriteClientDataExt
+
+Writes current client data only for local client
+Other clients can grab the client state from entity_state_t
+==================
+*/
+void MSG_WriteClientDataExt( sizebuf_t *msg, clientdata_t *from, clientdata_t *to, float timebase, const delta_fieldmask_t *mask )
+{
+	delta_t		*pField;
+	delta_info_t	*dt;
+	int		startBit;
+	int		numChanges = 0;
+
+	dt = Delta_FindStruct( "clientdata_t" );
+	Assert( dt && dt->bInitialized );
+
+	pField = dt->pFields;
+	Assert( pField != NULL );
+
 	startBit = msg->iCurBit;
 
 	MSG_WriteOneBit( msg, 1 ); // have clientdata
 
 	// activate fields and call custom encode func
-	Delta_CustomEncode( dt, from, to );
+	if( !mask ) Delta_CustomEncode( dt, from, to );
 
 	// process fields
-	for( i = 0; i < dt->numFields; i++, pField++ )
-	{
-		if( Delta_WriteField( msg, pField, from, to, timebase ))
-			numChanges++;
-	}
+	numChanges += Delta_WriteChangedFields( msg, dt, from, to, timebase, mask );
 
 	if( numChanges ) return; // we have updates
 
@@ -1549,6 +1989,17 @@ void MSG_WriteClientData( sizebuf_t *msg, clientdata_t *from, clientdata_t *to,
 	MSG_WriteOneBit( msg, 0 ); // no changes
 }
 
+/*
+==================
+MSG_WriteClientData
+
+==================
+*/
+void MSG_WriteClientData( sizebuf_t *msg, clientdata_t *from, clientdata_t *to, float timebase )
+{
+	MSG_WriteClientDataExt( msg, from, to, timebase, NULL );
+}
+
 /*
 ==================
 MSG_ReadClientData
@@ -1591,17 +2042,35 @@ weapon_data_t communication
 */
 /*
 ==================
-MSG_WriteWeaponData
+MSG_PrepareWeaponData
+
+==================
+*/
+void MSG_PrepareWeaponData( weapon_data_t *from, weapon_data_t *to, delta_fieldmask_t *mask )
+{
+	delta_info_t	*dt;
+
+	dt = Delta_FindStruct( "weapon_data_t" );
+	Assert( dt && dt->bInitialized );
+
+	// activate fields and call custom encode func
+	Delta_CustomEncode( dt, from, to );
+	Delta_SaveFieldMask( dt, mask );
+}
+
+/*
+==================
+MSG_WriteWeaponDataExt
 
 Writes current client data only for local client
 Other clients can grab the client state from entity_state_t
 ==================
 */
-void MSG_WriteWeaponData( sizebuf_t *msg, weapon_data_t *from, weapon_data_t *to, float timebase, int index )
+void MSG_WriteWeaponDataExt( sizebuf_t *msg, weapon_data_t *from, weapon_data_t *to, float timebase, int index, const delta_fieldmask_t *mask )
 {
 	delta_t		*pField;
 	delta_info_t	*dt;
-	int		i, startBit;
+	int		startBit;
 	int		numChanges = 0;
 
 	dt = Delta_FindStruct( "weapon_data_t" );
@@ -1611,7 +2080,7 @@ void MSG_WriteWeaponData( sizebuf_t *msg, weapon_data_t *from, weapon_data_t *to
 	Assert( pField != NULL );
 
 	// activate fields and call custom encode func
-	Delta_CustomEncode( dt, from, to );
+	if( !mask ) Delta_CustomEncode( dt, from, to );
 
 	startBit = msg->iCurBit;
 
@@ -1619,16 +2088,23 @@ void MSG_WriteWeaponData( sizebuf_t *msg, weapon_data_t *from, weapon_data_t *to
 	MSG_WriteUBitLong( msg, index, MAX_WEAPON_BITS );
 
 	// process fields
-	for( i = 0; i < dt->numFields; i++, pField++ )
-	{
-		if( Delta_WriteField( msg, pField, from, to, timebase ))
-			numChanges++;
-	}
+	numChanges += Delta_WriteChangedFields( msg, dt, from, to, timebase, mask );
 
 	// if we have no changes - kill the message
 	if( !numChanges ) MSG_SeekToBit( msg, startBit, SEEK_SET );
 }
 
+/*
+==================
+MSG_WriteWeaponData
+
+==================
+*/
+void MSG_WriteWeaponData( sizebuf_t *msg, weapon_data_t *from, weapon_data_t *to, float timebase, int index )
+{
+	MSG_WriteWeaponDataExt( msg, from, to, timebase, index, NULL );
+}
+
 /*
 ==================
 MSG_ReadWeaponData
@@ -1666,7 +2142,70 @@ entity_state_t communication
 */
 /*
 ==================
-MSG_WriteDeltaEntity
+Delta_FindEntityStruct
+
+==================
+*/
+static delta_info_t *Delta_FindEntityStruct( entity_state_t *to, int delta_type )
+{
+	delta_info_t	*dt;
+
+	if( FBitSet( to->entityType, ENTITY_BEAM ))
+	{
+		dt = Delta_FindStruct( "custom_entity_state_t" );
+	}
+	else if( delta_type == DELTA_PLAYER )
+	{
+		dt = Delta_FindStruct( "entity_state_player_t" );
+	}
+	else
+	{
+		dt = Delta_FindStruct( "entity_state_t" );
+	}
+
+	Assert( dt && dt->bInitialized );
+
+	return dt;
+}
+
+/*
+==================
+MSG_PrepareDeltaEntity
+
+==================
+*/
+void MSG_PrepareDeltaEntity( entity_state_t *from, entity_state_t *to, int delta_type, delta_fieldmask_t *mask )
+{
+	delta_info_t	*dt;
+	int		i;
+
+	// remove message has no fields
+	if( to == NULL )
+		return;
+
+	if( to->number < 0 || to->number >= GI->max_edicts )
+		Host_Error( "MSG_WriteDeltaEntity: Bad entity number: %i\n", to->number );
+
+	dt = Delta_FindEntityStruct( to, delta_type );
+
+	if( delta_type == DELTA_STATIC )
+	{
+		// static entities won't to be custom encoded
+		for( i = 0; i < dt->numFields; i++ )
+			dt->pFields[i].bInactive = false;
+	}
+	else
+	{
+		// activate fields and call custom encode func
+		Delta_CustomEncode( dt, from, to );
+	}
+
+	Delta_SaveFieldMask( dt, mask );
+}
+
+/*
+==================
+MSG_WriteDeltaEntityExt
 
 Writes part of a packetentities message, including the entity number.
 Can delta from either a baseline or a previous packet_entity
@@ -1675,7 +2214,7 @@ If force is not set, then nothing at all will be generated if the entity is
 identical, under the assumption that the in-order delta code will catch it.
 ==================
 */
-void MSG_WriteDeltaEntity( entity_state_t *from, entity_state_t *to, sizebuf_t *msg, qboolean force, int delta_type, float timebase, int baseline )
+void MSG_WriteDeltaEntityExt( entity_state_t *from, entity_state_t *to, sizebuf_t *msg, qboolean force, int delta_type, float timebase, int baseline, const delta_fieldmask_t *mask )
 {
 	delta_info_t	*dt = NULL;
 	delta_t		*pField;
@@ -1704,7 +2243,8 @@ void MSG_WriteDeltaEntity( entity_state_t *from, entity_state_t *to, sizebuf_t *
 
 	startBit = msg->iCurBit;
 
-	if( to->number < 0 || to->number >= GI->max_edicts )
+	// already checked by MSG_PrepareDeltaEntity
+	if( !mask && ( to->number < 0 || to->number >= GI->max_edicts ))
 		Host_Error( "MSG_WriteDeltaEntity: Bad entity number: %i\n", to->number );
 
 	MSG_WriteUBitLong( msg, to->number, MAX_ENTITY_BITS );
@@ -1725,25 +2265,16 @@ void MSG_WriteDeltaEntity( entity_state_t *from, entity_state_t *to, sizebuf_t *
 	}
 	else MSG_WriteOneBit( msg, 0 );
 
-	if( FBitSet( to->entityType, ENTITY_BEAM ))
-	{
-		dt = Delta_FindStruct( "custom_entity_state_t" );
-	}
-	else if( delta_type == DELTA_PLAYER )
-	{
-		dt = Delta_FindStruct( "entity_state_player_t" );
-	}
-	else
-	{
-		dt = Delta_FindStruct( "entity_state_t" );
-	}
-
-	Assert( dt && dt->bInitialized );
+	dt = Delta_FindEntityStruct( to, delta_type );
 
 	pField = dt->pFields;
 	Assert( pField != NULL );
 
-	if( delta_type == DELTA_STATIC )
+	if( mask != NULL )
+	{
+		// fields was activated by MSG_PrepareDeltaEntity
+	}
+	else if( delta_type == DELTA_STATIC )
 	{
 		// static entities won't to be custom encoded
 		for( i = 0; i < dt->numFields; i++ )
@@ -1756,16 +2287,318 @@ void MSG_WriteDeltaEntity( entity_state_t *from, entity_state_t *to, sizebuf_t *
 	}
 
 	// process fields
-	for( i = 0; i < dt->numFields; i++, pField++ )
-	{
-		if( Delta_WriteField( msg, pField, from, to, timebase ))
-			numChanges++;
-	}
+	numChanges += Delta_WriteChangedFields( msg, dt, from, to, timebase, mask );
 
 	// if we have no changes - kill the message
 	if( !numChanges && !force ) MSG_SeekToBit( msg, startBit, SEEK_SET );
 }
 
+/*
+==================
+MSG_WriteDeltaEntity
+
+==================
+*/
+void MSG_WriteDeltaEntity( entity_state_t *from, entity_state_t *to, sizebuf_t *msg, qboolean force, int delta_type, float timebase, int baseline )
+{
+	MSG_WriteDeltaEntityExt( from, to, msg, force, delta_type, timebase, baseline, NULL );
+}
+
+/*
+==================
+Delta_EntityFieldBits
+
+bits taken by each field of entity delta, including the
+change bit, zero if field is not sent. Returns table index
+==================
+*/
+int Delta_EntityFieldBits( entity_state_t *from, entity_state_t *to, int delta_type, float timebase, const delta_fieldmask_t *mask, int *fieldbits )
+{
+	delta_fieldmask_t	changed;
+	delta_info_t	*dt;
+	delta_t		*pField;
+	int		i;
+
+	dt = Delta_FindEntityStruct( to, delta_type );
+	Delta_ChangedFields( dt, from, to, timebase, mask, &changed );
+
+	for( i = 0, pField = dt->pFields; i < dt->numFields; i++, pField++ )
+	{
+		if( !FBitSet( changed.bits[i >> 5], BIT( i & 31 )))
+			fieldbits[i] = 0;
+		else if( FBitSet( pField->flags, DT_STRING ))
+			fieldbits[i] = ( Q_strlen( (char *)((byte *)to + pField->offset )) + 1 ) * 8 + 1;
+		else fieldbits[i] = pField->bits + 1;
+	}
+
+	return dt - dt_info;
+}
+
+/*
+=====================
+Delta_CompareBench
+
+compare recorded entity states with both paths
+=====================
+*/
+void Delta_CompareBench( entity_state_t **from, entity_state_t **to, const int *delta_type, int numpairs, int iterations, float timebase )
+{
+	delta_fieldmask_t	inactive, changed, reference;
+	double		start, scalar, fast;
+	int		i, j, mismatches = 0;
+	int		numChanged = 0;
+
+	memset( &inactive, 0, sizeof( inactive ));
+
+	// correctness first
+	for( i = 0; i < numpairs; i++ )
+	{
+		delta_info_t	*dt = Delta_FindEntityStruct( to[i], delta_type[i] );
+
+		Delta_ChangedFieldsScalar( dt, from[i], to[i], timebase, &inactive, &reference );
+		Delta_ChangedFields( dt, from[i], to[i], timebase, &inactive, &changed );
+
+		if( memcmp( &reference, &changed, sizeof( changed )))
+			mismatches++;
+
+		for( j = 0; j < dt->numFields; j++ )
+		{
+			if( FBitSet( reference.bits[j >> 5], BIT( j & 31 )))
+				numChanged++;
+		}
+	}
+
+	start = Sys_DoubleTime();
+	for( j = 0; j < iterations; j++ )
+	{
+		for( i = 0; i < numpairs; i++ )
+			Delta_ChangedFieldsScalar( Delta_FindEntityStruct( to[i], delta_type[i] ), from[i], to[i], timebase, &inactive, &changed );
+	}
+	scalar = Sys_DoubleTime() - start;
+
+	start = Sys_DoubleTime();
+	for( j = 0; j < iterations; j++ )
+	{
+		for( i = 0; i < numpairs; i++ )
+			Delta_ChangedFields( Delta_FindEntityStruct( to[i], delta_type[i] ), from[i], to[i], timebase, &inactive, &changed );
+	}
+	fast = Sys_DoubleTime() - start;
+
+#if defined DELTA_DIFF_SSE2
+	Con_Printf( "%d state pairs, %d changed fields, %d iterations, SSE2 kernel\n", numpairs, numChanged, iterations );
+#elif defined DELTA_DIFF_NEON
+	Con_Printf( "%d state pairs, %d changed fields, %d iterations, NEON kernel\n", numpairs, numChanged, iterations );
+#else
+	Con_Printf( "%d state pairs, %d changed fields, %d iterations, generic kernel\n", numpairs, numChanged, iterations );
+#endif
+	Con_Printf( "scalar: %.3f ms, %.1f ns per pair\n", scalar * 1000.0, scalar * 1e9 / ((double)numpairs * iterations ));
+	Con_Printf( "layout: %.3f ms, %.1f ns per pair\n", fast * 1000.0, fast * 1e9 / ((double)numpairs * iterations ));
+
+	if( mismatches ) Con_Printf( S_ERROR "%d pairs have different results\n", mismatches );
+	else Con_Printf( "results are identical, %.2fx speedup\n", fast > 0.0 ? scalar / fast : 0.0 );
+}
+
+/*
+=============================================================================
+
+entity delta cache
+
+many clients are receiving the same deltas for the
+same entities, so remember encoded bits and copy them
+
+=============================================================================
+*/
+#define DELTA_CACHE_SIZE	2048		// must be power of two
+#define DELTA_CACHE_PROBES	8
+#define DELTA_CACHE_BYTES	0x40000		// encoded bits storage
+
+typedef struct
+{
+	uint		hash;
+	int		sequence;			// entry is valid only for current sequence
+	entity_state_t	from;
+	entity_state_t	to;
+	int		force;
+	int		delta_type;
+	int		baseline;
+	float		timebase;
+	delta_fieldmask_t	mask;			// custom encoders may depend on receiving client
+	int		offset;			// in cache storage
+	int		numbits;
+} delta_cache_entry_t;
+
+struct delta_cache_s
+{
+	delta_cache_entry_t	entries[DELTA_CACHE_SIZE];
+	int		sequence;
+	byte		*storage;
+	int		used;
+	uint		hits;
+	uint		misses;
+};
+
+/*
+==================
+Delta_AllocCache
+
+==================
+*/
+delta_cache_t *Delta_AllocCache( void )
+{
+	delta_cache_t	*cache;
+
+	cache = Z_Calloc( sizeof( *cache ));
+	cache->storage = Z_Malloc( DELTA_CACHE_BYTES );
+	cache->sequence = 1;
+
+	return cache;
+}
+
+/*
+==================
+Delta_FreeCache
+
+==================
+*/
+void Delta_FreeCache( delta_cache_t *cache )
+{
+	if( !cache ) return;
+
+	Z_Free( cache->storage );
+	Z_Free( cache );
+}
+
+/*
+==================
+Delta_ClearCache
+
+forget all entries, keep the stats
+==================
+*/
+void Delta_ClearCache( delta_cache_t *cache )
+{
+	cache->sequence++;
+	cache->used = 0;
+}
+
+/*
+==================
+Delta_CacheStats
+
+==================
+*/
+void Delta_CacheStats( delta_cache_t *cache, uint *hits, uint *misses, qboolean reset )
+{
+	*hits += cache->hits;
+	*misses += cache->misses;
+
+	if( reset ) cache->hits = cache->misses = 0;
+}
+
+/*
+==================
+Delta_HashEntityStates
+
+==================
+*/
+static uint Delta_HashEntityStates( const entity_state_t *from, const entity_state_t *to, int key )
+{
+	const uint	*data;
+	uint		hash = (uint)key;
+	int		i;
+
+	data = (const uint *)from;
+	for( i = 0; i < sizeof( *from ) / sizeof( uint ); i++ )
+		hash = ( hash ^ data[i] ) * 16777619;
+
+	data = (const uint *)to;
+	for( i = 0; i < sizeof( *to ) / sizeof( uint ); i++ )
+		hash = ( hash ^ data[i] ) * 16777619;
+
+	return hash;
+}
+
+/*
+==================
+MSG_WriteDeltaEntityCached
+
+result depends only on the states, arguments and active fields,
+so the encoded bits can be reused by any client
+==================
+*/
+void MSG_WriteDeltaEntityCached( delta_cache_t *cache, entity_state_t *from, entity_state_t *to, sizebuf_t *msg, qboolean force, int delta_type, float timebase, int baseline, const delta_fieldmask_t *mask )
+{
+	delta_cache_entry_t	*entry = NULL;
+	sizebuf_t		bits;
+	uint		hash;
+	int		i, startBit;
+
+	// removes are cheap enough, and key needs an active field mask
+	if( !cache || !from || !to || !mask )
+	{
+		MSG_WriteDeltaEntityExt( from, to, msg, force, delta_type, timebase, baseline, mask );
+		return;
+	}
+
+	hash = Delta_HashEntityStates( from, to, ( baseline << 3 ) ^ ( delta_type << 1 ) ^ !!force );
+
+	for( i = 0; i < DELTA_CACHE_PROBES; i++ )
+	{
+		delta_cache_entry_t	*e = &cache->entries[( hash + i ) & ( DELTA_CACHE_SIZE - 1 )];
+
+		if( e->sequence != cache->sequence )
+		{
+			// free slot, remember for insertion
+			if( !entry ) entry = e;
+			break;
+		}
+
+		if( e->hash != hash || e->force != force || e->delta_type != delta_type )
+			continue;
+
+		if( e->baseline != baseline || e->timebase != timebase )
+			continue;
+
+		if( memcmp( &e->to, to, sizeof( *to )) || memcmp( &e->from, from, sizeof( *from )))
+			continue;
+
+		if( memcmp( &e->mask, mask, sizeof( *mask )))
+			continue;
+
+		cache->hits++;
+		MSG_WriteBits( msg, cache->storage + e->offset, e->numbits );
+		return;
+	}
+
+	cache->misses++;
+	startBit = msg->iCurBit;
+
+	MSG_WriteDeltaEntityExt( from, to, msg, force, delta_type, timebase, baseline, mask );
+
+	if( !entry || MSG_CheckOverflow( msg ))
+		return;
+
+	// keep the storage dword aligned for MSG_ReadBits
+	if( cache->used + BitByte( msg->iCurBit - startBit ) + 4 > DELTA_CACHE_BYTES )
+		return;
+
+	entry->hash = hash;
+	entry->sequence = cache->sequence;
+	entry->from = *from;
+	entry->to = *to;
+	entry->force = force;
+	entry->delta_type = delta_type;
+	entry->baseline = baseline;
+	entry->timebase = timebase;
+	entry->mask = *mask;
+	entry->offset = cache->used;
+	entry->numbits = msg->iCurBit - startBit;
+
+	MSG_StartReading( &bits, msg->pData, MSG_GetMaxBytes( msg ), startBit, -1 );
+	MSG_ReadBits( &bits, cache->storage + entry->offset, entry->numbits );
+	cache->used += PAD_NUMBER( BitByte( entry->numbits ), 4 );
+}
+
 /*
 ==================
 MSG_ReadDeltaEntity
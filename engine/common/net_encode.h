@@ -76,6 +76,15 @@ struct delta_s
 	qboolean		bInactive;	// unsetted by user request
 };
 
+// inactive fields after custom encode, so the rest of
+// the delta can be written without calling game dll again
+#define MAX_DELTA_FIELDS	128	// enough for entity_state_t
+
+typedef struct
+{
+	uint		bits[MAX_DELTA_FIELDS / 32];
+} delta_fieldmask_t;
+
 typedef void (*pfnDeltaEncode)( struct delta_s *pFields, const byte *from, const byte *to );
 
 typedef struct
@@ -91,6 +100,8 @@ typedef struct
 	char		funcName[32];
 	pfnDeltaEncode	userCallback;
 	qboolean		bInitialized;
+
+	struct delta_layout_s	*layout;		// compiled for fast comparison, may be NULL
 } delta_info_t;
 
 //
@@ -134,5 +145,27 @@ void MSG_ReadWeaponData( sizebuf_t *msg, struct weapon_data_s *from, struct weap
 void MSG_WriteDeltaEntity( struct entity_state_s *from, struct entity_state_s *to, sizebuf_t *msg, qboolean force, int type, float tbase, int ofs );
 qboolean MSG_ReadDeltaEntity( sizebuf_t *msg, struct entity_state_s *from, struct entity_state_s *to, int num, int type, float timebase );
 int Delta_TestBaseline( struct entity_state_s *from, struct entity_state_s *to, qboolean player, float timebase );
+int Delta_MaxEntityBits( void );
+int Delta_EntityFieldBits( struct entity_state_s *from, struct entity_state_s *to, int type, float timebase, const delta_fieldmask_t *mask, int *fieldbits );
+
+// split encoding: prepare calls custom encoders and must be done on main thread,
+// write part uses only the mask and may be called from any thread
+void MSG_PrepareClientData( struct clientdata_s *from, struct clientdata_s *to, delta_fieldmask_t *mask );
+void MSG_PrepareWeaponData( struct weapon_data_s *from, struct weapon_data_s *to, delta_fieldmask_t *mask );
+void MSG_PrepareDeltaEntity( struct entity_state_s *from, struct entity_state_s *to, int type, delta_fieldmask_t *mask );
+void MSG_WriteClientDataExt( sizebuf_t *msg, struct clientdata_s *from, struct clientdata_s *to, float timebase, const delta_fieldmask_t *mask );
+void MSG_WriteWeaponDataExt( sizebuf_t *msg, struct weapon_data_s *from, struct weapon_data_s *to, float timebase, int index, const delta_fieldmask_t *mask );
+// changed fields as bitmask, uses vectorized compare when table layout is compiled
+void Delta_ChangedFields( delta_info_t *dt, const void *from, const void *to, float timebase, const delta_fieldmask_t *inactive, delta_fieldmask_t *changed );
+void Delta_CompareBench( struct entity_state_s **from, struct entity_state_s **to, const int *delta_type, int numpairs, int iterations, float timebase );
+
+// entity delta cache, each thread must have its own
+typedef struct delta_cache_s delta_cache_t;
+delta_cache_t *Delta_AllocCache( void );
+void Delta_FreeCache( delta_cache_t *cache );
+void Delta_ClearCache( delta_cache_t *cache );
+void Delta_CacheStats( delta_cache_t *cache, uint *hits, uint *misses, qboolean reset );
+void MSG_WriteDeltaEntityCached( delta_cache_t *cache, struct entity_state_s *from, struct entity_state_s *to, sizebuf_t *msg, qboolean force, int type, float tbase, int ofs, const delta_fieldmask_t *mask );
+void MSG_WriteDeltaEntityExt( struct entity_state_s *from, struct entity_state_s *to, sizebuf_t *msg, qboolean force, int type, float tbase, int ofs, const delta_fieldmask_t *mask );
 
 #endif//NET_ENCODE_H
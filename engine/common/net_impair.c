@@ -0,0 +1,936 @@
+/*
+net_impair.c - network impairment simulator
+Copyright (C) 2026 Xash3D FWGS contributors
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+*/
+
+#include "common.h"
+#include "netchan.h"
+#include "protocol.h"
+#include "xash3d_mathlib.h"
+
+/*
+Impairment is applied to incoming datagrams, on loopback and on real
+sockets alike, so enabling it on both sockets affects both directions.
+Every socket has its own random generator seeded from profile, so the
+same traffic gives the same result.
+
+Profiles are loaded from script:
+
+// comment
+profile "dsl"
+{
+	seed		1
+	latency		40	// ms
+	jitter		8	// ms
+	jitter_dist	normal	// none, uniform, normal or pareto
+	jitter_shape	2.5	// pareto only
+	loss_good		0.001	// Gilbert-Elliott loss model
+	loss_bad		0.3
+	good_to_bad	0.01	// per packet
+	bad_to_good	0.25
+	reorder		0.01
+	reorder_delay	30	// ms
+	duplicate		0.005
+	bandwidth		64000	// bytes per second, 0 is unlimited
+	queue		16384	// bytes, tail drop beyond that
+	mtu		1200	// larger datagrams are dropped
+	at 10 loss_bad 0.8		// change parameter 10 seconds after start
+}
+*/
+
+#define IMPAIR_MAX_EVENTS		64
+#define IMPAIR_MAX_QUEUE		4096	// packets
+#define IMPAIR_MAX_MESSAGES		8192	// completion times kept by bench
+
+typedef enum
+{
+	JITTER_NONE = 0,
+	JITTER_UNIFORM,
+	JITTER_NORMAL,
+	JITTER_PARETO,
+} jitterdist_t;
+
+typedef struct
+{
+	float		time;		// since profile start
+	char		key[32];
+	char		value[32];
+} impairevent_t;
+
+typedef struct
+{
+	string		name;
+	uint		seed;
+	float		latency;		// ms
+	float		jitter;		// ms
+	int		jitter_dist;
+	float		jitter_shape;
+	float		loss_good;
+	float		loss_bad;
+	float		good_to_bad;
+	float		bad_to_good;
+	float		reorder;
+	float		reorder_delay;	// ms
+	float		duplicate;
+	float		bandwidth;	// bytes per second
+	int		queue;		// bytes
+	int		mtu;
+
+	int		numevents;
+	impairevent_t	events[IMPAIR_MAX_EVENTS];
+} impairprofile_t;
+
+typedef struct impairpkt_s
+{
+	struct impairpkt_s	*next;
+	double		time;		// when it will be delivered
+	uint		order;		// keeps equal times in arrival order
+	netadr_t		from;
+	size_t		size;
+	byte		data[1];		// variable sized
+} impairpkt_t;
+
+typedef struct
+{
+	uint		received;
+	uint		delivered;
+	uint		lost;		// by loss model
+	uint		overflowed;	// by bandwidth queue
+	uint		oversized;	// by mtu
+	uint		duplicated;
+	uint		reordered;
+} impairstats_t;
+
+typedef struct
+{
+	qboolean		active;
+	impairprofile_t	profile;
+	double		starttime;
+	int		nextevent;
+
+	uint64_t		rng;
+	qboolean		bad;		// Gilbert-Elliott state
+	double		linkfree;		// when bandwidth limiter is idle
+	double		lastdelivery;	// keeps order if not reordered
+	uint		order;
+
+	impairpkt_t	*queue;		// sorted by time
+	int		queued;
+	int		queuedbytes;
+
+	impairstats_t	stats;
+} impairsock_t;
+
+static impairsock_t	net_impair[NS_COUNT];
+
+/*
+====================
+NET_ImpairRandom
+
+xorshift64*, returns [0..1)
+====================
+*/
+static float NET_ImpairRandom( impairsock_t *s )
+{
+	s->rng ^= s->rng >> 12;
+	s->rng ^= s->rng << 25;
+	s->rng ^= s->rng >> 27;
+
+	return (float)(( s->rng * 0x2545F4914F6CDD1DULL ) >> 40 ) * ( 1.0f / 16777216.0f );
+}
+
+/*
+====================
+NET_ImpairJitter
+
+extra delay in ms
+====================
+*/
+static float NET_ImpairJitter( impairsock_t *s )
+{
+	const impairprofile_t	*p = &s->profile;
+	float			u1, u2;
+
+	if( p->jitter <= 0.0f )
+		return 0.0f;
+
+	switch( p->jitter_dist )
+	{
+	case JITTER_UNIFORM:
+		return p->jitter * ( NET_ImpairRandom( s ) * 2.0f - 1.0f );
+	case JITTER_NORMAL:
+		// Box-Muller
+		u1 = Q_max( NET_ImpairRandom( s ), 1e-7f );
+		u2 = NET_ImpairRandom( s );
+		return p->jitter * sqrt( -2.0f * log( u1 )) * cos( M_PI2_F * u2 );
+	case JITTER_PARETO:
+		// heavy tail, always positive
+		u1 = Q_max( NET_ImpairRandom( s ), 1e-7f );
+		return p->jitter * ( pow( u1, -1.0f / Q_max( p->jitter_shape, 1.01f )) - 1.0f );
+	default:
+		return 0.0f;
+	}
+}
+
+/*
+====================
+NET_ImpairSetKey
+
+====================
+*/
+static qboolean NET_ImpairSetKey( impairprofile_t *p, const char *key, const char *value )
+{
+	if( !Q_stricmp( key, "seed" )) p->seed = Q_atoi( value );
+	else if( !Q_stricmp( key, "latency" )) p->latency = Q_atof( value );
+	else if( !Q_stricmp( key, "jitter" )) p->jitter = Q_atof( value );
+	else if( !Q_stricmp( key, "jitter_shape" )) p->jitter_shape = Q_atof( value );
+	else if( !Q_stricmp( key, "loss_good" )) p->loss_good = Q_atof( value );
+	else if( !Q_stricmp( key, "loss_bad" )) p->loss_bad = Q_atof( value );
+	else if( !Q_stricmp( key, "good_to_bad" )) p->good_to_bad = Q_atof( value );
+	else if( !Q_stricmp( key, "bad_to_good" )) p->bad_to_good = Q_atof( value );
+	else if( !Q_stricmp( key, "reorder" )) p->reorder = Q_atof( value );
+	else if( !Q_stricmp( key, "reorder_delay" )) p->reorder_delay = Q_atof( value );
+	else if( !Q_stricmp( key, "duplicate" )) p->duplicate = Q_atof( value );
+	else if( !Q_stricmp( key, "bandwidth" )) p->bandwidth = Q_atof( value );
+	else if( !Q_stricmp( key, "queue" )) p->queue = Q_atoi( value );
+	else if( !Q_stricmp( key, "mtu" )) p->mtu = Q_atoi( value );
+	else if( !Q_stricmp( key, "jitter_dist" ))
+	{
+		if( !Q_stricmp( value, "uniform" )) p->jitter_dist = JITTER_UNIFORM;
+		else if( !Q_stricmp( value, "normal" )) p->jitter_dist = JITTER_NORMAL;
+		else if( !Q_stricmp( value, "pareto" )) p->jitter_dist = JITTER_PARETO;
+		else if( !Q_stricmp( value, "none" )) p->jitter_dist = JITTER_NONE;
+		else return false;
+	}
+	else return false;
+
+	return true;
+}
+
+/*
+====================
+NET_ImpairDefaults
+
+====================
+*/
+static void NET_ImpairDefaults( impairprofile_t *p, const char *name )
+{
+	memset( p, 0, sizeof( *p ));
+	Q_strncpy( p->name, name, sizeof( p->name ));
+	p->seed = 1;
+	p->jitter_dist = JITTER_NORMAL;
+	p->jitter_shape = 2.5f;
+	p->bad_to_good = 1.0f;
+	p->queue = 65536;
+}
+
+/*
+====================
+NET_ImpairLoadProfiles
+
+returns number of profiles, up to maxprofiles
+====================
+*/
+static int NET_ImpairLoadProfiles( const char *filename, impairprofile_t *profiles, int maxprofiles )
+{
+	char		token[MAX_TOKEN], key[MAX_TOKEN];
+	impairprofile_t	*p = NULL;
+	int		count = 0;
+	char		*afile, *pfile;
+
+	afile = (char *)FS_LoadFile( filename, NULL, false );
+
+	if( !afile )
+	{
+		Con_Printf( S_ERROR "couldn't load %s\n", filename );
+		return 0;
+	}
+
+	pfile = afile;
+
+	while(( pfile = COM_ParseFile( pfile, token )) != NULL )
+	{
+		if( !p )
+		{
+			if( Q_stricmp( token, "profile" ))
+			{
+				Con_Printf( S_ERROR "%s: expected profile, got %s\n", filename, token );
+				break;
+			}
+
+			if( count >= maxprofiles )
+			{
+				Con_Printf( S_WARN "%s: too many profiles, only %d used\n", filename, maxprofiles );
+				break;
+			}
+
+			p = &profiles[count];
+			pfile = COM_ParseFile( pfile, token );
+			NET_ImpairDefaults( p, token );
+
+			pfile = COM_ParseFile( pfile, token );
+			if( Q_strcmp( token, "{" ))
+			{
+				Con_Printf( S_ERROR "%s: expected {, got %s\n", filename, token );
+				break;
+			}
+			continue;
+		}
+
+		if( !Q_strcmp( token, "}" ))
+		{
+			count++;
+			p = NULL;
+			continue;
+		}
+
+		if( !Q_stricmp( token, "at" ))
+		{
+			impairevent_t	*ev;
+
+			if( p->numevents >= IMPAIR_MAX_EVENTS )
+			{
+				Con_Printf( S_ERROR "%s: too many events in %s\n", filename, p->name );
+				break;
+			}
+
+			// keep them sorted by time
+			ev = &p->events[p->numevents];
+			pfile = COM_ParseFile( pfile, token );
+			ev->time = Q_atof( token );
+			pfile = COM_ParseFile( pfile, ev->key );
+			pfile = COM_ParseFile( pfile, ev->value );
+
+			for( ; ev > p->events && ev[-1].time > ev->time; ev-- )
+			{
+				impairevent_t	temp = ev[-1];
+				ev[-1] = ev[0];
+				ev[0] = temp;
+			}
+
+			p->numevents++;
+			continue;
+		}
+
+		Q_strncpy( key, token, sizeof( key ));
+		pfile = COM_ParseFile( pfile, token );
+
+		if( !NET_ImpairSetKey( p, key, token ))
+			Con_Printf( S_WARN "%s: unknown %s %s in %s\n", filename, key, token, p->name );
+	}
+
+	if( p != NULL )
+		Con_Printf( S_ERROR "%s: unexpected end of file in %s\n", filename, p->name );
+
+	Mem_Free( afile );
+
+	return count;
+}
+
+/*
+====================
+NET_ImpairFlush
+
+drop all pending packets
+====================
+*/
+static void NET_ImpairFlush( impairsock_t *s )
+{
+	impairpkt_t	*pkt, *next;
+
+	for( pkt = s->queue; pkt; pkt = next )
+	{
+		next = pkt->next;
+		Mem_Free( pkt );
+	}
+
+	s->queue = NULL;
+	s->queued = 0;
+	s->queuedbytes = 0;
+}
+
+/*
+====================
+NET_ImpairStart
+
+====================
+*/
+static void NET_ImpairStart( netsrc_t sock, const impairprofile_t *profile )
+{
+	impairsock_t	*s = &net_impair[sock];
+
+	NET_ImpairFlush( s );
+	memset( s, 0, sizeof( *s ));
+
+	s->profile = *profile;
+	s->starttime = host.realtime;
+	s->rng = (uint64_t)profile->seed * 0x9E3779B97F4A7C15ULL + sock + 1;
+	s->active = true;
+}
+
+/*
+====================
+NET_ImpairStop
+
+====================
+*/
+static void NET_ImpairStop( netsrc_t sock )
+{
+	impairsock_t	*s = &net_impair[sock];
+
+	NET_ImpairFlush( s );
+	s->active = false;
+}
+
+/*
+====================
+NET_ImpairActive
+
+====================
+*/
+qboolean NET_ImpairActive( netsrc_t sock )
+{
+	return net_impair[sock].active;
+}
+
+/*
+====================
+NET_ImpairEnqueue
+
+====================
+*/
+static void NET_ImpairEnqueue( impairsock_t *s, const netadr_t *from, const void *data, size_t size, double time )
+{
+	impairpkt_t	*pkt, **link;
+
+	pkt = Z_Malloc( sizeof( *pkt ) + size );
+	pkt->time = time;
+	pkt->order = s->order++;
+	pkt->from = *from;
+	pkt->size = size;
+	memcpy( pkt->data, data, size );
+
+	for( link = &s->queue; *link && (*link)->time <= time; link = &(*link)->next );
+
+	pkt->next = *link;
+	*link = pkt;
+	s->queued++;
+	s->queuedbytes += size;
+}
+
+/*
+====================
+NET_ImpairIncoming
+
+decide fate of new datagram
+====================
+*/
+static void NET_ImpairIncoming( impairsock_t *s, const netadr_t *from, const void *data, size_t size )
+{
+	impairprofile_t	*p = &s->profile;
+	double		now = host.realtime;
+	double		time;
+	float		loss;
+
+	s->stats.received++;
+
+	if( p->mtu > 0 && size > p->mtu )
+	{
+		s->stats.oversized++;
+		return;
+	}
+
+	// two state loss model, bursts happen in bad state
+	if( s->bad )
+	{
+		if( NET_ImpairRandom( s ) < p->bad_to_good )
+			s->bad = false;
+	}
+	else if( NET_ImpairRandom( s ) < p->good_to_bad )
+		s->bad = true;
+
+	loss = s->bad ? p->loss_bad : p->loss_good;
+
+	if( loss > 0.0f && NET_ImpairRandom( s ) < loss )
+	{
+		s->stats.lost++;
+		return;
+	}
+
+	// bottleneck link with limited queue
+	if( p->bandwidth > 0.0f )
+	{
+		double	start = Q_max( s->linkfree, now );
+		int	backlog = ( start - now ) * p->bandwidth;
+
+		if( backlog + size > p->queue || s->queued >= IMPAIR_MAX_QUEUE )
+		{
+			s->stats.overflowed++;
+			return;
+		}
+
+		s->linkfree = start + size / p->bandwidth;
+		now = s->linkfree;
+	}
+	else if( s->queued >= IMPAIR_MAX_QUEUE )
+	{
+		s->stats.overflowed++;
+		return;
+	}
+
+	time = now + Q_max( p->latency + NET_ImpairJitter( s ), 0.0f ) * 0.001;
+
+	if( p->reorder > 0.0f && NET_ImpairRandom( s ) < p->reorder )
+	{
+		// let next packets overtake it
+		time += p->reorder_delay * 0.001;
+		s->stats.reordered++;
+	}
+	else
+	{
+		// jitter alone doesn't reorder
+		time = Q_max( time, s->lastdelivery );
+		s->lastdelivery = time;
+	}
+
+	NET_ImpairEnqueue( s, from, data, size, time );
+
+	if( p->duplicate > 0.0f && NET_ImpairRandom( s ) < p->duplicate )
+	{
+		NET_ImpairEnqueue( s, from, data, size, time );
+		s->stats.duplicated++;
+	}
+}
+
+/*
+====================
+NET_ImpairPacket
+
+same as NET_LagPacket: takes new datagram if newdata is
+set and returns next one which is due in data
+====================
+*/
+qboolean NET_ImpairPacket( qboolean newdata, netsrc_t sock, netadr_t *from, size_t *length, void *data )
+{
+	impairsock_t	*s = &net_impair[sock];
+	impairpkt_t	*pkt;
+
+	// scripted changes
+	while( s->nextevent < s->profile.numevents )
+	{
+		impairevent_t	*ev = &s->profile.events[s->nextevent];
+
+		if( host.realtime - s->starttime < ev->time )
+			break;
+
+		NET_ImpairSetKey( &s->profile, ev->key, ev->value );
+		s->nextevent++;
+	}
+
+	if( newdata )
+		NET_ImpairIncoming( s, from, data, *length );
+
+	pkt = s->queue;
+
+	if( !pkt || pkt->time > host.realtime )
+		return false;
+
+	s->queue = pkt->next;
+	s->queued--;
+	s->queuedbytes -= pkt->size;
+	s->stats.delivered++;
+
+	memcpy( data, pkt->data, pkt->size );
+	*from = pkt->from;
+	*length = pkt->size;
+	Mem_Free( pkt );
+
+	return true;
+}
+
+/*
+====================
+NET_ImpairPrintStats
+
+====================
+*/
+static void NET_ImpairPrintStats( const char *name, const impairstats_t *st )
+{
+	Con_Printf( "%-8s %8u %8u %6u %6u %6u %6u %6u\n", name, st->received, st->delivered,
+		st->lost, st->overflowed, st->oversized, st->duplicated, st->reordered );
+}
+
+/*
+====================
+NET_Impair_f
+
+net_impair <file> [profile] [client|server|both]
+====================
+*/
+static void NET_Impair_f( void )
+{
+	impairprofile_t	*profiles;
+	const char	*target = "both";
+	int		i, count;
+
+	if( Cmd_Argc() < 2 )
+	{
+		Con_Printf( S_USAGE "net_impair <file> [profile] [client|server|both], net_impair off\n" );
+
+		Con_Printf( "socket   received delivered lost  queue    mtu    dup reorder\n" );
+		for( i = 0; i < NS_COUNT; i++ )
+		{
+			if( net_impair[i].active )
+				NET_ImpairPrintStats( i == NS_CLIENT ? "client" : "server", &net_impair[i].stats );
+		}
+		return;
+	}
+
+	if( !Q_stricmp( Cmd_Argv( 1 ), "off" ))
+	{
+		NET_ImpairStop( NS_CLIENT );
+		NET_ImpairStop( NS_SERVER );
+		return;
+	}
+
+	// same rules as fakelag
+	if( !host_developer.value )
+	{
+		Con_Printf( "Enable developer mode to activate network impairment\n" );
+		return;
+	}
+
+	profiles = Z_Malloc( sizeof( *profiles ) * 32 );
+	count = NET_ImpairLoadProfiles( Cmd_Argv( 1 ), profiles, 32 );
+
+	for( i = 0; i < count; i++ )
+	{
+		if( Cmd_Argc() < 3 || !Q_stricmp( profiles[i].name, Cmd_Argv( 2 )))
+			break;
+	}
+
+	if( Cmd_Argc() > 3 )
+		target = Cmd_Argv( 3 );
+
+	if( i == count )
+	{
+		Con_Printf( S_ERROR "no such profile in %s\n", Cmd_Argv( 1 ));
+	}
+	else
+	{
+		if( Q_stricmp( target, "server" ))
+			NET_ImpairStart( NS_CLIENT, &profiles[i] );
+		if( Q_stricmp( target, "client" ))
+			NET_ImpairStart( NS_SERVER, &profiles[i] );
+
+		Con_Printf( "network impairment %s applied to %s\n", profiles[i].name, target );
+	}
+
+	Mem_Free( profiles );
+}
+
+/*
+=============================================================================
+
+IMPAIRMENT BENCHMARK
+
+=============================================================================
+*/
+#define IMPAIR_BENCH_ID		(('B'<<24)+('P'<<16)+('M'<<8)+'I') // "IMPB"
+#define IMPAIR_BENCH_TICK		0.01
+
+typedef struct
+{
+	uint		sent;		// messages queued
+	uint		completed;
+	double		*created;		// [IMPAIR_MAX_MESSAGES]
+	float		*latency;		// completion times, ms
+	size_t		payload;		// delivered bytes
+} impairbench_t;
+
+static int	net_impair_fragsize;
+
+/*
+====================
+NET_ImpairBenchBlockSize
+
+same as remote client with cl_dlmax set
+====================
+*/
+static int NET_ImpairBenchBlockSize( void *unused, fragsize_t mode )
+{
+	if( mode == FRAGSIZE_SPLIT )
+		return 0;
+
+	if( mode == FRAGSIZE_UNRELIABLE )
+		return NET_MAX_MESSAGE;
+
+	return net_impair_fragsize;
+}
+
+/*
+====================
+NET_ImpairBenchReceive
+
+read everything that arrived to chan
+====================
+*/
+static void NET_ImpairBenchReceive( netchan_t *chan, impairbench_t *bench )
+{
+	byte	data[NET_MAX_FRAGMENT];
+	netadr_t	from;
+	size_t	length;
+	sizebuf_t	msg;
+	int	i;
+
+	// loopback queue is short, drain it in full
+	for( i = 0; i < 16; i++ )
+	{
+		if( !NET_GetPacket( chan->sock, &from, data, &length ))
+			continue;
+
+		net_from = from;
+		MSG_Init( &msg, "ImpairBench", data, length );
+
+		if( !Netchan_Process( chan, &msg ) && !Netchan_IncomingReady( chan ))
+			continue;
+
+		if( !bench || !Netchan_IncomingReady( chan ))
+			continue;
+
+		if( Netchan_CopyNormalFragments( chan, &msg, &length ) && length >= 8 )
+		{
+			sizebuf_t	hdr;
+			uint	id;
+
+			MSG_StartReading( &hdr, MSG_GetData( &msg ), length, 0, -1 );
+
+			if( MSG_ReadLong( &hdr ) == IMPAIR_BENCH_ID && ( id = MSG_ReadLong( &hdr )) < bench->sent )
+			{
+				bench->latency[bench->completed++] = ( host.realtime - bench->created[id] ) * 1000.0;
+				bench->payload += length;
+			}
+		}
+	}
+}
+
+/*
+====================
+NET_ImpairBenchQueue
+
+fill the waiting list with one more message
+====================
+*/
+static void NET_ImpairBenchQueue( netchan_t *chan, impairbench_t *bench, int msgsize )
+{
+	static byte	buf[NET_MAX_MESSAGE];
+	sizebuf_t		msg;
+	uint		rnd = bench->sent * 2654435761U + 1;
+	int		i;
+
+	MSG_Init( &msg, "ImpairBench", buf, sizeof( buf ));
+	MSG_WriteLong( &msg, IMPAIR_BENCH_ID );
+	MSG_WriteLong( &msg, bench->sent );
+
+	// incompressible payload
+	for( i = 8; i < msgsize; i++ )
+	{
+		rnd = rnd * 1103515245 + 12345;
+		MSG_WriteByte( &msg, rnd >> 24 );
+	}
+
+	bench->created[bench->sent++] = host.realtime;
+	Netchan_CreateFragments( chan, &msg );
+}
+
+/*
+====================
+NET_ImpairCompareFloats
+
+====================
+*/
+static int NET_ImpairCompareFloats( const void *a, const void *b )
+{
+	float	f1 = *(const float *)a;
+	float	f2 = *(const float *)b;
+
+	return ( f1 > f2 ) - ( f1 < f2 );
+}
+
+/*
+====================
+NET_ImpairBench
+
+run reliable stream between two channels over
+loopback with impairment on both directions
+====================
+*/
+static void NET_ImpairBench( const impairprofile_t *profile, float seconds, int msgsize, float rate )
+{
+	netchan_t		*srv, *cli;
+	impairbench_t	bench;
+	netadr_t		adr;
+	double		endtime;
+	impairstats_t	up, down;
+	uint		retransmits, packets;
+	size_t		wire;
+	float		avg = 0.0f;
+	int		i;
+
+	srv = Z_Calloc( sizeof( *srv ));
+	cli = Z_Calloc( sizeof( *cli ));
+	memset( &bench, 0, sizeof( bench ));
+	bench.created = Z_Malloc( sizeof( *bench.created ) * IMPAIR_MAX_MESSAGES );
+	bench.latency = Z_Malloc( sizeof( *bench.latency ) * IMPAIR_MAX_MESSAGES );
+
+	memset( &adr, 0, sizeof( adr ));
+	adr.type = NA_LOOPBACK;
+
+	Netchan_Setup( NS_SERVER, srv, adr, Cvar_VariableInteger( "net_qport" ), NULL, NET_ImpairBenchBlockSize );
+	Netchan_Setup( NS_CLIENT, cli, adr, Cvar_VariableInteger( "net_qport" ), NULL, NET_ImpairBenchBlockSize );
+	srv->rate = cli->rate = rate;
+
+	NET_ImpairStart( NS_CLIENT, profile );
+	NET_ImpairStart( NS_SERVER, profile );
+
+	for( endtime = host.realtime + seconds; host.realtime < endtime; host.realtime += IMPAIR_BENCH_TICK )
+	{
+		// keep one message waiting behind the one being sent
+		if( !srv->waitlist[FRAG_NORMAL_STREAM] && bench.sent < IMPAIR_MAX_MESSAGES )
+			NET_ImpairBenchQueue( srv, &bench, msgsize );
+
+		// loopback is never choked by Netchan_CanPacket
+		if( srv->cleartime < host.realtime )
+			Netchan_Transmit( srv, 0, NULL );
+
+		NET_ImpairBenchReceive( cli, &bench );
+
+		// acknowledge
+		Netchan_Transmit( cli, 0, NULL );
+		NET_ImpairBenchReceive( srv, NULL );
+	}
+
+	up = net_impair[NS_SERVER].stats;
+	down = net_impair[NS_CLIENT].stats;
+	retransmits = srv->retransmits;
+	packets = srv->outgoing_sequence - 1;
+	wire = srv->total_sended;
+
+	NET_ImpairStop( NS_CLIENT );
+	NET_ImpairStop( NS_SERVER );
+	Netchan_Clear( srv );
+	Netchan_Clear( cli );
+
+	qsort( bench.latency, bench.completed, sizeof( float ), NET_ImpairCompareFloats );
+	for( i = 0; i < bench.completed; i++ )
+		avg += bench.latency[i];
+
+	Con_Printf( "^3%s^7: %u of %u messages, %.1f KB/s payload, %.1f KB/s on wire\n", profile->name,
+		bench.completed, bench.sent, bench.payload / 1024.0 / seconds, wire / 1024.0 / seconds );
+	Con_Printf( "  %u packets, %u reliable retransmits\n", packets, retransmits );
+
+	if( bench.completed )
+	{
+		Con_Printf( "  completion ms: min %.0f, avg %.0f, p95 %.0f, max %.0f\n", bench.latency[0],
+			avg / bench.completed, bench.latency[bench.completed * 95 / 100], bench.latency[bench.completed - 1] );
+	}
+
+	Con_Printf( "socket   received delivered lost  queue    mtu    dup reorder\n" );
+	NET_ImpairPrintStats( "down", &down );
+	NET_ImpairPrintStats( "up", &up );
+
+	Mem_Free( bench.created );
+	Mem_Free( bench.latency );
+	Mem_Free( srv );
+	Mem_Free( cli );
+}
+
+/*
+====================
+NET_ImpairBench_f
+
+net_impair_bench <file> [seconds] [msgsize] [rate] [fragsize]
+====================
+*/
+static void NET_ImpairBench_f( void )
+{
+	impairsock_t	saved[NS_COUNT];
+	impairprofile_t	*profiles;
+	double		realtime;
+	float		seconds = 30.0f, rate = 25000.0f;
+	int		msgsize = 8192;
+	int		i, count;
+
+	if( Cmd_Argc() < 2 )
+	{
+		Con_Printf( S_USAGE "net_impair_bench <file> [seconds] [msgsize] [rate] [fragsize]\n" );
+		return;
+	}
+
+	// it uses loopback sockets
+	if( SV_Active() || CL_Active( ))
+	{
+		Con_Printf( S_ERROR "net_impair_bench: disconnect first\n" );
+		return;
+	}
+
+	if( Cmd_Argc() > 2 ) seconds = bound( 1.0f, Q_atof( Cmd_Argv( 2 )), 3600.0f );
+	if( Cmd_Argc() > 3 ) msgsize = bound( 16, Q_atoi( Cmd_Argv( 3 )), NET_MAX_MESSAGE / 2 );
+	if( Cmd_Argc() > 4 ) rate = bound( MIN_RATE, Q_atof( Cmd_Argv( 4 )), MAX_RATE );
+
+	net_impair_fragsize = FRAGMENT_DEFAULT_SIZE;
+	if( Cmd_Argc() > 5 ) net_impair_fragsize = bound( FRAGMENT_MIN_SIZE, Q_atoi( Cmd_Argv( 5 )), FRAGMENT_MAX_SIZE );
+
+	profiles = Z_Malloc( sizeof( *profiles ) * 32 );
+	count = NET_ImpairLoadProfiles( Cmd_Argv( 1 ), profiles, 32 );
+
+	Con_Printf( "%d profiles, %g seconds each, %d byte messages, rate %g, fragment %d\n", count, seconds, msgsize, rate, net_impair_fragsize );
+
+	// time is simulated, so run is repeatable and fast
+	memcpy( saved, net_impair, sizeof( saved ));
+	memset( net_impair, 0, sizeof( net_impair ));
+	realtime = host.realtime;
+
+	for( i = 0; i < count; i++ )
+	{
+		NET_ImpairBench( &profiles[i], seconds, msgsize, rate );
+		host.realtime = realtime;
+	}
+
+	memcpy( net_impair, saved, sizeof( saved ));
+	Mem_Free( profiles );
+}
+
+/*
+====================
+NET_ImpairInit
+
+====================
+*/
+void NET_ImpairInit( void )
+{
+	Cmd_AddCommand( "net_impair", NET_Impair_f, "simulate latency, jitter, burst loss, reordering and bandwidth limit on incoming packets" );
+	Cmd_AddCommand( "net_impair_bench", NET_ImpairBench_f, "measure netchan throughput under each impairment profile of a file" );
+}
+
+/*
+====================
+NET_ImpairShutdown
+
+====================
+*/
+void NET_ImpairShutdown( void )
+{
+	NET_ImpairStop( NS_CLIENT );
+	NET_ImpairStop( NS_SERVER );
+}
@@ -12,7 +12,7 @@ but WITHOUT ANY WARRANTY; without even the implied warranty of
 MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
 GNU General Public License for more details.
 */
-
+#define _GNU_SOURCE // recvmmsg, sendmmsg
 #include "common.h"
 #include "client.h" // ConnectionProgress
 #include "netchan.h"
@@ -98,6 +98,18 @@ typedef int WSAsize_t;
 
 #define NET_USE_FRAGMENTS
 
+#if XASH_LINUX && !defined XASH_NO_NETWORK && defined MSG_WAITFORONE
+#define NET_USE_MMSG
+#endif
+
+// same restrictions as for asynchronous name resolve, plus gcc atomics
+#if !XASH_WIN32 && !XASH_EMSCRIPTEN && !XASH_DOS4GW && !defined XASH_NO_NETWORK && !defined XASH_NO_ASYNC_NS_RESOLVE && defined __GNUC__
+#define NET_USE_THREAD
+#include <pthread.h>
+#include <poll.h>
+#include <unistd.h>
+#endif
+
 #define PORT_ANY			-1
 #define MAX_LOOPBACK		4
 #define MASK_LOOPBACK		(MAX_LOOPBACK - 1)
@@ -148,6 +160,90 @@ typedef struct
 } SPLITPACKET;
 #pragma pack(pop)
 
+typedef struct
+{
+	uint		packets_in;
+	uint		packets_out;
+	uint		calls_in;		// receive syscalls, including empty ones
+	uint		calls_out;
+	double		starttime;
+	int		startframe;
+} net_iostats_t;
+
+#ifdef NET_USE_MMSG
+#define NET_RECV_BATCH		32		// datagrams per recvmmsg
+#define NET_SEND_BATCH		64		// datagrams per sendmmsg
+#define NET_SEND_ARENA		0x20000		// queued datagrams are copied here
+
+typedef struct
+{
+	// receive ring, refilled by single recvmmsg when consumed
+	struct mmsghdr	recvhdrs[NET_RECV_BATCH];
+	struct iovec	recviov[NET_RECV_BATCH];
+	struct sockaddr	recvaddr[NET_RECV_BATCH];
+	byte		recvbuf[NET_RECV_BATCH][NET_MAX_FRAGMENT];
+	int		recvcount;
+	int		recvnext;
+	int		drainframe;	// socket was drained in this host frame
+
+	// send queue, flushed by single sendmmsg
+	struct mmsghdr	sendhdrs[NET_SEND_BATCH];
+	struct iovec	sendiov[NET_SEND_BATCH];
+	struct sockaddr	sendaddr[NET_SEND_BATCH];
+	netadr_t		sendadr[NET_SEND_BATCH];
+	byte		sendbuf[NET_SEND_ARENA];
+	int		sendcount;
+	int		sendsize;
+	qboolean		sending;		// inside NET_BeginBatch/NET_EndBatch
+} net_batch_t;
+#endif
+
+#ifdef NET_USE_THREAD
+#define NET_RING_SIZE		0x200000		// bytes, must be power of two
+#define NET_RING_WRAP		0xFFFFFFFF	// record length that skips to the ring start
+#define NET_RING_RECORD( len )	(( sizeof( net_ringhdr_t ) + (len) + 15 ) & ~15 )
+#define NET_LoadAcquire( x )	__atomic_load_n( &(x), __ATOMIC_ACQUIRE )
+#define NET_StoreRelease( x, v )	__atomic_store_n( &(x), (v), __ATOMIC_RELEASE )
+
+typedef struct
+{
+	uint		length;		// datagram length or NET_RING_WRAP
+	double		time;		// Sys_DoubleTime of arrival
+	netadr_t		adr;		// incoming datagrams
+	struct sockaddr	addr;		// outgoing datagrams
+} net_ringhdr_t;
+
+// single producer, single consumer
+typedef struct
+{
+	byte		*data;
+	size_t		head;		// bytes committed, written by producer
+	size_t		tail;		// bytes released, written by consumer
+	size_t		pending;		// reserved by producer, not committed yet
+} net_ring_t;
+
+typedef struct
+{
+	pthread_t		thread;
+	qboolean		active;
+	qboolean		batching;		// inside NET_BeginBatch/NET_EndBatch
+	int		quit;
+	int		socket;
+	int		wakefd[2];	// pipe to interrupt poll
+	net_ring_t	in;		// network thread -> host
+	net_ring_t	out;		// host -> network thread
+	size_t		inrelease;	// record handed out by last NET_GetPacket
+
+	// written by network thread
+	uint		calls_in;
+	uint		calls_out;
+	uint		drops_in;		// incoming ring was full
+	uint		errors_out;
+
+	uint		overflows_out;	// outgoing ring was full, sent directly
+} net_thread_t;
+#endif
+
 typedef struct
 {
 	net_loopback_t	loopbacks[NS_COUNT];
@@ -162,6 +258,14 @@ typedef struct
 	qboolean		threads_initialized;
 	qboolean		configured;
 	qboolean		allow_ip;
+	net_iostats_t	iostats[NS_COUNT];
+	float		packetdelay;	// last packet waited in the network thread queue before frame start
+#ifdef NET_USE_THREAD
+	net_thread_t	thread;		// server socket only
+#endif
+#ifdef NET_USE_MMSG
+	net_batch_t	*batch;		// server socket only
+#endif
 #if XASH_WIN32
 	WSADATA		winsockdata;
 #endif
@@ -176,6 +280,12 @@ static convar_t		*net_ipclientport;
 static convar_t		*net_fakelag;
 static convar_t		*net_fakeloss;
 static convar_t		*net_address;
+#ifdef NET_USE_MMSG
+static convar_t		*net_batch;
+#endif
+#ifdef NET_USE_THREAD
+static convar_t		*net_thread;
+#endif
 convar_t			*net_clockwindow;
 netadr_t			net_local;
 
@@ -769,6 +879,12 @@ static void NET_SendLoopPacket( netsrc_t sock, size_t length, const void *data,
 
 	loop = &net.loopbacks[sock^1];
 
+	if( length > sizeof( loop->msgs[0].data ))
+	{
+		Con_Reportf( S_ERROR "NET_SendLoopPacket: oversize packet %i bytes\n", (int)length );
+		return;
+	}
+
 	i = loop->send & MASK_LOOPBACK;
 	loop->send++;
 
@@ -920,6 +1036,10 @@ static qboolean NET_LagPacket( qboolean newdata, netsrc_t sock, netadr_t *from,
 	int		ninterval;
 	float		curtime;
 
+	// replaces fakelag and fakeloss
+	if( NET_ImpairActive( sock ))
+		return NET_ImpairPacket( newdata, sock, from, length, data );
+
 	if( net.fakelag <= 0.0f )
 	{
 		NET_ClearLagData( true, true );
@@ -1081,12 +1201,669 @@ qboolean NET_GetLong( byte *pData, int size, size_t *outSize, int splitsize )
 
 /*
 ==================
-NET_QueuePacket
+NET_ProcessPacket
 
-queue normal and lagged packets
+handle split and lagged packets
 ==================
 */
-qboolean NET_QueuePacket( netsrc_t sock, netadr_t *from, byte *data, size_t *length )
+static qboolean NET_ProcessPacket( netsrc_t sock, netadr_t *from, byte *data, int size, size_t *length )
+{
+	*length = size;
+#if !XASH_DEDICATED
+	if( CL_LegacyMode() )
+		return NET_LagPacket( true, sock, from, length, data );
+
+	// check for split message
+	if( sock == NS_CLIENT && *(int *)data == NET_HEADER_SPLITPACKET )
+	{
+		return NET_GetLong( data, size, length, CL_GetSplitSize() );
+	}
+#endif
+	// lag the packet, if needed
+	return NET_LagPacket( true, sock, from, length, data );
+}
+
+/*
+==================
+NET_ReportSendError
+==================
+*/
+static void NET_ReportSendError( netadr_t to )
+{
+	int err = WSAGetLastError();
+
+	// WSAEWOULDBLOCK is silent
+	if( err == WSAEWOULDBLOCK )
+		return;
+
+	// some PPP links don't allow broadcasts
+	if( err == WSAEADDRNOTAVAIL && to.type == NA_BROADCAST )
+		return;
+
+	if( Host_IsDedicated() )
+	{
+		Con_DPrintf( S_ERROR "NET_SendPacket: %s to %s\n", NET_ErrorString(), NET_AdrToString( to ));
+	}
+	else if( err == WSAEADDRNOTAVAIL || err == WSAENOBUFS )
+	{
+		Con_DPrintf( S_ERROR "NET_SendPacket: %s to %s\n", NET_ErrorString(), NET_AdrToString( to ));
+	}
+	else
+	{
+		Con_Printf( S_ERROR "NET_SendPacket: %s to %s\n", NET_ErrorString(), NET_AdrToString( to ));
+	}
+}
+
+#ifdef NET_USE_MMSG
+/*
+==================
+NET_GetBatch
+
+batched I/O is used for server socket only
+==================
+*/
+static net_batch_t *NET_GetBatch( netsrc_t sock )
+{
+	int	i;
+
+	if( sock != NS_SERVER || !net_batch->value || !NET_IsSocketValid( net.ip_sockets[sock] ))
+		return NULL;
+
+	if( !net.batch )
+	{
+		net.batch = Z_Calloc( sizeof( net_batch_t ));
+		net.batch->drainframe = -1;
+
+		for( i = 0; i < NET_RECV_BATCH; i++ )
+		{
+			net.batch->recviov[i].iov_base = net.batch->recvbuf[i];
+			net.batch->recviov[i].iov_len = sizeof( net.batch->recvbuf[i] );
+			net.batch->recvhdrs[i].msg_hdr.msg_iov = &net.batch->recviov[i];
+			net.batch->recvhdrs[i].msg_hdr.msg_iovlen = 1;
+			net.batch->recvhdrs[i].msg_hdr.msg_name = &net.batch->recvaddr[i];
+		}
+	}
+
+	return net.batch;
+}
+
+/*
+==================
+NET_RecvBatch
+
+returns next datagram from the ring, refills it with a single recvmmsg
+when consumed. Result is same as for recvfrom, packet stays valid until next call
+==================
+*/
+static int NET_RecvBatch( netsrc_t sock, int net_socket, struct sockaddr *addr, byte **data )
+{
+	net_batch_t	*b = net.batch;
+	struct mmsghdr	*hdr;
+	int		i, ret;
+
+	if( b->recvnext >= b->recvcount )
+	{
+		b->recvnext = b->recvcount = 0;
+
+		// last call didn't fill the ring, so socket was empty
+		// don't spend another syscall on it until next frame
+		if( b->drainframe == host.framecount )
+		{
+			errno = EWOULDBLOCK;
+			return -1;
+		}
+
+		for( i = 0; i < NET_RECV_BATCH; i++ )
+		{
+			b->recvhdrs[i].msg_hdr.msg_namelen = sizeof( b->recvaddr[i] );
+			b->recvhdrs[i].msg_hdr.msg_flags = 0;
+		}
+
+		ret = recvmmsg( net_socket, b->recvhdrs, NET_RECV_BATCH, MSG_DONTWAIT, NULL );
+		net.iostats[sock].calls_in++;
+
+		if( ret <= 0 )
+		{
+			if( ret == 0 ) errno = EWOULDBLOCK;
+			if( errno == EWOULDBLOCK ) b->drainframe = host.framecount;
+			return -1;
+		}
+
+		if( ret < NET_RECV_BATCH )
+			b->drainframe = host.framecount;
+		b->recvcount = ret;
+	}
+
+	hdr = &b->recvhdrs[b->recvnext];
+	*data = b->recvbuf[b->recvnext];
+	*addr = b->recvaddr[b->recvnext];
+	b->recvnext++;
+
+	// report truncated datagrams as oversized
+	if( FBitSet( hdr->msg_hdr.msg_flags, MSG_TRUNC ))
+		return NET_MAX_FRAGMENT;
+
+	return hdr->msg_len;
+}
+
+/*
+==================
+NET_FlushBatch
+
+send all queued datagrams
+==================
+*/
+static void NET_FlushBatch( netsrc_t sock )
+{
+	net_batch_t	*b = net.batch;
+	int		ret, sent = 0;
+
+	if( !b ) return;
+
+	while( sent < b->sendcount )
+	{
+		ret = sendmmsg( net.ip_sockets[sock], &b->sendhdrs[sent], b->sendcount - sent, 0 );
+		net.iostats[sock].calls_out++;
+
+		if( ret <= 0 )
+		{
+			// first datagram is failed, report it and try the rest
+			NET_ReportSendError( b->sendadr[sent] );
+			sent++;
+			continue;
+		}
+
+		sent += ret;
+	}
+
+	b->sendcount = 0;
+	b->sendsize = 0;
+}
+
+/*
+==================
+NET_QueueBatchPacket
+
+copy datagram into send queue, if batch is active
+==================
+*/
+static qboolean NET_QueueBatchPacket( netsrc_t sock, size_t length, const void *data, netadr_t *to, struct sockaddr *addr, size_t splitsize )
+{
+	net_batch_t	*b = net.batch;
+	int		i;
+
+	if( !b || !b->sending || sock != NS_SERVER || to->type != NA_IP )
+		return false;
+
+	if( length > NET_SEND_ARENA )
+		return false;
+
+#ifdef NET_USE_FRAGMENTS
+	// split packets are sent immediately
+	if( splitsize > sizeof( SPLITPACKET ) && length > splitsize )
+		return false;
+#endif
+
+	if( b->sendcount == NET_SEND_BATCH || b->sendsize + length > NET_SEND_ARENA )
+		NET_FlushBatch( sock );
+
+	i = b->sendcount++;
+	memcpy( b->sendbuf + b->sendsize, data, length );
+	b->sendiov[i].iov_base = b->sendbuf + b->sendsize;
+	b->sendiov[i].iov_len = length;
+	b->sendaddr[i] = *addr;
+	b->sendadr[i] = *to;
+	b->sendhdrs[i].msg_hdr.msg_name = &b->sendaddr[i];
+	b->sendhdrs[i].msg_hdr.msg_namelen = sizeof( b->sendaddr[i] );
+	b->sendhdrs[i].msg_hdr.msg_iov = &b->sendiov[i];
+	b->sendhdrs[i].msg_hdr.msg_iovlen = 1;
+	b->sendsize += length;
+	net.iostats[sock].packets_out++;
+
+	return true;
+}
+
+/*
+==================
+NET_FreeBatch
+==================
+*/
+static void NET_FreeBatch( void )
+{
+	if( !net.batch ) return;
+
+	Mem_Free( net.batch );
+	net.batch = NULL;
+}
+#endif // NET_USE_MMSG
+
+#ifdef NET_USE_THREAD
+/*
+==================
+NET_RingReserve
+
+returns space for a record of given size or NULL if ring is full
+==================
+*/
+static net_ringhdr_t *NET_RingReserve( net_ring_t *ring, size_t size )
+{
+	size_t	tail = NET_LoadAcquire( ring->tail );
+	size_t	offset = ring->head & ( NET_RING_SIZE - 1 );
+	size_t	skip = 0;
+
+	// records are never split
+	if( NET_RING_SIZE - offset < size )
+		skip = NET_RING_SIZE - offset;
+
+	if( ring->head + skip + size - tail > NET_RING_SIZE )
+		return NULL;
+
+	if( skip )
+	{
+		((net_ringhdr_t *)( ring->data + offset ))->length = NET_RING_WRAP;
+		offset = 0;
+	}
+
+	ring->pending = skip + size;
+
+	return (net_ringhdr_t *)( ring->data + offset );
+}
+
+/*
+==================
+NET_RingCommit
+
+make reserved record visible to consumer
+==================
+*/
+static void NET_RingCommit( net_ring_t *ring )
+{
+	NET_StoreRelease( ring->head, ring->head + ring->pending );
+	ring->pending = 0;
+}
+
+/*
+==================
+NET_RingPeek
+
+returns oldest record or NULL if ring is empty,
+record stays in the ring until NET_RingRelease
+==================
+*/
+static net_ringhdr_t *NET_RingPeek( net_ring_t *ring, size_t *size )
+{
+	size_t		head = NET_LoadAcquire( ring->head );
+	net_ringhdr_t	*hdr;
+	size_t		offset;
+
+	while( ring->tail != head )
+	{
+		offset = ring->tail & ( NET_RING_SIZE - 1 );
+		hdr = (net_ringhdr_t *)( ring->data + offset );
+
+		if( hdr->length == NET_RING_WRAP )
+		{
+			NET_StoreRelease( ring->tail, ring->tail + NET_RING_SIZE - offset );
+			continue;
+		}
+
+		*size = NET_RING_RECORD( hdr->length );
+		return hdr;
+	}
+
+	return NULL;
+}
+
+/*
+==================
+NET_RingRelease
+==================
+*/
+static void NET_RingRelease( net_ring_t *ring, size_t size )
+{
+	NET_StoreRelease( ring->tail, ring->tail + size );
+}
+
+/*
+==================
+NET_WakeThread
+==================
+*/
+static void NET_WakeThread( void )
+{
+	byte	c = 0;
+
+	// pipe is non-blocking, full pipe wakes thread anyway
+	if( write( net.thread.wakefd[1], &c, 1 ) < 0 )
+		return;
+}
+
+/*
+==================
+NET_ThreadReceive
+
+drain the socket into incoming ring
+==================
+*/
+static void NET_ThreadReceive( byte *buf, size_t bufsize )
+{
+	net_thread_t	*nt = &net.thread;
+	net_ringhdr_t	*hdr;
+	struct sockaddr	addr;
+	socklen_t		addr_len;
+	int		ret;
+
+	while( 1 )
+	{
+		addr_len = sizeof( addr );
+		ret = recvfrom( nt->socket, buf, bufsize, 0, &addr, &addr_len );
+		nt->calls_in++;
+
+		if( ret < 0 ) break;
+
+		if( ret >= NET_MAX_FRAGMENT )
+			continue; // oversize
+
+		if(( hdr = NET_RingReserve( &nt->in, NET_RING_RECORD( ret ))) == NULL )
+		{
+			nt->drops_in++;
+			continue;
+		}
+
+		hdr->length = ret;
+		hdr->time = Sys_DoubleTime();
+		NET_SockadrToNetadr( &addr, &hdr->adr );
+		memcpy( hdr + 1, buf, ret );
+		NET_RingCommit( &nt->in );
+	}
+}
+
+/*
+==================
+NET_ThreadSend
+
+send everything queued by host
+==================
+*/
+static void NET_ThreadSend( void )
+{
+	net_thread_t	*nt = &net.thread;
+	net_ringhdr_t	*hdr;
+	size_t		size;
+
+	while(( hdr = NET_RingPeek( &nt->out, &size )) != NULL )
+	{
+		if( sendto( nt->socket, hdr + 1, hdr->length, 0, &hdr->addr, sizeof( hdr->addr )) < 0 && errno != EWOULDBLOCK )
+			nt->errors_out++;
+		nt->calls_out++;
+
+		NET_RingRelease( &nt->out, size );
+	}
+}
+
+/*
+==================
+NET_ThreadMain
+
+network thread never touches anything except its rings,
+so no engine functions that aren't thread-safe are allowed here
+==================
+*/
+static void *NET_ThreadMain( void *unused )
+{
+	static byte	buf[NET_MAX_FRAGMENT];
+	net_thread_t	*nt = &net.thread;
+	struct pollfd	fds[2];
+
+	fds[0].fd = nt->socket;
+	fds[0].events = POLLIN;
+	fds[1].fd = nt->wakefd[0];
+	fds[1].events = POLLIN;
+
+	while( !NET_LoadAcquire( nt->quit ))
+	{
+		fds[0].revents = fds[1].revents = 0;
+
+		if( poll( fds, 2, 100 ) < 0 && errno != EINTR )
+			break;
+
+		if( FBitSet( fds[1].revents, POLLIN ))
+		{
+			while( read( nt->wakefd[0], buf, sizeof( buf )) > 0 );
+		}
+
+		if( FBitSet( fds[0].revents, POLLIN ))
+			NET_ThreadReceive( buf, sizeof( buf ));
+
+		NET_ThreadSend();
+	}
+
+	// don't lose the last frame
+	NET_ThreadSend();
+
+	return NULL;
+}
+
+/*
+==================
+NET_StartThread
+==================
+*/
+static void NET_StartThread( void )
+{
+	net_thread_t	*nt = &net.thread;
+
+	memset( nt, 0, sizeof( *nt ));
+	nt->socket = net.ip_sockets[NS_SERVER];
+
+	if( pipe( nt->wakefd ) < 0 )
+	{
+		Con_Printf( S_ERROR "NET_StartThread: %s\n", NET_ErrorString( ));
+		Cvar_SetValue( "net_thread", 0.0f );
+		return;
+	}
+
+	fcntl( nt->wakefd[0], F_SETFL, fcntl( nt->wakefd[0], F_GETFL ) | O_NONBLOCK );
+	fcntl( nt->wakefd[1], F_SETFL, fcntl( nt->wakefd[1], F_GETFL ) | O_NONBLOCK );
+	nt->in.data = Z_Malloc( NET_RING_SIZE );
+	nt->out.data = Z_Malloc( NET_RING_SIZE );
+
+	if( pthread_create( &nt->thread, NULL, NET_ThreadMain, NULL ))
+	{
+		Con_Printf( S_ERROR "NET_StartThread: couldn't create thread\n" );
+		Cvar_SetValue( "net_thread", 0.0f );
+		close( nt->wakefd[0] );
+		close( nt->wakefd[1] );
+		Mem_Free( nt->in.data );
+		Mem_Free( nt->out.data );
+		memset( nt, 0, sizeof( *nt ));
+		return;
+	}
+
+	nt->active = true;
+}
+
+/*
+==================
+NET_StopThread
+
+unread incoming datagrams are dropped
+==================
+*/
+static void NET_StopThread( void )
+{
+	net_thread_t	*nt = &net.thread;
+
+	if( !nt->active )
+		return;
+
+	NET_StoreRelease( nt->quit, 1 );
+	NET_WakeThread();
+	pthread_join( nt->thread, NULL );
+
+	close( nt->wakefd[0] );
+	close( nt->wakefd[1] );
+	Mem_Free( nt->in.data );
+	Mem_Free( nt->out.data );
+	memset( nt, 0, sizeof( *nt ));
+}
+
+/*
+==================
+NET_UpdateThread
+
+start or stop network thread when net_thread is changed
+==================
+*/
+static void NET_UpdateThread( void )
+{
+	qboolean	wanted = net_thread->value && NET_IsSocketValid( net.ip_sockets[NS_SERVER] );
+
+	if( wanted == net.thread.active )
+		return;
+
+	if( wanted ) NET_StartThread();
+	else NET_StopThread();
+}
+
+/*
+==================
+NET_QueueThreadPacket
+
+take next datagram from the incoming ring,
+it's released on the next call
+==================
+*/
+static qboolean NET_QueueThreadPacket( netadr_t *from, byte *data, byte **packet, size_t *length )
+{
+	net_thread_t	*nt = &net.thread;
+	net_ringhdr_t	*hdr;
+	size_t		size;
+
+	if( nt->inrelease )
+	{
+		NET_RingRelease( &nt->in, nt->inrelease );
+		nt->inrelease = 0;
+	}
+
+	*length = 0;
+	*packet = data;
+
+	if(( hdr = NET_RingPeek( &nt->in, &size )) == NULL )
+		return NET_LagPacket( false, NS_SERVER, from, length, data );
+
+	nt->inrelease = size;
+	net.packetdelay = Q_max( 0.0, host.framestart - hdr->time );
+	net.iostats[NS_SERVER].packets_in++;
+	*from = hdr->adr;
+
+	// lag queue may deliver a bigger packet than the record
+	if( net.fakelag > 0.0f || NET_ImpairActive( NS_SERVER ))
+		memcpy( data, hdr + 1, hdr->length );
+	else *packet = (byte *)( hdr + 1 );
+
+	return NET_ProcessPacket( NS_SERVER, from, *packet, hdr->length, length );
+}
+
+/*
+==================
+NET_PushThreadPacket
+
+queue datagram for network thread
+==================
+*/
+static qboolean NET_PushThreadPacket( netsrc_t sock, size_t length, const void *data, netadr_t *to, struct sockaddr *addr, size_t splitsize )
+{
+	net_thread_t	*nt = &net.thread;
+	net_ringhdr_t	*hdr;
+
+	if( !nt->active || sock != NS_SERVER || to->type != NA_IP || length >= NET_MAX_FRAGMENT )
+		return false;
+
+#ifdef NET_USE_FRAGMENTS
+	// split packets are sent immediately
+	if( splitsize > sizeof( SPLITPACKET ) && length > splitsize )
+		return false;
+#endif
+
+	if(( hdr = NET_RingReserve( &nt->out, NET_RING_RECORD( length ))) == NULL )
+	{
+		nt->overflows_out++;
+		return false;
+	}
+
+	hdr->length = length;
+	hdr->addr = *addr;
+	memcpy( hdr + 1, data, length );
+	NET_RingCommit( &nt->out );
+	net.iostats[sock].packets_out++;
+
+	if( !nt->batching )
+		NET_WakeThread();
+
+	return true;
+}
+#endif // NET_USE_THREAD
+
+/*
+==================
+NET_BeginBatch
+
+datagrams sent to sock are queued until NET_EndBatch
+==================
+*/
+void NET_BeginBatch( netsrc_t sock )
+{
+#ifdef NET_USE_MMSG
+	net_batch_t	*b;
+#endif
+#ifdef NET_USE_THREAD
+	// wake network thread once for the whole batch
+	if( sock == NS_SERVER && net.thread.active )
+	{
+		net.thread.batching = true;
+		return;
+	}
+#endif
+#ifdef NET_USE_MMSG
+	if(( b = NET_GetBatch( sock )) != NULL )
+		b->sending = true;
+#endif
+}
+
+/*
+==================
+NET_EndBatch
+==================
+*/
+void NET_EndBatch( netsrc_t sock )
+{
+#ifdef NET_USE_THREAD
+	if( sock == NS_SERVER && net.thread.batching )
+	{
+		net.thread.batching = false;
+		NET_WakeThread();
+		return;
+	}
+#endif
+#ifdef NET_USE_MMSG
+	if( sock != NS_SERVER || !net.batch )
+		return;
+
+	NET_FlushBatch( sock );
+	net.batch->sending = false;
+#endif
+}
+
+/*
+==================
+NET_QueuePacketInPlace
+
+queue normal and lagged packets, *packet is pointed either to
+data or to the receive ring to avoid copying
+==================
+*/
+static qboolean NET_QueuePacketInPlace( netsrc_t sock, netadr_t *from, byte *data, byte **packet, size_t *length )
 {
 	byte		buf[NET_MAX_FRAGMENT];
 	int		ret;
@@ -1095,13 +1872,41 @@ qboolean NET_QueuePacket( netsrc_t sock, netadr_t *from, byte *data, size_t *len
 	struct sockaddr	addr;
 
 	*length = 0;
+	*packet = data;
+
+#ifdef NET_USE_THREAD
+	if( sock == NS_SERVER && net.thread.active )
+		return NET_QueueThreadPacket( from, data, packet, length );
+#endif
 
 	net_socket = net.ip_sockets[sock];
 
 	if( NET_IsSocketValid( net_socket ) )
 	{
-		addr_len = sizeof( addr );
-		ret = recvfrom( net_socket, buf, sizeof( buf ), 0, (struct sockaddr *)&addr, &addr_len );
+#ifdef NET_USE_MMSG
+		// drain the ring even if batching was just disabled
+		if( NET_GetBatch( sock ) || ( sock == NS_SERVER && net.batch && net.batch->recvnext < net.batch->recvcount ))
+		{
+			ret = NET_RecvBatch( sock, net_socket, &addr, packet );
+
+			// lag queue may deliver a bigger loopback packet than the ring slot
+			if( !NET_IsSocketError( ret ) && ret < NET_MAX_FRAGMENT && ( net.fakelag > 0.0f || NET_ImpairActive( sock )))
+			{
+				memcpy( data, *packet, ret );
+				*packet = data;
+			}
+		}
+		else
+#endif
+		{
+			addr_len = sizeof( addr );
+			ret = recvfrom( net_socket, buf, sizeof( buf ), 0, (struct sockaddr *)&addr, &addr_len );
+			net.iostats[sock].calls_in++;
+
+			// transfer data
+			if( !NET_IsSocketError( ret ) && ret < NET_MAX_FRAGMENT )
+				memcpy( data, buf, ret );
+		}
 
 		if( !NET_IsSocketError( ret ) )
 		{
@@ -1109,21 +1914,8 @@ qboolean NET_QueuePacket( netsrc_t sock, netadr_t *from, byte *data, size_t *len
 
 			if( ret < NET_MAX_FRAGMENT )
 			{
-				// Transfer data
-				memcpy( data, buf, ret );
-				*length = ret;
-#if !XASH_DEDICATED
-				if( CL_LegacyMode() )
-					return NET_LagPacket( true, sock, from, length, data );
-
-				// check for split message
-				if( sock == NS_CLIENT && *(int *)data == NET_HEADER_SPLITPACKET )
-				{
-					return NET_GetLong( data, ret, length, CL_GetSplitSize() );
-				}
-#endif
-				// lag the packet, if needed
-				return NET_LagPacket( true, sock, from, length, data );
+				net.iostats[sock].packets_in++;
+				return NET_ProcessPacket( sock, from, *packet, ret, length );
 			}
 			else
 			{
@@ -1149,9 +1941,30 @@ qboolean NET_QueuePacket( netsrc_t sock, netadr_t *from, byte *data, size_t *len
 		}
 	}
 
+	*packet = data;
 	return NET_LagPacket( false, sock, from, length, data );
 }
 
+/*
+==================
+NET_QueuePacket
+
+queue normal and lagged packets
+==================
+*/
+qboolean NET_QueuePacket( netsrc_t sock, netadr_t *from, byte *data, size_t *length )
+{
+	byte	*packet;
+
+	if( !NET_QueuePacketInPlace( sock, from, data, &packet, length ))
+		return false;
+
+	if( packet != data )
+		memcpy( data, packet, *length );
+
+	return true;
+}
+
 /*
 ==================
 NET_GetPacket
@@ -1176,6 +1989,53 @@ qboolean NET_GetPacket( netsrc_t sock, netadr_t *from, byte *data, size_t *lengt
 	}
 }
 
+/*
+==================
+NET_GetPacketInPlace
+
+same as NET_GetPacket, but *packet may point to the receive ring
+instead of data. Packet is valid until next call
+==================
+*/
+qboolean NET_GetPacketInPlace( netsrc_t sock, netadr_t *from, byte *data, byte **packet, size_t *length )
+{
+	*packet = data;
+	net.packetdelay = 0.0f;
+
+	if( !data || !length )
+		return false;
+
+#ifdef NET_USE_THREAD
+	if( sock == NS_SERVER )
+		NET_UpdateThread();
+#endif
+
+	NET_AdjustLag();
+
+	if( NET_GetLoopPacket( sock, from, data, length ))
+	{
+		return NET_LagPacket( true, sock, from, length, data );
+	}
+	else
+	{
+		return NET_QueuePacketInPlace( sock, from, data, packet, length );
+	}
+}
+
+/*
+==================
+NET_GetPacketDelay
+
+how long last received packet was waiting in the network
+thread queue before current frame was started, in seconds.
+Unlike time of reading, it's on the same clock as host.realtime
+==================
+*/
+float NET_GetPacketDelay( void )
+{
+	return net.packetdelay;
+}
+
 /*
 ==================
 NET_SendLong
@@ -1224,8 +2084,11 @@ int NET_SendLong( netsrc_t sock, int net_socket, const char *buf, size_t len, in
 			}
 
 			ret = sendto( net_socket, packet, size + sizeof( SPLITPACKET ), flags, to, tolen );
+			net.iostats[sock].calls_out++;
 			if( ret < 0 ) return ret; // error
 
+			net.iostats[sock].packets_out++;
+
 			if( ret >= size )
 				total_sent += size;
 			len -= size;
@@ -1239,6 +2102,8 @@ int NET_SendLong( netsrc_t sock, int net_socket, const char *buf, size_t len, in
 #endif
 	{
 		// no fragmenantion for client connection
+		net.iostats[sock].calls_out++;
+		net.iostats[sock].packets_out++;
 		return sendto( net_socket, buf, len, flags, to, tolen );
 	}
 }
@@ -1278,34 +2143,20 @@ void NET_SendPacketEx( netsrc_t sock, size_t length, const void *data, netadr_t
 
 	NET_NetadrToSockadr( &to, &addr );
 
-	ret = NET_SendLong( sock, net_socket, data, length, 0, &addr, sizeof( addr ), splitsize );
-
-	if( NET_IsSocketError( ret ))
-	{
-		int err = WSAGetLastError();
-
-		// WSAEWOULDBLOCK is silent
-		if( err == WSAEWOULDBLOCK )
-			return;
+#ifdef NET_USE_THREAD
+	if( NET_PushThreadPacket( sock, length, data, &to, &addr, splitsize ))
+		return;
+#endif
 
-		// some PPP links don't allow broadcasts
-		if( err == WSAEADDRNOTAVAIL && to.type == NA_BROADCAST )
-			return;
+#ifdef NET_USE_MMSG
+	if( NET_QueueBatchPacket( sock, length, data, &to, &addr, splitsize ))
+		return;
+#endif
 
-		if( Host_IsDedicated() )
-		{
-			Con_DPrintf( S_ERROR "NET_SendPacket: %s to %s\n", NET_ErrorString(), NET_AdrToString( to ));
-		}
-		else if( err == WSAEADDRNOTAVAIL || err == WSAENOBUFS )
-		{
-			Con_DPrintf( S_ERROR "NET_SendPacket: %s to %s\n", NET_ErrorString(), NET_AdrToString( to ));
-		}
-		else
-		{
-			Con_Printf( S_ERROR "NET_SendPacket: %s to %s\n", NET_ErrorString(), NET_AdrToString( to ));
-		}
-	}
+	ret = NET_SendLong( sock, net_socket, data, length, 0, &addr, sizeof( addr ), splitsize );
 
+	if( NET_IsSocketError( ret ))
+		NET_ReportSendError( to );
 }
 
 /*
@@ -1599,6 +2450,11 @@ void NET_Config( qboolean multiplayer )
 	{
 		int	i;
 
+#ifdef NET_USE_THREAD
+		// thread polls the server socket
+		NET_StopThread();
+#endif
+
 		// shut down any existing sockets
 		for( i = 0; i < NS_COUNT; i++ )
 		{
@@ -1608,6 +2464,9 @@ void NET_Config( qboolean multiplayer )
 				net.ip_sockets[i] = INVALID_SOCKET;
 			}
 		}
+#ifdef NET_USE_MMSG
+		NET_FreeBatch();
+#endif
 	}
 
 	NET_ClearLoopback ();
@@ -1681,6 +2540,70 @@ void NET_ClearLagData( qboolean bClient, qboolean bServer )
 	if( bServer ) NET_ClearLaggedList( &net.lagdata[NS_SERVER] );
 }
 
+/*
+====================
+NET_ResetIOStats
+====================
+*/
+static void NET_ResetIOStats( void )
+{
+	int	i;
+
+	memset( net.iostats, 0, sizeof( net.iostats ));
+
+	for( i = 0; i < NS_COUNT; i++ )
+	{
+		net.iostats[i].starttime = Sys_DoubleTime();
+		net.iostats[i].startframe = host.framecount;
+	}
+}
+
+/*
+====================
+NET_IOStats_f
+
+packets and syscalls since last reset
+====================
+*/
+static void NET_IOStats_f( void )
+{
+	const char	*names[NS_COUNT] = { "client", "server" };
+	net_iostats_t	*st;
+	double		time;
+	int		i, frames;
+
+	if( Cmd_Argc() > 1 && !Q_stricmp( Cmd_Argv( 1 ), "reset" ))
+	{
+		NET_ResetIOStats();
+		return;
+	}
+
+#ifdef NET_USE_MMSG
+	Con_Printf( "batched I/O: %s\n", net_batch->value ? "enabled" : "disabled" );
+#else
+	Con_Printf( "batched I/O: not supported\n" );
+#endif
+#ifdef NET_USE_THREAD
+	if( net.thread.active )
+	{
+		Con_Printf( "network thread: %u recv calls, %u send calls, %u dropped in, %u send errors, %u ring overflows\n",
+			net.thread.calls_in, net.thread.calls_out, net.thread.drops_in, net.thread.errors_out, net.thread.overflows_out );
+	}
+	else Con_Printf( "network thread: %s\n", net_thread->value ? "waiting for server socket" : "disabled" );
+#endif
+
+	for( i = 0; i < NS_COUNT; i++ )
+	{
+		st = &net.iostats[i];
+		time = Q_max( Sys_DoubleTime() - st->starttime, 0.001 );
+		frames = Q_max( host.framecount - st->startframe, 1 );
+
+		Con_Printf( "%s: in %.1f pkt/s, %.2f calls/frame; out %.1f pkt/s, %.2f calls/frame (%u/%u packets, %u/%u calls)\n",
+			names[i], st->packets_in / time, (double)st->calls_in / frames, st->packets_out / time, (double)st->calls_out / frames,
+			st->packets_in, st->packets_out, st->calls_in, st->calls_out );
+	}
+}
+
 /*
 ====================
 NET_Init
@@ -1702,6 +2625,14 @@ void NET_Init( void )
 	net_clientport = Cvar_Get( "clientport", va( "%i", PORT_CLIENT ), FCVAR_READ_ONLY, "network default client port" );
 	net_fakelag = Cvar_Get( "fakelag", "0", 0, "lag all incoming network data (including loopback) by xxx ms." );
 	net_fakeloss = Cvar_Get( "fakeloss", "0", 0, "act like we dropped the packet this % of the time." );
+#ifdef NET_USE_MMSG
+	net_batch = Cvar_Get( "net_batch", "1", FCVAR_ARCHIVE, "receive and send server datagrams in batches with recvmmsg/sendmmsg" );
+#endif
+#ifdef NET_USE_THREAD
+	net_thread = Cvar_Get( "net_thread", "0", FCVAR_ARCHIVE, "receive and send server datagrams on a separate thread" );
+#endif
+	Cmd_AddCommand( "net_iostats", NET_IOStats_f, "show packets and syscalls per second and per frame, 'reset' to clear counters" );
+	NET_ImpairInit();
 
 	// prepare some network data
 	for( i = 0; i < NS_COUNT; i++ )
@@ -1738,6 +2669,7 @@ void NET_Init( void )
 	if( Sys_GetParmFromCmdLine( "-clockwindow", cmd ))
 		Cvar_SetValue( "clockwindow", Q_atof( cmd ));
 
+	NET_ResetIOStats();
 	net.sequence_number = 1;
 	net.initialized = true;
 	Con_Reportf( "Base networking initialized.\n" );
@@ -1755,6 +2687,7 @@ void NET_Shutdown( void )
 		return;
 
 	NET_ClearLagData( true, true );
+	NET_ImpairShutdown();
 
 	NET_Config( false );
 #if XASH_WIN32
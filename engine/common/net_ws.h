@@ -62,11 +62,19 @@ int NET_StringToAdrNB( const char *string, netadr_t *adr );
 qboolean NET_CompareAdr( const netadr_t a, const netadr_t b );
 qboolean NET_CompareBaseAdr( const netadr_t a, const netadr_t b );
 qboolean NET_GetPacket( netsrc_t sock, netadr_t *from, byte *data, size_t *length );
+qboolean NET_GetPacketInPlace( netsrc_t sock, netadr_t *from, byte *data, byte **packet, size_t *length );
+float NET_GetPacketDelay( void );
 qboolean NET_BufferToBufferCompress( byte *dest, uint *destLen, byte *source, uint sourceLen );
 qboolean NET_BufferToBufferDecompress( byte *dest, uint *destLen, byte *source, uint sourceLen );
 void NET_SendPacket( netsrc_t sock, size_t length, const void *data, netadr_t to );
 void NET_SendPacketEx( netsrc_t sock, size_t length, const void *data, netadr_t to, size_t splitsize );
 void NET_ClearLagData( qboolean bClient, qboolean bServer );
+void NET_ImpairInit( void );
+void NET_ImpairShutdown( void );
+qboolean NET_ImpairActive( netsrc_t sock );
+qboolean NET_ImpairPacket( qboolean newdata, netsrc_t sock, netadr_t *from, size_t *length, void *data );
+void NET_BeginBatch( netsrc_t sock );
+void NET_EndBatch( netsrc_t sock );
 
 #if !XASH_DEDICATED
 qboolean CL_LegacyMode( void );
@@ -189,18 +189,27 @@ typedef struct fragbuf_s
 	byte		frag_message_buf[NET_MAX_FRAGMENT];	// the actual data sits here
 	qboolean		isfile;				// is this a file buffer?
 	qboolean		isbuffer;				// is this file buffer from memory ( custom decal, etc. ).
-	qboolean		iscompressed;			// is compressed file, we should using filename.ztmp
-	char		filename[MAX_OSPATH];		// name of the file to save out on remote host
 	int		foffset;				// offset in file from which to read data
 	int		size;				// size of data to read at that offset
 } fragbuf_t;
 
+// file fragments that are produced one by one as channel sends them
+typedef struct fragstream_s
+{
+	struct netmap_s	*map;				// shared view of the file data
+	char		filename[MAX_OSPATH];		// name of the file to save out on remote host
+	int		chunksize;			// fragment size at the moment of creation
+	int		pos;				// next offset in file data
+	int		bufferid;				// id of the next buffer
+} fragstream_t;
+
 // Waiting list of fragbuf chains
 typedef struct fbufqueue_s
 {
 	struct fbufqueue_s	*next;		// next chain in waiting list
 	int		fragbufcount;	// number of buffers in this chain
 	fragbuf_t		*fragbufs;	// the actual buffers
+	fragstream_t	*stream;		// or source to make them from
 } fragbufwaiting_t;
 
 typedef enum fragsize_e
@@ -252,6 +261,7 @@ typedef struct netchan_s
 	uint		reliable_fragid[MAX_STREAMS];		// buffer id for each waiting fragment
 
 	fragbuf_t		*fragbufs[MAX_STREAMS];	// the current fragment being set
+	fragstream_t	*fragstream[MAX_STREAMS];	// the rest of current file, if streamed
 	int		fragbufcount[MAX_STREAMS];	// the total number of fragments in this stream
 
 	int		frag_startpos[MAX_STREAMS];	// position in outgoing buffer where frag data starts
@@ -272,10 +282,12 @@ typedef struct netchan_s
 	// added for net_speeds
 	size_t		total_sended;
 	size_t		total_received;
+	uint		retransmits;	// reliable payloads sent again
 	qboolean	split;
 	unsigned int	maxpacket;
 	unsigned int	splitid;
 	netsplit_t netsplit;
+	qboolean	deflate;		// remote side can inflate fragments
 } netchan_t;
 
 extern netadr_t		net_from;
@@ -283,6 +295,7 @@ extern netadr_t		net_local;
 extern sizebuf_t		net_message;
 extern byte		net_message_buffer[NET_MAX_MESSAGE];
 extern convar_t		*net_speeds;
+extern convar_t		*net_deflate;
 extern convar_t		sv_lan;
 extern convar_t		sv_lan_rate;
 extern int		net_drop;
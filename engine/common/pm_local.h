@@ -33,6 +33,9 @@ void Pmove_Init( void );
 void PM_InitBoxHull( void );
 hull_t *PM_HullForBsp( physent_t *pe, playermove_t *pmove, float *offset );
 qboolean PM_RecursiveHullCheck( hull_t *hull, int num, float p1f, float p2f, vec3_t p1, vec3_t p2, pmtrace_t *trace );
+void PM_PackHull( hull_t *hull, int numclipnodes, byte *mempool );
+void PM_FreePackedHulls( byte *mempool );
+void PM_TraceBench_f( void );
 pmtrace_t PM_PlayerTraceExt( playermove_t *pm, vec3_t p1, vec3_t p2, int flags, int numents, physent_t *ents, int ignore_pe, pfnIgnore pmFilter );
 int PM_TestPlayerPosition( playermove_t *pmove, vec3_t pos, pmtrace_t *ptrace, pfnIgnore pmFilter );
 int PM_HullPointContents( hull_t *hull, int num, const vec3_t p );
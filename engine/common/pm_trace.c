@@ -195,10 +195,10 @@ hull_t *PM_HullForStudio( physent_t *pe, playermove_t *pmove, int *numhitboxes )
 
 /*
 ==================
-PM_RecursiveHullCheck
+PM_RecursiveHullCheck_r
 ==================
 */
-qboolean PM_RecursiveHullCheck( hull_t *hull, int num, float p1f, float p2f, vec3_t p1, vec3_t p2, pmtrace_t *trace )
+static qboolean PM_RecursiveHullCheck_r( hull_t *hull, int num, float p1f, float p2f, vec3_t p1, vec3_t p2, pmtrace_t *trace )
 {
 	mclipnode_t	*node;
 	mplane_t		*plane;
@@ -264,14 +264,14 @@ loc0:
 	VectorLerp( p1, frac, p2, mid );
 
 	// move up to the node
-	if( !PM_RecursiveHullCheck( hull, node->children[side], p1f, midf, p1, mid, trace ))
+	if( !PM_RecursiveHullCheck_r( hull, node->children[side], p1f, midf, p1, mid, trace ))
 		return false;
 
 	// this recursion can not be optimized because mid would need to be duplicated on a stack
 	if( PM_HullPointContents( hull, node->children[side^1], mid ) != CONTENTS_SOLID )
 	{
 		// go past the node
-		return PM_RecursiveHullCheck( hull, node->children[side^1], midf, p2f, mid, p2, trace );
+		return PM_RecursiveHullCheck_r( hull, node->children[side^1], midf, p2f, mid, p2, trace );
 	}
 
 	// never got out of the solid area
@@ -313,6 +313,483 @@ loc0:
 	return false;
 }
 
+/*
+===============================================================================
+
+FLAT HULLS
+
+clipnodes and planes of static bsp hulls are packed at load time
+into one array, so trace doesn't jump between two arrays, and
+the iterative kernel keeps its own small stack of split points
+
+===============================================================================
+*/
+#define FLATHULL_HASH_SIZE	1024	// must be power of two
+#define FLATHULL_STACK	256	// deeper trees use recursive version
+
+// 32 bytes, two nodes per cache line
+typedef struct
+{
+	vec3_t		normal;
+	float		dist;
+	int		type;		// same as mplane_t, < 3 is axial
+	int		children[2];	// negative numbers are contents
+	int		pad;
+} pm_flatnode_t;
+
+typedef struct pm_flathull_s
+{
+	const mclipnode_t	*clipnodes;	// hash key
+	pm_flatnode_t	*nodes;
+	int		numnodes;
+	byte		*mempool;		// owner
+	struct pm_flathull_s	*next;
+} pm_flathull_t;
+
+// one split point in the trace
+typedef struct
+{
+	const pm_flatnode_t	*node;
+	int		side;
+	float		frac;
+	float		p1f, p2f, midf;
+	vec3_t		p1, p2, mid;
+} pm_flatstack_t;
+
+typedef struct
+{
+	hull_t		hull;		// copy, clipnodes are valid until PM_FreePackedHulls
+	int		num;
+	float		p1f, p2f;
+	vec3_t		p1, p2;
+} pm_recordtrace_t;
+
+static pm_flathull_t	*pm_flathulls[FLATHULL_HASH_SIZE];
+static int		pm_numflathulls;
+
+static struct
+{
+	pm_recordtrace_t	*traces;
+	int		numtraces;
+	int		maxtraces;	// still recording while numtraces < maxtraces
+} pm_tracebench;
+
+static uint PM_HashClipnodes( const mclipnode_t *clipnodes )
+{
+	return (uint)(((size_t)clipnodes >> 4 ) * 2654435761u ) & ( FLATHULL_HASH_SIZE - 1 );
+}
+
+/*
+==================
+PM_PackHull
+
+called by model loader for static hulls only
+==================
+*/
+void PM_PackHull( hull_t *hull, int numclipnodes, byte *mempool )
+{
+	pm_flathull_t	*flat;
+	pm_flatnode_t	*out;
+	mclipnode_t	*in;
+	mplane_t		*plane;
+	uint		hash;
+	int		i;
+
+	if( !hull->clipnodes || !hull->planes || numclipnodes <= 0 )
+		return;
+
+	flat = Mem_Calloc( mempool, sizeof( *flat ));
+	flat->nodes = out = Mem_Malloc( mempool, sizeof( *out ) * numclipnodes );
+	flat->clipnodes = hull->clipnodes;
+	flat->numnodes = numclipnodes;
+	flat->mempool = mempool;
+
+	for( i = 0, in = hull->clipnodes; i < numclipnodes; i++, in++, out++ )
+	{
+		plane = hull->planes + in->planenum;
+
+		VectorCopy( plane->normal, out->normal );
+		out->dist = plane->dist;
+		out->type = plane->type;
+		out->children[0] = in->children[0];
+		out->children[1] = in->children[1];
+		out->pad = 0;
+	}
+
+	hash = PM_HashClipnodes( hull->clipnodes );
+	flat->next = pm_flathulls[hash];
+	pm_flathulls[hash] = flat;
+	pm_numflathulls++;
+}
+
+/*
+==================
+PM_FreePackedHulls
+
+forget hulls of model that is going to be freed
+==================
+*/
+void PM_FreePackedHulls( byte *mempool )
+{
+	pm_flathull_t	**prev, *flat;
+	int		i;
+
+	for( i = 0; i < FLATHULL_HASH_SIZE; i++ )
+	{
+		for( prev = &pm_flathulls[i]; ( flat = *prev ) != NULL; )
+		{
+			if( flat->mempool == mempool )
+			{
+				*prev = flat->next;
+				pm_numflathulls--;
+			}
+			else prev = &flat->next;
+		}
+	}
+
+	// recorded hulls may be freed now
+	pm_tracebench.numtraces = pm_tracebench.maxtraces = 0;
+}
+
+/*
+==================
+PM_FindPackedHull
+
+==================
+*/
+static pm_flathull_t *PM_FindPackedHull( const hull_t *hull )
+{
+	pm_flathull_t	*flat;
+
+	if( !pm_numflathulls || !hull->clipnodes )
+		return NULL;
+
+	for( flat = pm_flathulls[PM_HashClipnodes( hull->clipnodes )]; flat; flat = flat->next )
+	{
+		if( flat->clipnodes == hull->clipnodes )
+			return flat;
+	}
+
+	return NULL;
+}
+
+/*
+==================
+PM_FlatPointContents
+
+==================
+*/
+static int PM_FlatPointContents( const pm_flathull_t *flat, int num, const vec3_t p )
+{
+	const pm_flatnode_t	*node;
+
+	while( num >= 0 )
+	{
+		node = &flat->nodes[num];
+		num = node->children[PlaneDiff( p, node ) < 0];
+	}
+
+	return num;
+}
+
+/*
+==================
+PM_FlatHullCheck
+
+same as PM_RecursiveHullCheck_r, but without recursion
+==================
+*/
+static qboolean PM_FlatHullCheck( hull_t *hull, const pm_flathull_t *flat, int num, float p1f, float p2f, vec3_t p1, vec3_t p2, pmtrace_t *trace )
+{
+	pm_flatstack_t	stack[FLATHULL_STACK];
+	const pm_flatnode_t	*node;
+	pm_flatstack_t	*top;
+	float		t1, t2, frac, midf;
+	vec3_t		mid, seg_p1, seg_p2;
+	float		start_p1f = p1f, start_p2f = p2f;
+	int		start_num = num;
+	vec3_t		start_p1, start_p2;
+	int		depth = 0;
+	int		side;
+
+	// p1 and p2 are pointing to the current segment
+	VectorCopy( p1, start_p1 );
+	VectorCopy( p2, start_p2 );
+	p1 = start_p1;
+	p2 = start_p2;
+
+	while( 1 )
+	{
+		// check for empty
+		if( num < 0 )
+		{
+			if( num != CONTENTS_SOLID )
+			{
+				trace->allsolid = false;
+				if( num == CONTENTS_EMPTY )
+					trace->inopen = true;
+				else trace->inwater = true;
+			}
+			else trace->startsolid = true;
+
+			// near side is done, continue with nearest split
+			if( !depth ) return true;
+
+			top = &stack[--depth];
+
+			if( PM_FlatPointContents( flat, top->node->children[top->side^1], top->mid ) != CONTENTS_SOLID )
+			{
+				// go past the node, popped slot stays intact until next split
+				num = top->node->children[top->side^1];
+				p1f = top->midf;
+				p2f = top->p2f;
+				p1 = top->mid;
+				p2 = top->p2;
+				continue;
+			}
+
+			// never got out of the solid area
+			if( trace->allsolid )
+				return false;
+
+			// the other side of the node is solid, this is the impact point
+			if( !top->side )
+			{
+				VectorCopy( top->node->normal, trace->plane.normal );
+				trace->plane.dist = top->node->dist;
+			}
+			else
+			{
+				VectorNegate( top->node->normal, trace->plane.normal );
+				trace->plane.dist = -top->node->dist;
+			}
+
+			frac = top->frac;
+			midf = top->midf;
+
+			while( PM_FlatPointContents( flat, hull->firstclipnode, top->mid ) == CONTENTS_SOLID )
+			{
+				// shouldn't really happen, but does occasionally
+				frac -= 0.1f;
+
+				if( frac < 0.0f )
+				{
+					trace->fraction = midf;
+					VectorCopy( top->mid, trace->endpos );
+					Con_Reportf( S_WARN "trace backed up past 0.0\n" );
+					return false;
+				}
+
+				midf = top->p1f + ( top->p2f - top->p1f ) * frac;
+				VectorLerp( top->p1, frac, top->p2, top->mid );
+			}
+
+			trace->fraction = midf;
+			VectorCopy( top->mid, trace->endpos );
+
+			return false;
+		}
+
+		if( hull->firstclipnode >= hull->lastclipnode )
+		{
+			// empty hull?
+			trace->allsolid = false;
+			trace->inopen = true;
+			return true;
+		}
+
+		if( num < hull->firstclipnode || num > hull->lastclipnode || num >= flat->numnodes )
+			Host_Error( "PM_RecursiveHullCheck: bad node number %i\n", num );
+
+		// find the point distances
+		node = &flat->nodes[num];
+
+		t1 = PlaneDiff( p1, node );
+		t2 = PlaneDiff( p2, node );
+
+		if( t1 >= 0.0f && t2 >= 0.0f )
+		{
+			num = node->children[0];
+			continue;
+		}
+
+		if( t1 < 0.0f && t2 < 0.0f )
+		{
+			num = node->children[1];
+			continue;
+		}
+
+		// too deep, restart with recursion, it sets the same flags
+		if( depth == FLATHULL_STACK )
+			return PM_RecursiveHullCheck_r( hull, start_num, start_p1f, start_p2f, start_p1, start_p2, trace );
+
+		// put the crosspoint DIST_EPSILON pixels on the near side
+		side = (t1 < 0.0f);
+
+		if( side ) frac = ( t1 + DIST_EPSILON ) / ( t1 - t2 );
+		else frac = ( t1 - DIST_EPSILON ) / ( t1 - t2 );
+
+		if( frac < 0.0f ) frac = 0.0f;
+		if( frac > 1.0f ) frac = 1.0f;
+
+		// remember the split, move up to the node
+		// NOTE: p1 or p2 may point into this slot after "go past"
+		top = &stack[depth++];
+		VectorLerp( p1, frac, p2, mid );
+		VectorCopy( p1, seg_p1 );
+		VectorCopy( p2, seg_p2 );
+		VectorCopy( seg_p1, top->p1 );
+		VectorCopy( seg_p2, top->p2 );
+		VectorCopy( mid, top->mid );
+		top->node = node;
+		top->side = side;
+		top->frac = frac;
+		top->p1f = p1f;
+		top->p2f = p2f;
+		top->midf = p1f + ( p2f - p1f ) * frac;
+
+		num = node->children[side];
+		p2f = top->midf;
+		p1 = top->p1;
+		p2 = top->mid;
+	}
+}
+
+/*
+==================
+PM_RecursiveHullCheck
+
+==================
+*/
+qboolean PM_RecursiveHullCheck( hull_t *hull, int num, float p1f, float p2f, vec3_t p1, vec3_t p2, pmtrace_t *trace )
+{
+	pm_flathull_t	*flat = PM_FindPackedHull( hull );
+
+	if( !flat ) return PM_RecursiveHullCheck_r( hull, num, p1f, p2f, p1, p2, trace );
+
+	if( pm_tracebench.numtraces < pm_tracebench.maxtraces )
+	{
+		pm_recordtrace_t	*rec = &pm_tracebench.traces[pm_tracebench.numtraces++];
+
+		rec->hull = *hull;
+		rec->num = num;
+		rec->p1f = p1f;
+		rec->p2f = p2f;
+		VectorCopy( p1, rec->p1 );
+		VectorCopy( p2, rec->p2 );
+
+		if( pm_tracebench.numtraces == pm_tracebench.maxtraces )
+			Con_Printf( "pm_trace_bench: recorded %d traces\n", pm_tracebench.numtraces );
+	}
+
+	return PM_FlatHullCheck( hull, flat, num, p1f, p2f, p1, p2, trace );
+}
+
+/*
+==================
+PM_InitBenchTrace
+
+same as SV_ClipMoveToEntity does
+==================
+*/
+static void PM_InitBenchTrace( pmtrace_t *trace, const pm_recordtrace_t *rec )
+{
+	memset( trace, 0, sizeof( *trace ));
+	VectorCopy( rec->p2, trace->endpos );
+	trace->fraction = 1.0f;
+	trace->allsolid = true;
+}
+
+/*
+==================
+PM_TraceBench_f
+
+pm_trace_bench record [count]
+pm_trace_bench [iterations]
+==================
+*/
+void PM_TraceBench_f( void )
+{
+	pm_recordtrace_t	*rec;
+	pmtrace_t		trace[2];
+	double		start, elapsed[2];
+	int		i, j, k, iterations;
+	int		numtraces = 0, mismatches = 0;
+
+	if( Cmd_Argc() > 1 && !Q_stricmp( Cmd_Argv( 1 ), "record" ))
+	{
+		if( pm_tracebench.traces )
+			Mem_Free( pm_tracebench.traces );
+
+		pm_tracebench.numtraces = 0;
+		pm_tracebench.maxtraces = Cmd_Argc() > 2 ? Q_atoi( Cmd_Argv( 2 )) : 10000;
+		pm_tracebench.maxtraces = bound( 1, pm_tracebench.maxtraces, 1000000 );
+		pm_tracebench.traces = Mem_Malloc( host.mempool, sizeof( pm_recordtrace_t ) * pm_tracebench.maxtraces );
+		Con_Printf( "pm_trace_bench: recording next %d hull traces\n", pm_tracebench.maxtraces );
+		return;
+	}
+
+	if( !pm_tracebench.numtraces )
+	{
+		Con_Printf( "No recorded traces, use \"pm_trace_bench record [count]\" on running map first\n" );
+		return;
+	}
+
+	// stop recording
+	pm_tracebench.maxtraces = pm_tracebench.numtraces;
+	iterations = Cmd_Argc() > 1 ? Q_atoi( Cmd_Argv( 1 )) : 10;
+	iterations = Q_max( iterations, 1 );
+
+	// correctness first
+	for( i = 0, rec = pm_tracebench.traces; i < pm_tracebench.numtraces; i++, rec++ )
+	{
+		pm_flathull_t	*flat = PM_FindPackedHull( &rec->hull );
+
+		if( !flat ) continue;
+
+		for( k = 0; k < 2; k++ )
+		{
+			PM_InitBenchTrace( &trace[k], rec );
+
+			if( k == 0 ) PM_RecursiveHullCheck_r( &rec->hull, rec->num, rec->p1f, rec->p2f, rec->p1, rec->p2, &trace[k] );
+			else PM_FlatHullCheck( &rec->hull, flat, rec->num, rec->p1f, rec->p2f, rec->p1, rec->p2, &trace[k] );
+		}
+
+		if( memcmp( &trace[0], &trace[1], sizeof( pmtrace_t )))
+			mismatches++;
+		numtraces++;
+	}
+
+	for( k = 0; k < 2; k++ )
+	{
+		start = Sys_DoubleTime();
+
+		for( j = 0; j < iterations; j++ )
+		{
+			for( i = 0, rec = pm_tracebench.traces; i < pm_tracebench.numtraces; i++, rec++ )
+			{
+				pm_flathull_t	*flat = PM_FindPackedHull( &rec->hull );
+
+				if( !flat ) continue;
+
+				PM_InitBenchTrace( &trace[k], rec );
+
+				if( k == 0 ) PM_RecursiveHullCheck_r( &rec->hull, rec->num, rec->p1f, rec->p2f, rec->p1, rec->p2, &trace[k] );
+				else PM_FlatHullCheck( &rec->hull, flat, rec->num, rec->p1f, rec->p2f, rec->p1, rec->p2, &trace[k] );
+			}
+		}
+
+		elapsed[k] = Sys_DoubleTime() - start;
+	}
+
+	Con_Printf( "%d traces, %d iterations, %d flat hulls\n", numtraces, iterations, pm_numflathulls );
+	Con_Printf( "recursive: %.0f traces per second\n", (double)numtraces * iterations / Q_max( elapsed[0], 0.000001 ));
+	Con_Printf( "flat: %.0f traces per second, speedup %.2fx\n", (double)numtraces * iterations / Q_max( elapsed[1], 0.000001 ), elapsed[0] / Q_max( elapsed[1], 0.000001 ));
+
+	if( mismatches ) Con_Printf( S_ERROR "%d traces differ\n", mismatches );
+	else Con_Printf( "results are identical\n" );
+}
+
 pmtrace_t PM_PlayerTraceExt( playermove_t *pmove, vec3_t start, vec3_t end, int flags, int numents, physent_t *ents, int ignore_pe, pfnIgnore pmFilter )
 {
 	physent_t	*pe;
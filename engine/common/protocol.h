@@ -301,6 +301,7 @@ extern const char	*clc_strings[clc_lastmsg+1];
 
 // FWGS extensions
 #define NET_EXT_SPLITSIZE (1U<<0) // set splitsize by cl_dlmax
+#define NET_EXT_DEFLATE (1U<<1) // fragments and downloads may be deflated
 
 // legacy protocol definitons
 #define PROTOCOL_LEGACY_VERSION		48
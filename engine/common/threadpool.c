@@ -0,0 +1,363 @@
+/*
+threadpool.c - tiny worker pool for engine-side parallel loops
+Copyright (C) 2026 Xash3D FWGS contributors
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+*/
+
+#include "common.h"
+#include "xash3d_mathlib.h"
+#include "threadpool.h"
+
+#ifdef XASH_THREADPOOL
+#if XASH_WIN32
+#include <windows.h>
+#define mutex_t		CRITICAL_SECTION
+#define thread_t		HANDLE
+#define mutex_init( x )	InitializeCriticalSection( x )
+#define mutex_free( x )	DeleteCriticalSection( x )
+#define mutex_lock( x )	EnterCriticalSection( x )
+#define mutex_unlock( x )	LeaveCriticalSection( x )
+#else // !XASH_WIN32
+#include <pthread.h>
+#define mutex_t		pthread_mutex_t
+#define thread_t		pthread_t
+#define mutex_init( x )	pthread_mutex_init( x, NULL )
+#define mutex_free( x )	pthread_mutex_destroy( x )
+#define mutex_lock( x )	pthread_mutex_lock( x )
+#define mutex_unlock( x )	pthread_mutex_unlock( x )
+#endif // !XASH_WIN32
+#endif // XASH_THREADPOOL
+
+typedef struct
+{
+	struct threadpool_s	*pool;
+	int		slot;
+} threadarg_t;
+
+struct threadpool_s
+{
+	string		name;
+	int		numthreads;	// including caller
+
+	// current job set, protected by mutex
+	pfnThreadJob	pfn;
+	void		*data;
+	int		count;
+	int		next;
+	int		pending;
+	int		generation;
+	qboolean		quit;
+
+#ifdef XASH_THREADPOOL
+	mutex_t		mutex;
+	thread_t		threads[MAX_POOL_THREADS];
+	threadarg_t	args[MAX_POOL_THREADS];
+#if XASH_WIN32
+	HANDLE		start;	// semaphore
+	HANDLE		done;	// auto-reset event
+#else
+	pthread_cond_t	start;
+	pthread_cond_t	done;
+#endif
+#endif
+};
+
+#ifdef XASH_THREADPOOL
+/*
+=================
+ThreadPool_RunJobs
+
+grab jobs of current set until nothing left
+mutex must be locked
+=================
+*/
+static void ThreadPool_RunJobs( threadpool_t *pool, int slot )
+{
+	while( pool->next < pool->count )
+	{
+		pfnThreadJob	pfn = pool->pfn;
+		void		*data = pool->data;
+		int		index = pool->next++;
+
+		mutex_unlock( &pool->mutex );
+		pfn( data, index, slot );
+		mutex_lock( &pool->mutex );
+
+		if( --pool->pending == 0 )
+		{
+#if XASH_WIN32
+			SetEvent( pool->done );
+#else
+			pthread_cond_broadcast( &pool->done );
+#endif
+		}
+	}
+}
+
+#if XASH_WIN32
+static DWORD WINAPI ThreadPool_Worker( LPVOID arg )
+#else
+static void *ThreadPool_Worker( void *arg )
+#endif
+{
+	threadarg_t	*thread = (threadarg_t *)arg;
+	threadpool_t	*pool = thread->pool;
+#if !XASH_WIN32
+	int		generation = 0;
+#endif
+
+	mutex_lock( &pool->mutex );
+
+	while( 1 )
+	{
+#if XASH_WIN32
+		mutex_unlock( &pool->mutex );
+		WaitForSingleObject( pool->start, INFINITE );
+		mutex_lock( &pool->mutex );
+#else
+		while( !pool->quit && pool->generation == generation )
+			pthread_cond_wait( &pool->start, &pool->mutex );
+		generation = pool->generation;
+#endif
+		if( pool->quit ) break;
+
+		ThreadPool_RunJobs( pool, thread->slot );
+	}
+
+	mutex_unlock( &pool->mutex );
+
+	return 0;
+}
+#endif // XASH_THREADPOOL
+
+/*
+=================
+ThreadPool_Create
+
+=================
+*/
+threadpool_t *ThreadPool_Create( const char *name, int numthreads )
+{
+	threadpool_t	*pool;
+
+	pool = Z_Calloc( sizeof( *pool ));
+	Q_strncpy( pool->name, name, sizeof( pool->name ));
+	numthreads = bound( 1, numthreads, MAX_POOL_THREADS );
+	pool->numthreads = 1;
+
+#ifdef XASH_THREADPOOL
+	mutex_init( &pool->mutex );
+#if XASH_WIN32
+	pool->start = CreateSemaphore( NULL, 0, 0x7fffffff, NULL );
+	pool->done = CreateEvent( NULL, FALSE, FALSE, NULL );
+#else
+	pthread_cond_init( &pool->start, NULL );
+	pthread_cond_init( &pool->done, NULL );
+#endif
+
+	// worker slots are 1-based, slot 0 is the calling thread
+	for( ; pool->numthreads < numthreads; pool->numthreads++ )
+	{
+		threadarg_t	*arg = &pool->args[pool->numthreads];
+
+		arg->pool = pool;
+		arg->slot = pool->numthreads;
+#if XASH_WIN32
+		pool->threads[pool->numthreads] = CreateThread( NULL, 0, ThreadPool_Worker, arg, 0, NULL );
+		if( !pool->threads[pool->numthreads] )
+			break;
+#else
+		if( pthread_create( &pool->threads[pool->numthreads], NULL, ThreadPool_Worker, arg ))
+			break;
+#endif
+	}
+
+	if( pool->numthreads != numthreads )
+		Con_Printf( S_WARN "%s: created only %d threads of %d\n", pool->name, pool->numthreads, numthreads );
+#endif // XASH_THREADPOOL
+
+	return pool;
+}
+
+/*
+=================
+ThreadPool_Destroy
+
+=================
+*/
+void ThreadPool_Destroy( threadpool_t *pool )
+{
+#ifdef XASH_THREADPOOL
+	int	i;
+#endif
+
+	if( !pool ) return;
+
+#ifdef XASH_THREADPOOL
+	mutex_lock( &pool->mutex );
+	pool->quit = true;
+#if XASH_WIN32
+	ReleaseSemaphore( pool->start, pool->numthreads, NULL );
+#else
+	pthread_cond_broadcast( &pool->start );
+#endif
+	mutex_unlock( &pool->mutex );
+
+	for( i = 1; i < pool->numthreads; i++ )
+	{
+#if XASH_WIN32
+		WaitForSingleObject( pool->threads[i], INFINITE );
+		CloseHandle( pool->threads[i] );
+#else
+		pthread_join( pool->threads[i], NULL );
+#endif
+	}
+
+#if XASH_WIN32
+	CloseHandle( pool->start );
+	CloseHandle( pool->done );
+#else
+	pthread_cond_destroy( &pool->start );
+	pthread_cond_destroy( &pool->done );
+#endif
+	mutex_free( &pool->mutex );
+#endif // XASH_THREADPOOL
+
+	Mem_Free( pool );
+}
+
+/*
+=================
+ThreadPool_NumThreads
+
+=================
+*/
+int ThreadPool_NumThreads( threadpool_t *pool )
+{
+	return pool ? pool->numthreads : 1;
+}
+
+/*
+=================
+ThreadPool_Start
+
+begin calls in background and return immediately,
+ThreadPool_Wait must be called before next job set
+=================
+*/
+void ThreadPool_Start( threadpool_t *pool, pfnThreadJob pfn, void *data, int count )
+{
+	if( !pool || count <= 0 ) return;
+
+	// one job set at a time
+	ThreadPool_Wait( pool );
+
+	if( pool->numthreads <= 1 )
+	{
+		// run everything in ThreadPool_Wait
+		pool->pfn = pfn;
+		pool->data = data;
+		pool->count = count;
+		pool->next = 0;
+		pool->pending = count;
+		return;
+	}
+
+#ifdef XASH_THREADPOOL
+	mutex_lock( &pool->mutex );
+	pool->pfn = pfn;
+	pool->data = data;
+	pool->count = count;
+	pool->next = 0;
+	pool->pending = count;
+	pool->generation++;
+#if XASH_WIN32
+	ResetEvent( pool->done );
+	ReleaseSemaphore( pool->start, Q_min( count, pool->numthreads - 1 ), NULL );
+#else
+	pthread_cond_broadcast( &pool->start );
+#endif
+	mutex_unlock( &pool->mutex );
+#endif // XASH_THREADPOOL
+}
+
+/*
+=================
+ThreadPool_Wait
+
+calling thread helps to finish current job set
+=================
+*/
+void ThreadPool_Wait( threadpool_t *pool )
+{
+	if( !pool || pool->count <= 0 ) return;
+
+	if( pool->numthreads <= 1 )
+	{
+		while( pool->next < pool->count )
+		{
+			int	index = pool->next++;
+
+			pool->pfn( pool->data, index, 0 );
+		}
+
+		pool->count = pool->next = pool->pending = 0;
+		return;
+	}
+
+#ifdef XASH_THREADPOOL
+	mutex_lock( &pool->mutex );
+
+	ThreadPool_RunJobs( pool, 0 );
+
+	while( pool->pending > 0 )
+	{
+#if XASH_WIN32
+		mutex_unlock( &pool->mutex );
+		WaitForSingleObject( pool->done, INFINITE );
+		mutex_lock( &pool->mutex );
+#else
+		pthread_cond_wait( &pool->done, &pool->mutex );
+#endif
+	}
+
+	// nothing to grab until next call
+	pool->count = 0;
+	pool->next = 0;
+	mutex_unlock( &pool->mutex );
+#endif // XASH_THREADPOOL
+}
+
+/*
+=================
+ThreadPool_ParallelFor
+
+calling thread takes part in the work,
+so the loop is never slower than serial one
+=================
+*/
+void ThreadPool_ParallelFor( threadpool_t *pool, pfnThreadJob pfn, void *data, int count )
+{
+	int	i;
+
+	if( count <= 0 ) return;
+
+	if( !pool || pool->numthreads <= 1 || count == 1 )
+	{
+		for( i = 0; i < count; i++ )
+			pfn( data, i, 0 );
+		return;
+	}
+
+	ThreadPool_Start( pool, pfn, data, count );
+	ThreadPool_Wait( pool );
+}
@@ -0,0 +1,42 @@
+/*
+threadpool.h - tiny worker pool for engine-side parallel loops
+Copyright (C) 2026 Xash3D FWGS contributors
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+*/
+
+#ifndef THREADPOOL_H
+#define THREADPOOL_H
+
+// same restrictions as for asynchronous name resolve
+#if !defined XASH_NO_ASYNC_NS_RESOLVE && ( XASH_WIN32 || !( XASH_EMSCRIPTEN || XASH_DOS4GW ))
+#define XASH_THREADPOOL
+#endif
+
+#define MAX_POOL_THREADS	32
+
+typedef struct threadpool_s threadpool_t;
+typedef void (*pfnThreadJob)( void *data, int index, int thread );	// thread is in [0, numthreads)
+
+// numthreads counts the calling thread too, so 1 means "run everything serially"
+threadpool_t *ThreadPool_Create( const char *name, int numthreads );
+void ThreadPool_Destroy( threadpool_t *pool );
+int ThreadPool_NumThreads( threadpool_t *pool );
+
+// calls pfn( data, i, thread ) for i in [0, count) and returns when all calls are finished
+void ThreadPool_ParallelFor( threadpool_t *pool, pfnThreadJob pfn, void *data, int count );
+
+// same calls in background, ThreadPool_Wait finishes them with help of calling thread
+// without worker threads everything is done in ThreadPool_Wait
+void ThreadPool_Start( threadpool_t *pool, pfnThreadJob pfn, void *data, int count );
+void ThreadPool_Wait( threadpool_t *pool );
+
+#endif//THREADPOOL_H
@@ -33,6 +33,13 @@ ENTITY AREA CHECKING
 #define AREA_NODES			32
 #define AREA_DEPTH			4
 
+// adaptive tree grows from the fixed one by splitting crowded leafs
+#define AREA_MAX_NODES		1024
+#define AREA_MAX_DEPTH		12
+#define AREA_SPLIT_COUNT		16		// split leafs with more entities than this
+#define AREA_MERGE_COUNT		( AREA_SPLIT_COUNT / 2 )	// merge split leafs back when they have this or less
+#define AREA_MIN_SIZE		64.0f		// don't split smaller leafs
+
 #include "lightstyle.h"
 
 extern const char		*et_name[];
@@ -55,6 +55,8 @@ typedef struct mempool_s
 } mempool_t;
 
 mempool_t *poolchain = NULL; // critical stuff
+static size_t mem_numallocs;	// never decremented, for benchmarks
+static size_t mem_allocbytes;
 
 void *_Mem_Alloc( byte *poolptr, size_t size, qboolean clear, const char *filename, int fileline )
 {
@@ -64,6 +66,8 @@ void *_Mem_Alloc( byte *poolptr, size_t size, qboolean clear, const char *filena
 	if( size <= 0 ) return NULL;
 	if( poolptr == NULL ) Sys_Error( "Mem_Alloc: pool == NULL (alloc at %s:%i)\n", filename, fileline );
 	pool->totalsize += size;
+	mem_numallocs++;
+	mem_allocbytes += size;
 
 	// big allocations are not clumped
 	pool->realsize += sizeof( memheader_t ) + size + sizeof( int );
@@ -321,6 +325,12 @@ void Mem_PrintStats( void )
 	Con_Printf( "total allocated size: ^1%s\n", Q_memprint( realsize ));
 }
 
+void Mem_GetAllocStats( size_t *numallocs, size_t *numbytes )
+{
+	if( numallocs ) *numallocs = mem_numallocs;
+	if( numbytes ) *numbytes = mem_allocbytes;
+}
+
 void Mem_PrintList( size_t minallocationsize )
 {
 	mempool_t		*pool;
@@ -16,7 +16,11 @@ GNU General Public License for more details.
 #ifndef PHYSINT_H
 #define PHYSINT_H
 
-#define SV_PHYSICS_INTERFACE_VERSION	6
+#define SV_PHYSICS_INTERFACE_VERSION	7
+#define SV_PHYSICS_INTERFACE_VERSION_OLD	6	// before SV_EntityPriority, still accepted
+
+// game dll must copy no more than this for the requested version
+#define SV_PHYSICS_INTERFACE_SIZE( ver )	(( ver ) >= 7 ? sizeof( physics_interface_t ) : offsetof( physics_interface_t, SV_EntityPriority ))
 
 #define STRUCT_FROM_LINK( l, t, m )	((t *)((byte *)l - (int)&(((t *)0)->m)))
 #define EDICT_FROM_AREA( l )		STRUCT_FROM_LINK( l, edict_t, area )
@@ -159,6 +163,8 @@ typedef struct physics_interface_s
 	void		*(*SV_HullForBsp)( edict_t *ent, const float *mins, const float *maxs, float *offset );
 	// handle player custom think function
 	int		(*SV_PlayerThink)( edict_t *ent, float frametime, double time );
+	// snapshot priority scale of entity for this client, 1.0 is default, zero or less will never hold it back
+	float		(*SV_EntityPriority)( edict_t *ent, edict_t *client );
 } physics_interface_t;
 
 #endif//PHYSINT_H
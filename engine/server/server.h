@@ -201,6 +201,23 @@ typedef struct
 	int  		first_entity;		// into the circular sv_packet_entities[]
 } client_frame_t;
 
+// snapshot scheduler state of single entity
+typedef struct
+{
+	float		accum;			// priority gathered while held back
+	double		waitstart;		// when entity got held back, 0 if it's up to date
+} sv_entprio_t;
+
+typedef struct
+{
+	int		budget;			// bits available for entities in last snapshot
+	int		changed;			// entities that need an update
+	int		deferred;			// held back in last snapshot
+	uint		total_deferred;
+	uint		total_starved;		// sent only because of sv_entity_maxdelay
+	float		maxdelay;			// longest time entity was held back
+} sv_snapstats_t;
+
 typedef struct sv_client_s
 {
 	cl_state_t	state;
@@ -253,6 +270,9 @@ typedef struct sv_client_s
 
 	client_frame_t	*frames;			// updates can be delta'd from here
 	event_state_t	events;			// delta-updated events cycle
+	sv_entprio_t	*entprio;			// [GI->max_edicts], allocated by snapshot scheduler
+	sv_snapstats_t	snapstats;
+	struct sv_netstats_s *netstats;		// per message traffic counters, allocated when sv_netstats is enabled
 
 	int		challenge;		// challenge of this user, randomly generated
 	int		userid;			// identifying number on server
@@ -347,6 +367,10 @@ typedef struct
 
 	byte		*mempool;			// server premamnent pool: edicts etc
 	byte		*stringspool;		// for engine strings
+
+	struct findindex_s	*findindex;		// string fields lookup index, allocated from mempool
+	struct querygrid_s	*querygrid;		// spatial index for sphere and pvs queries
+	struct leafindex_s	*leafindex;		// pvs cluster to entities index
 } svgame_static_t;
 
 typedef struct
@@ -393,6 +417,23 @@ extern convar_t		sv_unlagsamples;
 extern convar_t		rcon_password;
 extern convar_t		sv_instancedbaseline;
 extern convar_t		sv_background_freeze;
+extern convar_t		sv_encode_threads;
+extern convar_t		sv_entity_priority;
+extern convar_t		sv_entity_maxdelay;
+extern convar_t		sv_entity_prio_dist;
+extern convar_t		sv_delta_cache;
+extern convar_t		sv_netstats_log;
+extern convar_t		sv_netstats_format;
+extern convar_t		sv_query_cache;
+extern convar_t		sv_query_rate;
+extern convar_t		sv_query_burst;
+extern convar_t		sv_query_rate_total;
+extern convar_t		sv_query_challenge;
+extern convar_t		sv_area_adaptive;
+extern convar_t		sv_find_index;
+extern convar_t		sv_spatial_query;
+extern convar_t		sv_leaf_index;
+extern convar_t		sv_fps;
 extern convar_t		sv_minupdaterate;
 extern convar_t		sv_maxupdaterate;
 extern convar_t		sv_downloadurl;
@@ -579,6 +620,13 @@ void SV_WriteFrameToClient( sv_client_t *client, sizebuf_t *msg );
 void SV_BuildClientFrame( sv_client_t *client );
 void SV_SendMessagesToAll( void );
 void SV_SkipUpdates( void );
+void SV_FreeEncodeJobs( void );
+void SV_EncodeBench_f( void );
+int SV_BuildFakeClientDatagram( sv_client_t *cl );
+void SV_DeltaCacheStats_f( void );
+void SV_DeltaBench_f( void );
+void SV_EntityStats_f( void );
+void SV_FreeEntityPriority( sv_client_t *cl );
 
 //
 // sv_game.c
@@ -595,6 +643,11 @@ void SV_CopyTraceToGlobal( trace_t *trace );
 qboolean SV_CheckEdict( const edict_t *e, const char *file, const int line );
 void SV_SetMinMaxSize( edict_t *e, const float *min, const float *max, qboolean relink );
 edict_t* SV_FindEntityByString( edict_t *pStartEdict, const char *pszField, const char *pszValue );
+void SV_RelinkFindIndex( edict_t *ed );
+void SV_InvalidateFindIndex( void );
+void SV_FindIndexStats_f( void );
+edict_t *pfnFindEntityInSphere( edict_t *pStartEdict, const float *org, float flRadius );
+void pfnRunPlayerMove( edict_t *pClient, const float *viewangles, float fmove, float smove, float upmove, word buttons, byte impulse, byte msec );
 void SV_PlaybackEventFull( int flags, const edict_t *pInvoker, word eventindex, float delay, float *origin,
 	float *angles, float fparam1, float fparam2, int iparam1, int iparam2, int bparam1, int bparam2 );
 void SV_PlaybackReliableEvent( sizebuf_t *msg, word eventindex, float delay, event_args_t *args );
@@ -665,6 +718,15 @@ qboolean SV_PlayerIsFrozen( edict_t *pClient );
 // sv_world.c
 //
 void SV_ClearWorld( void );
+void SV_UpdateAreaNodes( void );
+void SV_RebuildAreaNodes( qboolean adaptive );
+void SV_AreaBench_f( void );
+void SV_SphereBench_f( void );
+void SV_InitQueryEdict( edict_t *ent );
+void SV_RemoveQueryEdict( edict_t *ent );
+qboolean SV_QueryEntityInSphere( edict_t *pStartEdict, const float *org, float flRadius, edict_t **result );
+qboolean SV_QueryEntitiesInPVS( edict_t *pview, edict_t **result );
+qboolean SV_VisibleEntities( const byte *pvs, uint *visible );
 void SV_UnlinkEdict( edict_t *ent );
 void SV_ClipMoveToEntity( edict_t *ent, const vec3_t start, vec3_t mins, vec3_t maxs, const vec3_t end, trace_t *trace );
 void SV_CustomClipMoveToEntity( edict_t *ent, const vec3_t start, vec3_t mins, vec3_t maxs, const vec3_t end, trace_t *trace );
@@ -685,4 +747,58 @@ const char *SV_GetLightStyle( int style );
 int SV_LightForEntity( edict_t *pEdict );
 void SV_ClearPhysEnts( void );
 
+//
+// sv_profile.c
+//
+extern qboolean sv_profiling;
+void SV_ProfileBegin( const char *name );
+void SV_ProfileEnd( void );
+void SV_ProfileBeginFrame( void );
+void SV_ProfileEndFrame( void );
+void SV_ProfileShutdown( void );
+void SV_Profile_f( void );
+void SV_LoadBench_f( void );
+
+// scope names must be string literals
+#define SV_PROFILE_BEGIN( name )	( sv_profiling ? SV_ProfileBegin( name ) : (void)0 )
+#define SV_PROFILE_END()		( sv_profiling ? SV_ProfileEnd() : (void)0 )
+
+//
+// sv_netstats.c
+//
+void SV_NetStatsMessage( sv_client_t *cl, int cmd, int bits );
+void SV_NetStatsFields( sv_client_t *cl, int table, const int *fieldbits, int numfields );
+void SV_NetStatsShared( sv_client_t *cl, int bits );
+void SV_NetStatsSignon( sv_client_t *cl, int bits );
+void SV_NetStatsFrame( void );
+void SV_FreeNetStats( sv_client_t *cl );
+void SV_NetStatsShutdown( void );
+void SV_NetStats_f( void );
+
+// cmd is svc_* or user message number
+#define SV_NETSTATS( cl, cmd, bits )	( (cl)->netstats ? SV_NetStatsMessage( cl, cmd, bits ) : (void)0 )
+
+// for messages written straight into cl->netchan.message, startbit is taken before MSG_BeginServerCmd
+#define SV_NETSTATS_SINCE( cl, cmd, startbit )	SV_NETSTATS( cl, cmd, MSG_GetNumBitsWritten( &(cl)->netchan.message ) - ( startbit ))
+
+//
+// sv_query.c
+//
+enum
+{
+	QUERY_INFO = 0,
+	QUERY_TSOURCE,
+	QUERY_PLAYERS,
+	QUERY_DETAILS,
+	QUERY_CACHED
+};
+
+qboolean SV_QueryAllowed( netadr_t from );
+qboolean SV_QueryChallenge( netadr_t from, sizebuf_t *msg );
+const byte *SV_GetCachedQuery( int type, int *size );
+void SV_CacheQuery( int type, const void *data, int size );
+void SV_InvalidateQueryCache( void );
+void SV_QueryStats_f( void );
+void SV_QueryBench_f( void );
+
 #endif//SERVER_H
@@ -162,11 +162,15 @@ tell the client about this problem
 */
 void SV_FailDownload( sv_client_t *cl, const char *filename )
 {
+	int	startbit;
+
 	if( !COM_CheckString( filename ))
 		return;
 
+	startbit = MSG_GetNumBitsWritten( &cl->netchan.message );
 	MSG_BeginServerCmd( &cl->netchan.message, svc_filetxferfailed );
 	MSG_WriteString( &cl->netchan.message, filename );
+	SV_NETSTATS_SINCE( cl, svc_filetxferfailed, startbit );
 }
 
 /*
@@ -393,9 +397,14 @@ void SV_ConnectClient( netadr_t from )
 	newcl->challenge = challenge; // save challenge for checksumming
 	if( newcl->frames ) Mem_Free( newcl->frames );
 	newcl->frames = (client_frame_t *)Z_Calloc( sizeof( client_frame_t ) * SV_UPDATE_BACKUP );
+	SV_FreeEntityPriority( newcl );
+	SV_FreeNetStats( newcl );
 	newcl->userid = g_userid++;	// create unique userid
 	newcl->state = cs_connected;
-	newcl->extensions = extensions & (NET_EXT_SPLITSIZE);
+	newcl->extensions = extensions & (NET_EXT_SPLITSIZE|NET_EXT_DEFLATE);
+
+	if( net_deflate->value <= 0.0f )
+		ClearBits( newcl->extensions, NET_EXT_DEFLATE );
 
 	// reset viewentities (from previous level)
 	memset( newcl->viewentity, 0, sizeof( newcl->viewentity ));
@@ -404,6 +413,7 @@ void SV_ConnectClient( netadr_t from )
 
 	// initailize netchan
 	Netchan_Setup( NS_SERVER, &newcl->netchan, from, qport, newcl, SV_GetFragmentSize );
+	newcl->netchan.deflate = FBitSet( newcl->extensions, NET_EXT_DEFLATE ) ? true : false;
 	MSG_Init( &newcl->datagram, "Datagram", newcl->datagram_buf, sizeof( newcl->datagram_buf )); // datagram buf
 
 	Q_strncpy( newcl->hashedcdkey, Info_ValueForKey( protinfo, "uuid" ), 32 );
@@ -496,6 +506,8 @@ edict_t *SV_FakeConnect( const char *netname )
 	sv.current_client = cl;
 
 	if( cl->frames ) Mem_Free( cl->frames );	// fakeclients doesn't have frames
+	SV_FreeEntityPriority( cl );
+	SV_FreeNetStats( cl );
 	memset( cl, 0, sizeof( sv_client_t ));
 
 	cl->edict = EDICT_NUM( (cl - svs.clients) + 1 );
@@ -542,12 +554,15 @@ void SV_DropClient( sv_client_t *cl, qboolean crash )
 	if( cl->state == cs_zombie )
 		return;	// already dropped
 
+	SV_InvalidateQueryCache();
+
 	if( !crash )
 	{
 		// add the disconnect
 		if( !FBitSet( cl->flags, FCL_FAKECLIENT ) )
 		{
 			MSG_BeginServerCmd( &cl->netchan.message, svc_disconnect );
+			SV_NETSTATS( cl, svc_disconnect, 8 );
 		}
 
 		if( cl->edict && cl->state == cs_spawned )
@@ -569,6 +584,8 @@ void SV_DropClient( sv_client_t *cl, qboolean crash )
 	if( cl->frames )
 		Mem_Free( cl->frames ); // release delta
 	cl->frames = NULL;
+	SV_FreeEntityPriority( cl );
+	SV_FreeNetStats( cl );
 
 	if( NET_CompareBaseAdr( cl->netchan.remote_address, host.rd.address ))
 		SV_EndRedirect();
@@ -623,6 +640,8 @@ void SV_BeginRedirect( netadr_t adr, int target, char *buffer, int buffersize, v
 
 void SV_FlushRedirect( netadr_t adr, int dest, char *buf )
 {
+	int	startbit;
+
 	if( sv.current_client && FBitSet( sv.current_client->flags, FCL_FAKECLIENT ))
 		return;
 
@@ -633,8 +652,10 @@ void SV_FlushRedirect( netadr_t adr, int dest, char *buf )
 		break;
 	case RD_CLIENT:
 		if( !sv.current_client ) return; // client not set
+		startbit = MSG_GetNumBitsWritten( &sv.current_client->netchan.message );
 		MSG_BeginServerCmd( &sv.current_client->netchan.message, svc_print );
 		MSG_WriteString( &sv.current_client->netchan.message, buf );
+		SV_NETSTATS_SINCE( sv.current_client, svc_print, startbit );
 		break;
 	case RD_NONE:
 		Con_Printf( S_ERROR "SV_FlushRedirect: %s: invalid destination\n", NET_AdrToString( adr ));
@@ -798,8 +819,10 @@ The second parameter should be the current protocol version number.
 void SV_Info( netadr_t from )
 {
 	char	string[MAX_INFO_STRING];
+	char	answer[MAX_INFO_STRING + 8];
+	const byte	*cached;
 	int	i, count = 0;
-	int	version;
+	int	version, size;
 
 	// ignore in single player
 	if( svs.maxclients == 1 || !svs.initialized )
@@ -811,6 +834,11 @@ void SV_Info( netadr_t from )
 	if( version != PROTOCOL_VERSION )
 	{
 		Q_snprintf( string, sizeof( string ), "%s: wrong version\n", hostname.string );
+		Netchan_OutOfBandPrint( NS_SERVER, from, "info\n%s", string );
+	}
+	else if(( cached = SV_GetCachedQuery( QUERY_INFO, &size )) != NULL )
+	{
+		Netchan_OutOfBand( NS_SERVER, from, size, (byte *)cached );
 	}
 	else
 	{
@@ -826,9 +854,11 @@ void SV_Info( netadr_t from )
 		Info_SetValueForKey( string, "numcl", va( "%i", count ), MAX_INFO_STRING );
 		Info_SetValueForKey( string, "maxcl", va( "%i", svs.maxclients ), MAX_INFO_STRING );
 		Info_SetValueForKey( string, "gamedir", GI->gamefolder, MAX_INFO_STRING );
-	}
 
-	Netchan_OutOfBandPrint( NS_SERVER, from, "info\n%s", string );
+		size = Q_snprintf( answer, sizeof( answer ), "info\n%s", string );
+		SV_CacheQuery( QUERY_INFO, answer, size );
+		Netchan_OutOfBand( NS_SERVER, from, size, (byte *)answer );
+	}
 }
 
 /*
@@ -842,7 +872,8 @@ void SV_BuildNetAnswer( netadr_t from )
 {
 	char	string[MAX_INFO_STRING];
 	int	version, context, type;
-	int	i, count = 0;
+	int	i, count = 0, size;
+	const byte	*cached;
 
 	// ignore in single player
 	if( svs.maxclients == 1 || !svs.initialized )
@@ -874,6 +905,12 @@ void SV_BuildNetAnswer( netadr_t from )
 	}
 	else if( type == NETAPI_REQUEST_PLAYERS )
 	{
+		if(( cached = SV_GetCachedQuery( QUERY_PLAYERS, &size )) != NULL )
+		{
+			Netchan_OutOfBandPrint( NS_SERVER, from, "netinfo %i %i %s\n", context, type, (const char *)cached );
+			return;
+		}
+
 		string[0] = '\0';
 
 		for( i = 0; i < svs.maxclients; i++ )
@@ -888,10 +925,17 @@ void SV_BuildNetAnswer( netadr_t from )
 		}
 
 		// send playernames
+		SV_CacheQuery( QUERY_PLAYERS, string, Q_strlen( string ) + 1 );
 		Netchan_OutOfBandPrint( NS_SERVER, from, "netinfo %i %i %s\n", context, type, string );
 	}
 	else if( type == NETAPI_REQUEST_DETAILS )
 	{
+		if(( cached = SV_GetCachedQuery( QUERY_DETAILS, &size )) != NULL )
+		{
+			Netchan_OutOfBandPrint( NS_SERVER, from, "netinfo %i %i %s\n", context, type, (const char *)cached );
+			return;
+		}
+
 		for( i = 0; i < svs.maxclients; i++ )
 			if( svs.clients[i].state >= cs_connected )
 				count++;
@@ -904,6 +948,7 @@ void SV_BuildNetAnswer( netadr_t from )
 		Info_SetValueForKey( string, "map", sv.name, MAX_INFO_STRING );
 
 		// send serverinfo
+		SV_CacheQuery( QUERY_DETAILS, string, Q_strlen( string ) + 1 );
 		Netchan_OutOfBandPrint( NS_SERVER, from, "netinfo %i %i %s\n", context, type, string );
 	}
 	else
@@ -1326,6 +1371,7 @@ void SV_PutClientInServer( sv_client_t *cl )
 		// fisrt entering
 		svgame.globals->time = sv.time;
 		svgame.dllFuncs.pfnClientPutInServer( ent );
+		SV_RelinkFindIndex( ent );
 
 		if( sv.background )	// don't attack player in background mode
 			SetBits( ent->v.flags, FL_GODMODE|FL_NOTARGET );
@@ -1382,6 +1428,7 @@ void SV_PutClientInServer( sv_client_t *cl )
 			// send initialization data
 			Netchan_CreateFragments( &cl->netchan, &msg );
 			Netchan_FragSend( &cl->netchan );
+			SV_NetStatsSignon( cl, MSG_GetNumBitsWritten( &msg ));
 		}
 	}
 }
@@ -1403,6 +1450,7 @@ void SV_UpdateClientView( sv_client_t *cl )
 
 	MSG_BeginServerCmd( &cl->netchan.message, svc_setview );
 	MSG_WriteWord( &cl->netchan.message, viewEnt );
+	SV_NETSTATS( cl, svc_setview, 8 + 16 );
 }
 
 /*
@@ -1590,6 +1638,7 @@ static qboolean SV_New_f( sv_client_t *cl )
 
 	Netchan_CreateFragments( &cl->netchan, &msg );
 	Netchan_FragSend( &cl->netchan );
+	SV_NetStatsSignon( cl, MSG_GetNumBitsWritten( &msg ));
 
 	return true;
 }
@@ -1722,6 +1771,9 @@ void SV_UserinfoChanged( sv_client_t *cl )
 		}
 	}
 
+	// name or player count is changed
+	SV_InvalidateQueryCache();
+
 	// rate command
 	val = Info_ValueForKey( cl->userinfo, "rate" );
 	if( COM_CheckString( val ) )
@@ -1903,6 +1955,7 @@ static qboolean SV_SendRes_f( sv_client_t *cl )
 
 	Netchan_CreateFragments( &cl->netchan, &msg );
 	Netchan_FragSend( &cl->netchan );
+	SV_NetStatsSignon( cl, MSG_GetNumBitsWritten( &msg ));
 
 	return true;
 }
@@ -2128,14 +2181,24 @@ void SV_ExecuteClientCommand( sv_client_t *cl, char *s )
 SV_TSourceEngineQuery
 ==================
 */
-void SV_TSourceEngineQuery( netadr_t from )
+void SV_TSourceEngineQuery( netadr_t from, sizebuf_t *msg )
 {
 	// A2S_INFO
 	char	answer[1024] = "";
 	int	count = 0, bots = 0;
-	int	index;
+	int	index, size;
+	const byte	*cached;
 	sizebuf_t	buf;
 
+	if( !SV_QueryChallenge( from, msg ))
+		return;
+
+	if(( cached = SV_GetCachedQuery( QUERY_TSOURCE, &size )) != NULL )
+	{
+		NET_SendPacket( NS_SERVER, size, cached, from );
+		return;
+	}
+
 	if( svs.clients )
 	{
 		for( index = 0; index < svs.maxclients; index++ )
@@ -2185,6 +2248,7 @@ void SV_TSourceEngineQuery( netadr_t from )
 	MSG_WriteByte( &buf, GI->secure ); // unsecure
 	MSG_WriteByte( &buf, bots );
 
+	SV_CacheQuery( QUERY_TSOURCE, MSG_GetData( &buf ), MSG_GetNumBytesWritten( &buf ));
 	NET_SendPacket( NS_SERVER, MSG_GetNumBytesWritten( &buf ), MSG_GetData( &buf ), from );
 }
 
@@ -2218,6 +2282,14 @@ void SV_ConnectionlessPacket( netadr_t from, sizebuf_t *msg )
 	pcmd = Cmd_Argv( 0 );
 	Con_Reportf( "SV_ConnectionlessPacket: %s : %s\n", NET_AdrToString( from ), pcmd );
 
+	// only cheap to forge and costly to answer queries are limited
+	if( !Q_strcmp( pcmd, "ping" ) || !Q_strcmp( pcmd, "info" ) || !Q_strcmp( pcmd, "netinfo" )
+		|| !Q_strcmp( pcmd, "T" "Source" ) || !Q_strcmp( pcmd, "i" ))
+	{
+		if( !SV_QueryAllowed( from ))
+			return;
+	}
+
 	if( !Q_strcmp( pcmd, "ping" )) SV_Ping( from );
 	else if( !Q_strcmp( pcmd, "ack" )) SV_Ack( from );
 	else if( !Q_strcmp( pcmd, "info" )) SV_Info( from );
@@ -2227,7 +2299,7 @@ void SV_ConnectionlessPacket( netadr_t from, sizebuf_t *msg )
 	else if( !Q_strcmp( pcmd, "rcon" )) SV_RemoteCommand( from, msg );
 	else if( !Q_strcmp( pcmd, "netinfo" )) SV_BuildNetAnswer( from );
 	else if( !Q_strcmp( pcmd, "s" )) SV_AddToMaster( from, msg );
-	else if( !Q_strcmp( pcmd, "T" "Source" )) SV_TSourceEngineQuery( from );
+	else if( !Q_strcmp( pcmd, "T" "Source" )) SV_TSourceEngineQuery( from, msg );
 	else if( !Q_strcmp( pcmd, "i" )) NET_SendPacket( NS_SERVER, 5, "\xFF\xFF\xFF\xFFj", from ); // A2A_PING
 	else if( svgame.dllFuncs.pfnConnectionlessPacket( &from, args, buf, &len ))
 	{
@@ -2518,7 +2590,8 @@ void SV_ExecuteClientMessage( sv_client_t *cl, sizebuf_t *msg )
 	frame = &cl->frames[cl->netchan.incoming_acknowledged & SV_UPDATE_MASK];
 
 	// ping time doesn't factor in message interval, either
-	frame->ping_time = host.realtime - frame->senttime - cl->cl_updaterate;
+	// and time packet was waiting in the network thread queue
+	frame->ping_time = host.realtime - NET_GetPacketDelay() - frame->senttime - cl->cl_updaterate;
 
 	// on first frame ( no senttime ) don't skew ping
 	if( frame->senttime == 0.0f ) frame->ping_time = 0.0f;
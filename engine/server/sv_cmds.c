@@ -29,6 +29,7 @@ void SV_ClientPrintf( sv_client_t *cl, char *fmt, ... )
 {
 	char	string[MAX_SYSPATH];
 	va_list	argptr;
+	int	startbit;
 
 	if( FBitSet( cl->flags, FCL_FAKECLIENT ))
 		return;
@@ -37,8 +38,10 @@ void SV_ClientPrintf( sv_client_t *cl, char *fmt, ... )
 	Q_vsprintf( string, fmt, argptr );
 	va_end( argptr );
 
+	startbit = MSG_GetNumBitsWritten( &cl->netchan.message );
 	MSG_BeginServerCmd( &cl->netchan.message, svc_print );
 	MSG_WriteString( &cl->netchan.message, string );
+	SV_NETSTATS_SINCE( cl, svc_print, startbit );
 }
 
 /*
@@ -53,7 +56,7 @@ void SV_BroadcastPrintf( sv_client_t *ignore, char *fmt, ... )
 	char		string[MAX_SYSPATH];
 	va_list		argptr;
 	sv_client_t	*cl;
-	int		i;
+	int		i, startbit;
 
 	va_start( argptr, fmt );
 	Q_vsprintf( string, fmt, argptr );
@@ -69,8 +72,10 @@ void SV_BroadcastPrintf( sv_client_t *ignore, char *fmt, ... )
 			if( cl == ignore || cl->state != cs_spawned )
 				continue;
 
+			startbit = MSG_GetNumBitsWritten( &cl->netchan.message );
 			MSG_BeginServerCmd( &cl->netchan.message, svc_print );
 			MSG_WriteString( &cl->netchan.message, string );
+			SV_NETSTATS_SINCE( cl, svc_print, startbit );
 		}
 	}
 
@@ -978,6 +983,21 @@ void SV_InitOperatorCommands( void )
 	Cmd_AddCommand( "shutdownserver", SV_KillServer_f, "shutdown current server" );
 	Cmd_AddCommand( "changelevel", SV_ChangeLevel_f, "change level" );
 	Cmd_AddCommand( "changelevel2", SV_ChangeLevel2_f, "smooth change level" );
+	Cmd_AddCommand( "sv_encode_bench", SV_EncodeBench_f, "measure client datagram encoding time with 1..N threads and check packets against serial encoder" );
+	Cmd_AddCommand( "sv_deltacache_stats", SV_DeltaCacheStats_f, "print entity delta cache hits and misses, 'reset' to clear counters" );
+	Cmd_AddCommand( "sv_entity_stats", SV_EntityStats_f, "print snapshot scheduler counters for each client, 'reset' to clear them" );
+	Cmd_AddCommand( "sv_delta_bench", SV_DeltaBench_f, "compare scalar and vectorized delta field comparison on recorded entity states" );
+	Cmd_AddCommand( "sv_find_stats", SV_FindIndexStats_f, "print entity lookup index hits and fallbacks, 'reset' to clear counters" );
+	Cmd_AddCommand( "sv_area_bench", SV_AreaBench_f, "record server traces and replay them with fixed and adaptive areanode trees" );
+	Cmd_AddCommand( "sv_profile", SV_Profile_f, "server frame profiler: on, off, reset, trace <file.json> [frames], or print the last frames" );
+	Cmd_AddCommand( "sv_loadbench", SV_LoadBench_f, "connect seeded bots and run server ticks as fast as possible on the loaded game and map" );
+	Cmd_AddCommand( "sv_query_stats", SV_QueryStats_f, "print server query cache and rate limit counters, 'reset' to clear them" );
+	Cmd_AddCommand( "sv_query_bench", SV_QueryBench_f, "flood query responder from loopback addresses and print answers per second" );
+	Cmd_AddCommand( "sv_netstats", SV_NetStats_f, "count bytes sent to clients by message type and entity field: on, off, reset, all, <slot> or <name>" );
+	Cmd_AddCommand( "sv_sphere_bench", SV_SphereBench_f, "spawn entities and compare radius queries with and without entity grid" );
+#ifdef XASH_64BIT
+	Cmd_AddCommand( "str64stats", SV_PrintStr64Stats_f, "print 64 bit string pool, string hash and map spawn statistics" );
+#endif
 
 	if( host.type == HOST_NORMAL )
 	{
@@ -1012,6 +1032,20 @@ void SV_KillOperatorCommands( void )
 	Cmd_RemoveCommand( "shutdownserver" );
 	Cmd_RemoveCommand( "changelevel" );
 	Cmd_RemoveCommand( "changelevel2" );
+	Cmd_RemoveCommand( "sv_encode_bench" );
+	Cmd_RemoveCommand( "sv_deltacache_stats" );
+	Cmd_RemoveCommand( "sv_delta_bench" );
+	Cmd_RemoveCommand( "sv_find_stats" );
+	Cmd_RemoveCommand( "sv_area_bench" );
+	Cmd_RemoveCommand( "sv_sphere_bench" );
+	Cmd_RemoveCommand( "sv_profile" );
+	Cmd_RemoveCommand( "sv_loadbench" );
+	Cmd_RemoveCommand( "sv_netstats" );
+	Cmd_RemoveCommand( "sv_query_stats" );
+	Cmd_RemoveCommand( "sv_query_bench" );
+#ifdef XASH_64BIT
+	Cmd_RemoveCommand( "str64stats" );
+#endif
 
 	if( host.type == HOST_NORMAL )
 	{
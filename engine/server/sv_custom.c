@@ -337,6 +337,8 @@ void SV_AddToResourceList( resource_t *pResource, resource_t *pList )
 
 void SV_SendCustomization( sv_client_t *cl, int playernum, resource_t *pResource )
 {
+	int	startbit = MSG_GetNumBitsWritten( &cl->netchan.message );
+
 	MSG_BeginServerCmd( &cl->netchan.message, svc_customization );
 	MSG_WriteByte( &cl->netchan.message, playernum );	// playernum
 	MSG_WriteByte( &cl->netchan.message, pResource->type );
@@ -347,6 +349,8 @@ void SV_SendCustomization( sv_client_t *cl, int playernum, resource_t *pResource
 
 	if( FBitSet( pResource->ucFlags, RES_CUSTOM ))
 		MSG_WriteBytes( &cl->netchan.message, pResource->rgucMD5_hash, 16 );
+
+	SV_NETSTATS_SINCE( cl, svc_customization, startbit );
 }
 
 void SV_RemoveFromResourceList( resource_t *pResource )
@@ -502,6 +506,7 @@ void SV_BatchUploadRequest( sv_client_t *cl )
 {
 	string		filename;
 	resource_t	*p, *n;
+	int		startbit;
 
 	for( p = cl->resourcesneeded.pNext; p != &cl->resourcesneeded; p = n )
 	{
@@ -519,8 +524,11 @@ void SV_BatchUploadRequest( sv_client_t *cl )
 			{
 				Q_snprintf( filename, sizeof( filename ), "!MD5%s", MD5_Print( p->rgucMD5_hash ));
 
+				startbit = MSG_GetNumBitsWritten( &cl->netchan.message );
+
 				if( SV_CheckFile( &cl->netchan.message, filename ))
 					SV_MoveToOnHandList( cl, p );
+				else SV_NETSTATS_SINCE( cl, svc_stufftext, startbit );
 			}
 			else
 			{
@@ -17,6 +17,7 @@ GNU General Public License for more details.
 #include "server.h"
 #include "const.h"
 #include "net_encode.h"
+#include "threadpool.h"
 
 typedef struct
 {
@@ -25,6 +26,68 @@ typedef struct
 	byte		sended[MAX_EDICTS_BYTES];
 } sv_ents_t;
 
+// single entity delta, recorded on main thread
+typedef struct
+{
+	entity_state_t	*from;
+	entity_state_t	*to;
+	int		baseline;		// custom baseline offset
+	short		delta_type;
+	short		force;
+	delta_fieldmask_t	mask;
+} sv_delta_t;
+
+// client datagram is built in two steps: all game dll
+// callbacks are done on main thread and recorded here,
+// then the bits can be written by any thread
+typedef struct
+{
+	sv_client_t	*cl;
+	sizebuf_t		msg;
+	byte		msg_buf[MAX_DATAGRAM];
+	int		head_bits;		// written by main thread
+	qboolean		encoded;		// don't wait for workers
+
+	// clientdata
+	int		clientdata_bit;		// where svc_clientdata starts
+	qboolean		clientdata;
+	clientdata_t	*from_cd;
+	clientdata_t	*to_cd;
+	delta_fieldmask_t	cd_mask;
+	int		num_weapons;
+	weapon_data_t	*from_wd;			// NULL if not delta'ing
+	weapon_data_t	*to_wd;
+	delta_fieldmask_t	wd_mask[MAX_LOCAL_WEAPONS];
+
+	// packetentities
+	int		packet_cmd;
+	int		num_entities;
+	int		delta_sequence;
+	int		first_old_entity;		// oldest referenced packet entity
+	int		num_deltas;
+	int		max_deltas;
+	sv_delta_t	*deltas;
+
+	// events and pings
+	sizebuf_t		tail;
+	byte		tail_buf[MAX_DATAGRAM];
+
+	// copy of client unreliable datagram
+	sizebuf_t		unreliable;
+	byte		unreliable_buf[MAX_DATAGRAM];
+} sv_encode_job_t;
+
+static struct
+{
+	threadpool_t	*pool;
+	int		numthreads;		// requested by cvar
+	sv_encode_job_t	*jobs[MAX_CLIENTS];
+	delta_cache_t	*caches[MAX_POOL_THREADS];	// one per thread
+} sv_encode;
+
+static clientdata_t		sv_nullcd;
+static weapon_data_t	sv_nullwd;
+
 int	c_fullsend;	// just a debug counter
 int	c_notsend;
 
@@ -64,6 +127,8 @@ static void SV_AddEntitiesToPacket( edict_t *pViewEnt, edict_t *pClient, client_
 	sv_client_t	*cl = NULL;
 	qboolean		player;
 	entity_state_t	*state;
+	uint		visible[MAX_EDICTS / 32];
+	qboolean		indexed;
 	int		e;
 
 	// during an error shutdown message we may need to transmit
@@ -91,11 +156,20 @@ static void SV_AddEntitiesToPacket( edict_t *pViewEnt, edict_t *pClient, client_
 	svgame.dllFuncs.pfnSetupVisibility( pViewEnt, pClient, &clientpvs, &clientphs );
 	if( !clientpvs ) fullvis = true;
 
+	// skip entities that can't pass pvs check in AddToFullPack
+	indexed = !fullvis && SV_VisibleEntities( clientpvs, visible );
+
 	// g-cont: of course we can send world but not want to do it :-)
 	for( e = 1; e < svgame.numEntities; e++ )
 	{
 		byte	*pset;
 
+		if( indexed && !FBitSet( visible[e >> 5], BIT( e & 31 )))
+		{
+			if( !visible[e >> 5] ) e |= 31; // skip the whole word
+			continue;
+		}
+
 		ent = EDICT_NUM( e );
 
 		// don't double add an entity through portals (in case this already added)
@@ -252,12 +326,39 @@ int SV_FindBestBaselineForStatic( int index, entity_state_t **baseline, entity_s
 
 /*
 =============
-SV_EmitPacketEntities
+SV_AddPacketDelta
 
-Writes a delta update of an entity_state_t list to the message->
+record entity delta, custom encoders are called here
 =============
 */
-static void SV_EmitPacketEntities( sv_client_t *cl, client_frame_t *to, sizebuf_t *msg )
+static void SV_AddPacketDelta( sv_encode_job_t *job, entity_state_t *from, entity_state_t *to, qboolean force, int delta_type, int baseline )
+{
+	sv_delta_t	*delta;
+
+	if( job->num_deltas >= job->max_deltas )
+	{
+		job->max_deltas = Q_max( job->max_deltas * 2, 256 );
+		job->deltas = Z_Realloc( job->deltas, sizeof( sv_delta_t ) * job->max_deltas );
+	}
+
+	delta = &job->deltas[job->num_deltas++];
+	delta->from = from;
+	delta->to = to;
+	delta->force = force;
+	delta->delta_type = delta_type;
+	delta->baseline = baseline;
+
+	MSG_PrepareDeltaEntity( from, to, delta_type, &delta->mask );
+}
+
+/*
+=============
+SV_PreparePacketEntities
+
+Builds a delta update of an entity_state_t list
+=============
+*/
+static void SV_PreparePacketEntities( sv_client_t *cl, client_frame_t *to, sv_encode_job_t *job )
 {
 	entity_state_t	*oldent, *newent;
 	int		oldindex, newindex;
@@ -266,6 +367,11 @@ static void SV_EmitPacketEntities( sv_client_t *cl, client_frame_t *to, sizebuf_
 	int		oldmax;
 	client_frame_t	*from;
 
+	job->num_entities = to->num_entities;
+	job->delta_sequence = cl->delta_sequence;
+	job->first_old_entity = to->first_entity;
+	job->num_deltas = 0;
+
 	// this is the frame that we are going to delta update from
 	if( cl->delta_sequence != -1 )
 	{
@@ -276,17 +382,15 @@ static void SV_EmitPacketEntities( sv_client_t *cl, client_frame_t *to, sizebuf_
 		if( from->first_entity <= ( svs.next_client_entities - svs.num_client_entities ))
 		{
 			Con_DPrintf( S_WARN "%s: delta request from out of date entities.\n", cl->name );
-			MSG_BeginServerCmd( msg, svc_packetentities );
-			MSG_WriteUBitLong( msg, to->num_entities - 1, MAX_VISIBLE_PACKET_BITS );
+			job->packet_cmd = svc_packetentities;
 
 			from = NULL;
 			oldmax = 0;
 		}
 		else
 		{
-			MSG_BeginServerCmd( msg, svc_deltapacketentities );
-			MSG_WriteUBitLong( msg, to->num_entities - 1, MAX_VISIBLE_PACKET_BITS );
-			MSG_WriteByte( msg, cl->delta_sequence );
+			job->packet_cmd = svc_deltapacketentities;
+			job->first_old_entity = from->first_entity;
 		}
 	}
 	else
@@ -294,8 +398,7 @@ static void SV_EmitPacketEntities( sv_client_t *cl, client_frame_t *to, sizebuf_
 		from = NULL;
 		oldmax = 0;
 
-		MSG_BeginServerCmd( msg, svc_packetentities );
-		MSG_WriteUBitLong( msg, to->num_entities - 1, MAX_VISIBLE_PACKET_BITS );
+		job->packet_cmd = svc_packetentities;
 	}
 
 	newent = NULL;
@@ -332,7 +435,7 @@ static void SV_EmitPacketEntities( sv_client_t *cl, client_frame_t *to, sizebuf_
 			// delta update from old position
 			// because the force parm is false, this will not result
 			// in any bytes being emited if the entity has not changed at all
-			MSG_WriteDeltaEntity( oldent, newent, msg, false, player, sv.time, 0 );
+			SV_AddPacketDelta( job, oldent, newent, false, player, 0 );
 			oldindex++;
 			newindex++;
 			continue;
@@ -363,7 +466,7 @@ static void SV_EmitPacketEntities( sv_client_t *cl, client_frame_t *to, sizebuf_
 			}
 
 			// this is a new entity, send it from the baseline
-			MSG_WriteDeltaEntity( baseline, newent, msg, true, player, sv.time, offset );
+			SV_AddPacketDelta( job, baseline, newent, true, player, offset );
 			newindex++;
 			continue;
 		}
@@ -378,13 +481,49 @@ static void SV_EmitPacketEntities( sv_client_t *cl, client_frame_t *to, sizebuf_
 				force = true;
 
 			// remove from message
-			MSG_WriteDeltaEntity( oldent, NULL, msg, force, false, sv.time, 0 );
+			SV_AddPacketDelta( job, oldent, NULL, force, false, 0 );
 			oldindex++;
 			continue;
 		}
 	}
+}
+
+/*
+=============
+SV_EmitPacketEntities
+
+Writes a delta update of an entity_state_t list to the message->
+=============
+*/
+static void SV_EmitPacketEntities( sv_encode_job_t *job, sizebuf_t *msg, delta_cache_t *cache )
+{
+	int		fieldbits[MAX_DELTA_FIELDS];
+	int		i, table, startbit;
+	sv_delta_t	*delta;
+
+	startbit = MSG_GetNumBitsWritten( msg );
+
+	MSG_BeginServerCmd( msg, job->packet_cmd );
+	MSG_WriteUBitLong( msg, job->num_entities - 1, MAX_VISIBLE_PACKET_BITS );
+
+	if( job->packet_cmd == svc_deltapacketentities )
+		MSG_WriteByte( msg, job->delta_sequence );
+
+	for( i = 0, delta = job->deltas; i < job->num_deltas; i++, delta++ )
+	{
+		MSG_WriteDeltaEntityCached( cache, delta->from, delta->to, msg, delta->force, delta->delta_type, sv.time, delta->baseline, &delta->mask );
+
+		// encoded bits may come from cache, so count the fields separately
+		if( job->cl->netstats && delta->from && delta->to )
+		{
+			table = Delta_EntityFieldBits( delta->from, delta->to, delta->delta_type, sv.time, &delta->mask, fieldbits );
+			SV_NetStatsFields( job->cl, table, fieldbits, Delta_FindStructByIndex( table )->numFields );
+		}
+	}
 
 	MSG_WriteUBitLong( msg, LAST_EDICT, MAX_ENTITY_BITS ); // end of packetentities
+
+	SV_NETSTATS( job->cl, job->packet_cmd, MSG_GetNumBitsWritten( msg ) - startbit );
 }
 
 /*
@@ -541,31 +680,356 @@ void SV_EmitPings( sizebuf_t *msg )
 	MSG_WriteOneBit( msg, 0 );
 }
 
+/*
+===============================================================================
+
+SNAPSHOT SCHEDULER
+
+===============================================================================
+*/
+typedef enum
+{
+	ENT_SEND = 0,
+	ENT_KEEP_OLD,		// client has older state, leave it
+	ENT_DROP,			// client doesn't have it yet, skip
+} sv_entaction_t;
+
+typedef struct
+{
+	int		index;		// in sv_ents_t
+	int		bits;		// estimated delta size
+	float		priority;
+	qboolean		forced;
+} sv_entcand_t;
+
+/*
+=======================
+SV_CompareEntCands
+
+forced first, then by priority
+=======================
+*/
+static int SV_CompareEntCands( const void *a, const void *b )
+{
+	const sv_entcand_t	*c1 = (const sv_entcand_t *)a;
+	const sv_entcand_t	*c2 = (const sv_entcand_t *)b;
+
+	if( c1->forced != c2->forced )
+		return c1->forced ? -1 : 1;
+
+	if( c1->priority > c2->priority )
+		return -1;
+	if( c1->priority < c2->priority )
+		return 1;
+
+	return c1->index - c2->index;
+}
+
+/*
+=======================
+SV_SnapshotBudget
+
+bits client can take for entities in this update
+=======================
+*/
+static int SV_SnapshotBudget( sv_client_t *cl, sv_encode_job_t *job )
+{
+	double	rate, interval;
+	int	bits;
+
+	if( sv_lan.value && sv_lan_rate.value > 1000.0f )
+		rate = sv_lan_rate.value;
+	else rate = cl->netchan.rate;
+
+	interval = Q_max( cl->cl_updaterate, sv.frametime );
+	bits = (int)( rate * interval ) * 8;
+
+	// can't go beyond single datagram anyway
+	bits = Q_min( bits, (int)sizeof( job->msg_buf ) * 8 );
+
+	// what's already queued for this update
+	bits -= MSG_GetNumBitsWritten( &job->msg );
+	bits -= MSG_GetNumBitsWritten( &cl->datagram );
+
+	return Q_max( bits, 0 );
+}
+
+/*
+=======================
+SV_ScheduleEntities
+
+choose entity updates that fit in client rate,
+the rest stay at the state client already has
+=======================
+*/
+static void SV_ScheduleEntities( sv_client_t *cl, sv_encode_job_t *job, sv_ents_t *ents )
+{
+	static sv_entcand_t		cands[MAX_VISIBLE_PACKET];
+	static entity_state_t	*oldstates[MAX_VISIBLE_PACKET];
+	static byte		actions[MAX_VISIBLE_PACKET];
+	static byte		events[MAX_EDICTS_BYTES];
+	sv_snapstats_t		*stats = &cl->snapstats;
+	client_frame_t		*from = NULL;
+	int			i, j, oldindex;
+	int			numcands, deferred;
+	int			budget, viewnum;
+	float			priodist;
+	edict_t			*view;
+	vec3_t			vieworg;
+
+	stats->changed = stats->deferred = 0;
+
+	if( !sv_entity_priority.value || !ents->num_entities )
+		return;
+
+	// these aren't limited by rate
+	if( FBitSet( cl->flags, FCL_FAKECLIENT ) || NET_IsLocalAddress( cl->netchan.remote_address ))
+		return;
+
+	if( !cl->entprio )
+		cl->entprio = Z_Calloc( sizeof( sv_entprio_t ) * GI->max_edicts );
+
+	// same delta source as SV_PreparePacketEntities, if it
+	// would roll off then client gets old states in full update
+	if( cl->delta_sequence != -1 )
+	{
+		from = &cl->frames[cl->delta_sequence & SV_UPDATE_MASK];
+
+		if( from->first_entity <= ( svs.next_client_entities + ents->num_entities - svs.num_client_entities ))
+			from = NULL;
+	}
+
+	// client drops everything missing in full update,
+	// so only delta frames can hold entities back
+	if( !from )
+	{
+		for( i = 0; i < ents->num_entities; i++ )
+		{
+			sv_entprio_t	*ep = &cl->entprio[ents->entities[i].number];
+
+			ep->accum = 0.0f;
+			ep->waitstart = 0.0;
+		}
+		return;
+	}
+
+	// find what client already has
+	for( i = oldindex = numcands = 0; i < ents->num_entities; i++ )
+	{
+		entity_state_t	*state = &ents->entities[i];
+		sv_entprio_t	*ep = &cl->entprio[state->number];
+
+		oldstates[i] = NULL;
+		actions[i] = ENT_SEND;
+
+		for( ; from && oldindex < from->num_entities; oldindex++ )
+		{
+			entity_state_t	*test = &svs.packet_entities[(from->first_entity+oldindex) % svs.num_client_entities];
+
+			if( test->number < state->number )
+				continue;
+
+			if( test->number == state->number )
+				oldstates[i] = test;
+			break;
+		}
+
+		if( oldstates[i] && !memcmp( oldstates[i], state, sizeof( *state )))
+		{
+			ep->accum = 0.0f;
+			ep->waitstart = 0.0;
+			continue;
+		}
+
+		if( !ep->waitstart )
+			ep->waitstart = host.realtime;
+
+		cands[numcands++].index = i;
+	}
+
+	stats->changed = numcands;
+	stats->budget = budget = SV_SnapshotBudget( cl, job );
+
+	// everything fits even in worst case
+	if( numcands * Delta_MaxEntityBits() <= budget )
+	{
+		for( i = 0; i < numcands; i++ )
+		{
+			sv_entprio_t	*ep = &cl->entprio[ents->entities[cands[i].index].number];
+
+			ep->accum = 0.0f;
+			ep->waitstart = 0.0;
+		}
+		return;
+	}
+
+	// events refer to entity in packet, so it must be there
+	memset( events, 0, sizeof( events ));
+	for( i = 0; i < MAX_EVENT_QUEUE; i++ )
+	{
+		event_info_t	*info = &cl->events.ei[i];
+
+		if( info->index && info->entity_index > 0 && info->entity_index < GI->max_edicts )
+			SETVISBIT( events, info->entity_index );
+	}
+
+	view = SV_IsValidEdict( cl->pViewEntity ) ? cl->pViewEntity : cl->edict;
+	VectorAdd( view->v.origin, view->v.view_ofs, vieworg );
+	viewnum = NUM_FOR_EDICT( view );
+	priodist = Q_max( sv_entity_prio_dist.value, 1.0f );
+
+	for( i = 0; i < numcands; i++ )
+	{
+		sv_entcand_t	*c = &cands[i];
+		entity_state_t	*state = &ents->entities[c->index];
+		entity_state_t	*old = oldstates[c->index];
+		sv_entprio_t	*ep = &cl->entprio[state->number];
+		edict_t		*ent = EDICT_NUM( state->number );
+		float		weight = 1.0f;
+		vec3_t		center;
+
+		if( svgame.physFuncs.SV_EntityPriority != NULL )
+			weight = svgame.physFuncs.SV_EntityPriority( ent, cl->edict );
+
+		c->bits = Delta_TestBaseline( old ? old : &svs.baselines[state->number], state, SV_IsPlayerIndex( state->number ), sv.time );
+		c->forced = false;
+
+		if( weight <= 0.0f || state->number == viewnum || ent == cl->edict || CHECKVISBIT( events, state->number ))
+		{
+			c->forced = true;
+		}
+		else if( host.realtime - ep->waitstart >= sv_entity_maxdelay.value )
+		{
+			// was held back for too long
+			stats->total_starved++;
+			c->forced = true;
+		}
+
+		// closer and faster is more important
+		VectorAverage( ent->v.absmin, ent->v.absmax, center );
+		c->priority = weight * ( priodist / ( priodist + VectorDistance( center, vieworg )));
+		c->priority *= 1.0f + VectorLength( ent->v.velocity ) / 320.0f;
+		c->priority += ep->accum;
+	}
+
+	qsort( cands, numcands, sizeof( cands[0] ), SV_CompareEntCands );
+
+	// cheaper updates still may fit after some big one didn't
+	for( i = deferred = 0; i < numcands; i++ )
+	{
+		sv_entcand_t	*c = &cands[i];
+		sv_entprio_t	*ep = &cl->entprio[ents->entities[c->index].number];
+
+		if( c->forced || c->bits <= budget )
+		{
+			budget -= c->bits;
+			ep->accum = 0.0f;
+			ep->waitstart = 0.0;
+			continue;
+		}
+
+		// it will win over time
+		ep->accum = c->priority;
+		stats->maxdelay = Q_max( stats->maxdelay, host.realtime - ep->waitstart );
+		actions[c->index] = oldstates[c->index] ? ENT_KEEP_OLD : ENT_DROP;
+		deferred++;
+	}
+
+	if( !deferred ) return;
+
+	// keep the list sorted
+	for( i = j = 0; i < ents->num_entities; i++ )
+	{
+		if( actions[i] == ENT_DROP )
+			continue;
+
+		if( actions[i] == ENT_KEEP_OLD )
+			ents->entities[j] = *oldstates[i];
+		else if( j != i )
+			ents->entities[j] = ents->entities[i];
+		j++;
+	}
+
+	ents->num_entities = j;
+	stats->deferred = deferred;
+	stats->total_deferred += deferred;
+}
+
+/*
+=======================
+SV_FreeEntityPriority
+
+=======================
+*/
+void SV_FreeEntityPriority( sv_client_t *cl )
+{
+	if( cl->entprio )
+		Mem_Free( cl->entprio );
+	cl->entprio = NULL;
+	memset( &cl->snapstats, 0, sizeof( cl->snapstats ));
+}
+
+/*
+=======================
+SV_EntityStats_f
+
+=======================
+*/
+void SV_EntityStats_f( void )
+{
+	qboolean	reset;
+	sv_client_t	*cl;
+	int	i;
+
+	reset = Cmd_Argc() > 1 && !Q_stricmp( Cmd_Argv( 1 ), "reset" );
+
+	Con_Printf( "entity priority: %s, max delay %g sec\n", sv_entity_priority.value ? "enabled" : "disabled", sv_entity_maxdelay.value );
+	Con_Printf( "name             budget changed deferred   total starved maxdelay\n" );
+	Con_Printf( "---------------- ------ ------- -------- ------- ------- --------\n" );
+
+	for( i = 0, cl = svs.clients; svs.clients && i < svs.maxclients; i++, cl++ )
+	{
+		sv_snapstats_t	*stats = &cl->snapstats;
+
+		if( cl->state != cs_spawned || FBitSet( cl->flags, FCL_FAKECLIENT ))
+			continue;
+
+		Con_Printf( "%-16.16s %6i %7i %8i %7u %7u %8.3f\n", cl->name, BitByte( stats->budget ),
+			stats->changed, stats->deferred, stats->total_deferred, stats->total_starved, stats->maxdelay );
+
+		if( reset )
+		{
+			stats->total_deferred = stats->total_starved = 0;
+			stats->maxdelay = 0.0f;
+		}
+	}
+}
+
 /*
 ==================
-SV_WriteClientdataToMessage
+SV_PrepareClientdata
 
 ==================
 */
-void SV_WriteClientdataToMessage( sv_client_t *cl, sizebuf_t *msg )
+static void SV_PrepareClientdata( sv_client_t *cl, sv_encode_job_t *job )
 {
-	clientdata_t	nullcd;
-	clientdata_t	*from_cd, *to_cd;
-	weapon_data_t	nullwd;
-	weapon_data_t	*from_wd, *to_wd;
+	sizebuf_t		*msg = &job->msg;
 	client_frame_t	*frame;
 	edict_t		*clent;
 	int		i;
 
-	memset( &nullcd, 0, sizeof( nullcd ));
 	frame = &cl->frames[cl->netchan.outgoing_sequence & SV_UPDATE_MASK];
 	frame->senttime = host.realtime;
 	frame->ping_time = -1.0f;
 	clent = cl->edict;
 
+	job->clientdata = false;
+	job->num_weapons = 0;
+
 	if( cl->chokecount != 0 )
 	{
 		MSG_BeginServerCmd( msg, svc_choke );
+		SV_NETSTATS( cl, svc_choke, 8 );
 		cl->chokecount = 0;
 	}
 
@@ -575,10 +1039,12 @@ void SV_WriteClientdataToMessage( sv_client_t *cl, sizebuf_t *msg )
 	case 1:
 		MSG_BeginServerCmd( msg, svc_setangle );
 		MSG_WriteVec3Angles( msg, clent->v.angles );
+		SV_NETSTATS( cl, svc_setangle, 8 + 3 * 16 );
 		break;
 	case 2:
 		MSG_BeginServerCmd( msg, svc_addangle );
 		MSG_WriteBitAngle( msg, clent->v.avelocity[YAW], 16 );
+		SV_NETSTATS( cl, svc_addangle, 8 + 16 );
 		clent->v.avelocity[YAW] = 0.0f;
 		break;
 	}
@@ -590,12 +1056,13 @@ void SV_WriteClientdataToMessage( sv_client_t *cl, sizebuf_t *msg )
 	// update clientdata_t
 	svgame.dllFuncs.pfnUpdateClientData( clent, FBitSet( cl->flags, FCL_LOCAL_WEAPONS ), &frame->clientdata );
 
+	job->clientdata_bit = MSG_GetNumBitsWritten( msg );
 	MSG_BeginServerCmd( msg, svc_clientdata );
 	if( FBitSet( cl->flags, FCL_HLTV_PROXY )) return;	// don't send more nothing
 
-	if( cl->delta_sequence == -1 ) from_cd = &nullcd;
-	else from_cd = &cl->frames[cl->delta_sequence & SV_UPDATE_MASK].clientdata;
-	to_cd = &frame->clientdata;
+	if( cl->delta_sequence == -1 ) job->from_cd = &sv_nullcd;
+	else job->from_cd = &cl->frames[cl->delta_sequence & SV_UPDATE_MASK].clientdata;
+	job->to_cd = &frame->clientdata;
 
 	if( cl->delta_sequence == -1 )
 	{
@@ -607,22 +1074,39 @@ void SV_WriteClientdataToMessage( sv_client_t *cl, sizebuf_t *msg )
 		MSG_WriteByte( msg, cl->delta_sequence );
 	}
 
-	// write clientdata_t
-	MSG_WriteClientData( msg, from_cd, to_cd, sv.time );
+	job->clientdata = true;
+	MSG_PrepareClientData( job->from_cd, job->to_cd, &job->cd_mask );
 
 	if( FBitSet( cl->flags, FCL_LOCAL_WEAPONS ) && svgame.dllFuncs.pfnGetWeaponData( clent, frame->weapondata ))
 	{
-		memset( &nullwd, 0, sizeof( nullwd ));
-
-		for( i = 0; i < MAX_LOCAL_WEAPONS; i++ )
-		{
-			if( cl->delta_sequence == -1 ) from_wd = &nullwd;
-			else from_wd = &cl->frames[cl->delta_sequence & SV_UPDATE_MASK].weapondata[i];
-			to_wd = &frame->weapondata[i];
+		if( cl->delta_sequence == -1 ) job->from_wd = NULL;
+		else job->from_wd = cl->frames[cl->delta_sequence & SV_UPDATE_MASK].weapondata;
+		job->to_wd = frame->weapondata;
+		job->num_weapons = MAX_LOCAL_WEAPONS;
 
-			MSG_WriteWeaponData( msg, from_wd, to_wd, sv.time, i );
-		}
+		for( i = 0; i < job->num_weapons; i++ )
+			MSG_PrepareWeaponData( job->from_wd ? &job->from_wd[i] : &sv_nullwd, &job->to_wd[i], &job->wd_mask[i] );
 	}
+}
+
+/*
+==================
+SV_WriteClientdataToMessage
+
+==================
+*/
+static void SV_WriteClientdataToMessage( sv_encode_job_t *job, sizebuf_t *msg )
+{
+	int	i;
+
+	if( !job->clientdata )
+		return;
+
+	// write clientdata_t
+	MSG_WriteClientDataExt( msg, job->from_cd, job->to_cd, sv.time, &job->cd_mask );
+
+	for( i = 0; i < job->num_weapons; i++ )
+		MSG_WriteWeaponDataExt( msg, job->from_wd ? &job->from_wd[i] : &sv_nullwd, &job->to_wd[i], sv.time, i, &job->wd_mask[i] );
 
 	// end marker
 	MSG_WriteOneBit( msg, 0 );
@@ -630,16 +1114,17 @@ void SV_WriteClientdataToMessage( sv_client_t *cl, sizebuf_t *msg )
 
 /*
 ==================
-SV_WriteEntitiesToClient
+SV_PrepareEntities
 
 ==================
 */
-void SV_WriteEntitiesToClient( sv_client_t *cl, sizebuf_t *msg )
+static void SV_PrepareEntities( sv_client_t *cl, sv_encode_job_t *job )
 {
 	client_frame_t	*frame;
 	entity_state_t	*state;
 	static sv_ents_t	frame_ents;
 	int		i, send_pings;
+	int		startbit;
 
 	frame = &cl->frames[cl->netchan.outgoing_sequence & SV_UPDATE_MASK];
 	send_pings = SV_ShouldUpdatePing( cl );
@@ -667,6 +1152,9 @@ void SV_WriteEntitiesToClient( sv_client_t *cl, sizebuf_t *msg )
 	// of an entity being included twice.
 	qsort( frame_ents.entities, frame_ents.num_entities, sizeof( frame_ents.entities[0] ), SV_EntityNumbers );
 
+	// hold back what doesn't fit in client rate
+	SV_ScheduleEntities( cl, job, &frame_ents );
+
 	// it will break all connected clients, but it takes more than one week to overflow it
 	if(( (uint)svs.next_client_entities ) + frame_ents.num_entities >= 0x7FFFFFFE )
 	{
@@ -689,9 +1177,18 @@ void SV_WriteEntitiesToClient( sv_client_t *cl, sizebuf_t *msg )
 		frame->num_entities++;
 	}
 
-	SV_EmitPacketEntities( cl, frame, msg );
-	SV_EmitEvents( cl, frame, msg );
-	if( send_pings ) SV_EmitPings( msg );
+	SV_PreparePacketEntities( cl, frame, job );
+
+	// events and pings are going after packet entities
+	SV_EmitEvents( cl, frame, &job->tail );
+	SV_NETSTATS( cl, svc_event, MSG_GetNumBitsWritten( &job->tail ));
+
+	if( send_pings )
+	{
+		startbit = MSG_GetNumBitsWritten( &job->tail );
+		SV_EmitPings( &job->tail );
+		SV_NETSTATS( cl, svc_pings, MSG_GetNumBitsWritten( &job->tail ) - startbit );
+	}
 }
 
 /*
@@ -703,47 +1200,612 @@ FRAME UPDATES
 */
 /*
 =======================
-SV_SendClientDatagram
+SV_GetEncodeJob
 =======================
 */
-void SV_SendClientDatagram( sv_client_t *cl )
+static sv_encode_job_t *SV_GetEncodeJob( int index )
 {
-	byte	msg_buf[MAX_DATAGRAM];
-	sizebuf_t	msg;
+	if( !sv_encode.jobs[index] )
+		sv_encode.jobs[index] = Z_Calloc( sizeof( sv_encode_job_t ));
+	return sv_encode.jobs[index];
+}
+
+/*
+=======================
+SV_PrepareClientDatagram
 
-	MSG_Init( &msg, "Datagram", msg_buf, sizeof( msg_buf ));
+everything that touches game dll or shared state
+=======================
+*/
+static void SV_PrepareClientDatagram( sv_client_t *cl, sv_encode_job_t *job )
+{
+	job->cl = cl;
+	job->encoded = false;
+	MSG_Init( &job->msg, "Datagram", job->msg_buf, sizeof( job->msg_buf ));
+	MSG_Init( &job->tail, "Datagram", job->tail_buf, sizeof( job->tail_buf ));
+	MSG_Init( &job->unreliable, cl->datagram.pDebugName, job->unreliable_buf, sizeof( job->unreliable_buf ));
 
 	// always send servertime at new frame
-	MSG_BeginServerCmd( &msg, svc_time );
-	MSG_WriteFloat( &msg, sv.time );
+	MSG_BeginServerCmd( &job->msg, svc_time );
+	MSG_WriteFloat( &job->msg, sv.time );
+	SV_NETSTATS( cl, svc_time, MSG_GetNumBitsWritten( &job->msg ));
 
-	SV_WriteClientdataToMessage( cl, &msg );
-	SV_WriteEntitiesToClient( cl, &msg );
+	SV_PrepareClientdata( cl, job );
+	SV_PrepareEntities( cl, job );
 
-	// copy the accumulated multicast datagram
-	// for this client out to the message
+	job->head_bits = MSG_GetNumBitsWritten( &job->msg );
+}
+
+/*
+=======================
+SV_EncodeClientDatagram
+
+can be called from any thread
+=======================
+*/
+static void SV_EncodeClientDatagram( void *data, int index, int thread )
+{
+	sv_encode_job_t	*job = ((sv_encode_job_t **)data)[index];
+	sizebuf_t		*msg = &job->msg;
+
+	if( job->encoded )
+		return;
+
+	MSG_SeekToBit( msg, job->head_bits, SEEK_SET );
+
+	SV_WriteClientdataToMessage( job, msg );
+	SV_NETSTATS( job->cl, svc_clientdata, MSG_GetNumBitsWritten( msg ) - job->clientdata_bit );
+	SV_EmitPacketEntities( job, msg, sv_encode.caches[thread] );
+	MSG_WriteBits( msg, MSG_GetData( &job->tail ), MSG_GetNumBitsWritten( &job->tail ));
+}
+
+/*
+=======================
+SV_StoreClientUnreliable
+
+grab the accumulated multicast datagram,
+game dll may write more while other clients are prepared
+=======================
+*/
+static void SV_StoreClientUnreliable( sv_client_t *cl, sv_encode_job_t *job )
+{
 	if( MSG_CheckOverflow( &cl->datagram ))
 	{
 		Con_Printf( S_WARN "%s overflowed for %s\n", MSG_GetName( &cl->datagram ), cl->name );
+		job->unreliable.bOverflow = true;
 	}
 	else
 	{
-		if( MSG_GetNumBytesWritten( &cl->datagram ) < MSG_GetNumBytesLeft( &msg ))
-			MSG_WriteBits( &msg, MSG_GetData( &cl->datagram ), MSG_GetNumBitsWritten( &cl->datagram ));
-		else Con_DPrintf( S_WARN "Ignoring unreliable datagram for %s, would overflow on msg\n", cl->name );
+		MSG_WriteBits( &job->unreliable, MSG_GetData( &cl->datagram ), MSG_GetNumBitsWritten( &cl->datagram ));
 	}
 
 	MSG_Clear( &cl->datagram );
+}
 
-	if( MSG_CheckOverflow( &msg ))
+/*
+=======================
+SV_TransmitClientDatagram
+=======================
+*/
+static void SV_TransmitClientDatagram( sv_encode_job_t *job )
+{
+	sv_client_t	*cl = job->cl;
+	sizebuf_t		*msg = &job->msg;
+
+	// copy the accumulated multicast datagram
+	// for this client out to the message
+	if( !MSG_CheckOverflow( &job->unreliable ))
+	{
+		if( MSG_GetNumBytesWritten( &job->unreliable ) < MSG_GetNumBytesLeft( msg ))
+			MSG_WriteBits( msg, MSG_GetData( &job->unreliable ), MSG_GetNumBitsWritten( &job->unreliable ));
+		else Con_DPrintf( S_WARN "Ignoring unreliable datagram for %s, would overflow on msg\n", cl->name );
+	}
+
+	if( MSG_CheckOverflow( msg ))
 	{
 		// must have room left for the packet header
-		Con_Printf( S_ERROR "%s overflowed for %s\n", MSG_GetName( &msg ), cl->name );
-		MSG_Clear( &msg );
+		Con_Printf( S_ERROR "%s overflowed for %s\n", MSG_GetName( msg ), cl->name );
+		MSG_Clear( msg );
 	}
 
 	// send the datagram
-	Netchan_TransmitBits( &cl->netchan, MSG_GetNumBitsWritten( &msg ), MSG_GetData( &msg ));
+	Netchan_TransmitBits( &cl->netchan, MSG_GetNumBitsWritten( msg ), MSG_GetData( msg ));
+}
+
+/*
+=======================
+SV_SendClientDatagram
+=======================
+*/
+void SV_SendClientDatagram( sv_client_t *cl )
+{
+	sv_encode_job_t	*job = SV_GetEncodeJob( 0 );
+
+	SV_PrepareClientDatagram( cl, job );
+	SV_StoreClientUnreliable( cl, job );
+	SV_EncodeClientDatagram( &job, 0, 0 );
+	SV_TransmitClientDatagram( job );
+}
+
+/*
+=======================
+SV_BuildFakeClientDatagram
+
+encode a datagram for a fakeclient without sending it
+and pretend it was acknowledged at once. Returns size in bytes
+=======================
+*/
+int SV_BuildFakeClientDatagram( sv_client_t *cl )
+{
+	sv_encode_job_t	*job = SV_GetEncodeJob( 0 );
+
+	if( !cl->frames || cl->state != cs_spawned )
+		return 0;
+
+	SV_PrepareClientDatagram( cl, job );
+	SV_EncodeClientDatagram( &job, 0, 0 );
+
+	cl->delta_sequence = cl->netchan.outgoing_sequence & 0xFF;
+	cl->netchan.outgoing_sequence++;
+
+	return MSG_GetNumBytesWritten( &job->msg );
+}
+
+/*
+=======================
+SV_UpdateEncodePool
+
+(re)create workers when sv_encode_threads is changed
+=======================
+*/
+static void SV_UpdateEncodePool( void )
+{
+	int	numthreads = bound( 1, (int)sv_encode_threads.value, MAX_POOL_THREADS );
+
+	if( sv_encode.numthreads == numthreads )
+		return;
+
+	ThreadPool_Destroy( sv_encode.pool );
+	sv_encode.pool = NULL;
+	sv_encode.numthreads = numthreads;
+
+	if( numthreads > 1 )
+		sv_encode.pool = ThreadPool_Create( "SV_Encode", numthreads );
+}
+
+/*
+=======================
+SV_UpdateDeltaCaches
+
+caches are valid only for one frame
+=======================
+*/
+static void SV_UpdateDeltaCaches( void )
+{
+	int	i;
+
+	for( i = 0; i < MAX_POOL_THREADS; i++ )
+	{
+		if( sv_delta_cache.value && i < sv_encode.numthreads )
+		{
+			if( !sv_encode.caches[i] )
+				sv_encode.caches[i] = Delta_AllocCache();
+			else Delta_ClearCache( sv_encode.caches[i] );
+		}
+		else if( sv_encode.caches[i] )
+		{
+			Delta_FreeCache( sv_encode.caches[i] );
+			sv_encode.caches[i] = NULL;
+		}
+	}
+}
+
+/*
+=======================
+SV_DeltaCacheStats_f
+=======================
+*/
+void SV_DeltaCacheStats_f( void )
+{
+	uint	hits = 0, misses = 0;
+	qboolean	reset;
+	int	i;
+
+	reset = Cmd_Argc() > 1 && !Q_stricmp( Cmd_Argv( 1 ), "reset" );
+
+	for( i = 0; i < MAX_POOL_THREADS; i++ )
+	{
+		if( sv_encode.caches[i] )
+			Delta_CacheStats( sv_encode.caches[i], &hits, &misses, reset );
+	}
+
+	Con_Printf( "delta cache: %s\n", sv_delta_cache.value ? "enabled" : "disabled" );
+	Con_Printf( "%u hits, %u misses (%.1f%% hit rate)\n", hits, misses,
+		( hits + misses ) ? hits * 100.0 / ( hits + misses ) : 0.0 );
+}
+
+/*
+=======================
+SV_FreeEncodeJobs
+=======================
+*/
+void SV_FreeEncodeJobs( void )
+{
+	int	i;
+
+	ThreadPool_Destroy( sv_encode.pool );
+	sv_encode.pool = NULL;
+	sv_encode.numthreads = 0;
+
+	for( i = 0; i < MAX_POOL_THREADS; i++ )
+	{
+		Delta_FreeCache( sv_encode.caches[i] );
+		sv_encode.caches[i] = NULL;
+	}
+
+	for( i = 0; i < MAX_CLIENTS; i++ )
+	{
+		if( !sv_encode.jobs[i] )
+			continue;
+
+		Z_Free( sv_encode.jobs[i]->deltas );
+		Z_Free( sv_encode.jobs[i] );
+		sv_encode.jobs[i] = NULL;
+	}
+}
+
+typedef struct
+{
+	sv_client_t	client;		// events, choke and ping timers, scheduler stats
+	client_frame_t	*frames;		// whole frame ring
+	sv_entprio_t	*entprio;		// copy of scheduler priorities
+	entity_state_t	*states;		// packet entities overwritten by this client
+	int		first_state;
+	int		num_states;
+	int		fixangle;
+	float		yawspeed;
+} sv_benchsave_t;
+
+/*
+=======================
+SV_BenchSaveClient
+
+remember everything datagram preparing is going to change
+=======================
+*/
+static void SV_BenchSaveClient( sv_client_t *cl, sv_benchsave_t *save, entity_state_t *scratch, int maxstates )
+{
+	int	i;
+
+	save->client = *cl;
+	save->frames = Z_Malloc( sizeof( client_frame_t ) * SV_UPDATE_BACKUP );
+	memcpy( save->frames, cl->frames, sizeof( client_frame_t ) * SV_UPDATE_BACKUP );
+	save->fixangle = cl->edict->v.fixangle;
+	save->yawspeed = cl->edict->v.avelocity[YAW];
+	save->first_state = svs.next_client_entities;
+
+	if( cl->entprio )
+	{
+		save->entprio = Z_Malloc( sizeof( sv_entprio_t ) * GI->max_edicts );
+		memcpy( save->entprio, cl->entprio, sizeof( sv_entprio_t ) * GI->max_edicts );
+	}
+
+	// we don't know yet how many states will be written
+	for( i = 0; i < maxstates; i++ )
+		scratch[i] = svs.packet_entities[(save->first_state + i) % svs.num_client_entities];
+
+	// don't count bench traffic
+	cl->netstats = NULL;
+}
+
+/*
+=======================
+SV_BenchKeepStates
+
+keep only really overwritten packet entities
+=======================
+*/
+static void SV_BenchKeepStates( sv_benchsave_t *save, const entity_state_t *scratch )
+{
+	save->num_states = svs.next_client_entities - save->first_state;
+
+	if( save->num_states > 0 )
+	{
+		save->states = Z_Malloc( sizeof( entity_state_t ) * save->num_states );
+		memcpy( save->states, scratch, sizeof( entity_state_t ) * save->num_states );
+	}
+}
+
+/*
+=======================
+SV_BenchRestoreClient
+
+put client back as it was before the bench
+=======================
+*/
+static void SV_BenchRestoreClient( sv_client_t *cl, sv_benchsave_t *save )
+{
+	int	i;
+
+	for( i = 0; i < save->num_states; i++ )
+		svs.packet_entities[(save->first_state + i) % svs.num_client_entities] = save->states[i];
+
+	if( save->entprio )
+	{
+		memcpy( cl->entprio, save->entprio, sizeof( sv_entprio_t ) * GI->max_edicts );
+		Z_Free( save->entprio );
+	}
+	else if( cl->entprio )
+	{
+		// allocated by the bench itself
+		Z_Free( cl->entprio );
+		cl->entprio = NULL;
+	}
+
+	if( save->states )
+		Z_Free( save->states );
+
+	cl->edict->v.fixangle = save->fixangle;
+	cl->edict->v.avelocity[YAW] = save->yawspeed;
+	memcpy( cl->frames, save->frames, sizeof( client_frame_t ) * SV_UPDATE_BACKUP );
+	Z_Free( save->frames );
+	*cl = save->client;
+}
+
+/*
+=======================
+SV_EncodeReferenceDatagram
+
+encode prepared datagram the way serial SV_SendClientDatagram
+used to: no precomputed field masks, no delta cache, one thread
+=======================
+*/
+static void SV_EncodeReferenceDatagram( sv_encode_job_t *job, sizebuf_t *msg )
+{
+	sv_delta_t	*delta;
+	int		i;
+
+	MSG_WriteBits( msg, MSG_GetData( &job->msg ), job->head_bits );
+
+	if( job->clientdata )
+	{
+		MSG_WriteClientData( msg, job->from_cd, job->to_cd, sv.time );
+
+		for( i = 0; i < job->num_weapons; i++ )
+			MSG_WriteWeaponData( msg, job->from_wd ? &job->from_wd[i] : &sv_nullwd, &job->to_wd[i], sv.time, i );
+
+		MSG_WriteOneBit( msg, 0 );
+	}
+
+	MSG_BeginServerCmd( msg, job->packet_cmd );
+	MSG_WriteUBitLong( msg, job->num_entities - 1, MAX_VISIBLE_PACKET_BITS );
+
+	if( job->packet_cmd == svc_deltapacketentities )
+		MSG_WriteByte( msg, job->delta_sequence );
+
+	for( i = 0, delta = job->deltas; i < job->num_deltas; i++, delta++ )
+		MSG_WriteDeltaEntity( delta->from, delta->to, msg, delta->force, delta->delta_type, sv.time, delta->baseline );
+
+	MSG_WriteUBitLong( msg, LAST_EDICT, MAX_ENTITY_BITS );
+	MSG_WriteBits( msg, MSG_GetData( &job->tail ), MSG_GetNumBitsWritten( &job->tail ));
+}
+
+/*
+=======================
+SV_BenchPacketCRC
+
+=======================
+*/
+static dword SV_BenchPacketCRC( sizebuf_t *msg )
+{
+	dword	crc;
+
+	// don't hash padding bits
+	CRC32_Init( &crc );
+	CRC32_ProcessBuffer( &crc, MSG_GetData( msg ), MSG_GetRealBytesWritten( msg ));
+	if( MSG_GetNumBitsWritten( msg ) & 7 )
+		CRC32_ProcessByte( &crc, MSG_GetData( msg )[MSG_GetRealBytesWritten( msg )] & ( BIT( MSG_GetNumBitsWritten( msg ) & 7 ) - 1 ));
+
+	return CRC32_Final( crc );
+}
+
+/*
+=======================
+SV_EncodeBench_f
+
+measure datagram encoding time for all spawned clients
+with different number of threads and check every run
+against the serial reference encoder. Client state, frame
+ring and packet entities are restored after the bench,
+but game dll callbacks were called and may keep changes
+=======================
+*/
+void SV_EncodeBench_f( void )
+{
+	sv_encode_job_t	*jobs[MAX_CLIENTS];
+	sv_client_t	*clients[MAX_CLIENTS];
+	sv_benchsave_t	*saves;
+	entity_state_t	*scratch;
+	int		maxstates;
+	dword		crcs[MAX_CLIENTS];
+	byte		*refbuf;
+	sizebuf_t		ref;
+	int		i, j, numjobs = 0, numdiffs, failed = 0;
+	int		iterations, maxthreads, numthreads;
+	double		start, single = 0.0, elapsed;
+	threadpool_t	*pool;
+	sv_client_t	*cl;
+
+	if( sv.state != ss_active )
+	{
+		Con_Printf( "Server is not active\n" );
+		return;
+	}
+
+	iterations = Cmd_Argc() > 1 ? Q_atoi( Cmd_Argv( 1 )) : 100;
+	maxthreads = Cmd_Argc() > 2 ? Q_atoi( Cmd_Argv( 2 )) : Q_max( (int)sv_encode_threads.value, 4 );
+	iterations = Q_max( iterations, 1 );
+	maxthreads = bound( 1, maxthreads, MAX_POOL_THREADS );
+
+	// don't let the bench trigger packet entities wraparound
+	if(( (uint)svs.next_client_entities ) + svs.maxclients * MAX_VISIBLE_PACKET >= 0x7FFFFFFE )
+	{
+		Con_Printf( "Packet entities are about to wrap, try again after restart\n" );
+		return;
+	}
+
+	maxstates = Q_min( MAX_VISIBLE_PACKET, svs.num_client_entities );
+	scratch = Z_Malloc( sizeof( entity_state_t ) * maxstates );
+	saves = Z_Calloc( sizeof( sv_benchsave_t ) * svs.maxclients );
+
+	for( i = 0, cl = svs.clients; i < svs.maxclients; i++, cl++ )
+	{
+		if( cl->state != cs_spawned || !cl->frames || !cl->edict )
+			continue;
+
+		// the frame about to be written is the one client deltas from,
+		// preparing would encode against its own overwritten copy
+		if( cl->delta_sequence != -1 && ( cl->delta_sequence & SV_UPDATE_MASK ) == ( cl->netchan.outgoing_sequence & SV_UPDATE_MASK ))
+		{
+			Con_Printf( "Skipping %s, frame ring wrapped\n", cl->name );
+			continue;
+		}
+
+		SV_BenchSaveClient( cl, &saves[numjobs], scratch, maxstates );
+		clients[numjobs] = cl;
+		jobs[numjobs] = SV_GetEncodeJob( numjobs );
+		SV_PrepareClientDatagram( cl, jobs[numjobs] );
+		SV_BenchKeepStates( &saves[numjobs], scratch );
+		numjobs++;
+	}
+
+	Z_Free( scratch );
+
+	if( !numjobs )
+	{
+		Con_Printf( "No spawned clients to encode\n" );
+		Z_Free( saves );
+		return;
+	}
+
+	// every threaded run must match the serial encoder bit for bit
+	refbuf = Z_Malloc( MAX_DATAGRAM );
+
+	for( j = 0; j < numjobs; j++ )
+	{
+		MSG_Init( &ref, "EncodeBench", refbuf, MAX_DATAGRAM );
+		SV_EncodeReferenceDatagram( jobs[j], &ref );
+		crcs[j] = SV_BenchPacketCRC( &ref );
+	}
+
+	Z_Free( refbuf );
+
+	// each bench thread needs own cache
+	for( j = 0; sv_delta_cache.value && j < maxthreads; j++ )
+	{
+		if( !sv_encode.caches[j] )
+			sv_encode.caches[j] = Delta_AllocCache();
+	}
+
+	Con_Printf( "Encoding %d clients, %d iterations, delta cache %s\n", numjobs, iterations, sv_delta_cache.value ? "on" : "off" );
+
+	for( numthreads = 1; numthreads <= maxthreads; numthreads++ )
+	{
+		pool = ThreadPool_Create( "SV_EncodeBench", numthreads );
+		start = Sys_DoubleTime();
+
+		for( i = 0; i < iterations; i++ )
+		{
+			for( j = 0; j < MAX_POOL_THREADS; j++ )
+			{
+				if( sv_encode.caches[j] )
+					Delta_ClearCache( sv_encode.caches[j] );
+			}
+
+			ThreadPool_ParallelFor( pool, SV_EncodeClientDatagram, jobs, numjobs );
+		}
+
+		elapsed = Sys_DoubleTime() - start;
+		ThreadPool_Destroy( pool );
+
+		for( j = numdiffs = 0; j < numjobs; j++ )
+		{
+			if( SV_BenchPacketCRC( &jobs[j]->msg ) != crcs[j] )
+				numdiffs++;
+		}
+
+		if( numthreads == 1 ) single = elapsed;
+		if( numdiffs ) failed++;
+
+		Con_Printf( "%2d threads: %.3f ms per frame, speedup %.2fx%s\n", numthreads,
+			elapsed * 1000.0 / iterations, single / Q_max( elapsed, 0.000001 ),
+			numdiffs ? va( " ^1(%d packets differ from serial encoder!)^7", numdiffs ) : "" );
+	}
+
+	for( j = numjobs - 1; j >= 0; j-- )
+		SV_BenchRestoreClient( clients[j], &saves[j] );
+	svs.next_client_entities = saves[0].first_state;
+	Z_Free( saves );
+
+	if( failed ) Con_Printf( S_ERROR "encoder check failed in %d of %d runs\n", failed, maxthreads );
+	else Con_Printf( "encoder check passed, all packets match serial encoder\n" );
+}
+
+/*
+=======================
+SV_DeltaBench_f
+
+compare entity states recorded in packet
+entities with scalar and compiled delta tables
+=======================
+*/
+void SV_DeltaBench_f( void )
+{
+	entity_state_t	**from, **to, **last;
+	int		*delta_type;
+	int		i, numpairs = 0;
+	int		iterations;
+
+	if( sv.state != ss_active || !svs.packet_entities )
+	{
+		Con_Printf( "Server is not active\n" );
+		return;
+	}
+
+	iterations = Cmd_Argc() > 1 ? Q_atoi( Cmd_Argv( 1 )) : 100;
+	iterations = Q_max( iterations, 1 );
+
+	from = Z_Malloc( sizeof( *from ) * svs.num_client_entities );
+	to = Z_Malloc( sizeof( *to ) * svs.num_client_entities );
+	delta_type = Z_Malloc( sizeof( *delta_type ) * svs.num_client_entities );
+	last = Z_Calloc( sizeof( *last ) * GI->max_edicts );
+
+	// pair every state with the previous state of the same entity
+	for( i = 0; i < svs.num_client_entities; i++ )
+	{
+		entity_state_t	*state = &svs.packet_entities[i];
+
+		if( state->number <= 0 || state->number >= GI->max_edicts )
+			continue;
+
+		if( last[state->number] )
+		{
+			from[numpairs] = last[state->number];
+			to[numpairs] = state;
+			delta_type[numpairs] = ( state->number <= svs.maxclients ) ? DELTA_PLAYER : DELTA_ENTITY;
+			numpairs++;
+		}
+
+		last[state->number] = state;
+	}
+
+	if( numpairs ) Delta_CompareBench( from, to, delta_type, numpairs, iterations, sv.time );
+	else Con_Printf( "No recorded entity states, connect a client first\n" );
+
+	Z_Free( from );
+	Z_Free( to );
+	Z_Free( delta_type );
+	Z_Free( last );
 }
 
 /*
@@ -784,7 +1846,10 @@ void SV_UpdateToReliableMessages( void )
 
 		if( FBitSet( cl->flags, FCL_RESEND_MOVEVARS ))
 		{
+			int	startbit = MSG_GetNumBitsWritten( &cl->netchan.message );
+
 			SV_FullUpdateMovevars( cl, &cl->netchan.message );
+			SV_NETSTATS_SINCE( cl, svc_deltamovevars, startbit );
 			ClearBits( cl->flags, FCL_RESEND_MOVEVARS );
 		}
 	}
@@ -823,6 +1888,9 @@ void SV_UpdateToReliableMessages( void )
 				MSG_WriteBits( &cl->datagram, MSG_GetBuf( &sv.spec_datagram ), MSG_GetNumBitsWritten( &sv.spec_datagram ));
 			else Con_DPrintf( S_WARN "Ignoring spectator datagram for %s, would overflow\n", cl->name );
 		}
+
+		if( cl->netstats )
+			SV_NetStatsShared( cl, MSG_GetNumBitsWritten( &sv.reliable_datagram ) + MSG_GetNumBitsWritten( &sv.datagram ));
 	}
 
 	// now clear the reliable and datagram buffers.
@@ -838,13 +1906,19 @@ SV_SendClientMessages
 */
 void SV_SendClientMessages( void )
 {
+	sv_encode_job_t	*jobs[MAX_CLIENTS];
 	sv_client_t	*cl;
-	int		i;
+	int		i, numjobs = 0;
 
 	if( sv.state == ss_dead )
 		return;
 
 	SV_UpdateToReliableMessages ();
+	SV_UpdateEncodePool ();
+	SV_UpdateDeltaCaches ();
+
+	// gather all datagrams into a single syscall
+	NET_BeginBatch( NS_SERVER );
 
 	// send a message to each connected client
 	for( i = 0, sv.current_client = svs.clients; i < svs.maxclients; i++, sv.current_client++ )
@@ -906,13 +1980,51 @@ void SV_SendClientMessages( void )
 
 			// NOTE: we should send frame even if server is not simulated to prevent overflow
 			if( cl->state == cs_spawned )
-				SV_SendClientDatagram( cl );
+			{
+				if( sv_encode.pool != NULL )
+				{
+					// encode later on workers
+					jobs[numjobs] = SV_GetEncodeJob( numjobs );
+					SV_PrepareClientDatagram( cl, jobs[numjobs] );
+					SV_StoreClientUnreliable( cl, jobs[numjobs] );
+
+					// delta source may roll off the circular buffer while
+					// other clients are prepared, so encode it right now
+					if( jobs[numjobs]->first_old_entity <= svs.next_client_entities + svs.maxclients * MAX_VISIBLE_PACKET - svs.num_client_entities )
+					{
+						SV_EncodeClientDatagram( jobs, numjobs, 0 );
+						jobs[numjobs]->encoded = true;
+					}
+					numjobs++;
+				}
+				else
+				{
+					SV_PROFILE_BEGIN( "SV_SendClientDatagram" );
+					SV_SendClientDatagram( cl );
+					SV_PROFILE_END();
+				}
+			}
 			else Netchan_TransmitBits( &cl->netchan, 0, NULL ); // just update reliable
 		}
 	}
 
 	// reset current client
 	sv.current_client = NULL;
+
+	if( numjobs )
+	{
+		SV_PROFILE_BEGIN( "EncodeClientDatagrams" );
+		ThreadPool_ParallelFor( sv_encode.pool, SV_EncodeClientDatagram, jobs, numjobs );
+		SV_PROFILE_END();
+
+		// send in the same order as serial path does
+		SV_PROFILE_BEGIN( "TransmitClientDatagrams" );
+		for( i = 0; i < numjobs; i++ )
+			SV_TransmitClientDatagram( jobs[i] );
+		SV_PROFILE_END();
+	}
+
+	NET_EndBatch( NS_SERVER );
 }
 
 /*
@@ -423,6 +423,7 @@ static int SV_Multicast( int dest, const vec3_t origin, const edict_t *ent, qboo
 		if( specproxy ) MSG_WriteBits( &sv.spec_datagram, MSG_GetData( &sv.multicast ), MSG_GetNumBitsWritten( &sv.multicast ));
 		else if( reliable ) MSG_WriteBits( &cl->netchan.message, MSG_GetData( &sv.multicast ), MSG_GetNumBitsWritten( &sv.multicast ));
 		else MSG_WriteBits( &cl->datagram, MSG_GetData( &sv.multicast ), MSG_GetNumBitsWritten( &sv.multicast ));
+		SV_NETSTATS( cl, sv.multicast.pData[0], MSG_GetNumBitsWritten( &sv.multicast ));
 		numsends++;
 	}
 
@@ -979,6 +980,7 @@ void SV_InitEdict( edict_t *pEdict )
 	Assert( pEdict != NULL );
 
 	SV_FreePrivateData( pEdict );
+	SV_InitQueryEdict( pEdict );
 	memset( &pEdict->v, 0, sizeof( entvars_t ));
 	pEdict->v.pContainingEntity = pEdict;
 	pEdict->v.controller[0] = 0x7F;
@@ -1002,6 +1004,7 @@ void SV_FreeEdict( edict_t *pEdict )
 
 	// unlink from world
 	SV_UnlinkEdict( pEdict );
+	SV_RemoveQueryEdict( pEdict );
 
 	SV_FreePrivateData( pEdict );
 
@@ -1023,6 +1026,8 @@ void SV_FreeEdict( edict_t *pEdict )
 	VectorClear( pEdict->v.angles );
 	VectorClear( pEdict->v.origin );
 	pEdict->free = true;
+
+	SV_RelinkFindIndex( pEdict );
 }
 
 /*
@@ -1124,6 +1129,7 @@ edict_t* SV_AllocPrivateData( edict_t *ent, string_t className )
 	}
 
 	SpawnEdict( &ent->v );
+	SV_RelinkFindIndex( ent );
 
 	return ent;
 }
@@ -1524,6 +1530,364 @@ void GAME_EXPORT pfnChangePitch( edict_t* ent )
 	ent->v.angles[PITCH] = SV_AngleMod( ent->v.idealpitch, ent->v.angles[PITCH], ent->v.pitch_speed );
 }
 
+/*
+=============================================================================
+
+ENTITY LOOKUP INDEX
+
+string fields are written by the game dll directly, so the index is
+relinked when the engine sees an entity spawn, free or move, resynced
+once per frame, and before every lookup the edicts between the start
+and the answer are checked against entvars, so result is always the
+same as linear scan would give
+=============================================================================
+*/
+#define FINDINDEX_HASHSIZE	1024
+#define FINDINDEX_FIELD( ed, ofs )	(*(string_t *)((byte *)&(ed)->v + (ofs)))
+
+static const struct
+{
+	const char	*name;
+	int		offset;
+} sv_findfields[] =
+{
+{ "classname",	offsetof( entvars_t, classname ) },
+{ "targetname",	offsetof( entvars_t, targetname ) },
+{ "target",	offsetof( entvars_t, target ) },
+{ "globalname",	offsetof( entvars_t, globalname ) },
+};
+
+#define FINDINDEX_FIELDS	ARRAYSIZE( sv_findfields )
+
+typedef struct
+{
+	int		buckets[FINDINDEX_HASHSIZE];	// first edict of the chain, 0 is empty
+	int		tails[FINDINDEX_HASHSIZE];	// last edict of the chain
+	int		*next;			// chains are sorted by edict number
+	int		*prev;
+	string_t		*value;			// value at last relink, 0 if not linked
+	uint		*hash;
+} findfield_t;
+
+typedef struct findindex_s
+{
+	findfield_t	fields[FINDINDEX_FIELDS];
+	int		numlinked;		// no linked edicts above this
+	qboolean		dirty;			// resync all edicts before next lookup
+} findindex_t;
+
+static struct
+{
+	uint		hits;			// answered by index
+	uint		fallbacks;		// linear scans
+	uint		stale;			// fields changed behind our back
+	uint		resyncs;			// full passes over edicts
+} sv_findstats;
+
+/*
+=========
+SV_GetFindIndex
+
+allocated once per game dll, edicts array has fixed size
+=========
+*/
+static findindex_t *SV_GetFindIndex( void )
+{
+	findindex_t	*fi = svgame.findindex;
+	findfield_t	*f;
+	int		i;
+
+	if( fi || !svgame.mempool || !svgame.edicts )
+		return fi;
+
+	fi = Mem_Calloc( svgame.mempool, sizeof( *fi ));
+
+	for( i = 0; i < FINDINDEX_FIELDS; i++ )
+	{
+		f = &fi->fields[i];
+		f->next = Mem_Calloc( svgame.mempool, sizeof( int ) * GI->max_edicts );
+		f->prev = Mem_Calloc( svgame.mempool, sizeof( int ) * GI->max_edicts );
+		f->value = Mem_Calloc( svgame.mempool, sizeof( string_t ) * GI->max_edicts );
+		f->hash = Mem_Calloc( svgame.mempool, sizeof( uint ) * GI->max_edicts );
+	}
+
+	fi->dirty = true;
+	svgame.findindex = fi;
+
+	return fi;
+}
+
+/*
+=========
+SV_UnlinkFindField
+
+=========
+*/
+static void SV_UnlinkFindField( findfield_t *f, int e )
+{
+	int	next = f->next[e];
+	int	prev = f->prev[e];
+
+	if( prev ) f->next[prev] = next;
+	else f->buckets[f->hash[e]] = next;
+
+	if( next ) f->prev[next] = prev;
+	else f->tails[f->hash[e]] = prev;
+
+	f->next[e] = f->prev[e] = 0;
+	f->value[e] = 0;
+}
+
+/*
+=========
+SV_LinkFindField
+
+keep chain sorted, so lookup can continue from the start edict
+=========
+*/
+static void SV_LinkFindField( findfield_t *f, int e, string_t value, const char *s )
+{
+	uint	hash = COM_HashKey( s, FINDINDEX_HASHSIZE );
+	int	prev, next;
+
+	if( f->tails[hash] < e )
+	{
+		// entities are mostly spawned in ascending order
+		prev = f->tails[hash];
+		next = 0;
+	}
+	else
+	{
+		for( prev = 0, next = f->buckets[hash]; next && next < e; next = f->next[next] )
+			prev = next;
+	}
+
+	if( prev ) f->next[prev] = e;
+	else f->buckets[hash] = e;
+
+	if( next ) f->prev[next] = e;
+	else f->tails[hash] = e;
+
+	f->prev[e] = prev;
+	f->next[e] = next;
+	f->value[e] = value;
+	f->hash[e] = hash;
+}
+
+/*
+=========
+SV_RelinkFindFields
+
+=========
+*/
+static qboolean SV_RelinkFindField( findindex_t *fi, int field, int e )
+{
+	findfield_t	*f = &fi->fields[field];
+	edict_t		*ed = EDICT_NUM( e );
+	const char	*s;
+	string_t		value;
+
+	// world is never returned by lookups
+	if( e > 0 && e < svgame.numEntities && !ed->free )
+		value = FINDINDEX_FIELD( ed, sv_findfields[field].offset );
+	else value = 0;
+
+	if( value == f->value[e] )
+		return false;
+
+	if( f->value[e] )
+		SV_UnlinkFindField( f, e );
+
+	if( !value ) return true;
+
+	s = STRING( value );
+
+	if( COM_CheckString( s ))
+		SV_LinkFindField( f, e, value, s );
+
+	return true;
+}
+
+/*
+=========
+SV_RelinkFindFields
+
+=========
+*/
+static void SV_RelinkFindFields( findindex_t *fi, int e )
+{
+	int	i;
+
+	for( i = 0; i < FINDINDEX_FIELDS; i++ )
+		SV_RelinkFindField( fi, i, e );
+}
+
+/*
+=========
+SV_ResyncFindIndex
+
+=========
+*/
+static void SV_ResyncFindIndex( findindex_t *fi )
+{
+	int	e, numlinked;
+
+	numlinked = Q_max( fi->numlinked, svgame.numEntities );
+
+	for( e = 1; e < numlinked; e++ )
+		SV_RelinkFindFields( fi, e );
+
+	fi->numlinked = svgame.numEntities;
+	fi->dirty = false;
+	sv_findstats.resyncs++;
+}
+
+/*
+=========
+SV_RelinkFindIndex
+
+called when engine knows entity was spawned, freed or moved
+=========
+*/
+void SV_RelinkFindIndex( edict_t *ed )
+{
+	findindex_t	*fi = svgame.findindex;
+	int		e;
+
+	if( !fi || !ed ) return;
+
+	e = NUM_FOR_EDICT( ed );
+
+	if( e <= 0 || e >= GI->max_edicts )
+		return;
+
+	SV_RelinkFindFields( fi, e );
+	fi->numlinked = Q_max( fi->numlinked, e + 1 );
+}
+
+/*
+=========
+SV_InvalidateFindIndex
+
+game could change anything, resync before next lookup
+=========
+*/
+void SV_InvalidateFindIndex( void )
+{
+	if( svgame.findindex )
+		svgame.findindex->dirty = true;
+}
+
+/*
+=========
+SV_FindIndexChain
+
+first entity after the start in the chain that
+matches now, 0 if there is none
+=========
+*/
+static int SV_FindIndexChain( findfield_t *f, int field, int start, uint hash, const char *pszValue )
+{
+	string_t	value;
+	edict_t	*ed;
+	int	e;
+
+	// iterating callers pass previous result, so chain walk is not restarted
+	if( start > 0 && f->value[start] && f->hash[start] == hash )
+		e = f->next[start];
+	else for( e = f->buckets[hash]; e && e <= start; e = f->next[e] );
+
+	for( ; e && e < svgame.numEntities; e = f->next[e] )
+	{
+		ed = EDICT_NUM( e );
+
+		if( !SV_IsValidEdict( ed )) continue;
+
+		if( e <= svs.maxclients && !SV_ClientFromEdict( ed, ( svs.maxclients != 1 )))
+			continue;
+
+		value = FINDINDEX_FIELD( ed, sv_findfields[field].offset );
+
+		if( value && !Q_strcmp( STRING( value ), pszValue ))
+			return e;
+	}
+
+	return 0;
+}
+
+/*
+=========
+SV_FindIndexLookup
+
+returns false if index can't be used and caller must scan edicts.
+Game dll may write fields directly, so edicts which are skipped by
+the answer are checked against entvars and relinked if changed
+=========
+*/
+static qboolean SV_FindIndexLookup( int fieldOffset, int start, const char *pszValue, edict_t **result )
+{
+	findindex_t	*fi;
+	findfield_t	*f;
+	uint		hash;
+	int		i, e, limit;
+
+	if( !sv_find_index.value )
+		return false;
+
+	for( i = 0; i < FINDINDEX_FIELDS; i++ )
+	{
+		if( sv_findfields[i].offset == fieldOffset )
+			break;
+	}
+
+	if( i == FINDINDEX_FIELDS || ( fi = SV_GetFindIndex( )) == NULL )
+		return false;
+
+	if( fi->dirty ) SV_ResyncFindIndex( fi );
+
+	f = &fi->fields[i];
+	hash = COM_HashKey( pszValue, FINDINDEX_HASHSIZE );
+
+	// answer can't be farther than first indexed match,
+	// but directly written edicts may be before it
+	limit = SV_FindIndexChain( f, i, start, hash, pszValue );
+	if( !limit ) limit = Q_max( fi->numlinked, svgame.numEntities ) - 1;
+
+	for( e = start + 1; e <= limit; e++ )
+	{
+		if( SV_RelinkFindField( fi, i, e ))
+			sv_findstats.stale++;
+	}
+
+	fi->numlinked = Q_max( fi->numlinked, svgame.numEntities );
+	sv_findstats.hits++;
+
+	if(( e = SV_FindIndexChain( f, i, start, hash, pszValue )) != 0 )
+		*result = EDICT_NUM( e );
+	else *result = svgame.edicts;
+
+	return true;
+}
+
+/*
+=========
+SV_FindIndexStats_f
+
+=========
+*/
+void SV_FindIndexStats_f( void )
+{
+	uint	total = sv_findstats.hits + sv_findstats.fallbacks;
+
+	Con_Printf( "entity lookup index: %s\n", sv_find_index.value ? "enabled" : "disabled" );
+	Con_Printf( "%u lookups, %u index hits, %u fallbacks (%.1f%% indexed)\n", total, sv_findstats.hits,
+		sv_findstats.fallbacks, total ? sv_findstats.hits * 100.0 / total : 0.0 );
+	Con_Printf( "%u stale entries detected, %u resyncs\n", sv_findstats.stale, sv_findstats.resyncs );
+
+	if( Cmd_Argc() > 1 && !Q_stricmp( Cmd_Argv( 1 ), "reset" ))
+		memset( &sv_findstats, 0, sizeof( sv_findstats ));
+}
+
 /*
 =========
 SV_FindEntityByString
@@ -1554,6 +1918,11 @@ edict_t *SV_FindEntityByString( edict_t *pStartEdict, const char *pszField, cons
 		return svgame.edicts;
 	}
 
+	if( SV_FindIndexLookup( desc->fieldOffset, e, pszValue, &ed ))
+		return ed;
+
+	sv_findstats.fallbacks++;
+
 	for( e++; e < svgame.numEntities; e++ )
 	{
 		ed = EDICT_NUM( e );
@@ -1633,6 +2002,9 @@ edict_t *pfnFindEntityInSphere( edict_t *pStartEdict, const float *org, float fl
 	float	eorg;
 	edict_t	*ent;
 
+	if( SV_QueryEntityInSphere( pStartEdict, org, flRadius, &ent ))
+		return ent;
+
 	flRadius *= flRadius;
 
 	if( SV_IsValidEdict( pStartEdict ))
@@ -1810,6 +2182,9 @@ edict_t *pfnEntitiesInPVS( edict_t *pview )
 	if( !SV_IsValidEdict( pview ))
 		return NULL;
 
+	if( SV_QueryEntitiesInPVS( pview, &pchain ))
+		return pchain;
+
 	VectorAdd( pview->v.origin, pview->v.view_ofs, viewpoint );
 	pchain = EDICT_NUM( 0 );
 
@@ -2473,8 +2848,11 @@ void GAME_EXPORT pfnClientCommand( edict_t* pEdict, char* szFmt, ... )
 
 	if( SV_IsValidCmd( buffer ))
 	{
+		int	startbit = MSG_GetNumBitsWritten( &cl->netchan.message );
+
 		MSG_BeginServerCmd( &cl->netchan.message, svc_stufftext );
 		MSG_WriteString( &cl->netchan.message, buffer );
+		SV_NETSTATS_SINCE( cl, svc_stufftext, startbit );
 	}
 	else Con_Printf( S_ERROR "Tried to stuff bad command %s\n", buffer );
 }
@@ -2989,10 +3367,19 @@ void *pfnPvEntPrivateData( edict_t *pEdict )
 
 
 #ifdef XASH_64BIT
+#define STR64_HASH_MIN	4096	// must be power of two
+
+typedef struct
+{
+	uint hash;
+	uint offset;	// from pstringarray, zero is free slot
+} str64hash_t;
+
 static struct str64_s
 {
 	size_t maxstringarray;
 	qboolean allowdup;
+	qboolean nohash;
 	char *staticstringarray;
 	char *pstringarray;
 	char *pstringarraystatic;
@@ -3004,7 +3391,132 @@ static struct str64_s
 	size_t numdups;
 	size_t numoverflows;
 	size_t totalalloc;
+	size_t numallocs;
+
+	// index of strings between poldstringbase and plast
+	str64hash_t *hashtable;
+	size_t hashsize;
+	size_t hashcount;
+	size_t numlookups;
+	size_t numprobes;
+	size_t maxprobes;
+	size_t numgrows;
+	size_t numclears;
+
+	// last map spawn
+	size_t spawnallocs;
+	double spawntime;
 } str64;
+
+/*
+==================
+SV_Str64Hash
+
+==================
+*/
+static uint SV_Str64Hash( const char *s )
+{
+	uint	hash = 2166136261u;
+
+	while( *s )
+	{
+		hash ^= (byte)*s++;
+		hash *= 16777619u;
+	}
+
+	return hash;
+}
+
+/*
+==================
+SV_Str64ClearHash
+
+called when search range is restarted
+==================
+*/
+static void SV_Str64ClearHash( void )
+{
+	if( !str64.hashtable )
+		return;
+
+	memset( str64.hashtable, 0, str64.hashsize * sizeof( *str64.hashtable ));
+	str64.hashcount = 0;
+	str64.numclears++;
+}
+
+/*
+==================
+SV_Str64InsertHash
+
+==================
+*/
+static void SV_Str64InsertHash( str64hash_t *table, size_t size, uint hash, uint offset )
+{
+	size_t	i = hash & ( size - 1 );
+
+	while( table[i].offset )
+		i = ( i + 1 ) & ( size - 1 );
+
+	table[i].hash = hash;
+	table[i].offset = offset;
+}
+
+/*
+==================
+SV_Str64GrowHash
+
+keep load factor below one half
+==================
+*/
+static void SV_Str64GrowHash( void )
+{
+	size_t	i, newsize = str64.hashsize * 2;
+	str64hash_t	*newtable;
+
+	newtable = Mem_Calloc( host.mempool, newsize * sizeof( *newtable ));
+
+	for( i = 0; i < str64.hashsize; i++ )
+	{
+		if( str64.hashtable[i].offset )
+			SV_Str64InsertHash( newtable, newsize, str64.hashtable[i].hash, str64.hashtable[i].offset );
+	}
+
+	Mem_Free( str64.hashtable );
+	str64.hashtable = newtable;
+	str64.hashsize = newsize;
+	str64.numgrows++;
+}
+
+/*
+==================
+SV_Str64FindHash
+
+==================
+*/
+static const char *SV_Str64FindHash( const char *szValue, uint hash )
+{
+	size_t	i = hash & ( str64.hashsize - 1 );
+	size_t	probes = 1;
+	const char	*result = NULL;
+
+	for( ; str64.hashtable[i].offset; i = ( i + 1 ) & ( str64.hashsize - 1 ), probes++ )
+	{
+		const char *s = str64.pstringarray + str64.hashtable[i].offset;
+
+		if( str64.hashtable[i].hash == hash && !Q_strcmp( s, szValue ))
+		{
+			result = s;
+			break;
+		}
+	}
+
+	str64.numlookups++;
+	str64.numprobes += probes;
+	if( probes > str64.maxprobes )
+		str64.maxprobes = probes;
+
+	return result;
+}
 #endif
 
 /*
@@ -3023,6 +3535,7 @@ void SV_EmptyStringPool( void )
 	{
 		str64.pstringbase = str64.poldstringbase = str64.pstringarraystatic;
 		str64.plast = str64.pstringbase + 1;
+		SV_Str64ClearHash();
 	}
 #else
 	Mem_EmptyPool( svgame.stringspool );
@@ -3085,6 +3598,8 @@ void SV_AllocStringPool( void )
 	else str64.maxstringarray = 65536;
 	if( Sys_CheckParm( "-str64dup" ) )
 		str64.allowdup = true;
+	if( Sys_CheckParm( "-str64nohash" ) )
+		str64.nohash = true;
 
 #ifdef USE_MMAP
 	{
@@ -3142,6 +3657,14 @@ void SV_AllocStringPool( void )
 	str64.pstringbase = str64.poldstringbase = ptr;
 	str64.plast = (byte*)ptr + 1;
 	svgame.globals->pStringBase = ptr;
+
+	if( !str64.allowdup && !str64.nohash )
+	{
+		// average entity string is about sixteen bytes
+		for( str64.hashsize = STR64_HASH_MIN; str64.hashsize < str64.maxstringarray / 8; str64.hashsize <<= 1 );
+		str64.hashtable = Mem_Calloc( host.mempool, str64.hashsize * sizeof( *str64.hashtable ));
+		str64.hashcount = 0;
+	}
 #else
 	svgame.stringspool = Mem_AllocPool( "Server Strings" );
 	svgame.globals->pStringBase = "";
@@ -3153,6 +3676,13 @@ void SV_FreeStringPool( void )
 #ifdef XASH_64BIT
 	Con_Reportf( "SV_FreeStringPool()\n" );
 
+	if( str64.hashtable )
+	{
+		Mem_Free( str64.hashtable );
+		str64.hashtable = NULL;
+		str64.hashsize = str64.hashcount = 0;
+	}
+
 #ifdef USE_MMAP
 	if( str64.pstringarray != str64.staticstringarray )
 		munmap( str64.pstringarray, (str64.maxstringarray * 2) & ~(sysconf( _SC_PAGESIZE ) - 1) );
@@ -3172,20 +3702,31 @@ allocate new engine string
 on 64bit platforms find in array string if deduplication enabled (default)
 if not found, add to array
 use -str64dup to disable deduplication, -str64alloc to set array size
+use -str64nohash to search the whole array instead of hash table
 =============
 */
 string_t GAME_EXPORT SV_AllocString( const char *szValue )
 {
 	const char *newString = NULL;
 	int cmp;
+#ifdef XASH_64BIT
+	uint hash = 0;
+#endif
 
 	if( svgame.physFuncs.pfnAllocString != NULL )
 		return svgame.physFuncs.pfnAllocString( szValue );
 
 #ifdef XASH_64BIT
 	cmp = 1;
+	str64.numallocs++;
 
-	if( !str64.allowdup )
+	if( str64.hashtable )
+	{
+		hash = SV_Str64Hash( szValue );
+		newString = SV_Str64FindHash( szValue, hash );
+		if( newString ) cmp = 0;
+	}
+	else if( !str64.allowdup )
 		for( newString = str64.poldstringbase + 1;
 			newString < str64.plast && ( cmp = Q_strcmp( newString, szValue ) );
 			newString += Q_strlen( newString ) + 1 );
@@ -3199,6 +3740,7 @@ string_t GAME_EXPORT SV_AllocString( const char *szValue )
 			str64.plast = str64.pstringbase + 1;
 			str64.poldstringbase = str64.pstringbase;
 			str64.numoverflows++;
+			SV_Str64ClearHash();
 		}
 
 		//MsgDev( D_NOTE, "SV_AllocString: %ld %s\n", str64.plast - svgame.globals->pStringBase, szValue );
@@ -3207,6 +3749,15 @@ string_t GAME_EXPORT SV_AllocString( const char *szValue )
 
 		newString = str64.plast;
 		str64.plast += len + 1;
+
+		if( str64.hashtable )
+		{
+			if(( str64.hashcount + 1 ) * 2 > str64.hashsize )
+				SV_Str64GrowHash();
+
+			SV_Str64InsertHash( str64.hashtable, str64.hashsize, hash, newString - str64.pstringarray );
+			str64.hashcount++;
+		}
 	}
 	else
 		str64.numdups++;
@@ -3233,6 +3784,18 @@ void SV_PrintStr64Stats_f( void )
 	Msg( "maximum array usage: %lu\n", str64.maxalloc );
 	Msg( "overflow counter: %lu\n", str64.numoverflows );
 	Msg( "dup string counter: %lu\n", str64.numdups );
+	Msg( "alloc calls: %lu\n", str64.numallocs );
+
+	if( str64.hashtable )
+	{
+		Msg( "hash table: %lu of %lu slots used\n", str64.hashcount, str64.hashsize );
+		Msg( "hash lookups: %lu, %.2f probes average, %lu max\n", str64.numlookups,
+			str64.numlookups ? (double)str64.numprobes / str64.numlookups : 0.0, str64.maxprobes );
+		Msg( "hash grows: %lu, clears: %lu\n", str64.numgrows, str64.numclears );
+	}
+	else Msg( "hash table: %s\n", str64.allowdup ? "off (-str64dup)" : "off (-str64nohash)" );
+
+	Msg( "last map spawn: %lu alloc calls, %.2f ms\n", str64.spawnallocs, str64.spawntime * 1000.0 );
 }
 #endif
 
@@ -3523,6 +4086,7 @@ pfnClientPrintf
 void GAME_EXPORT pfnClientPrintf( edict_t* pEdict, PRINT_TYPE ptype, const char *szMsg )
 {
 	sv_client_t	*client;
+	int		startbit;
 
 	if(( client = SV_ClientFromEdict( pEdict, false )) == NULL )
 	{
@@ -3540,8 +4104,10 @@ void GAME_EXPORT pfnClientPrintf( edict_t* pEdict, PRINT_TYPE ptype, const char
 		SV_ClientPrintf( client, "%s", szMsg );
 		break;
 	case print_center:
+		startbit = MSG_GetNumBitsWritten( &client->netchan.message );
 		MSG_BeginServerCmd( &client->netchan.message, svc_centerprint );
 		MSG_WriteString( &client->netchan.message, szMsg );
+		SV_NETSTATS_SINCE( client, svc_centerprint, startbit );
 		break;
 	}
 }
@@ -3598,6 +4164,7 @@ void GAME_EXPORT pfnCrosshairAngle( const edict_t *pClient, float pitch, float y
 	MSG_BeginServerCmd( &client->netchan.message, svc_crosshairangle );
 	MSG_WriteChar( &client->netchan.message, pitch * 5 );
 	MSG_WriteChar( &client->netchan.message, yaw * 5 );
+	SV_NETSTATS( client, svc_crosshairangle, 8 + 8 + 8 );
 }
 
 /*
@@ -3634,6 +4201,7 @@ void GAME_EXPORT pfnSetView( const edict_t *pClient, const edict_t *pViewent )
 
 	MSG_BeginServerCmd( &client->netchan.message, svc_setview );
 	MSG_WriteWord( &client->netchan.message, viewEnt );
+	SV_NETSTATS( client, svc_setview, 8 + 16 );
 }
 
 /*
@@ -3707,6 +4275,7 @@ void GAME_EXPORT pfnFadeClientVolume( const edict_t *pEdict, int fadePercent, in
 	MSG_WriteByte( &cl->netchan.message, holdTime );
 	MSG_WriteByte( &cl->netchan.message, fadeOutSeconds );
 	MSG_WriteByte( &cl->netchan.message, fadeInSeconds );
+	SV_NETSTATS( cl, svc_soundfade, 8 + 4 * 8 );
 }
 
 /*
@@ -3947,6 +4516,7 @@ void GAME_EXPORT SV_PlaybackEventFull( int flags, const edict_t *pInvoker, word
 	event_info_t	*ei = NULL;
 	int		j, slot, bestslot;
 	int		invokerIndex;
+	int		startbit;
 	byte		*mask = NULL;
 	vec3_t		pvspoint;
 
@@ -4085,7 +4655,9 @@ void GAME_EXPORT SV_PlaybackEventFull( int flags, const edict_t *pInvoker, word
 		if( FBitSet( flags, FEV_RELIABLE ))
 		{
 			// skipping queue, write direct into reliable datagram
+			startbit = MSG_GetNumBitsWritten( &cl->netchan.message );
 			SV_PlaybackReliableEvent( &cl->netchan.message, eventindex, delay, &args );
+			SV_NETSTATS( cl, svc_event_reliable, MSG_GetNumBitsWritten( &cl->netchan.message ) - startbit );
 			continue;
 		}
 
@@ -4510,8 +5082,11 @@ void GAME_EXPORT pfnQueryClientCvarValue( const edict_t *player, const char *cva
 
 	if(( cl = SV_ClientFromEdict( player, true )) != NULL )
 	{
+		int	startbit = MSG_GetNumBitsWritten( &cl->netchan.message );
+
 		MSG_BeginServerCmd( &cl->netchan.message, svc_querycvarvalue );
 		MSG_WriteString( &cl->netchan.message, cvarName );
+		SV_NETSTATS_SINCE( cl, svc_querycvarvalue, startbit );
 	}
 	else
 	{
@@ -4537,9 +5112,12 @@ void GAME_EXPORT pfnQueryClientCvarValue2( const edict_t *player, const char *cv
 
 	if(( cl = SV_ClientFromEdict( player, true )) != NULL )
 	{
+		int	startbit = MSG_GetNumBitsWritten( &cl->netchan.message );
+
 		MSG_BeginServerCmd( &cl->netchan.message, svc_querycvarvalue2 );
 		MSG_WriteLong( &cl->netchan.message, requestID );
 		MSG_WriteString( &cl->netchan.message, cvarName );
+		SV_NETSTATS_SINCE( cl, svc_querycvarvalue2, startbit );
 	}
 	else
 	{
@@ -4937,10 +5515,12 @@ void SV_LoadFromFile( const char *mapname, char *entities )
 					inhibited++;
 				}
 			}
+			else SV_RelinkFindIndex( ent );
 		}
 
 		Con_DPrintf( "\n%i entities inhibited\n", inhibited );
 	}
+	else SV_InvalidateFindIndex();
 
 	// reset world origin and angles for some reason
 	VectorClear( svgame.edicts->v.origin );
@@ -4987,7 +5567,19 @@ void SV_SpawnEntities( const char *mapname )
 	svgame.globals->time = sv.time;
 
 	// spawn the rest of the entities on the map
+#ifdef XASH_64BIT
+	{
+		size_t	allocs = str64.numallocs;
+		double	start = Sys_DoubleTime();
+
+		SV_LoadFromFile( mapname, sv.worldmodel->entities );
+
+		str64.spawntime = Sys_DoubleTime() - start;
+		str64.spawnallocs = str64.numallocs - allocs;
+	}
+#else
 	SV_LoadFromFile( mapname, sv.worldmodel->entities );
+#endif
 }
 
 void SV_UnloadProgs( void )
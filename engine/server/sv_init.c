@@ -526,6 +526,9 @@ void SV_ActivateServer( int runPhysics )
 
 	MSG_Init( &msg, "ActivateServer", msg_buf, sizeof( msg_buf ));
 
+	// map and player list are changed
+	SV_InvalidateQueryCache();
+
 	// always clearing newunit variable
 	Cvar_SetValue( "sv_newunit", 0 );
 
@@ -635,6 +638,7 @@ void SV_DeactivateServer( void )
 	svgame.globals->time = sv.time;
 	svgame.dllFuncs.pfnServerDeactivate();
 	Host_SetServerState( ss_dead );
+	SV_InvalidateQueryCache();
 
 	SV_FreeEdicts ();
 
@@ -648,11 +652,15 @@ void SV_DeactivateServer( void )
 		if( svs.clients[i].frames )
 			Mem_Free( svs.clients[i].frames );
 		svs.clients[i].frames = NULL;
+
+		// entity numbers are meaningless on next map
+		SV_FreeEntityPriority( &svs.clients[i] );
 	}
 
 	svgame.globals->maxEntities = GI->max_edicts;
 	svgame.globals->maxClients = svs.maxclients;
 	svgame.numEntities = svs.maxclients + 1; // clients + world
+	SV_InvalidateFindIndex();
 	svgame.globals->startspot = 0;
 	svgame.globals->mapname = 0;
 }
@@ -764,6 +772,7 @@ void SV_SetupClients( void )
 	// init network stuff
 	NET_Config(( svs.maxclients > 1 ));
 	svgame.numEntities = svs.maxclients + 1; // clients + world
+	SV_InvalidateFindIndex();
 	ClearBits( sv_maxclients->flags, FCVAR_CHANGED );
 }
 
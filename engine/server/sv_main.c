@@ -98,6 +98,22 @@ CVAR_DEFINE_AUTO( sv_airmove, "1", FCVAR_SERVER, "obsolete, compatibility issues
 CVAR_DEFINE_AUTO( sv_version, "", FCVAR_READ_ONLY, "engine version string" );
 CVAR_DEFINE_AUTO( hostname, "", FCVAR_SERVER|FCVAR_PRINTABLEONLY, "name of current host" );
 CVAR_DEFINE_AUTO( sv_fps, "0.0", FCVAR_SERVER, "server framerate" );
+CVAR_DEFINE_AUTO( sv_encode_threads, "1", 0, "number of threads used to encode client datagrams, 1 disables workers" );
+CVAR_DEFINE_AUTO( sv_entity_priority, "1", 0, "hold back low priority entity updates when snapshot doesn't fit in client rate" );
+CVAR_DEFINE_AUTO( sv_entity_maxdelay, "0.5", 0, "longest time in seconds an entity update may be held back" );
+CVAR_DEFINE_AUTO( sv_entity_prio_dist, "512", 0, "distance at which entity snapshot priority is halved" );
+CVAR_DEFINE_AUTO( sv_delta_cache, "1", 0, "reuse encoded entity deltas between clients during the frame" );
+CVAR_DEFINE_AUTO( sv_netstats_log, "0", 0, "seconds between netstats samples appended to netstats.csv or netstats.json, 0 disables" );
+CVAR_DEFINE_AUTO( sv_netstats_format, "csv", 0, "netstats sample format, csv or json" );
+CVAR_DEFINE_AUTO( sv_query_cache, "1", 0, "reuse answers to server queries until server state is changed" );
+CVAR_DEFINE_AUTO( sv_query_rate, "5", 0, "server queries per second answered for one address, 0 disables limit" );
+CVAR_DEFINE_AUTO( sv_query_burst, "15", 0, "server queries one address can send at once before sv_query_rate applies" );
+CVAR_DEFINE_AUTO( sv_query_rate_total, "0", 0, "server queries per second answered for all addresses together, 0 disables limit" );
+CVAR_DEFINE_AUTO( sv_query_challenge, "0", 0, "require a challenge in A2S_INFO queries, makes reflection useless" );
+CVAR_DEFINE_AUTO( sv_area_adaptive, "0", 0, "split crowded areanodes as entities move, 0 keeps the fixed tree" );
+CVAR_DEFINE_AUTO( sv_spatial_query, "1", 0, "answer FindEntityInSphere and EntitiesInPVS from entity grid instead of scanning all edicts" );
+CVAR_DEFINE_AUTO( sv_leaf_index, "1", 0, "visit only entities in visible leafs when building client packets" );
+CVAR_DEFINE_AUTO( sv_find_index, "1", 0, "use hashed index for classname, targetname, target and globalname lookups" );
 
 // gore-related cvars
 CVAR_DEFINE_AUTO( violence_hblood, "1", 0, "draw human blood" );
@@ -352,10 +368,11 @@ void SV_ReadPackets( void )
 	sv_client_t	*cl;
 	int		i, qport;
 	size_t		curSize;
+	byte		*packet;
 
-	while( NET_GetPacket( NS_SERVER, &net_from, net_message_buffer, &curSize ))
+	while( NET_GetPacketInPlace( NS_SERVER, &net_from, net_message_buffer, &packet, &curSize ))
 	{
-		MSG_Init( &net_message, "ClientPacket", net_message_buffer, curSize );
+		MSG_Init( &net_message, "ClientPacket", packet, curSize );
 
 		// check for connectionless packet (0xffffffff) first
 		if( MSG_GetMaxBytes( &net_message ) >= 4 && *(int *)net_message.pData == -1 )
@@ -586,7 +603,9 @@ qboolean SV_RunGameFrame( void )
 		{
 			sv.frametime = fps;
 
+			SV_PROFILE_BEGIN( "SV_Physics" );
 			SV_Physics();
+			SV_PROFILE_END();
 
 			sv.time_residual -= fps;
 			sv.time += fps;
@@ -597,7 +616,9 @@ qboolean SV_RunGameFrame( void )
 	}
 	else
 	{
+		SV_PROFILE_BEGIN( "SV_Physics" );
 		SV_Physics();
+		SV_PROFILE_END();
 		sv.time += sv.frametime;
 		return true;
 	}
@@ -614,6 +635,8 @@ void Host_ServerFrame( void )
 	// if server is not active, do nothing
 	if( !svs.initialized ) return;
 
+	SV_ProfileBeginFrame ();
+
 	if( sv_fps.value != 0.0f && ( sv.simulating || sv.state != ss_active ))
 		sv.time_residual += host.frametime;
 
@@ -625,7 +648,9 @@ void Host_ServerFrame( void )
 	SV_CheckCmdTimes ();
 
 	// read packets from clients
+	SV_PROFILE_BEGIN( "SV_ReadPackets" );
 	SV_ReadPackets ();
+	SV_PROFILE_END();
 
 	// refresh physic movevars on the client side
 	SV_UpdateMovevars ( false );
@@ -637,16 +662,24 @@ void Host_ServerFrame( void )
 	SV_CheckTimeouts ();
 
 	// let everything in the world think and move
-	if( !SV_RunGameFrame ()) return;
+	if( SV_RunGameFrame ())
+	{
+		// send messages back to the clients that had packets read this frame
+		SV_PROFILE_BEGIN( "SV_SendClientMessages" );
+		SV_SendClientMessages ();
+		SV_PROFILE_END();
 
-	// send messages back to the clients that had packets read this frame
-	SV_SendClientMessages ();
+		// count traffic and write samples
+		SV_NetStatsFrame ();
 
-	// clear edict flags for next frame
-	SV_PrepWorldFrame ();
+		// clear edict flags for next frame
+		SV_PrepWorldFrame ();
 
-	// send a heartbeat to the master if needed
-	Master_Heartbeat ();
+		// send a heartbeat to the master if needed
+		Master_Heartbeat ();
+	}
+
+	SV_ProfileEndFrame ();
 }
 
 /*
@@ -930,6 +963,22 @@ void SV_Init( void )
 	Cvar_RegisterVariable( &mp_logecho );
 	Cvar_RegisterVariable( &mp_logfile );
 	Cvar_RegisterVariable( &sv_background_freeze );
+	Cvar_RegisterVariable( &sv_encode_threads );
+	Cvar_RegisterVariable( &sv_entity_priority );
+	Cvar_RegisterVariable( &sv_entity_maxdelay );
+	Cvar_RegisterVariable( &sv_entity_prio_dist );
+	Cvar_RegisterVariable( &sv_delta_cache );
+	Cvar_RegisterVariable( &sv_netstats_log );
+	Cvar_RegisterVariable( &sv_netstats_format );
+	Cvar_RegisterVariable( &sv_query_cache );
+	Cvar_RegisterVariable( &sv_query_rate );
+	Cvar_RegisterVariable( &sv_query_burst );
+	Cvar_RegisterVariable( &sv_query_rate_total );
+	Cvar_RegisterVariable( &sv_query_challenge );
+	Cvar_RegisterVariable( &sv_area_adaptive );
+	Cvar_RegisterVariable( &sv_find_index );
+	Cvar_RegisterVariable( &sv_spatial_query );
+	Cvar_RegisterVariable( &sv_leaf_index );
 
 	sv_allow_joystick = Cvar_Get( "sv_allow_joystick", "1", FCVAR_ARCHIVE, "allow connect with joystick enabled" );
 	sv_allow_mouse = Cvar_Get( "sv_allow_mouse", "1", FCVAR_ARCHIVE, "allow connect with mouse" );
@@ -1010,6 +1059,8 @@ release server clients
 */
 void SV_FreeClients( void )
 {
+	SV_FreeEncodeJobs();
+
 	if( svs.maxclients != 0 )
 	{
 		// free server static data
@@ -1062,6 +1113,8 @@ void SV_Shutdown( const char *finalmsg )
 
 	NET_Config( false );
 	SV_UnloadProgs ();
+	SV_ProfileShutdown ();
+	SV_NetStatsShutdown ();
 	CL_Drop();
 
 	// free current level
@@ -0,0 +1,801 @@
+/*
+sv_netstats.c - per client traffic accounting
+Copyright (C) 2026 Xash3D FWGS contributors
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+*/
+
+#include "common.h"
+#include "server.h"
+#include "net_encode.h"
+
+#define NETSTATS_MAX_MSGS	256		// svc_* and user messages share the byte
+#define NETSTATS_TABLES	3		// entity delta tables
+#define NETSTATS_TOP_FIELDS	16
+
+typedef struct
+{
+	uint		count;
+	uint64_t		bits;
+} netcounter_t;
+
+typedef struct
+{
+	netcounter_t	msgs[NETSTATS_MAX_MSGS];
+	netcounter_t	fields[NETSTATS_TABLES][MAX_DELTA_FIELDS];	// part of packetentities bits
+	netcounter_t	shared;			// reliable and unreliable datagrams sent to everyone
+	netcounter_t	signon;			// serverdata, resources and baselines sent as fragments
+	uint64_t		wire;			// bytes sent by netchan, headers and resends included
+} netcounters_t;
+
+typedef struct sv_netstats_s
+{
+	netcounters_t	total;
+	netcounters_t	last;			// total at previous sample
+	size_t		wirestart;		// netchan.total_sended when counting was started
+	double		starttime;
+} sv_netstats_t;
+
+typedef struct
+{
+	const char	*table;
+	const char	*name;
+	netcounter_t	counter;
+} netstatrow_t;
+
+static const char *netstats_tablenames[NETSTATS_TABLES] =
+{
+	"entity_state_t",
+	"entity_state_player_t",
+	"custom_entity_state_t",
+};
+
+static struct
+{
+	qboolean		enabled;
+	int		tables[NETSTATS_TABLES];	// delta table indices
+	qboolean		tables_found;
+
+	file_t		*log;
+	qboolean		logjson;
+	double		nextsample;
+	double		lastsample;
+
+	netcounters_t	sum;			// scratch for all clients
+	netcounters_t	delta;			// scratch for samples
+	netstatrow_t	rows[NETSTATS_TABLES * MAX_DELTA_FIELDS];
+} netstats;
+
+/*
+=================
+SV_NetStatsMessage
+
+=================
+*/
+void SV_NetStatsMessage( sv_client_t *cl, int cmd, int bits )
+{
+	netcounter_t	*c;
+
+	if( bits <= 0 ) return;
+
+	c = &cl->netstats->total.msgs[cmd & ( NETSTATS_MAX_MSGS - 1 )];
+	c->count++;
+	c->bits += bits;
+}
+
+/*
+=================
+SV_NetStatsFindTables
+
+main thread only, encoding workers read the indices
+=================
+*/
+static void SV_NetStatsFindTables( void )
+{
+	delta_info_t	*dt;
+	int		i, j;
+
+	if( netstats.tables_found )
+		return;
+
+	for( i = 0; i < NETSTATS_TABLES; i++ )
+	{
+		netstats.tables[i] = -1;
+
+		for( j = 0; ( dt = Delta_FindStructByIndex( j )) != NULL; j++ )
+		{
+			if( !Q_strcmp( dt->pName, netstats_tablenames[i] ))
+				netstats.tables[i] = j;
+		}
+	}
+
+	netstats.tables_found = true;
+}
+
+/*
+=================
+SV_NetStatsTableSlot
+
+=================
+*/
+static int SV_NetStatsTableSlot( int table )
+{
+	int	i;
+
+	for( i = 0; i < NETSTATS_TABLES; i++ )
+	{
+		if( netstats.tables[i] == table )
+			return i;
+	}
+
+	return -1;
+}
+
+/*
+=================
+SV_NetStatsFields
+
+=================
+*/
+void SV_NetStatsFields( sv_client_t *cl, int table, const int *fieldbits, int numfields )
+{
+	netcounter_t	*c;
+	int		i, slot;
+
+	if( !cl->netstats || ( slot = SV_NetStatsTableSlot( table )) < 0 )
+		return;
+
+	numfields = Q_min( numfields, MAX_DELTA_FIELDS );
+	c = cl->netstats->total.fields[slot];
+
+	for( i = 0; i < numfields; i++ )
+	{
+		if( !fieldbits[i] )
+			continue;
+
+		c[i].count++;
+		c[i].bits += fieldbits[i];
+	}
+}
+
+/*
+=================
+SV_NetStatsShared
+
+=================
+*/
+void SV_NetStatsShared( sv_client_t *cl, int bits )
+{
+	if( !cl->netstats || bits <= 0 )
+		return;
+
+	cl->netstats->total.shared.count++;
+	cl->netstats->total.shared.bits += bits;
+}
+
+/*
+=================
+SV_NetStatsSignon
+
+connection buffers are built from many
+messages and only counted as a whole
+=================
+*/
+void SV_NetStatsSignon( sv_client_t *cl, int bits )
+{
+	if( !cl->netstats || bits <= 0 )
+		return;
+
+	cl->netstats->total.signon.count++;
+	cl->netstats->total.signon.bits += bits;
+}
+
+/*
+=================
+SV_FreeNetStats
+
+=================
+*/
+void SV_FreeNetStats( sv_client_t *cl )
+{
+	if( !cl->netstats )
+		return;
+
+	Z_Free( cl->netstats );
+	cl->netstats = NULL;
+}
+
+/*
+=================
+SV_ResetNetStats
+
+=================
+*/
+static void SV_ResetNetStats( sv_client_t *cl )
+{
+	memset( cl->netstats, 0, sizeof( *cl->netstats ));
+	cl->netstats->wirestart = cl->netchan.total_sended;
+	cl->netstats->starttime = host.realtime;
+}
+
+/*
+=================
+SV_NetStatsOverhead
+
+wire bits that don't belong to any counted message
+=================
+*/
+static uint64_t SV_NetStatsOverhead( const netcounters_t *c )
+{
+	uint64_t	counted = c->shared.bits + c->signon.bits;
+	int	i;
+
+	for( i = 0; i < NETSTATS_MAX_MSGS; i++ )
+		counted += c->msgs[i].bits;
+
+	// counted data may be dropped on overflow
+	if( c->wire * 8 < counted )
+		return 0;
+
+	return c->wire * 8 - counted;
+}
+
+/*
+=================
+SV_NetStatsAdd
+
+out = a + b, or a - b if subtract is set
+=================
+*/
+static void SV_NetStatsAdd( netcounters_t *out, const netcounters_t *a, const netcounters_t *b, qboolean subtract )
+{
+	const netcounter_t	*pa = a->msgs;
+	const netcounter_t	*pb = b->msgs;
+	netcounter_t	*po = out->msgs;
+	int		i, count;
+
+	// msgs, fields, shared and signon go one after another
+	count = ( offsetof( netcounters_t, signon ) - offsetof( netcounters_t, msgs )) / sizeof( netcounter_t ) + 1;
+
+	for( i = 0; i < count; i++ )
+	{
+		po[i].count = subtract ? pa[i].count - pb[i].count : pa[i].count + pb[i].count;
+		po[i].bits = subtract ? pa[i].bits - pb[i].bits : pa[i].bits + pb[i].bits;
+	}
+
+	out->wire = subtract ? a->wire - b->wire : a->wire + b->wire;
+}
+
+/*
+=================
+SV_NetStatsMsgName
+
+=================
+*/
+static const char *SV_NetStatsMsgName( int id )
+{
+	int	i;
+
+	if( id <= svc_lastmsg )
+		return svc_strings[id];
+
+	for( i = 1; i < MAX_USER_MESSAGES && svgame.msg[i].name[0]; i++ )
+	{
+		if( svgame.msg[i].number == id )
+			return svgame.msg[i].name;
+	}
+
+	return va( "usermsg_%i", id );
+}
+
+/*
+=================
+SV_NetStatsFieldName
+
+=================
+*/
+static const char *SV_NetStatsFieldName( int slot, int field )
+{
+	delta_info_t	*dt;
+
+	if( netstats.tables[slot] < 0 )
+		return "unknown";
+
+	dt = Delta_FindStructByIndex( netstats.tables[slot] );
+
+	if( !dt->pFields || field >= dt->numFields )
+		return "unknown";
+
+	return dt->pFields[field].name;
+}
+
+/*
+=================
+SV_CompareNetStatRows
+
+=================
+*/
+static int SV_CompareNetStatRows( const void *a, const void *b )
+{
+	const netstatrow_t	*ra = (const netstatrow_t *)a;
+	const netstatrow_t	*rb = (const netstatrow_t *)b;
+
+	if( ra->counter.bits > rb->counter.bits )
+		return -1;
+	if( ra->counter.bits < rb->counter.bits )
+		return 1;
+	return 0;
+}
+
+/*
+=================
+SV_NetStatsPrint
+
+=================
+*/
+static void SV_NetStatsPrint( const char *title, const netcounters_t *c, double seconds )
+{
+	netstatrow_t	*row;
+	uint64_t		overhead;
+	int		i, j, numrows;
+	double		wire;
+
+	overhead = SV_NetStatsOverhead( c );
+	wire = Q_max( c->wire, 1 );
+
+	Con_Printf( "%s: %s in %.1f sec, %.2f KB/s\n", title, Q_memprint( c->wire ), seconds, seconds > 0.0 ? c->wire / 1024.0 / seconds : 0.0 );
+	Con_Printf( "%-28s %9s %11s %8s %6s\n", "message", "count", "bytes", "avg", "wire" );
+
+	// messages
+	for( i = numrows = 0; i < NETSTATS_MAX_MSGS; i++ )
+	{
+		if( !c->msgs[i].count )
+			continue;
+
+		row = &netstats.rows[numrows++];
+		row->table = NULL;
+		row->name = SV_NetStatsMsgName( i );
+		row->counter = c->msgs[i];
+	}
+
+	if( c->shared.count )
+	{
+		row = &netstats.rows[numrows++];
+		row->table = NULL;
+		row->name = "(shared datagrams)";
+		row->counter = c->shared;
+	}
+
+	if( c->signon.count )
+	{
+		row = &netstats.rows[numrows++];
+		row->table = NULL;
+		row->name = "(signon buffers)";
+		row->counter = c->signon;
+	}
+
+	qsort( netstats.rows, numrows, sizeof( netstats.rows[0] ), SV_CompareNetStatRows );
+
+	for( i = 0; i < numrows; i++ )
+	{
+		row = &netstats.rows[i];
+		Con_Printf( "%-28s %9u %11.0f %8.1f %5.1f%%\n", row->name, row->counter.count, row->counter.bits / 8.0,
+			row->counter.bits / 8.0 / row->counter.count, row->counter.bits * 100.0 / 8.0 / wire );
+	}
+
+	Con_Printf( "%-28s %9s %11.0f %8s %5.1f%%\n", "(netchan and other)", "", overhead / 8.0, "", overhead * 100.0 / 8.0 / wire );
+
+	// entity fields
+	for( i = numrows = 0; i < NETSTATS_TABLES; i++ )
+	{
+		for( j = 0; j < MAX_DELTA_FIELDS; j++ )
+		{
+			if( !c->fields[i][j].count )
+				continue;
+
+			row = &netstats.rows[numrows++];
+			row->table = netstats_tablenames[i];
+			row->name = SV_NetStatsFieldName( i, j );
+			row->counter = c->fields[i][j];
+		}
+	}
+
+	if( !numrows ) return;
+
+	qsort( netstats.rows, numrows, sizeof( netstats.rows[0] ), SV_CompareNetStatRows );
+
+	Con_Printf( "%-40s %9s %11s %6s\n", "entity field", "updates", "bytes", "wire" );
+
+	for( i = 0; i < numrows && i < NETSTATS_TOP_FIELDS; i++ )
+	{
+		row = &netstats.rows[i];
+		Con_Printf( "%-40s %9u %11.0f %5.1f%%\n", va( "%s.%s", row->table, row->name ), row->counter.count,
+			row->counter.bits / 8.0, row->counter.bits * 100.0 / 8.0 / wire );
+	}
+
+	if( numrows > NETSTATS_TOP_FIELDS )
+		Con_Printf( "...and %d more fields\n", numrows - NETSTATS_TOP_FIELDS );
+}
+
+/*
+=================
+SV_NetStatsJSONString
+
+=================
+*/
+static void SV_NetStatsJSONString( file_t *f, const char *s )
+{
+	FS_Printf( f, "\"" );
+
+	for( ; *s; s++ )
+	{
+		if( *s == '"' || *s == '\\' )
+			FS_Printf( f, "\\%c", *s );
+		else if( (byte)*s < ' ' )
+			FS_Printf( f, "\\u%04x", (byte)*s );
+		else FS_Printf( f, "%c", *s );
+	}
+
+	FS_Printf( f, "\"" );
+}
+
+/*
+=================
+SV_NetStatsWriteCSV
+
+=================
+*/
+static void SV_NetStatsWriteCSV( file_t *f, sv_client_t *cl, const netcounters_t *c )
+{
+	int	slot = cl - svs.clients;
+	int	i, j;
+
+	FS_Printf( f, "%.3f,%d,%d,wire,wire,1,%llu\n", sv.time, slot, cl->userid, (unsigned long long)c->wire * 8 );
+	FS_Printf( f, "%.3f,%d,%d,overhead,overhead,1,%llu\n", sv.time, slot, cl->userid, (unsigned long long)SV_NetStatsOverhead( c ));
+
+	if( c->shared.count )
+		FS_Printf( f, "%.3f,%d,%d,shared,shared,%u,%llu\n", sv.time, slot, cl->userid, c->shared.count, (unsigned long long)c->shared.bits );
+
+	if( c->signon.count )
+		FS_Printf( f, "%.3f,%d,%d,signon,signon,%u,%llu\n", sv.time, slot, cl->userid, c->signon.count, (unsigned long long)c->signon.bits );
+
+	for( i = 0; i < NETSTATS_MAX_MSGS; i++ )
+	{
+		if( !c->msgs[i].count )
+			continue;
+
+		FS_Printf( f, "%.3f,%d,%d,%s,%s,%u,%llu\n", sv.time, slot, cl->userid, i > svc_lastmsg ? "usermsg" : "svc",
+			SV_NetStatsMsgName( i ), c->msgs[i].count, (unsigned long long)c->msgs[i].bits );
+	}
+
+	for( i = 0; i < NETSTATS_TABLES; i++ )
+	{
+		for( j = 0; j < MAX_DELTA_FIELDS; j++ )
+		{
+			if( !c->fields[i][j].count )
+				continue;
+
+			FS_Printf( f, "%.3f,%d,%d,field,%s.%s,%u,%llu\n", sv.time, slot, cl->userid, netstats_tablenames[i],
+				SV_NetStatsFieldName( i, j ), c->fields[i][j].count, (unsigned long long)c->fields[i][j].bits );
+		}
+	}
+}
+
+/*
+=================
+SV_NetStatsWriteJSON
+
+=================
+*/
+static void SV_NetStatsWriteJSON( file_t *f, sv_client_t *cl, const netcounters_t *c )
+{
+	qboolean	first;
+	int	i, j;
+
+	FS_Printf( f, "{\"slot\":%d,\"userid\":%d,\"name\":", (int)( cl - svs.clients ), cl->userid );
+	SV_NetStatsJSONString( f, cl->name );
+	FS_Printf( f, ",\"wire\":%llu,\"overhead\":%llu,\"shared\":[%u,%llu],\"signon\":[%u,%llu],\"messages\":{", (unsigned long long)c->wire * 8,
+		(unsigned long long)SV_NetStatsOverhead( c ), c->shared.count, (unsigned long long)c->shared.bits, c->signon.count, (unsigned long long)c->signon.bits );
+
+	for( i = 0, first = true; i < NETSTATS_MAX_MSGS; i++ )
+	{
+		if( !c->msgs[i].count )
+			continue;
+
+		if( !first ) FS_Printf( f, "," );
+		SV_NetStatsJSONString( f, SV_NetStatsMsgName( i ));
+		FS_Printf( f, ":[%u,%llu]", c->msgs[i].count, (unsigned long long)c->msgs[i].bits );
+		first = false;
+	}
+
+	FS_Printf( f, "},\"fields\":{" );
+
+	for( i = 0, first = true; i < NETSTATS_TABLES; i++ )
+	{
+		for( j = 0; j < MAX_DELTA_FIELDS; j++ )
+		{
+			if( !c->fields[i][j].count )
+				continue;
+
+			if( !first ) FS_Printf( f, "," );
+			FS_Printf( f, "\"%s.%s\":[%u,%llu]", netstats_tablenames[i], SV_NetStatsFieldName( i, j ),
+				c->fields[i][j].count, (unsigned long long)c->fields[i][j].bits );
+			first = false;
+		}
+	}
+
+	FS_Printf( f, "}}" );
+}
+
+/*
+=================
+SV_NetStatsCloseLog
+
+=================
+*/
+static void SV_NetStatsCloseLog( void )
+{
+	if( !netstats.log )
+		return;
+
+	FS_Close( netstats.log );
+	netstats.log = NULL;
+}
+
+/*
+=================
+SV_NetStatsSample
+
+append counters of the last interval to log,
+values are in bits
+=================
+*/
+static void SV_NetStatsSample( void )
+{
+	qboolean		json = !Q_stricmp( sv_netstats_format.string, "json" );
+	const char	*filename = json ? "netstats.json" : "netstats.csv";
+	qboolean		first = true;
+	sv_client_t	*cl;
+	int		i;
+
+	if( netstats.log && netstats.logjson != json )
+		SV_NetStatsCloseLog();
+
+	if( !netstats.log )
+	{
+		qboolean	exists = FS_FileExists( filename, true );
+
+		if(( netstats.log = FS_Open( filename, "a", true )) == NULL )
+		{
+			Con_Printf( S_ERROR "sv_netstats: couldn't open %s\n", filename );
+			Cvar_DirectSet( &sv_netstats_log, "0" );
+			return;
+		}
+
+		netstats.logjson = json;
+
+		if( !json && !exists )
+			FS_Printf( netstats.log, "time,slot,userid,kind,name,count,bits\n" );
+	}
+
+	// one JSON object per line
+	if( json ) FS_Printf( netstats.log, "{\"time\":%.3f,\"interval\":%.3f,\"clients\":[", sv.time, host.realtime - netstats.lastsample );
+
+	for( i = 0, cl = svs.clients; i < svs.maxclients; i++, cl++ )
+	{
+		if( !cl->netstats || cl->state < cs_connected )
+			continue;
+
+		cl->netstats->total.wire = cl->netchan.total_sended - cl->netstats->wirestart;
+		SV_NetStatsAdd( &netstats.delta, &cl->netstats->total, &cl->netstats->last, true );
+		cl->netstats->last = cl->netstats->total;
+
+		if( json )
+		{
+			if( !first ) FS_Printf( netstats.log, "," );
+			SV_NetStatsWriteJSON( netstats.log, cl, &netstats.delta );
+		}
+		else SV_NetStatsWriteCSV( netstats.log, cl, &netstats.delta );
+
+		first = false;
+	}
+
+	if( json ) FS_Printf( netstats.log, "]}\n" );
+
+	netstats.lastsample = host.realtime;
+}
+
+/*
+=================
+SV_NetStatsFrame
+
+allocate counters for new clients and
+write samples when it's time
+=================
+*/
+void SV_NetStatsFrame( void )
+{
+	sv_client_t	*cl;
+	int		i;
+
+	if( netstats.enabled )
+		SV_NetStatsFindTables();
+
+	for( i = 0, cl = svs.clients; i < svs.maxclients; i++, cl++ )
+	{
+		if( netstats.enabled && cl->state >= cs_connected && !FBitSet( cl->flags, FCL_FAKECLIENT ))
+		{
+			if( cl->netstats ) continue;
+
+			cl->netstats = Z_Malloc( sizeof( sv_netstats_t ));
+			SV_ResetNetStats( cl );
+		}
+		else SV_FreeNetStats( cl );
+	}
+
+	if( !netstats.enabled || sv_netstats_log.value <= 0.0f )
+	{
+		SV_NetStatsCloseLog();
+		netstats.nextsample = 0.0;
+		return;
+	}
+
+	// first sample covers a full interval
+	if( netstats.nextsample == 0.0 )
+	{
+		netstats.lastsample = host.realtime;
+		netstats.nextsample = host.realtime + sv_netstats_log.value;
+		return;
+	}
+
+	if( host.realtime < netstats.nextsample )
+		return;
+
+	SV_NetStatsSample();
+	netstats.nextsample = host.realtime + Q_max( sv_netstats_log.value, 0.1f );
+}
+
+/*
+=================
+SV_NetStatsShutdown
+
+=================
+*/
+void SV_NetStatsShutdown( void )
+{
+	int	i;
+
+	SV_NetStatsCloseLog();
+	netstats.nextsample = 0.0;
+
+	for( i = 0; svs.clients && i < svs.maxclients; i++ )
+		SV_FreeNetStats( &svs.clients[i] );
+}
+
+/*
+=================
+SV_NetStats_f
+
+sv_netstats [on|off|reset|all|<slot>|<name>]
+=================
+*/
+void SV_NetStats_f( void )
+{
+	const char	*arg = Cmd_Argv( 1 );
+	sv_client_t	*cl;
+	double		seconds = 0.0;
+	int		i, count;
+
+	if( !Q_stricmp( arg, "on" ))
+	{
+		// counters are allocated on next frame
+		netstats.enabled = true;
+		Con_Printf( "sv_netstats: enabled\n" );
+		return;
+	}
+	else if( !Q_stricmp( arg, "off" ))
+	{
+		netstats.enabled = false;
+		SV_NetStatsShutdown();
+		Con_Printf( "sv_netstats: disabled\n" );
+		return;
+	}
+
+	if( !svs.clients || !netstats.enabled )
+	{
+		Con_Printf( "sv_netstats: counting is disabled, use \"sv_netstats on\"\n" );
+		return;
+	}
+
+	// update wire totals
+	for( i = 0, cl = svs.clients; i < svs.maxclients; i++, cl++ )
+	{
+		if( cl->netstats )
+			cl->netstats->total.wire = cl->netchan.total_sended - cl->netstats->wirestart;
+	}
+
+	if( !Q_stricmp( arg, "reset" ))
+	{
+		for( i = 0, cl = svs.clients; i < svs.maxclients; i++, cl++ )
+		{
+			if( cl->netstats )
+				SV_ResetNetStats( cl );
+		}
+		Con_Printf( "sv_netstats: counters are cleared\n" );
+	}
+	else if( !Q_stricmp( arg, "all" ))
+	{
+		memset( &netstats.sum, 0, sizeof( netstats.sum ));
+
+		for( i = count = 0, cl = svs.clients; i < svs.maxclients; i++, cl++ )
+		{
+			if( !cl->netstats )
+				continue;
+
+			SV_NetStatsAdd( &netstats.sum, &netstats.sum, &cl->netstats->total, false );
+			seconds = Q_max( seconds, host.realtime - cl->netstats->starttime );
+			count++;
+		}
+
+		SV_NetStatsPrint( va( "%d clients", count ), &netstats.sum, seconds );
+	}
+	else if( Cmd_Argc() > 1 )
+	{
+		for( i = 0, cl = svs.clients; i < svs.maxclients; i++, cl++ )
+		{
+			if( !cl->netstats )
+				continue;
+
+			if( Q_isdigit( arg ) && Q_atoi( arg ) == i )
+				break;
+
+			if( !Q_strcmp( cl->name, arg ))
+				break;
+		}
+
+		if( i == svs.maxclients )
+		{
+			Con_Printf( S_ERROR "sv_netstats: no client %s\n", arg );
+			return;
+		}
+
+		SV_NetStatsPrint( cl->name, &cl->netstats->total, host.realtime - cl->netstats->starttime );
+	}
+	else
+	{
+		Con_Printf( "%4s %-24s %8s %10s %8s %6s  %s\n", "slot", "name", "seconds", "sent", "KB/s", "ovrhd", "largest message" );
+
+		for( i = 0, cl = svs.clients; i < svs.maxclients; i++, cl++ )
+		{
+			netcounters_t	*c;
+			int		j, best = 0;
+
+			if( !cl->netstats )
+				continue;
+
+			c = &cl->netstats->total;
+			seconds = host.realtime - cl->netstats->starttime;
+
+			for( j = 1; j < NETSTATS_MAX_MSGS; j++ )
+			{
+				if( c->msgs[j].bits > c->msgs[best].bits )
+					best = j;
+			}
+
+			Con_Printf( "%4d %-24s %8.1f %10s %8.2f %5.1f%%  %s\n", i, cl->name, seconds, Q_memprint( c->wire ),
+				seconds > 0.0 ? c->wire / 1024.0 / seconds : 0.0, SV_NetStatsOverhead( c ) * 100.0 / 8.0 / Q_max( c->wire, 1 ),
+				c->msgs[best].count ? SV_NetStatsMsgName( best ) : "none" );
+		}
+
+		Con_Printf( "sampling to %s: %s\n", !Q_stricmp( sv_netstats_format.string, "json" ) ? "netstats.json" : "netstats.csv",
+			sv_netstats_log.value > 0.0f ? va( "every %g sec", sv_netstats_log.value ) : "off" );
+	}
+}
@@ -209,7 +209,9 @@ qboolean SV_RunThink( edict_t *ent )
 						// by a trigger with a local time.
 		ent->v.nextthink = 0.0f;
 		svgame.globals->time = thinktime;
+		SV_PROFILE_BEGIN( "Think" );
 		svgame.dllFuncs.pfnThink( ent );
+		SV_PROFILE_END();
 	}
 
 	if( FBitSet( ent->v.flags, FL_KILLME ))
@@ -248,7 +250,9 @@ qboolean SV_PlayerRunThink( edict_t *ent, float frametime, double time )
 
 		ent->v.nextthink = 0.0f;
 		svgame.globals->time = thinktime;
+		SV_PROFILE_BEGIN( "Think" );
 		svgame.dllFuncs.pfnThink( ent );
+		SV_PROFILE_END();
 	}
 
 	if( FBitSet( ent->v.flags, FL_KILLME ))
@@ -283,13 +287,17 @@ void SV_Impact( edict_t *e1, edict_t *e2, trace_t *trace )
 	if( e1->v.solid != SOLID_NOT )
 	{
 		SV_CopyTraceToGlobal( trace );
+		SV_PROFILE_BEGIN( "Touch" );
 		svgame.dllFuncs.pfnTouch( e1, e2 );
+		SV_PROFILE_END();
 	}
 
 	if( e2->v.solid != SOLID_NOT )
 	{
 		SV_CopyTraceToGlobal( trace );
+		SV_PROFILE_BEGIN( "Touch" );
 		svgame.dllFuncs.pfnTouch( e2, e1 );
+		SV_PROFILE_END();
 	}
 }
 
@@ -1191,7 +1199,12 @@ void SV_Physics_Pusher( edict_t *ent )
 
 	// if the pusher has a "blocked" function, call it
 	// otherwise, just stay in place until the obstacle is gone
-	if( pBlocker ) svgame.dllFuncs.pfnBlocked( ent, pBlocker );
+	if( pBlocker )
+	{
+		SV_PROFILE_BEGIN( "Blocked" );
+		svgame.dllFuncs.pfnBlocked( ent, pBlocker );
+		SV_PROFILE_END();
+	}
 
 	for( i = 0; i < 3; i++ )
 	{
@@ -1203,7 +1216,9 @@ void SV_Physics_Pusher( edict_t *ent )
 	{
 		ent->v.nextthink = 0.0f;
 		svgame.globals->time = sv.time;
+		SV_PROFILE_BEGIN( "Think" );
 		svgame.dllFuncs.pfnThink( ent );
+		SV_PROFILE_END();
 	}
 }
 
@@ -1706,6 +1721,33 @@ void SV_Physics_None( edict_t *ent )
 	SV_RunThink( ent );
 }
 
+/*
+=============
+SV_MovetypeName
+
+profiler scope names
+=============
+*/
+static const char *SV_MovetypeName( int movetype )
+{
+	switch( movetype )
+	{
+	case MOVETYPE_NONE: return "MOVETYPE_NONE";
+	case MOVETYPE_NOCLIP: return "MOVETYPE_NOCLIP";
+	case MOVETYPE_FOLLOW: return "MOVETYPE_FOLLOW";
+	case MOVETYPE_COMPOUND: return "MOVETYPE_COMPOUND";
+	case MOVETYPE_STEP: return "MOVETYPE_STEP";
+	case MOVETYPE_PUSHSTEP: return "MOVETYPE_PUSHSTEP";
+	case MOVETYPE_FLY: return "MOVETYPE_FLY";
+	case MOVETYPE_TOSS: return "MOVETYPE_TOSS";
+	case MOVETYPE_BOUNCE: return "MOVETYPE_BOUNCE";
+	case MOVETYPE_FLYMISSILE: return "MOVETYPE_FLYMISSILE";
+	case MOVETYPE_BOUNCEMISSILE: return "MOVETYPE_BOUNCEMISSILE";
+	case MOVETYPE_PUSH: return "MOVETYPE_PUSH";
+	default: return "MOVETYPE_OTHER";
+	}
+}
+
 //============================================================================
 static void SV_Physics_Entity( edict_t *ent )
 {
@@ -1730,6 +1772,8 @@ static void SV_Physics_Entity( edict_t *ent )
 		SV_LinkEdict( ent, true );
 	}
 
+	SV_PROFILE_BEGIN( SV_MovetypeName( ent->v.movetype ));
+
 	switch( ent->v.movetype )
 	{
 	case MOVETYPE_NONE:
@@ -1763,6 +1807,8 @@ static void SV_Physics_Entity( edict_t *ent )
 		break;
 	}
 
+	SV_PROFILE_END();
+
 	// g-cont. don't alow free entities during loading because
 	// this produce a corrupted baselines
 	if( sv.state == ss_active && FBitSet( ent->v.flags, FL_KILLME ))
@@ -1780,12 +1826,16 @@ void SV_Physics( void )
 	edict_t	*ent;
 	int    	i;
 
+	SV_UpdateAreaNodes ();
+	SV_InvalidateFindIndex ();
 	SV_CheckAllEnts ();
 
 	svgame.globals->time = sv.time;
 
 	// let the progs know that a new frame has started
+	SV_PROFILE_BEGIN( "StartFrame" );
 	svgame.dllFuncs.pfnStartFrame();
+	SV_PROFILE_END();
 
 	// treat each object in turn
 	for( i = 0; i < svgame.numEntities; i++ )
@@ -2065,13 +2115,27 @@ Initialize server external physics
 qboolean SV_InitPhysicsAPI( void )
 {
 	static PHYSICAPI	pPhysIface;
+	physics_interface_t	funcs;
+	int		version;
 
 	pPhysIface = (PHYSICAPI)COM_GetProcAddress( svgame.hInstance, "Server_GetPhysicsInterface" );
 	if( pPhysIface )
 	{
-		if( pPhysIface( SV_PHYSICS_INTERFACE_VERSION, &gPhysicsAPI, &svgame.physFuncs ))
+		// newest first, older dll leaves new callbacks cleared
+		for( version = SV_PHYSICS_INTERFACE_VERSION; version >= SV_PHYSICS_INTERFACE_VERSION_OLD; version-- )
 		{
-			Con_Reportf( "SV_LoadProgs: ^2initailized extended PhysicAPI ^7ver. %i\n", SV_PHYSICS_INTERFACE_VERSION );
+			memset( &funcs, 0, sizeof( funcs ));
+
+			if( pPhysIface( version, &gPhysicsAPI, &funcs ))
+				break;
+		}
+
+		memset( &svgame.physFuncs, 0, sizeof( svgame.physFuncs ));
+
+		if( version >= SV_PHYSICS_INTERFACE_VERSION_OLD )
+		{
+			memcpy( &svgame.physFuncs, &funcs, SV_PHYSICS_INTERFACE_SIZE( version ));
+			Con_Reportf( "SV_LoadProgs: ^2initailized extended PhysicAPI ^7ver. %i\n", version );
 
 			if( svgame.physFuncs.SV_CheckFeatures != NULL )
 			{
@@ -2082,9 +2146,6 @@ qboolean SV_InitPhysicsAPI( void )
 			return true;
 		}
 
-		// make sure what physic functions is cleared
-		memset( &svgame.physFuncs, 0, sizeof( svgame.physFuncs ));
-
 		return false; // just tell user about problems
 	}
 
@@ -1086,7 +1086,9 @@ void SV_RunCmd( sv_client_t *cl, usercmd_t *ucmd, int random_seed )
 	}
 
 	svgame.globals->time = cl->timebase;
+	SV_PROFILE_BEGIN( "PlayerPreThink" );
 	svgame.dllFuncs.pfnPlayerPreThink( clent );
+	SV_PROFILE_END();
 	SV_PlayerRunThink( clent, frametime, cl->timebase );
 
 	// If conveyor, or think, set basevelocity, then send to client asap too.
@@ -1097,7 +1099,9 @@ void SV_RunCmd( sv_client_t *cl, usercmd_t *ucmd, int random_seed )
 	SV_SetupPMove( svgame.pmove, cl, ucmd, cl->physinfo );
 
 	// motor!
+	SV_PROFILE_BEGIN( "PM_Move" );
 	svgame.dllFuncs.pfnPM_Move( svgame.pmove, true );
+	SV_PROFILE_END();
 
 	// copy results back to client
 	SV_FinishPMove( svgame.pmove, cl );
@@ -1135,7 +1139,9 @@ void SV_RunCmd( sv_client_t *cl, usercmd_t *ucmd, int random_seed )
 	svgame.globals->frametime = frametime;
 
 	// run post-think
+	SV_PROFILE_BEGIN( "PlayerPostThink" );
 	svgame.dllFuncs.pfnPlayerPostThink( clent );
+	SV_PROFILE_END();
 	svgame.dllFuncs.pfnCmdEnd( clent );
 
 	if( !FBitSet( cl->flags, FCL_FAKECLIENT ))
@@ -0,0 +1,619 @@
+/*
+sv_profile.c - hierarchical server frame profiler
+Copyright (C) 2026 Xash3D FWGS contributors
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+*/
+
+#include "common.h"
+#include "server.h"
+
+#define PROFILE_MAX_NODES	256
+#define PROFILE_MAX_DEPTH	32
+
+typedef struct
+{
+	const char	*name;		// scope names are string literals, compared by pointer
+	int		parent;
+	int		child;		// first child
+	int		sibling;		// next child of the same parent
+
+	double		start;		// current scope started at
+	double		frametime;	// spent in the current frame
+	int		framecalls;
+
+	double		lasttime;		// complete values of previous frame
+	int		lastcalls;
+	double		totaltime;
+	double		maxtime;
+	uint		totalcalls;
+} profnode_t;
+
+static struct
+{
+	profnode_t	nodes[PROFILE_MAX_NODES];
+	int		numnodes;
+	int		stack[PROFILE_MAX_DEPTH];
+	int		depth;
+	int		lost;		// scopes didn't fit into nodes or stack
+	uint		frames;
+	qboolean		wanted;		// applied on next frame
+
+	// chrome trace streaming
+	file_t		*trace;
+	string		tracename;
+	int		traceframes;
+	qboolean		tracefirst;
+	double		tracebase;
+} sv_prof;
+
+qboolean		sv_profiling;
+
+/*
+=================
+SV_ProfileTraceEvent
+
+=================
+*/
+static void SV_ProfileTraceEvent( const char *name, double start, double duration )
+{
+	FS_Printf( sv_prof.trace, "%s\n{\"name\":\"%s\",\"cat\":\"server\",\"ph\":\"X\",\"pid\":1,\"tid\":1,\"ts\":%.3f,\"dur\":%.3f}",
+		sv_prof.tracefirst ? "" : ",", name, ( start - sv_prof.tracebase ) * 1000000.0, duration * 1000000.0 );
+	sv_prof.tracefirst = false;
+}
+
+/*
+=================
+SV_ProfileStopTrace
+
+=================
+*/
+static void SV_ProfileStopTrace( void )
+{
+	if( !sv_prof.trace )
+		return;
+
+	FS_Printf( sv_prof.trace, "\n]}\n" );
+	FS_Close( sv_prof.trace );
+	sv_prof.trace = NULL;
+
+	Con_Printf( "sv_profile: trace written to %s\n", sv_prof.tracename );
+}
+
+/*
+=================
+SV_ProfileBegin
+
+=================
+*/
+void SV_ProfileBegin( const char *name )
+{
+	int	parent, node;
+
+	if( sv_prof.depth >= PROFILE_MAX_DEPTH )
+	{
+		// still count depth, so ends are matched
+		sv_prof.depth++;
+		sv_prof.lost++;
+		return;
+	}
+
+	parent = sv_prof.depth ? sv_prof.stack[sv_prof.depth - 1] : -1;
+
+	if( parent < 0 && sv_prof.depth )
+	{
+		// parent was lost, so are children
+		sv_prof.stack[sv_prof.depth++] = -1;
+		return;
+	}
+
+	for( node = parent >= 0 ? sv_prof.nodes[parent].child : ( sv_prof.numnodes ? 0 : -1 ); node >= 0; node = sv_prof.nodes[node].sibling )
+	{
+		if( sv_prof.nodes[node].name == name )
+			break;
+	}
+
+	if( node < 0 )
+	{
+		if( sv_prof.numnodes >= PROFILE_MAX_NODES || ( parent < 0 && sv_prof.numnodes ))
+		{
+			sv_prof.stack[sv_prof.depth++] = -1;
+			sv_prof.lost++;
+			return;
+		}
+
+		node = sv_prof.numnodes++;
+		memset( &sv_prof.nodes[node], 0, sizeof( profnode_t ));
+		sv_prof.nodes[node].name = name;
+		sv_prof.nodes[node].parent = parent;
+		sv_prof.nodes[node].child = -1;
+		sv_prof.nodes[node].sibling = -1;
+
+		if( parent >= 0 )
+		{
+			sv_prof.nodes[node].sibling = sv_prof.nodes[parent].child;
+			sv_prof.nodes[parent].child = node;
+		}
+	}
+
+	sv_prof.stack[sv_prof.depth++] = node;
+	sv_prof.nodes[node].start = Sys_DoubleTime();
+}
+
+/*
+=================
+SV_ProfileEnd
+
+=================
+*/
+void SV_ProfileEnd( void )
+{
+	profnode_t	*node;
+	double		duration;
+	int		index;
+
+	if( sv_prof.depth <= 0 )
+		return;
+
+	sv_prof.depth--;
+
+	if( sv_prof.depth >= PROFILE_MAX_DEPTH )
+		return;
+
+	if(( index = sv_prof.stack[sv_prof.depth] ) < 0 )
+		return;
+
+	node = &sv_prof.nodes[index];
+	duration = Sys_DoubleTime() - node->start;
+	node->frametime += duration;
+	node->framecalls++;
+
+	if( sv_prof.trace )
+		SV_ProfileTraceEvent( node->name, node->start, duration );
+}
+
+/*
+=================
+SV_ProfileBeginFrame
+
+=================
+*/
+void SV_ProfileBeginFrame( void )
+{
+	int	i;
+
+	sv_profiling = sv_prof.wanted;
+	if( !sv_profiling ) return;
+
+	// error could longjmp out of the previous frame
+	sv_prof.depth = 0;
+
+	for( i = 0; i < sv_prof.numnodes; i++ )
+	{
+		sv_prof.nodes[i].frametime = 0.0;
+		sv_prof.nodes[i].framecalls = 0;
+	}
+
+	SV_ProfileBegin( "Host_ServerFrame" );
+}
+
+/*
+=================
+SV_ProfileEndFrame
+
+=================
+*/
+void SV_ProfileEndFrame( void )
+{
+	profnode_t	*node;
+	int		i;
+
+	if( !sv_profiling ) return;
+
+	while( sv_prof.depth > 0 )
+		SV_ProfileEnd();
+
+	for( i = 0; i < sv_prof.numnodes; i++ )
+	{
+		node = &sv_prof.nodes[i];
+		node->lasttime = node->frametime;
+		node->lastcalls = node->framecalls;
+		node->totaltime += node->frametime;
+		node->totalcalls += node->framecalls;
+		node->maxtime = Q_max( node->maxtime, node->frametime );
+	}
+
+	sv_prof.frames++;
+
+	if( sv_prof.trace && --sv_prof.traceframes <= 0 )
+		SV_ProfileStopTrace();
+}
+
+/*
+=================
+SV_ProfilePrintNode
+
+children are linked in reverse order of appearance
+=================
+*/
+static void SV_ProfilePrintNode( int index, int depth, double frametime )
+{
+	profnode_t	*node;
+	int		order[PROFILE_MAX_NODES];
+	int		i, count = 0;
+	char		name[64];
+
+	if( index < 0 ) return;
+
+	for( i = index; i >= 0; i = sv_prof.nodes[i].sibling )
+		order[count++] = i;
+
+	while( count-- > 0 )
+	{
+		node = &sv_prof.nodes[order[count]];
+
+		memset( name, ' ', sizeof( name ));
+		Q_strncpy( name + Q_min( depth * 2, 32 ), node->name, sizeof( name ) - Q_min( depth * 2, 32 ));
+
+		Con_Printf( "%-40s %9.3f %9.3f %9.3f %8.1f %6.1f%%\n", name, node->lasttime * 1000.0,
+			node->totaltime * 1000.0 / sv_prof.frames, node->maxtime * 1000.0,
+			(double)node->totalcalls / sv_prof.frames, frametime > 0.0 ? node->totaltime * 100.0 / frametime : 0.0 );
+
+		SV_ProfilePrintNode( node->child, depth + 1, frametime );
+	}
+}
+
+/*
+=================
+SV_Profile_f
+
+sv_profile [on|off|reset|trace <file> [frames]|trace stop]
+=================
+*/
+void SV_Profile_f( void )
+{
+	const char	*cmd = Cmd_Argv( 1 );
+	int		frames;
+
+	if( !Q_stricmp( cmd, "on" ))
+	{
+		sv_prof.wanted = true;
+		Con_Printf( "sv_profile: enabled\n" );
+	}
+	else if( !Q_stricmp( cmd, "off" ))
+	{
+		SV_ProfileStopTrace();
+		sv_prof.wanted = false;
+		Con_Printf( "sv_profile: disabled\n" );
+	}
+	else if( !Q_stricmp( cmd, "reset" ))
+	{
+		sv_prof.numnodes = sv_prof.depth = sv_prof.lost = 0;
+		sv_prof.frames = 0;
+		sv_profiling = false; // current frame can't be completed
+	}
+	else if( !Q_stricmp( cmd, "trace" ))
+	{
+		if( !Q_stricmp( Cmd_Argv( 2 ), "stop" ))
+		{
+			SV_ProfileStopTrace();
+			return;
+		}
+
+		if( Cmd_Argc() < 3 )
+		{
+			Con_Printf( S_USAGE "sv_profile trace <file.json> [frames]\n" );
+			return;
+		}
+
+		SV_ProfileStopTrace();
+		frames = Cmd_Argc() > 3 ? Q_atoi( Cmd_Argv( 3 )) : 1000;
+
+		if(( sv_prof.trace = FS_Open( Cmd_Argv( 2 ), "w", true )) == NULL )
+		{
+			Con_Printf( S_ERROR "sv_profile: couldn't create %s\n", Cmd_Argv( 2 ));
+			return;
+		}
+
+		Q_strncpy( sv_prof.tracename, Cmd_Argv( 2 ), sizeof( sv_prof.tracename ));
+		sv_prof.traceframes = Q_max( frames, 1 );
+		sv_prof.tracefirst = true;
+		sv_prof.tracebase = Sys_DoubleTime();
+		sv_prof.wanted = true;
+
+		FS_Printf( sv_prof.trace, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[" );
+		Con_Printf( "sv_profile: tracing %d frames to %s\n", sv_prof.traceframes, sv_prof.tracename );
+	}
+	else if( Cmd_Argc() > 1 )
+	{
+		Con_Printf( S_USAGE "sv_profile [on|off|reset|trace <file.json> [frames]|trace stop]\n" );
+	}
+	else if( !sv_prof.frames || !sv_prof.numnodes )
+	{
+		Con_Printf( "sv_profile: no frames recorded, use \"sv_profile on\"\n" );
+	}
+	else
+	{
+		Con_Printf( "%-40s %9s %9s %9s %8s %7s\n", "scope", "last ms", "avg ms", "max ms", "calls", "frame" );
+		SV_ProfilePrintNode( 0, 0, sv_prof.nodes[0].totaltime );
+		Con_Printf( "%u frames, %d scopes lost\n", sv_prof.frames, sv_prof.lost );
+	}
+}
+
+/*
+=================
+SV_ProfileShutdown
+
+=================
+*/
+void SV_ProfileShutdown( void )
+{
+	SV_ProfileStopTrace();
+	sv_prof.wanted = sv_profiling = false;
+}
+
+/*
+===============================================================================
+
+LOAD BENCHMARK
+
+===============================================================================
+*/
+#define LOADBENCH_MAX_TICKS	1000000
+
+typedef struct
+{
+	sv_client_t	*cl;
+	uint		rand;		// own generator, game dll can't shift the pattern
+	vec3_t		angles;
+	float		yawspeed;
+	int		strafetime;
+	int		firetime;
+	size_t		bytes;
+} loadbot_t;
+
+/*
+=================
+SV_LoadBotRandom
+
+xorshift32, period does not matter here
+=================
+*/
+static float SV_LoadBotRandom( loadbot_t *bot, float min, float max )
+{
+	bot->rand ^= bot->rand << 13;
+	bot->rand ^= bot->rand >> 17;
+	bot->rand ^= bot->rand << 5;
+
+	return min + ( max - min ) * (float)( bot->rand & 0xFFFF ) / 65535.0f;
+}
+
+/*
+=================
+SV_LoadBotConnect
+
+same sequence as bot code in game dlls does
+=================
+*/
+static qboolean SV_LoadBotConnect( loadbot_t *bot, int index, uint seed )
+{
+	char	reject[128];
+	edict_t	*ent;
+
+	if(( ent = SV_FakeConnect( va( "loadbot%d", index ))) == NULL )
+		return false;
+
+	bot->cl = SV_ClientFromEdict( ent, true );
+	bot->cl->frames = Z_Calloc( sizeof( client_frame_t ) * SV_UPDATE_BACKUP );
+	bot->cl->delta_sequence = -1;
+
+	SV_InitEdict( ent );
+	ent->v.flags = FL_CLIENT|FL_FAKECLIENT;
+	ent->v.netname = MAKE_STRING( bot->cl->name );
+	ent->v.colormap = NUM_FOR_EDICT( ent );
+
+	reject[0] = '\0';
+	svgame.globals->time = sv.time;
+
+	if( !svgame.dllFuncs.pfnClientConnect( ent, bot->cl->name, "127.0.0.1", reject ))
+	{
+		Con_Printf( S_WARN "sv_loadbench: %s rejected: %s\n", bot->cl->name, reject );
+		SV_DropClient( bot->cl, false );
+		return false;
+	}
+
+	svgame.dllFuncs.pfnClientPutInServer( ent );
+	SetBits( ent->v.flags, FL_CLIENT|FL_FAKECLIENT );
+	SV_RelinkFindIndex( ent );
+
+	bot->rand = ( seed + index * 0x9E3779B9 ) | 1;
+	bot->angles[YAW] = SV_LoadBotRandom( bot, 0.0f, 360.0f );
+	bot->yawspeed = SV_LoadBotRandom( bot, -90.0f, 90.0f );
+	bot->strafetime = bot->firetime = 0;
+	bot->bytes = 0;
+
+	return true;
+}
+
+/*
+=================
+SV_LoadBotDisconnect
+
+drop bot whatever state it has reached,
+unless game dll already gave slot to someone else
+=================
+*/
+static void SV_LoadBotDisconnect( loadbot_t *bot, int index )
+{
+	sv_client_t	*cl = bot->cl;
+
+	if( cl->state == cs_free || cl->state == cs_zombie )
+		return;
+
+	if( !FBitSet( cl->flags, FCL_FAKECLIENT ) || Q_strcmp( cl->name, va( "loadbot%d", index )))
+		return;
+
+	SV_DropClient( cl, false );
+}
+
+/*
+=================
+SV_LoadBotThink
+
+wander around, change strafe side and shoot in bursts
+=================
+*/
+static void SV_LoadBotThink( loadbot_t *bot, float frametime )
+{
+	float	fmove, smove;
+	word	buttons = 0;
+
+	if( --bot->strafetime <= 0 )
+	{
+		bot->strafetime = (int)SV_LoadBotRandom( bot, 20.0f, 200.0f );
+		bot->yawspeed = SV_LoadBotRandom( bot, -90.0f, 90.0f );
+	}
+
+	if( --bot->firetime <= 0 )
+		bot->firetime = (int)SV_LoadBotRandom( bot, 50.0f, 300.0f );
+
+	if( bot->firetime < 30 )
+		SetBits( buttons, IN_ATTACK );
+
+	if(( bot->strafetime & 63 ) == 0 )
+		SetBits( buttons, IN_JUMP );
+
+	bot->angles[YAW] = anglemod( bot->angles[YAW] + bot->yawspeed * frametime );
+	bot->angles[PITCH] = 10.0f * sin( bot->strafetime * 0.05f );
+
+	fmove = 400.0f;
+	smove = ( bot->strafetime & 1 ) ? 200.0f : -200.0f;
+	SetBits( buttons, IN_FORWARD|( smove > 0.0f ? IN_MOVERIGHT : IN_MOVELEFT ));
+
+	pfnRunPlayerMove( bot->cl->edict, bot->angles, fmove, smove, 0.0f, buttons, 0, (byte)bound( 1, frametime * 1000.0f, 255 ));
+}
+
+/*
+=================
+SV_CompareDoubles
+=================
+*/
+static int SV_CompareDoubles( const void *a, const void *b )
+{
+	double	x = *(const double *)a, y = *(const double *)b;
+
+	return ( x > y ) - ( x < y );
+}
+
+/*
+=================
+SV_LoadBench_f
+
+sv_loadbench <bots> [ticks] [seed]
+runs on the loaded game dll and map, so
+results are only comparable between runs
+of the same game, map and machine
+=================
+*/
+void SV_LoadBench_f( void )
+{
+	loadbot_t		*bots;
+	double		*times, frametime, oldframetime, start, total = 0.0;
+	size_t		allocs0, bytes0, allocs1, bytes1, traffic = 0;
+	int		i, tick, numbots, maxbots, ticks;
+	uint		seed;
+
+	if( Cmd_Argc() < 2 )
+	{
+		Con_Printf( S_USAGE "sv_loadbench <bots> [ticks] [seed]\n" );
+		return;
+	}
+
+	if( sv.state != ss_active )
+	{
+		Con_Printf( "Server is not active\n" );
+		return;
+	}
+
+	maxbots = Q_atoi( Cmd_Argv( 1 ));
+	ticks = Cmd_Argc() > 2 ? Q_atoi( Cmd_Argv( 2 )) : 1000;
+	seed = Cmd_Argc() > 3 ? Q_atoi( Cmd_Argv( 3 )) : 1;
+	ticks = bound( 1, ticks, LOADBENCH_MAX_TICKS );
+	maxbots = bound( 1, maxbots, svs.maxclients );
+
+	// bots must see the same world each run
+	COM_SetRandomSeed( seed );
+
+	bots = Z_Calloc( sizeof( loadbot_t ) * maxbots );
+	times = Z_Malloc( sizeof( double ) * ticks );
+
+	for( numbots = 0; numbots < maxbots; numbots++ )
+	{
+		if( !SV_LoadBotConnect( &bots[numbots], numbots, seed ))
+			break;
+	}
+
+	if( !numbots )
+	{
+		Con_Printf( "sv_loadbench: no free slots for bots\n" );
+		Z_Free( times );
+		Z_Free( bots );
+		return;
+	}
+
+	frametime = sv_fps.value > 0.0f ? 1.0 / sv_fps.value : 0.01;
+	oldframetime = host.frametime;
+	Con_Printf( "sv_loadbench: %d bots, %d ticks at %.1f Hz, seed %u\n", numbots, ticks, 1.0 / frametime, seed );
+
+	Mem_GetAllocStats( &allocs0, &bytes0 );
+
+	for( tick = 0; tick < ticks; tick++ )
+	{
+		start = Sys_DoubleTime();
+
+		for( i = 0; i < numbots; i++ )
+		{
+			if( bots[i].cl->state == cs_spawned )
+				SV_LoadBotThink( &bots[i], frametime );
+		}
+
+		host.frametime = frametime;
+		Host_ServerFrame();
+
+		// bots don't get datagrams, so build them here
+		for( i = 0; i < numbots; i++ )
+			bots[i].bytes += SV_BuildFakeClientDatagram( bots[i].cl );
+
+		times[tick] = Sys_DoubleTime() - start;
+		total += times[tick];
+	}
+
+	Mem_GetAllocStats( &allocs1, &bytes1 );
+	host.frametime = oldframetime;
+
+	for( i = 0; i < numbots; i++ )
+	{
+		traffic += bots[i].bytes;
+		SV_LoadBotDisconnect( &bots[i], i );
+	}
+
+	qsort( times, ticks, sizeof( double ), SV_CompareDoubles );
+
+	Con_Printf( "tick ms: avg %.3f, p50 %.3f, p90 %.3f, p99 %.3f, max %.3f\n", total * 1000.0 / ticks,
+		times[ticks / 2] * 1000.0, times[ticks * 9 / 10] * 1000.0, times[ticks * 99 / 100] * 1000.0, times[ticks - 1] * 1000.0 );
+	Con_Printf( "traffic: %.1f bytes per client per tick, %s per client total\n",
+		(double)traffic / numbots / ticks, Q_memprint( (float)traffic / numbots ));
+	Con_Printf( "allocations: %lu (%.2f per tick), %s\n", (unsigned long)( allocs1 - allocs0 ),
+		(double)( allocs1 - allocs0 ) / ticks, Q_memprint( (float)( bytes1 - bytes0 )));
+
+	Z_Free( times );
+	Z_Free( bots );
+}
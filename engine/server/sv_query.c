@@ -0,0 +1,452 @@
+/*
+sv_query.c - cached and rate limited answers to server queries
+Copyright (C) 2026 Xash3D FWGS contributors
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+*/
+
+#include "common.h"
+#include "server.h"
+#include "net_api.h"
+
+#define QUERY_MAX_ANSWER	1400
+#define QUERY_VOLATILE_TIME	1.0		// player list has frags and times
+#define QUERY_LIMIT_SLOTS	4096		// must be power of two
+#define QUERY_LIMIT_PROBES	8
+#define QUERY_CHALLENGE_WINDOW	30.0		// challenge is valid for one or two windows
+#define S2C_CHALLENGE		'A'
+
+typedef struct
+{
+	int		generation;		// valid while it matches query.generation
+	double		time;
+	int		size;
+	byte		data[QUERY_MAX_ANSWER];
+} querycache_t;
+
+typedef struct
+{
+	uint		ip;
+	float		tokens;
+	double		time;			// last refill, 0 if slot is free
+} querylimit_t;
+
+typedef struct
+{
+	uint		queries;
+	uint		hits;
+	uint		misses;
+	uint		limited;
+	uint		challenged;
+	uint		badchallenge;
+} querystats_t;
+
+typedef struct
+{
+	int		generation;
+	querycache_t	cache[QUERY_CACHED];
+	querylimit_t	slots[QUERY_LIMIT_SLOTS];
+	querylimit_t	total;			// all addresses together
+	uint		secret;
+	querystats_t	stats;
+} querystate_t;
+
+static querystate_t	query;
+
+/*
+=================
+SV_InvalidateQueryCache
+
+called when anything from query answers is changed
+=================
+*/
+void SV_InvalidateQueryCache( void )
+{
+	query.generation++;
+}
+
+/*
+=================
+SV_GetCachedQuery
+
+returns NULL if answer must be built again
+=================
+*/
+const byte *SV_GetCachedQuery( int type, int *size )
+{
+	querycache_t	*c = &query.cache[type];
+
+	// hostname isn't watched by anyone else
+	if( FBitSet( hostname.flags, FCVAR_CHANGED ))
+	{
+		ClearBits( hostname.flags, FCVAR_CHANGED );
+		SV_InvalidateQueryCache();
+	}
+
+	if( !sv_query_cache.value || c->generation != query.generation || !c->size )
+	{
+		query.stats.misses++;
+		return NULL;
+	}
+
+	if( type == QUERY_PLAYERS && host.realtime - c->time > QUERY_VOLATILE_TIME )
+	{
+		query.stats.misses++;
+		return NULL;
+	}
+
+	query.stats.hits++;
+	*size = c->size;
+
+	return c->data;
+}
+
+/*
+=================
+SV_CacheQuery
+
+=================
+*/
+void SV_CacheQuery( int type, const void *data, int size )
+{
+	querycache_t	*c = &query.cache[type];
+
+	if( size <= 0 || size > sizeof( c->data ))
+	{
+		c->size = 0;
+		return;
+	}
+
+	memcpy( c->data, data, size );
+	c->size = size;
+	c->time = host.realtime;
+	c->generation = query.generation;
+}
+
+/*
+=================
+SV_RefillQueryLimit
+
+=================
+*/
+static qboolean SV_RefillQueryLimit( querylimit_t *slot, float rate, float burst )
+{
+	slot->tokens = Q_min( burst, slot->tokens + ( host.realtime - slot->time ) * rate );
+	slot->time = host.realtime;
+
+	if( slot->tokens < 1.0f )
+		return false;
+
+	slot->tokens -= 1.0f;
+	return true;
+}
+
+/*
+=================
+SV_QueryAllowed
+
+token bucket for each source address in a fixed
+table, stale or oldest entry is replaced on collision
+=================
+*/
+qboolean SV_QueryAllowed( netadr_t from )
+{
+	querylimit_t	*slot = NULL, *victim = NULL;
+	float		rate, burst;
+	uint		ip, hash;
+	int		i;
+
+	query.stats.queries++;
+
+	// loopback and LAN broadcasts are trusted
+	if( from.type != NA_IP )
+		return true;
+
+	if( sv_query_rate_total.value > 0.0f )
+	{
+		if( query.total.time == 0.0 )
+		{
+			query.total.tokens = sv_query_rate_total.value;
+			query.total.time = host.realtime;
+		}
+
+		if( !SV_RefillQueryLimit( &query.total, sv_query_rate_total.value, sv_query_rate_total.value ))
+		{
+			query.stats.limited++;
+			return false;
+		}
+	}
+
+	if( sv_query_rate.value <= 0.0f )
+		return true;
+
+	rate = sv_query_rate.value;
+	burst = Q_max( sv_query_burst.value, 1.0f );
+
+	memcpy( &ip, from.ip, sizeof( ip ));
+	hash = ( ip * 2654435761U ) >> 20;
+
+	for( i = 0; i < QUERY_LIMIT_PROBES; i++ )
+	{
+		querylimit_t	*s = &query.slots[( hash + i ) & ( QUERY_LIMIT_SLOTS - 1 )];
+
+		if( s->time != 0.0 && s->ip == ip )
+		{
+			slot = s;
+			break;
+		}
+
+		// free slots have zero time and go first
+		if( !victim || s->time < victim->time )
+			victim = s;
+	}
+
+	if( !slot )
+	{
+		slot = victim;
+		slot->ip = ip;
+		slot->tokens = burst;
+		slot->time = host.realtime;
+	}
+
+	if( !SV_RefillQueryLimit( slot, rate, burst ))
+	{
+		query.stats.limited++;
+		return false;
+	}
+
+	return true;
+}
+
+/*
+=================
+SV_QueryChallengeFor
+
+stateless, derived from address and time window
+=================
+*/
+static int SV_QueryChallengeFor( netadr_t from, int window )
+{
+	uint	h, ip;
+
+	while( !query.secret )
+		query.secret = ( COM_RandomLong( 0, 0xFFFF ) << 16 ) | COM_RandomLong( 0, 0xFFFF );
+
+	memcpy( &ip, from.ip, sizeof( ip ));
+
+	h = query.secret ^ ( window * 0x9E3779B9U );
+	h = ( h ^ ip ) * 0x85EBCA6BU;
+	h ^= h >> 13;
+	h *= 0xC2B2AE35U;
+	h ^= h >> 16;
+
+	return (int)h;
+}
+
+/*
+=================
+SV_QueryChallenge
+
+large answers may need the challenge that follows the
+request string, otherwise sends S2C_CHALLENGE and returns false
+=================
+*/
+qboolean SV_QueryChallenge( netadr_t from, sizebuf_t *msg )
+{
+	byte	answer[5];
+	int	window, challenge;
+
+	if( !sv_query_challenge.value || from.type != NA_IP )
+		return true;
+
+	window = (int)( host.realtime / QUERY_CHALLENGE_WINDOW );
+
+	if( MSG_GetNumBytesLeft( msg ) >= 4 )
+	{
+		challenge = MSG_ReadLong( msg );
+
+		if( challenge == SV_QueryChallengeFor( from, window ) || challenge == SV_QueryChallengeFor( from, window - 1 ))
+			return true;
+
+		query.stats.badchallenge++;
+	}
+
+	challenge = SV_QueryChallengeFor( from, window );
+	answer[0] = S2C_CHALLENGE;
+	answer[1] = challenge & 0xFF;
+	answer[2] = ( challenge >> 8 ) & 0xFF;
+	answer[3] = ( challenge >> 16 ) & 0xFF;
+	answer[4] = ( challenge >> 24 ) & 0xFF;
+
+	Netchan_OutOfBand( NS_SERVER, from, sizeof( answer ), answer );
+	query.stats.challenged++;
+
+	return false;
+}
+
+/*
+=================
+SV_QueryStats_f
+
+=================
+*/
+void SV_QueryStats_f( void )
+{
+	querystats_t	*s = &query.stats;
+	int		i, used = 0;
+
+	if( !Q_stricmp( Cmd_Argv( 1 ), "reset" ))
+	{
+		memset( s, 0, sizeof( *s ));
+		return;
+	}
+
+	for( i = 0; i < QUERY_LIMIT_SLOTS; i++ )
+	{
+		if( query.slots[i].time != 0.0 )
+			used++;
+	}
+
+	Con_Printf( "query cache: %s, rate limit: %g/sec burst %g, total %g/sec, challenge %s\n",
+		sv_query_cache.value ? "on" : "off", sv_query_rate.value, sv_query_burst.value,
+		sv_query_rate_total.value, sv_query_challenge.value ? "on" : "off" );
+	Con_Printf( "%u queries, %u rate limited, %u challenges sent, %u bad challenges\n",
+		s->queries, s->limited, s->challenged, s->badchallenge );
+	Con_Printf( "%u cache hits, %u misses (%.1f%% hit rate)\n", s->hits, s->misses,
+		( s->hits + s->misses ) ? s->hits * 100.0 / ( s->hits + s->misses ) : 0.0 );
+	Con_Printf( "%d of %d address slots in use\n", used, QUERY_LIMIT_SLOTS );
+}
+
+/*
+=================
+SV_QueryBenchPhase
+
+=================
+*/
+static void SV_QueryBenchPhase( const char *name, double seconds, int sources, string *requests, int numrequests )
+{
+	querystats_t	before = query.stats;
+	byte		packet[128];
+	double		start, end;
+	uint		count = 0;
+	sizebuf_t		msg;
+	netadr_t		from;
+	int		len;
+
+	memset( &from, 0, sizeof( from ));
+	from.type = NA_IP;
+	from.ip[0] = 127;
+	from.port = MSG_BigShort( 9 ); // discard
+
+	start = Sys_DoubleTime();
+	end = start + seconds;
+
+	do
+	{
+		const char	*req = requests[count % numrequests];
+		int		source = count % sources;
+
+		// every source is a separate loopback address
+		from.ip[1] = ( source >> 16 ) & 0xFF;
+		from.ip[2] = ( source >> 8 ) & 0xFF;
+		from.ip[3] = ( source & 0xFF ) + 1;
+
+		*(int *)packet = NET_HEADER_OUTOFBANDPACKET;
+		len = Q_strlen( req ) + 1;
+		memcpy( packet + 4, req, len );
+
+		MSG_Init( &msg, "QueryBench", packet, len + 4 );
+		SV_ConnectionlessPacket( from, &msg );
+
+		// time is checked in batches, it's slower than the query
+		if(( ++count & 63 ) == 0 )
+		{
+			host.realtime = Sys_DoubleTime();
+			if( host.realtime >= end )
+				break;
+		}
+	} while( 1 );
+
+	seconds = Sys_DoubleTime() - start;
+
+	Con_Printf( "%-10s %10.0f q/s %9u queries %9u limited %6.1f%% cache hits\n", name, count / seconds, count,
+		query.stats.limited - before.limited, ( query.stats.hits - before.hits ) * 100.0 /
+		Q_max( 1, ( query.stats.hits - before.hits ) + ( query.stats.misses - before.misses )));
+}
+
+/*
+=================
+SV_QueryBench_f
+
+flood the responder with the mix of queries from
+loopback addresses and measure answer rate
+=================
+*/
+void SV_QueryBench_f( void )
+{
+	string		requests[6];
+	double		seconds, oldtime;
+	string		cache, rate, challenge;
+	querystate_t	*saved;
+	int		sources, generation;
+
+	if( !svs.initialized || svs.maxclients == 1 )
+	{
+		Con_Printf( S_ERROR "sv_query_bench: start a multiplayer server first\n" );
+		return;
+	}
+
+	seconds = Cmd_Argc() > 1 ? bound( 0.1, Q_atof( Cmd_Argv( 1 )), 60.0 ) : 2.0;
+	sources = Cmd_Argc() > 2 ? bound( 1, Q_atoi( Cmd_Argv( 2 )), 0xFFFFFF ) : 1024;
+
+	Q_strncpy( cache, sv_query_cache.string, sizeof( cache ));
+	Q_strncpy( rate, sv_query_rate.string, sizeof( rate ));
+	Q_strncpy( challenge, sv_query_challenge.string, sizeof( challenge ));
+	oldtime = host.realtime;
+
+	// bench moves time forward, cached answers and limits
+	// would keep timestamps from the future after it
+	saved = Mem_Malloc( host.mempool, sizeof( *saved ));
+	*saved = query;
+
+	Q_strncpy( requests[0], "TSource Engine Query", sizeof( requests[0] ));
+	Q_snprintf( requests[1], sizeof( requests[1] ), "info %i", PROTOCOL_VERSION );
+	Q_snprintf( requests[2], sizeof( requests[2] ), "netinfo %i 0 %i", PROTOCOL_VERSION, NETAPI_REQUEST_PLAYERS );
+	Q_snprintf( requests[3], sizeof( requests[3] ), "netinfo %i 0 %i", PROTOCOL_VERSION, NETAPI_REQUEST_DETAILS );
+	Q_snprintf( requests[4], sizeof( requests[4] ), "netinfo %i 0 %i", PROTOCOL_VERSION, NETAPI_REQUEST_RULES );
+	Q_strncpy( requests[5], "ping", sizeof( requests[5] ));
+
+	Con_Printf( "%d sources, %g seconds each\n", sources, seconds );
+
+	// answers are really sent to discard port of 127.x.x.x
+	Cvar_DirectSet( &sv_query_challenge, "0" );
+	Cvar_DirectSet( &sv_query_rate, "0" );
+	Cvar_DirectSet( &sv_query_cache, "0" );
+	SV_QueryBenchPhase( "uncached", seconds, sources, requests, ARRAYSIZE( requests ));
+
+	Cvar_DirectSet( &sv_query_cache, "1" );
+	SV_QueryBenchPhase( "cached", seconds, sources, requests, ARRAYSIZE( requests ));
+
+	Cvar_DirectSet( &sv_query_rate, Q_atof( rate ) > 0.0f ? rate : sv_query_rate.def_string );
+	memset( query.slots, 0, sizeof( query.slots ));
+	SV_QueryBenchPhase( "limited", seconds, sources, requests, ARRAYSIZE( requests ));
+
+	Cvar_DirectSet( &sv_query_cache, cache );
+	Cvar_DirectSet( &sv_query_rate, rate );
+	Cvar_DirectSet( &sv_query_challenge, challenge );
+	host.realtime = oldtime;
+
+	// old answers are still valid unless bench has invalidated them
+	generation = query.generation;
+	query = *saved;
+	query.generation = generation;
+	Mem_Free( saved );
+}
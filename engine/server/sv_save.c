@@ -1671,6 +1671,8 @@ static int LoadGameState( char const *level, qboolean changelevel )
 			{
 				// force the entity to be relinked
 //				SV_LinkEdict( pent, false );
+				SV_RelinkFindIndex( pent );
+				SV_InitQueryEdict( pent );
 			}
 		}
 	}
@@ -1866,6 +1868,8 @@ static int CreateEntityTransitionList( SAVERESTOREDATA *pSaveData, int levelMask
 				// a matching entity, not be spawned
 				if( svgame.dllFuncs.pfnRestore( pent, pSaveData, 1 ) > 0 )
 				{
+					SV_RelinkFindIndex( pent );
+					SV_InitQueryEdict( pent );
 					movedCount++;
 				}
 				else
@@ -1894,6 +1898,8 @@ static int CreateEntityTransitionList( SAVERESTOREDATA *pSaveData, int levelMask
 					}
 					else
 					{
+						SV_RelinkFindIndex( pent );
+						SV_InitQueryEdict( pent );
 						pTable->flags = FENTTABLE_REMOVED;
 						movedCount++;
 					}
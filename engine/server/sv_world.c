@@ -18,6 +18,7 @@ GNU General Public License for more details.
 #include "const.h"
 #include "pm_local.h"
 #include "studio.h"
+#include "mod_local.h"
 
 typedef struct moveclip_s
 {
@@ -405,10 +406,66 @@ ENTITY AREA CHECKING
 
 ===============================================================================
 */
+// same as EDICT_FROM_AREA without truncating pointer to int
+#define AREA_EDICT( l )	((edict_t *)((byte *)( l ) - offsetof( edict_t, area )))
+
 static int	iTouchLinkSemaphore = 0;	// prevent recursion when SV_TouchLinks is active
-areanode_t	sv_areanodes[AREA_NODES];
+areanode_t	sv_areanodes[AREA_MAX_NODES];
 static int	sv_numareanodes;
 
+// extra node info, areanode_t is shared with physics interface
+typedef struct
+{
+	vec3_t		mins;
+	vec3_t		maxs;
+	int		depth;		// -1 for merged out nodes
+	int		failcount;	// number of entities when split was failed
+} areanode_info_t;
+
+static areanode_info_t	sv_areainfo[AREA_MAX_NODES];
+static int		sv_areafree[AREA_MAX_NODES];	// merged out nodes for reuse
+static int		sv_numareafree;
+static qboolean		sv_areaadaptive;	// current tree is growing
+
+static void SV_FreeRecordedMoves( void );
+static void SV_LinkQueryEdict( edict_t *ent );
+static void SV_ResetQueryGrid( struct querygrid_s *qg );
+static void SV_ResetLeafIndex( struct leafindex_s *li );
+
+/*
+===============
+SV_AllocAreaNode
+
+===============
+*/
+static areanode_t *SV_AllocAreaNode( int depth, vec3_t mins, vec3_t maxs )
+{
+	areanode_info_t	*info;
+	areanode_t	*anode;
+	int		index;
+
+	if( sv_numareafree > 0 )
+		index = sv_areafree[--sv_numareafree];
+	else index = sv_numareanodes++;
+
+	info = &sv_areainfo[index];
+	anode = &sv_areanodes[index];
+
+	ClearLink( &anode->trigger_edicts );
+	ClearLink( &anode->solid_edicts );
+	ClearLink( &anode->portal_edicts );
+
+	anode->axis = -1;
+	anode->children[0] = anode->children[1] = NULL;
+
+	VectorCopy( mins, info->mins );
+	VectorCopy( maxs, info->maxs );
+	info->depth = depth;
+	info->failcount = 0;
+
+	return anode;
+}
+
 /*
 ===============
 SV_CreateAreaNode
@@ -423,18 +480,10 @@ areanode_t *SV_CreateAreaNode( int depth, vec3_t mins, vec3_t maxs )
 	vec3_t		mins1, maxs1;
 	vec3_t		mins2, maxs2;
 
-	anode = &sv_areanodes[sv_numareanodes++];
-
-	ClearLink( &anode->trigger_edicts );
-	ClearLink( &anode->solid_edicts );
-	ClearLink( &anode->portal_edicts );
+	anode = SV_AllocAreaNode( depth, mins, maxs );
 
 	if( depth == AREA_DEPTH )
-	{
-		anode->axis = -1;
-		anode->children[0] = anode->children[1] = NULL;
 		return anode;
-	}
 
 	VectorSubtract( maxs, mins, size );
 	if( size[0] > size[1] )
@@ -454,6 +503,355 @@ areanode_t *SV_CreateAreaNode( int depth, vec3_t mins, vec3_t maxs )
 	return anode;
 }
 
+/*
+===============
+SV_CountAreaLinks
+
+===============
+*/
+static int SV_CountAreaLinks( areanode_t *node )
+{
+	link_t	*lists[3] = { &node->trigger_edicts, &node->solid_edicts, &node->portal_edicts };
+	link_t	*l;
+	int	i, count = 0;
+
+	for( i = 0; i < 3; i++ )
+	{
+		for( l = lists[i]->next; l != lists[i]; l = l->next )
+			count++;
+	}
+
+	return count;
+}
+
+/*
+===============
+SV_MoveAreaLinks
+
+push entities that don't cross the split down to children
+===============
+*/
+static void SV_MoveAreaLinks( areanode_t *node, link_t *list, int offset )
+{
+	link_t	*l, *next;
+	edict_t	*ent;
+
+	for( l = list->next; l != list; l = next )
+	{
+		next = l->next;
+		ent = AREA_EDICT( l );
+
+		if( ent->v.absmin[node->axis] > node->dist )
+		{
+			RemoveLink( l );
+			InsertLinkBefore( l, (link_t *)((byte *)node->children[0] + offset ));
+		}
+		else if( ent->v.absmax[node->axis] < node->dist )
+		{
+			RemoveLink( l );
+			InsertLinkBefore( l, (link_t *)((byte *)node->children[1] + offset ));
+		}
+	}
+}
+
+/*
+===============
+SV_CompareFloats
+
+===============
+*/
+static int SV_CompareFloats( const void *a, const void *b )
+{
+	float	f1 = *(const float *)a;
+	float	f2 = *(const float *)b;
+
+	if( f1 == f2 )
+		return 0;
+
+	if( f1 < f2 )
+		return -1;
+	return 1;
+}
+
+/*
+===============
+SV_SplitAreaNode
+
+split leaf at median of entity centers
+===============
+*/
+static qboolean SV_SplitAreaNode( areanode_t *node )
+{
+	areanode_info_t	*info = &sv_areainfo[node - sv_areanodes];
+	link_t		*lists[3] = { &node->trigger_edicts, &node->solid_edicts, &node->portal_edicts };
+	float		centers[AREA_SPLIT_COUNT * 4];
+	int		i, axis, numcenters = 0, nummoved = 0;
+	vec3_t		size, mins1, maxs1, mins2, maxs2;
+	float		dist, margin;
+	link_t		*l;
+	edict_t		*ent;
+
+	if( AREA_MAX_NODES - sv_numareanodes + sv_numareafree < 2 || info->depth >= AREA_MAX_DEPTH )
+		return false;
+
+	VectorSubtract( info->maxs, info->mins, size );
+	axis = ( size[0] > size[1] ) ? 0 : 1;
+	if( size[2] > size[axis] ) axis = 2;
+
+	if( size[axis] < AREA_MIN_SIZE * 2.0f )
+		return false;
+
+	for( i = 0; i < 3; i++ )
+	{
+		for( l = lists[i]->next; l != lists[i] && numcenters < ARRAYSIZE( centers ); l = l->next )
+		{
+			ent = AREA_EDICT( l );
+			centers[numcenters++] = 0.5f * ( ent->v.absmin[axis] + ent->v.absmax[axis] );
+		}
+	}
+
+	if( !numcenters ) return false;
+
+	qsort( centers, numcenters, sizeof( centers[0] ), SV_CompareFloats );
+
+	// keep both halves big enough
+	margin = Q_max( size[axis] * 0.25f, AREA_MIN_SIZE );
+	dist = bound( info->mins[axis] + margin, centers[numcenters / 2], info->maxs[axis] - margin );
+
+	// splitting is useless when all entities cross the plane
+	for( i = 0; i < 3; i++ )
+	{
+		for( l = lists[i]->next; l != lists[i]; l = l->next )
+		{
+			ent = AREA_EDICT( l );
+			if( ent->v.absmin[axis] > dist || ent->v.absmax[axis] < dist )
+				nummoved++;
+		}
+	}
+
+	if( !nummoved ) return false;
+
+	VectorCopy( info->mins, mins1 );
+	VectorCopy( info->mins, mins2 );
+	VectorCopy( info->maxs, maxs1 );
+	VectorCopy( info->maxs, maxs2 );
+	maxs1[axis] = mins2[axis] = dist;
+
+	node->children[0] = SV_AllocAreaNode( info->depth + 1, mins2, maxs2 );
+	node->children[1] = SV_AllocAreaNode( info->depth + 1, mins1, maxs1 );
+	node->axis = axis;
+	node->dist = dist;
+
+	SV_MoveAreaLinks( node, &node->trigger_edicts, offsetof( areanode_t, trigger_edicts ));
+	SV_MoveAreaLinks( node, &node->solid_edicts, offsetof( areanode_t, solid_edicts ));
+	SV_MoveAreaLinks( node, &node->portal_edicts, offsetof( areanode_t, portal_edicts ));
+
+	return true;
+}
+
+/*
+===============
+SV_LinkToAreaNode
+
+find the first node that the ent's box crosses
+===============
+*/
+static void SV_LinkToAreaNode( edict_t *ent )
+{
+	areanode_t	*node = sv_areanodes;
+
+	while( 1 )
+	{
+		if( node->axis == -1 ) break;
+		if( ent->v.absmin[node->axis] > node->dist )
+			node = node->children[0];
+		else if( ent->v.absmax[node->axis] < node->dist )
+			node = node->children[1];
+		else break; // crosses the node
+	}
+
+	// link it in
+	if( ent->v.solid == SOLID_TRIGGER )
+		InsertLinkBefore( &ent->area, &node->trigger_edicts );
+	else if( ent->v.solid == SOLID_PORTAL )
+		InsertLinkBefore( &ent->area, &node->portal_edicts );
+	else InsertLinkBefore( &ent->area, &node->solid_edicts );
+}
+
+/*
+===============
+SV_FreeAreaNode
+
+===============
+*/
+static void SV_FreeAreaNode( areanode_t *node )
+{
+	int	index = node - sv_areanodes;
+
+	ClearLink( &node->trigger_edicts );
+	ClearLink( &node->solid_edicts );
+	ClearLink( &node->portal_edicts );
+	node->axis = -1;
+	node->children[0] = node->children[1] = NULL;
+	sv_areainfo[index].depth = -1;
+	sv_areafree[sv_numareafree++] = index;
+}
+
+/*
+===============
+SV_MergeLinks
+
+===============
+*/
+static void SV_MergeLinks( link_t *list, link_t *dest )
+{
+	link_t	*l, *next;
+
+	for( l = list->next; l != list; l = next )
+	{
+		next = l->next;
+		RemoveLink( l );
+		InsertLinkBefore( l, dest );
+	}
+}
+
+/*
+===============
+SV_MergeAreaNode
+
+pull entities of both leaf children back into
+the node, the fixed tree is never merged
+===============
+*/
+static qboolean SV_MergeAreaNode( areanode_t *node )
+{
+	areanode_t	*child;
+	int		i, count;
+
+	if( node->axis == -1 || sv_areainfo[node - sv_areanodes].depth < AREA_DEPTH )
+		return false;
+
+	if( node->children[0]->axis != -1 || node->children[1]->axis != -1 )
+		return false;
+
+	count = SV_CountAreaLinks( node );
+	count += SV_CountAreaLinks( node->children[0] );
+	count += SV_CountAreaLinks( node->children[1] );
+
+	if( count > AREA_MERGE_COUNT )
+		return false;
+
+	for( i = 0; i < 2; i++ )
+	{
+		child = node->children[i];
+		SV_MergeLinks( &child->trigger_edicts, &node->trigger_edicts );
+		SV_MergeLinks( &child->solid_edicts, &node->solid_edicts );
+		SV_MergeLinks( &child->portal_edicts, &node->portal_edicts );
+		SV_FreeAreaNode( child );
+	}
+
+	node->axis = -1;
+	node->children[0] = node->children[1] = NULL;
+	sv_areainfo[node - sv_areanodes].failcount = 0;
+
+	return true;
+}
+
+/*
+===============
+SV_AdaptAreaNodes
+
+merge emptied leafs and split crowded ones
+===============
+*/
+static void SV_AdaptAreaNodes( void )
+{
+	areanode_info_t	*info;
+	areanode_t	*node;
+	int		i, count;
+
+	// leafs of merged nodes are freed first, so
+	// splits can reuse them in the same frame
+	for( i = 0; i < sv_numareanodes; i++ )
+	{
+		if( sv_areainfo[i].depth >= 0 )
+			SV_MergeAreaNode( &sv_areanodes[i] );
+	}
+
+	// new nodes are appended or reused, reused ones are checked next frame
+	for( i = 0; i < sv_numareanodes; i++ )
+	{
+		node = &sv_areanodes[i];
+		info = &sv_areainfo[i];
+
+		if( node->axis != -1 || info->depth < 0 )
+			continue;
+
+		count = SV_CountAreaLinks( node );
+
+		if( count <= AREA_SPLIT_COUNT || count == info->failcount )
+			continue;
+
+		if( !SV_SplitAreaNode( node ))
+			info->failcount = count;
+	}
+}
+
+/*
+===============
+SV_UpdateAreaNodes
+
+adapt tree to entities, must be called when
+nobody walks through the area lists
+===============
+*/
+void SV_UpdateAreaNodes( void )
+{
+	if( sv_areaadaptive != ( sv_area_adaptive.value != 0.0f ))
+	{
+		SV_RebuildAreaNodes( sv_area_adaptive.value != 0.0f );
+		return;
+	}
+
+	if( sv_areaadaptive )
+		SV_AdaptAreaNodes();
+}
+
+/*
+===============
+SV_RebuildAreaNodes
+
+relink all entities into new tree
+===============
+*/
+void SV_RebuildAreaNodes( qboolean adaptive )
+{
+	edict_t	*ent;
+	int	i;
+
+	memset( sv_areanodes, 0, sizeof( sv_areanodes ));
+	sv_numareanodes = 0;
+	sv_numareafree = 0;
+
+	SV_CreateAreaNode( 0, sv.worldmodel->mins, sv.worldmodel->maxs );
+
+	// old links are pointing to the cleared nodes
+	for( i = 1; i < svgame.numEntities; i++ )
+	{
+		ent = EDICT_NUM( i );
+
+		if( !ent->area.prev )
+			continue;
+
+		SV_LinkToAreaNode( ent );
+	}
+
+	sv_areaadaptive = adaptive;
+
+	if( sv_areaadaptive )
+		SV_AdaptAreaNodes();
+}
+
 /*
 ===============
 SV_ClearWorld
@@ -476,6 +874,15 @@ void SV_ClearWorld( void )
 	memset( sv_areanodes, 0, sizeof( sv_areanodes ));
 	iTouchLinkSemaphore = 0;
 	sv_numareanodes = 0;
+	sv_numareafree = 0;
+	sv_areaadaptive = ( sv_area_adaptive.value != 0.0f );
+	SV_FreeRecordedMoves();
+
+	if( svgame.querygrid )
+		SV_ResetQueryGrid( svgame.querygrid );
+
+	if( svgame.leafindex )
+		SV_ResetLeafIndex( svgame.leafindex );
 
 	SV_CreateAreaNode( 0, sv.worldmodel->mins, sv.worldmodel->maxs );
 }
@@ -525,176 +932,947 @@ void SV_TouchLinks( edict_t *ent, areanode_t *node )
 			if( touch == ent || touch->v.solid != SOLID_TRIGGER ) // disabled ?
 				continue;
 
-			if( touch->v.groupinfo && ent->v.groupinfo )
-			{
-				if( svs.groupop == GROUP_OP_AND && !FBitSet( touch->v.groupinfo, ent->v.groupinfo ))
-					continue;
+			if( touch->v.groupinfo && ent->v.groupinfo )
+			{
+				if( svs.groupop == GROUP_OP_AND && !FBitSet( touch->v.groupinfo, ent->v.groupinfo ))
+					continue;
+
+				if( svs.groupop == GROUP_OP_NAND && FBitSet( touch->v.groupinfo, ent->v.groupinfo ))
+					continue;
+			}
+
+			if( !BoundsIntersect( ent->v.absmin, ent->v.absmax, touch->v.absmin, touch->v.absmax ))
+				continue;
+
+			mod = SV_ModelHandle( touch->v.modelindex );
+
+			// check brush triggers accuracy
+			if( mod && mod->type == mod_brush )
+			{
+				// force to select bsp-hull
+				hull = SV_HullForBsp( touch, ent->v.mins, ent->v.maxs, offset );
+
+				// support for rotational triggers
+				if( FBitSet( mod->flags, MODEL_HAS_ORIGIN ) && !VectorIsNull( touch->v.angles ))
+				{
+					matrix4x4	matrix;
+					Matrix4x4_CreateFromEntity( matrix, touch->v.angles, offset, 1.0f );
+					Matrix4x4_VectorITransform( matrix, ent->v.origin, test );
+				}
+				else
+				{
+					// offset the test point appropriately for this hull.
+					VectorSubtract( ent->v.origin, offset, test );
+				}
+
+				// test hull for intersection with this model
+				if( PM_HullPointContents( hull, hull->firstclipnode, test ) != CONTENTS_SOLID )
+					continue;
+			}
+		}
+
+		// never touch the triggers when "playersonly" is active
+		if( !sv.playersonly )
+		{
+			svgame.globals->time = sv.time;
+			SV_PROFILE_BEGIN( "Touch" );
+			svgame.dllFuncs.pfnTouch( touch, ent );
+			SV_PROFILE_END();
+		}
+	}
+
+	// recurse down both sides
+	if( node->axis == -1 ) return;
+
+	if( ent->v.absmax[node->axis] > node->dist )
+		SV_TouchLinks( ent, node->children[0] );
+	if( ent->v.absmin[node->axis] < node->dist )
+		SV_TouchLinks( ent, node->children[1] );
+}
+
+/*
+===============
+SV_FindTouchedLeafs
+
+===============
+*/
+void SV_FindTouchedLeafs( edict_t *ent, mnode_t *node, int *headnode )
+{
+	int	sides;
+	mleaf_t	*leaf;
+
+	if( node->contents == CONTENTS_SOLID )
+		return;
+
+	// add an efrag if the node is a leaf
+	if( node->contents < 0 )
+	{
+		if( ent->num_leafs > ( MAX_ENT_LEAFS - 1 ))
+		{
+			// continue counting leafs,
+			// so we know how many it's overrun
+			ent->num_leafs = (MAX_ENT_LEAFS + 1);
+		}
+		else
+		{
+			leaf = (mleaf_t *)node;
+			ent->leafnums[ent->num_leafs] = leaf->cluster;
+			ent->num_leafs++;
+		}
+		return;
+	}
+
+	// NODE_MIXED
+	sides = BOX_ON_PLANE_SIDE( ent->v.absmin, ent->v.absmax, node->plane );
+
+	if(( sides == 3 ) && ( *headnode == -1 ))
+		*headnode = node - sv.worldmodel->nodes;
+
+	// recurse down the contacted sides
+	if( sides & 1 ) SV_FindTouchedLeafs( ent, node->children[0], headnode );
+	if( sides & 2 ) SV_FindTouchedLeafs( ent, node->children[1], headnode );
+}
+
+/*
+===============================================================================
+
+LEAF INDEX
+
+inverted index from pvs cluster to entities, built from leafs collected
+by SV_FindTouchedLeafs, so packet building visits only entities in
+visible clusters. Entities that game can see by other means (headnode,
+portals, phs, beams) are visited always
+
+===============================================================================
+*/
+typedef struct leafindex_s
+{
+	int		*heads;			// first link in the cluster, 0 is empty
+	int		*next;			// link is edict number * MAX_ENT_LEAFS + slot
+	int		*prev;
+	int		*numlinks;		// -1 if edict isn't indexed
+
+	// links are valid while these are unchanged
+	int		*num_leafs;
+	int		*headnode;
+	byte		*leafnums;
+
+	uint		always[MAX_EDICTS / 32];	// edicts to visit regardless of pvs
+	uint		framecount;
+} leafindex_t;
+
+/*
+===============
+SV_UnindexEntityLeafs
+
+===============
+*/
+static void SV_UnindexEntityLeafs( leafindex_t *li, int e )
+{
+	int	i, link, next, prev;
+
+	for( i = 0; i < li->numlinks[e]; i++ )
+	{
+		link = e * MAX_ENT_LEAFS + i;
+		next = li->next[link];
+		prev = li->prev[link];
+
+		if( prev > 0 ) li->next[prev] = next;
+		else li->heads[-prev] = next;	// head keeps cluster number instead of previous link
+		if( next ) li->prev[next] = prev;
+	}
+
+	li->numlinks[e] = -1;
+}
+
+/*
+===============
+SV_IndexEntityLeafs
+
+===============
+*/
+static void SV_IndexEntityLeafs( edict_t *ent )
+{
+	leafindex_t	*li = svgame.leafindex;
+	int		i, e, link, cluster;
+
+	if( !li ) return;
+
+	e = NUM_FOR_EDICT( ent );
+
+	if( li->numlinks[e] >= 0 )
+		SV_UnindexEntityLeafs( li, e );
+
+	li->numlinks[e] = 0;
+	li->num_leafs[e] = ent->num_leafs;
+	li->headnode[e] = ent->headnode;
+	memcpy( li->leafnums + e * sizeof( ent->leafnums ), ent->leafnums, sizeof( ent->leafnums ));
+
+	// headnode entities are visited always
+	if( ent->headnode >= 0 || ent->num_leafs > MAX_ENT_LEAFS )
+		return;
+
+	for( i = 0; i < ent->num_leafs; i++ )
+	{
+		cluster = ent->leafnums[i];
+		link = e * MAX_ENT_LEAFS + i;
+
+		// never visible, but keep the link so unindexing stays simple
+		if( cluster < 0 || cluster >= MAX_MAP_LEAFS )
+			cluster = MAX_MAP_LEAFS;
+
+		li->next[link] = li->heads[cluster];
+		li->prev[link] = -cluster;
+		if( li->heads[cluster] ) li->prev[li->heads[cluster]] = link;
+		li->heads[cluster] = link;
+	}
+
+	li->numlinks[e] = ent->num_leafs;
+}
+
+/*
+===============
+SV_ResetLeafIndex
+
+cluster numbers are changed with the map
+===============
+*/
+static void SV_ResetLeafIndex( leafindex_t *li )
+{
+	memset( li->heads, 0, sizeof( int ) * ( MAX_MAP_LEAFS + 1 ));
+	memset( li->numlinks, 0xFF, sizeof( int ) * GI->max_edicts );
+	li->framecount = 0;
+}
+
+/*
+===============
+SV_UpdateLeafIndex
+
+catch the leafs changed without relinking and
+collect entities that can't be found through clusters
+===============
+*/
+static leafindex_t *SV_UpdateLeafIndex( void )
+{
+	leafindex_t	*li = svgame.leafindex;
+	edict_t		*ent;
+	int		e;
+
+	if( !li )
+	{
+		if( !svgame.mempool || !svgame.edicts )
+			return NULL;
+
+		li = Mem_Calloc( svgame.mempool, sizeof( *li ));
+		li->heads = Mem_Calloc( svgame.mempool, sizeof( int ) * ( MAX_MAP_LEAFS + 1 ));
+		li->next = Mem_Calloc( svgame.mempool, sizeof( int ) * GI->max_edicts * MAX_ENT_LEAFS );
+		li->prev = Mem_Calloc( svgame.mempool, sizeof( int ) * GI->max_edicts * MAX_ENT_LEAFS );
+		li->numlinks = Mem_Calloc( svgame.mempool, sizeof( int ) * GI->max_edicts );
+		li->num_leafs = Mem_Calloc( svgame.mempool, sizeof( int ) * GI->max_edicts );
+		li->headnode = Mem_Calloc( svgame.mempool, sizeof( int ) * GI->max_edicts );
+		li->leafnums = Mem_Calloc( svgame.mempool, sizeof( svgame.edicts->leafnums ) * GI->max_edicts );
+		svgame.leafindex = li;
+		SV_ResetLeafIndex( li );
+	}
+
+	if( li->framecount == host.framecount )
+		return li;
+
+	memset( li->always, 0, sizeof( li->always ));
+
+	for( e = 1; e < svgame.numEntities; e++ )
+	{
+		ent = EDICT_NUM( e );
+
+		if( ent->free )
+		{
+			if( li->numlinks[e] >= 0 )
+				SV_UnindexEntityLeafs( li, e );
+			continue;
+		}
+
+		if( li->numlinks[e] < 0 || li->num_leafs[e] != ent->num_leafs || li->headnode[e] != ent->headnode
+		 || memcmp( li->leafnums + e * sizeof( ent->leafnums ), ent->leafnums, sizeof( ent->leafnums )))
+			SV_IndexEntityLeafs( ent );
+
+		if( e <= svs.maxclients || ent->headnode >= 0 || FBitSet( ent->v.flags, FL_CUSTOMENTITY )
+		 || FBitSet( ent->v.effects, EF_REQUEST_PHS|EF_MERGE_VISIBILITY ))
+			SetBits( li->always[e >> 5], BIT( e & 31 ));
+	}
+
+	li->framecount = host.framecount;
+
+	return li;
+}
+
+/*
+===============
+SV_VisibleEntities
+
+entities that may pass pvs check, false if all must be visited
+===============
+*/
+qboolean SV_VisibleEntities( const byte *pvs, uint *visible )
+{
+	leafindex_t	*li;
+	int		i, b, e, link, cluster;
+
+	if( !sv_leaf_index.value || !pvs || !sv.worldmodel )
+		return false;
+
+	if( !( li = SV_UpdateLeafIndex( )))
+		return false;
+
+	memcpy( visible, li->always, sizeof( li->always ));
+
+	for( i = 0; i < world.visbytes; i++ )
+	{
+		if( !pvs[i] ) continue;
+
+		for( b = 0; b < 8; b++ )
+		{
+			cluster = ( i << 3 ) + b;
+
+			if( !FBitSet( pvs[i], BIT( b )) || cluster >= MAX_MAP_LEAFS )
+				continue;
+
+			for( link = li->heads[cluster]; link; link = li->next[link] )
+			{
+				e = link / MAX_ENT_LEAFS;
+				SetBits( visible[e >> 5], BIT( e & 31 ));
+			}
+		}
+	}
+
+	return true;
+}
+
+/*
+===============
+SV_LinkEdict
+===============
+*/
+void SV_LinkEdict( edict_t *ent, qboolean touch_triggers )
+{
+	int		headnode;
+
+	if( ent->area.prev ) SV_UnlinkEdict( ent );	// unlink from old position
+	if( ent == svgame.edicts ) return;		// don't add the world
+	if( !SV_IsValidEdict( ent )) return;		// never add freed ents
+
+	SV_RelinkFindIndex( ent );
+
+	// set the abs box
+	svgame.dllFuncs.pfnSetAbsBox( ent );
+	SV_LinkQueryEdict( ent );
+
+	if( ent->v.movetype == MOVETYPE_FOLLOW && SV_IsValidEdict( ent->v.aiment ))
+	{
+		memcpy( ent->leafnums, ent->v.aiment->leafnums, sizeof( ent->leafnums ));
+		ent->num_leafs = ent->v.aiment->num_leafs;
+		ent->headnode = ent->v.aiment->headnode;
+	}
+	else
+	{
+		// link to PVS leafs
+		ent->num_leafs = 0;
+		ent->headnode = -1;
+		headnode = -1;
+
+		if( ent->v.modelindex )
+			SV_FindTouchedLeafs( ent, sv.worldmodel->nodes, &headnode );
+
+		if( ent->num_leafs > MAX_ENT_LEAFS )
+		{
+			memset( ent->leafnums, -1, sizeof( ent->leafnums ));
+			ent->num_leafs = 0;	// so we use headnode instead
+			ent->headnode = headnode;
+		}
+	}
+
+	SV_IndexEntityLeafs( ent );
+
+	// ignore non-solid bodies
+	if( ent->v.solid == SOLID_NOT && ent->v.skin >= CONTENTS_EMPTY )
+		return;
+
+	SV_LinkToAreaNode( ent );
+
+	if( touch_triggers && !iTouchLinkSemaphore )
+	{
+		iTouchLinkSemaphore = true;
+		SV_TouchLinks( ent, sv_areanodes );
+		iTouchLinkSemaphore = false;
+	}
+}
+
+/*
+===============================================================================
+
+ENTITY QUERIES
+
+two level 2d grid over entity boxes for radius and pvs queries.
+entities that weren't linked since spawn can have any box,
+so they are kept in separate list and checked by every query
+
+===============================================================================
+*/
+#define QUERY_CELL_SIZE	256.0f
+#define QUERY_BIGCELL_SIZE	2048.0f
+#define QUERY_MAX_COORD	262144.0f		// boxes beyond are checked by every query
+#define QUERY_HASH_SIZE	4096
+#define QUERY_LIST_HUGE	( QUERY_HASH_SIZE * 2 )
+#define QUERY_LIST_UNLINKED	( QUERY_LIST_HUGE + 1 )
+#define QUERY_NUM_LISTS	( QUERY_LIST_UNLINKED + 1 )
+
+typedef struct querygrid_s
+{
+	int		heads[QUERY_NUM_LISTS];	// first edict in the list, 0 is empty
+	int		*next;
+	int		*prev;
+	int		*list;			// list the edict is in, -1 if none
+	uint		generation;		// changed by any relink
+
+	// lists are walked once per query, hashed cells may collide
+	uint		visited[QUERY_NUM_LISTS];
+	uint		querycount;
+
+	// sphere results are kept for "start edict" continuation
+	int		*results;
+	int		numresults;
+	int		lastresult;
+	uint		resultgen;
+	vec3_t		resultorg;
+	float		resultradius;
+} querygrid_t;
+
+/*
+===============
+SV_RemoveQueryLink
+
+===============
+*/
+static void SV_RemoveQueryLink( querygrid_t *qg, int e )
+{
+	int	next = qg->next[e];
+	int	prev = qg->prev[e];
+
+	if( qg->list[e] < 0 )
+		return;
+
+	if( prev ) qg->next[prev] = next;
+	else qg->heads[qg->list[e]] = next;
+	if( next ) qg->prev[next] = prev;
+
+	qg->next[e] = qg->prev[e] = 0;
+	qg->list[e] = -1;
+	qg->generation++;
+}
+
+/*
+===============
+SV_InsertQueryLink
+
+===============
+*/
+static void SV_InsertQueryLink( querygrid_t *qg, int e, int list )
+{
+	SV_RemoveQueryLink( qg, e );
+
+	qg->next[e] = qg->heads[list];
+	qg->prev[e] = 0;
+	if( qg->heads[list] ) qg->prev[qg->heads[list]] = e;
+	qg->heads[list] = e;
+	qg->list[e] = list;
+	qg->generation++;
+}
+
+/*
+===============
+SV_ResetQueryGrid
+
+===============
+*/
+static void SV_ResetQueryGrid( querygrid_t *qg )
+{
+	int	e;
+
+	memset( qg->heads, 0, sizeof( qg->heads ));
+	memset( qg->next, 0, sizeof( int ) * GI->max_edicts );
+	memset( qg->prev, 0, sizeof( int ) * GI->max_edicts );
+	memset( qg->list, 0xFF, sizeof( int ) * GI->max_edicts );
+
+	// we know nothing about boxes of existing entities
+	for( e = 1; e < svgame.numEntities; e++ )
+	{
+		if( !EDICT_NUM( e )->free )
+			SV_InsertQueryLink( qg, e, QUERY_LIST_UNLINKED );
+	}
+
+	qg->numresults = 0;
+	qg->generation++;
+}
+
+/*
+===============
+SV_GetQueryGrid
+
+===============
+*/
+static querygrid_t *SV_GetQueryGrid( void )
+{
+	querygrid_t	*qg = svgame.querygrid;
+
+	if( qg || !svgame.mempool || !svgame.edicts )
+		return qg;
+
+	qg = Mem_Calloc( svgame.mempool, sizeof( *qg ));
+	qg->next = Mem_Calloc( svgame.mempool, sizeof( int ) * GI->max_edicts );
+	qg->prev = Mem_Calloc( svgame.mempool, sizeof( int ) * GI->max_edicts );
+	qg->list = Mem_Calloc( svgame.mempool, sizeof( int ) * GI->max_edicts );
+	qg->results = Mem_Calloc( svgame.mempool, sizeof( int ) * GI->max_edicts );
+	svgame.querygrid = qg;
+
+	SV_ResetQueryGrid( qg );
+
+	return qg;
+}
+
+/*
+===============
+SV_QueryCell
+
+===============
+*/
+static int SV_QueryCell( int x, int y, int level )
+{
+	return level * QUERY_HASH_SIZE + ((((uint)x * 73856093U ) ^ ((uint)y * 19349663U )) & ( QUERY_HASH_SIZE - 1 ));
+}
+
+/*
+===============
+SV_QueryListForBox
+
+entity goes to the cell of its center, so boxes
+can stick out of the cell up to half of cell size
+===============
+*/
+static int SV_QueryListForBox( const vec3_t absmin, const vec3_t absmax )
+{
+	float	cx, cy, size;
+
+	// reversed or NaN boxes
+	if( !( absmax[0] >= absmin[0] && absmax[1] >= absmin[1] && absmax[2] >= absmin[2] ))
+		return QUERY_LIST_HUGE;
+
+	cx = 0.5f * ( absmin[0] + absmax[0] );
+	cy = 0.5f * ( absmin[1] + absmax[1] );
+	size = Q_max( absmax[0] - absmin[0], absmax[1] - absmin[1] );
+
+	if( !( fabs( cx ) < QUERY_MAX_COORD && fabs( cy ) < QUERY_MAX_COORD ))
+		return QUERY_LIST_HUGE;
+
+	if( size <= QUERY_CELL_SIZE )
+		return SV_QueryCell( floor( cx / QUERY_CELL_SIZE ), floor( cy / QUERY_CELL_SIZE ), 0 );
+
+	if( size <= QUERY_BIGCELL_SIZE )
+		return SV_QueryCell( floor( cx / QUERY_BIGCELL_SIZE ), floor( cy / QUERY_BIGCELL_SIZE ), 1 );
+
+	return QUERY_LIST_HUGE;
+}
+
+/*
+===============
+SV_InitQueryEdict
+
+edict was (re)spawned or restored, its box isn't known until linked
+===============
+*/
+void SV_InitQueryEdict( edict_t *ent )
+{
+	querygrid_t	*qg = svgame.querygrid;
+	int		e;
+
+	if( !qg ) return;
+
+	e = NUM_FOR_EDICT( ent );
+	if( e > 0 && e < GI->max_edicts )
+		SV_InsertQueryLink( qg, e, QUERY_LIST_UNLINKED );
+}
+
+/*
+===============
+SV_RemoveQueryEdict
+
+===============
+*/
+void SV_RemoveQueryEdict( edict_t *ent )
+{
+	querygrid_t	*qg = svgame.querygrid;
+	int		e;
+
+	if( !qg ) return;
+
+	e = NUM_FOR_EDICT( ent );
+	if( e > 0 && e < GI->max_edicts )
+		SV_RemoveQueryLink( qg, e );
+}
+
+/*
+===============
+SV_LinkQueryEdict
+
+===============
+*/
+static void SV_LinkQueryEdict( edict_t *ent )
+{
+	querygrid_t	*qg = svgame.querygrid;
+	int		e, list;
+
+	if( !qg ) return;
+
+	e = NUM_FOR_EDICT( ent );
+	list = SV_QueryListForBox( ent->v.absmin, ent->v.absmax );
+
+	if( qg->list[e] != list )
+		SV_InsertQueryLink( qg, e, list );
+	else qg->generation++; // same cell, but the box has changed
+}
+
+/*
+===============
+SV_EntityInSphere
+
+same test as linear search does
+===============
+*/
+static qboolean SV_EntityInSphere( edict_t *ent, int e, const float *org, float radius2 )
+{
+	float	distSquared = 0.0f;
+	float	eorg;
+	int	j;
+
+	if( !SV_IsValidEdict( ent ))
+		return false;
+
+	// ignore clients that not in a game
+	if( e <= svs.maxclients && !SV_ClientFromEdict( ent, true ))
+		return false;
+
+	for( j = 0; j < 3 && distSquared <= radius2; j++ )
+	{
+		if( org[j] < ent->v.absmin[j] )
+			eorg = org[j] - ent->v.absmin[j];
+		else if( org[j] > ent->v.absmax[j] )
+			eorg = org[j] - ent->v.absmax[j];
+		else eorg = 0.0f;
+
+		distSquared += eorg * eorg;
+	}
+
+	return distSquared < radius2;
+}
+
+/*
+===============
+SV_GatherQueryList
+
+===============
+*/
+static void SV_GatherQueryList( querygrid_t *qg, int list, int start, const float *org, float radius2 )
+{
+	int	e;
+
+	// edict is in one list only, so results can't have duplicates
+	if( qg->visited[list] == qg->querycount )
+		return;
+	qg->visited[list] = qg->querycount;
+
+	for( e = qg->heads[list]; e; e = qg->next[e] )
+	{
+		if( e <= start || e >= svgame.numEntities )
+			continue;
+
+		if( qg->numresults >= GI->max_edicts )
+		{
+			Con_Reportf( S_ERROR "SV_GatherQueryList: results overflow\n" );
+			return;
+		}
+
+		if( SV_EntityInSphere( EDICT_NUM( e ), e, org, radius2 ))
+			qg->results[qg->numresults++] = e;
+	}
+}
+
+/*
+===============
+SV_GatherQueryLevel
+
+===============
+*/
+static void SV_GatherQueryLevel( querygrid_t *qg, int level, float cellsize, int start, const float *org, float radius )
+{
+	int	x, y, xmin, xmax, ymin, ymax;
+	float	radius2 = radius * radius;
+
+	// boxes stick out of their cells up to a half of cell
+	xmin = floor(( org[0] - radius ) / cellsize - 1.5f );
+	xmax = floor(( org[0] + radius ) / cellsize + 0.5f );
+	ymin = floor(( org[1] - radius ) / cellsize - 1.5f );
+	ymax = floor(( org[1] + radius ) / cellsize + 0.5f );
+
+	if(( xmax - xmin + 1 ) * ( ymax - ymin + 1 ) >= QUERY_HASH_SIZE / 2 )
+	{
+		// faster to walk all cells once
+		for( x = 0; x < QUERY_HASH_SIZE; x++ )
+			SV_GatherQueryList( qg, level * QUERY_HASH_SIZE + x, start, org, radius2 );
+		return;
+	}
+
+	// hash collisions can add same cell twice, it's walked once
+	for( x = xmin; x <= xmax; x++ )
+	{
+		for( y = ymin; y <= ymax; y++ )
+			SV_GatherQueryList( qg, SV_QueryCell( x, y, level ), start, org, radius2 );
+	}
+}
+
+static int SV_CompareEdictNums( const void *a, const void *b )
+{
+	return *(const int *)a - *(const int *)b;
+}
+
+/*
+===============
+SV_QueryEntityInSphere
 
-				if( svs.groupop == GROUP_OP_NAND && FBitSet( touch->v.groupinfo, ent->v.groupinfo ))
-					continue;
-			}
+returns false when linear search is required,
+otherwise result is first entity after the start in edict order
+===============
+*/
+qboolean SV_QueryEntityInSphere( edict_t *pStartEdict, const float *org, float flRadius, edict_t **result )
+{
+	querygrid_t	*qg;
+	float		radius2, radius;
+	int		i, e = 0;
+	edict_t		*ent;
 
-			if( !BoundsIntersect( ent->v.absmin, ent->v.absmax, touch->v.absmin, touch->v.absmax ))
-				continue;
+	if( !sv_spatial_query.value || !( qg = SV_GetQueryGrid( )))
+		return false;
 
-			mod = SV_ModelHandle( touch->v.modelindex );
+	radius = fabs( flRadius );
+	radius2 = flRadius * flRadius;
 
-			// check brush triggers accuracy
-			if( mod && mod->type == mod_brush )
-			{
-				// force to select bsp-hull
-				hull = SV_HullForBsp( touch, ent->v.mins, ent->v.maxs, offset );
+	// let linear search handle the weird ones
+	if( !( radius < QUERY_MAX_COORD && fabs( org[0] ) < QUERY_MAX_COORD && fabs( org[1] ) < QUERY_MAX_COORD ))
+		return false;
 
-				// support for rotational triggers
-				if( FBitSet( mod->flags, MODEL_HAS_ORIGIN ) && !VectorIsNull( touch->v.angles ))
-				{
-					matrix4x4	matrix;
-					Matrix4x4_CreateFromEntity( matrix, touch->v.angles, offset, 1.0f );
-					Matrix4x4_VectorITransform( matrix, ent->v.origin, test );
-				}
-				else
-				{
-					// offset the test point appropriately for this hull.
-					VectorSubtract( ent->v.origin, offset, test );
-				}
+	if( SV_IsValidEdict( pStartEdict ))
+		e = NUM_FOR_EDICT( pStartEdict );
 
-				// test hull for intersection with this model
-				if( PM_HullPointContents( hull, hull->firstclipnode, test ) != CONTENTS_SOLID )
-					continue;
-			}
+	if( e > 0 && qg->resultgen == qg->generation && qg->lastresult < qg->numresults && qg->results[qg->lastresult] == e
+	 && VectorCompare( org, qg->resultorg ) && flRadius == qg->resultradius )
+	{
+		// nothing was relinked since previous call, continue from there
+		i = qg->lastresult + 1;
+	}
+	else
+	{
+		// new set of visited lists
+		if( ++qg->querycount == 0 )
+		{
+			memset( qg->visited, 0, sizeof( qg->visited ));
+			qg->querycount = 1;
 		}
 
-		// never touch the triggers when "playersonly" is active
-		if( !sv.playersonly )
+		qg->numresults = 0;
+		SV_GatherQueryLevel( qg, 0, QUERY_CELL_SIZE, e, org, radius );
+		SV_GatherQueryLevel( qg, 1, QUERY_BIGCELL_SIZE, e, org, radius );
+		SV_GatherQueryList( qg, QUERY_LIST_HUGE, e, org, radius2 );
+		SV_GatherQueryList( qg, QUERY_LIST_UNLINKED, e, org, radius2 );
+
+		qsort( qg->results, qg->numresults, sizeof( int ), SV_CompareEdictNums );
+
+		qg->resultgen = qg->generation;
+		qg->resultradius = flRadius;
+		VectorCopy( org, qg->resultorg );
+		i = 0;
+	}
+
+	for( ; i < qg->numresults; i++ )
+	{
+		ent = EDICT_NUM( qg->results[i] );
+
+		// clients may leave the game between calls
+		if( SV_EntityInSphere( ent, qg->results[i], org, radius2 ))
 		{
-			svgame.globals->time = sv.time;
-			svgame.dllFuncs.pfnTouch( touch, ent );
+			qg->lastresult = i;
+			*result = ent;
+			return true;
 		}
 	}
 
-	// recurse down both sides
-	if( node->axis == -1 ) return;
+	qg->lastresult = qg->numresults;
+	*result = svgame.edicts;
 
-	if( ent->v.absmax[node->axis] > node->dist )
-		SV_TouchLinks( ent, node->children[0] );
-	if( ent->v.absmin[node->axis] < node->dist )
-		SV_TouchLinks( ent, node->children[1] );
+	return true;
 }
 
 /*
 ===============
-SV_FindTouchedLeafs
+SV_QueryEntitiesInPVS
 
+linked entities keep their pvs leafs, so most of them
+are tested against pvs bits instead of walking the bsp
 ===============
 */
-void SV_FindTouchedLeafs( edict_t *ent, mnode_t *node, int *headnode )
+qboolean SV_QueryEntitiesInPVS( edict_t *pview, edict_t **result )
 {
-	int	sides;
-	mleaf_t	*leaf;
+	querygrid_t	*qg;
+	edict_t		*pchain, *pent, *ptest;
+	vec3_t		viewpoint;
+	qboolean		visible;
+	byte		*pvs;
+	int		i, j;
+
+	if( !sv_spatial_query.value || !( qg = SV_GetQueryGrid( )))
+		return false;
 
-	if( node->contents == CONTENTS_SOLID )
-		return;
+	VectorAdd( pview->v.origin, pview->v.view_ofs, viewpoint );
+	pvs = Mod_GetPVSForPoint( viewpoint );
+	pchain = EDICT_NUM( 0 );
 
-	// add an efrag if the node is a leaf
-	if( node->contents < 0 )
+	for( i = 1; i < svgame.numEntities; i++ )
 	{
-		if( ent->num_leafs > ( MAX_ENT_LEAFS - 1 ))
+		pent = EDICT_NUM( i );
+
+		if( !SV_IsValidEdict( pent ))
+			continue;
+
+		if( !pvs )
 		{
-			// continue counting leafs,
-			// so we know how many it's overrun
-			ent->num_leafs = (MAX_ENT_LEAFS + 1);
+			visible = true;
 		}
-		else
+		else if( pent->v.movetype == MOVETYPE_FOLLOW && SV_IsValidEdict( pent->v.aiment ))
 		{
-			leaf = (mleaf_t *)node;
-			ent->leafnums[ent->num_leafs] = leaf->cluster;
-			ent->num_leafs++;
+			// aiment could move after we was linked
+			ptest = pent->v.aiment;
+			visible = Mod_BoxVisible( ptest->v.absmin, ptest->v.absmax, pvs );
 		}
-		return;
-	}
+		else if( qg->list[i] >= 0 && qg->list[i] != QUERY_LIST_UNLINKED && pent->num_leafs > 0 )
+		{
+			// leafs were collected for current box by SV_LinkEdict
+			for( j = 0, visible = false; j < pent->num_leafs && !visible; j++ )
+				visible = CHECKVISBIT( pvs, pent->leafnums[j] ) ? true : false;
+		}
+		else visible = Mod_BoxVisible( pent->v.absmin, pent->v.absmax, pvs );
 
-	// NODE_MIXED
-	sides = BOX_ON_PLANE_SIDE( ent->v.absmin, ent->v.absmax, node->plane );
+		if( visible )
+		{
+			pent->v.chain = pchain;
+			pchain = pent;
+		}
+	}
 
-	if(( sides == 3 ) && ( *headnode == -1 ))
-		*headnode = node - sv.worldmodel->nodes;
+	*result = pchain;
 
-	// recurse down the contacted sides
-	if( sides & 1 ) SV_FindTouchedLeafs( ent, node->children[0], headnode );
-	if( sides & 2 ) SV_FindTouchedLeafs( ent, node->children[1], headnode );
+	return true;
 }
 
 /*
-===============
-SV_LinkEdict
-===============
+==================
+SV_SphereBench_f
+
+sv_sphere_bench [entities] [queries] [radius]
+==================
 */
-void SV_LinkEdict( edict_t *ent, qboolean touch_triggers )
+void SV_SphereBench_f( void )
 {
-	areanode_t	*node;
-	int		headnode;
+	int		i, j, numents, numqueries;
+	int		found[2], checksum[2];
+	double		start, elapsed[2];
+	edict_t		**ents, *ent;
+	float		radius, size;
+	vec3_t		*origins;
+	string		saved;
+	model_t		*world = sv.worldmodel;
+	int		total;
+
+	if( sv.state != ss_active )
+	{
+		Con_Printf( "Server is not active\n" );
+		return;
+	}
 
-	if( ent->area.prev ) SV_UnlinkEdict( ent );	// unlink from old position
-	if( ent == svgame.edicts ) return;		// don't add the world
-	if( !SV_IsValidEdict( ent )) return;		// never add freed ents
+	numents = Cmd_Argc() > 1 ? Q_atoi( Cmd_Argv( 1 )) : 4000;
+	numqueries = Cmd_Argc() > 2 ? Q_atoi( Cmd_Argv( 2 )) : 10000;
+	radius = Cmd_Argc() > 3 ? Q_atof( Cmd_Argv( 3 )) : 256.0f;
+	numents = bound( 0, numents, GI->max_edicts - svgame.numEntities );
+	numqueries = Q_max( numqueries, 1 );
 
-	// set the abs box
-	svgame.dllFuncs.pfnSetAbsBox( ent );
+	ents = Mem_Malloc( host.mempool, sizeof( *ents ) * Q_max( numents, 1 ));
+	origins = Mem_Malloc( host.mempool, sizeof( *origins ) * numqueries );
+	COM_SetRandomSeed( 1 );
 
-	if( ent->v.movetype == MOVETYPE_FOLLOW && SV_IsValidEdict( ent->v.aiment ))
-	{
-		memcpy( ent->leafnums, ent->v.aiment->leafnums, sizeof( ent->leafnums ));
-		ent->num_leafs = ent->v.aiment->num_leafs;
-		ent->headnode = ent->v.aiment->headnode;
-	}
-	else
+	// engine-only entities, game dll never sees them spawned
+	for( i = 0; i < numents; i++ )
 	{
-		// link to PVS leafs
-		ent->num_leafs = 0;
-		ent->headnode = -1;
-		headnode = -1;
+		ent = ents[i] = SV_AllocEdict();
+		size = ( i & 15 ) ? COM_RandomFloat( 8.0f, 32.0f ) : COM_RandomFloat( 128.0f, 1024.0f );
 
-		if( ent->v.modelindex )
-			SV_FindTouchedLeafs( ent, sv.worldmodel->nodes, &headnode );
-
-		if( ent->num_leafs > MAX_ENT_LEAFS )
+		for( j = 0; j < 3; j++ )
 		{
-			memset( ent->leafnums, -1, sizeof( ent->leafnums ));
-			ent->num_leafs = 0;	// so we use headnode instead
-			ent->headnode = headnode;
+			ent->v.origin[j] = COM_RandomFloat( world->mins[j], world->maxs[j] );
+			ent->v.absmin[j] = ent->v.origin[j] - size;
+			ent->v.absmax[j] = ent->v.origin[j] + size;
 		}
-	}
-
-	// ignore non-solid bodies
-	if( ent->v.solid == SOLID_NOT && ent->v.skin >= CONTENTS_EMPTY )
-		return;
 
-	// find the first node that the ent's box crosses
-	node = sv_areanodes;
+		ent->v.solid = SOLID_NOT;
+		SV_LinkQueryEdict( ent );
+	}
 
-	while( 1 )
+	for( i = 0; i < numqueries; i++ )
 	{
-		if( node->axis == -1 ) break;
-		if( ent->v.absmin[node->axis] > node->dist )
-			node = node->children[0];
-		else if( ent->v.absmax[node->axis] < node->dist )
-			node = node->children[1];
-		else break; // crosses the node
+		for( j = 0; j < 3; j++ )
+			origins[i][j] = COM_RandomFloat( world->mins[j], world->maxs[j] );
 	}
 
-	// link it in
-	if( ent->v.solid == SOLID_TRIGGER )
-		InsertLinkBefore( &ent->area, &node->trigger_edicts );
-	else if( ent->v.solid == SOLID_PORTAL )
-		InsertLinkBefore( &ent->area, &node->portal_edicts );
-	else InsertLinkBefore( &ent->area, &node->solid_edicts );
+	Q_strncpy( saved, sv_spatial_query.string, sizeof( saved ));
+	total = svgame.numEntities - 1;
 
-	if( touch_triggers && !iTouchLinkSemaphore )
+	for( i = 0; i < 2; i++ )
 	{
-		iTouchLinkSemaphore = true;
-		SV_TouchLinks( ent, sv_areanodes );
-		iTouchLinkSemaphore = false;
+		Cvar_DirectSet( &sv_spatial_query, i ? "1" : "0" );
+		found[i] = checksum[i] = 0;
+		start = Sys_DoubleTime();
+
+		for( j = 0; j < numqueries; j++ )
+		{
+			ent = NULL;
+
+			while(( ent = pfnFindEntityInSphere( ent, origins[j], radius )) != svgame.edicts )
+			{
+				checksum[i] = checksum[i] * 31 + NUM_FOR_EDICT( ent );
+				found[i]++;
+			}
+		}
+
+		elapsed[i] = Sys_DoubleTime() - start;
+
+		Con_Printf( "%s: %.0f queries per second, %.1f entities per query\n", i ? "grid" : "linear",
+			numqueries / Q_max( elapsed[i], 0.000001 ), (double)found[i] / numqueries );
 	}
+
+	Cvar_DirectSet( &sv_spatial_query, saved );
+
+	for( i = 0; i < numents; i++ )
+		SV_FreeEdict( ents[i] );
+
+	Con_Printf( "%d entities, %d queries, radius %g, speedup %.2fx, results %s\n", total, numqueries,
+		radius, elapsed[0] / Q_max( elapsed[1], 0.000001 ), checksum[0] == checksum[1] && found[0] == found[1] ? "match" : "DIFFER" );
+
+	Mem_Free( origins );
+	Mem_Free( ents );
 }
 
 /*
@@ -1341,6 +2519,203 @@ void SV_ClipToWorldBrush( areanode_t *node, moveclip_t *clip )
 		SV_ClipToWorldBrush( node->children[1], clip );
 }
 
+/*
+===============================================================================
+
+AREA BENCHMARK
+
+===============================================================================
+*/
+typedef struct
+{
+	vec3_t		start;
+	vec3_t		mins;
+	vec3_t		maxs;
+	vec3_t		end;
+	int		type;
+	int		passent;
+	qboolean		monsterclip;
+} sv_recmove_t;
+
+static struct
+{
+	sv_recmove_t	*moves;
+	int		nummoves;
+	int		maxmoves;		// still recording while nummoves < maxmoves
+} sv_areabench;
+
+/*
+==================
+SV_RecordMove
+
+==================
+*/
+static void SV_RecordMove( const vec3_t start, vec3_t mins, vec3_t maxs, const vec3_t end, int type, edict_t *e, qboolean monsterclip )
+{
+	sv_recmove_t	*move = &sv_areabench.moves[sv_areabench.nummoves++];
+
+	VectorCopy( start, move->start );
+	VectorCopy( mins, move->mins );
+	VectorCopy( maxs, move->maxs );
+	VectorCopy( end, move->end );
+	move->type = type;
+	move->passent = e ? NUM_FOR_EDICT( e ) : 0;
+	move->monsterclip = monsterclip;
+
+	if( sv_areabench.nummoves == sv_areabench.maxmoves )
+		Con_Printf( "sv_area_bench: recorded %d moves\n", sv_areabench.nummoves );
+}
+
+/*
+==================
+SV_FreeRecordedMoves
+
+==================
+*/
+static void SV_FreeRecordedMoves( void )
+{
+	if( sv_areabench.moves )
+		Mem_Free( sv_areabench.moves );
+	memset( &sv_areabench, 0, sizeof( sv_areabench ));
+}
+
+/*
+==================
+SV_ReplayMoves
+
+returns elapsed time, results of first iteration are stored
+==================
+*/
+static double SV_ReplayMoves( trace_t *results, int iterations )
+{
+	sv_recmove_t	*move;
+	double		start;
+	edict_t		*e;
+	trace_t		tr;
+	int		i, j;
+
+	start = Sys_DoubleTime();
+
+	for( i = 0; i < iterations; i++ )
+	{
+		for( j = 0, move = sv_areabench.moves; j < sv_areabench.nummoves; j++, move++ )
+		{
+			e = NULL;
+
+			if( move->passent > 0 && move->passent < svgame.numEntities )
+			{
+				e = EDICT_NUM( move->passent );
+				if( !SV_IsValidEdict( e )) e = NULL;
+			}
+
+			tr = SV_Move( move->start, move->mins, move->maxs, move->end, move->type, e, move->monsterclip );
+			if( i == 0 ) results[j] = tr;
+		}
+	}
+
+	return Sys_DoubleTime() - start;
+}
+
+/*
+==================
+SV_AreaNodeStats
+
+==================
+*/
+static void SV_AreaNodeStats( int *maxdepth, int *maxlinks )
+{
+	int	i;
+
+	*maxdepth = *maxlinks = 0;
+
+	for( i = 0; i < sv_numareanodes; i++ )
+	{
+		*maxdepth = Q_max( *maxdepth, sv_areainfo[i].depth );
+		*maxlinks = Q_max( *maxlinks, SV_CountAreaLinks( &sv_areanodes[i] ));
+	}
+}
+
+/*
+==================
+SV_AreaBench_f
+
+sv_area_bench record [count]
+sv_area_bench [iterations]
+==================
+*/
+void SV_AreaBench_f( void )
+{
+	trace_t		*results[2];
+	double		elapsed[2];
+	globalvars_t	globals;
+	int		i, iterations;
+	int		maxdepth, maxlinks;
+	int		mismatches = 0;
+
+	if( sv.state != ss_active )
+	{
+		Con_Printf( "Server is not active\n" );
+		return;
+	}
+
+	if( Cmd_Argc() > 1 && !Q_stricmp( Cmd_Argv( 1 ), "record" ))
+	{
+		SV_FreeRecordedMoves();
+		sv_areabench.maxmoves = Cmd_Argc() > 2 ? Q_atoi( Cmd_Argv( 2 )) : 10000;
+		sv_areabench.maxmoves = bound( 1, sv_areabench.maxmoves, 1000000 );
+		sv_areabench.moves = Mem_Malloc( host.mempool, sizeof( sv_recmove_t ) * sv_areabench.maxmoves );
+		Con_Printf( "sv_area_bench: recording next %d moves\n", sv_areabench.maxmoves );
+		return;
+	}
+
+	if( !sv_areabench.nummoves )
+	{
+		Con_Printf( "No recorded moves, use \"sv_area_bench record [count]\" first\n" );
+		return;
+	}
+
+	// stop recording
+	sv_areabench.maxmoves = sv_areabench.nummoves;
+	iterations = Cmd_Argc() > 1 ? Q_atoi( Cmd_Argv( 1 )) : 10;
+	iterations = Q_max( iterations, 1 );
+
+	// replay must not leave traces in game globals
+	globals = *svgame.globals;
+
+	for( i = 0; i < 2; i++ )
+	{
+		results[i] = Mem_Malloc( host.mempool, sizeof( trace_t ) * sv_areabench.nummoves );
+		SV_RebuildAreaNodes( i );
+		elapsed[i] = SV_ReplayMoves( results[i], iterations );
+		SV_AreaNodeStats( &maxdepth, &maxlinks );
+
+		Con_Printf( "%s tree: %d nodes, depth %d, max %d links in node, %.0f queries per second\n",
+			i ? "adaptive" : "fixed", sv_numareanodes - sv_numareafree, maxdepth, maxlinks,
+			(double)sv_areabench.nummoves * iterations / Q_max( elapsed[i], 0.000001 ));
+	}
+
+	*svgame.globals = globals;
+	SV_RebuildAreaNodes( sv_area_adaptive.value != 0.0f );
+
+	for( i = 0; i < sv_areabench.nummoves; i++ )
+	{
+		trace_t	*a = &results[0][i], *b = &results[1][i];
+
+		if( a->fraction != b->fraction || a->ent != b->ent || !VectorCompare( a->endpos, b->endpos ))
+			mismatches++;
+		else if( a->allsolid != b->allsolid || a->startsolid != b->startsolid || a->inopen != b->inopen || a->inwater != b->inwater )
+			mismatches++;
+		else if( !VectorCompare( a->plane.normal, b->plane.normal ) || a->plane.dist != b->plane.dist || a->hitgroup != b->hitgroup )
+			mismatches++;
+	}
+
+	Con_Printf( "%d moves, %d iterations, speedup %.2fx, %d traces differ\n", sv_areabench.nummoves,
+		iterations, elapsed[0] / Q_max( elapsed[1], 0.000001 ), mismatches );
+
+	Mem_Free( results[0] );
+	Mem_Free( results[1] );
+}
+
 /*
 ==================
 SV_Move
@@ -1352,6 +2727,9 @@ trace_t SV_Move( const vec3_t start, vec3_t mins, vec3_t maxs, const vec3_t end,
 	vec3_t		trace_endpos;
 	float		trace_fraction;
 
+	if( sv_areabench.nummoves < sv_areabench.maxmoves )
+		SV_RecordMove( start, mins, maxs, end, type, e, monsterclip );
+
 	memset( &clip, 0, sizeof( moveclip_t ));
 	SV_ClipMoveToEntity( EDICT_NUM( 0 ), start, mins, maxs, end, &clip.trace );
 